@@ -0,0 +1,2364 @@
+#include "Benchmarks.h"
+#include "ObjLoader.h"
+#include "MeshOptimizer.h"
+#include "TangentGenerator.h"
+#include "PackedVertex.h"
+#include "Meshlet.h"
+#include "OffsetAllocator.h"
+#include "TransformStore.h"
+#include "EntityWorld.h"
+#include "Components.h"
+#include "JobSystem.h"
+#include "TripleBuffer.h"
+#include "DynamicBVH.h"
+#include "OcclusionCuller.h"
+#include "SpatialHashGrid.h"
+#include "SphereNarrowphase.h"
+#include "MeshBounds.h"
+#include "MeshBVH.h"
+#include "PhysicsWorld.h"
+#include "FracturePattern.h"
+#include "ShardPool.h"
+#include "SeededRandom.h"
+#include <Windows.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+using namespace DirectX;
+using namespace SeededRandom; // Every benchmark has its own seed so runs repeat
+
+namespace
+{
+	const char* SyntheticObjFile = "models\\benchmark_synthetic.obj";
+
+	double GetSeconds()
+	{
+		LARGE_INTEGER now, frequency;
+		QueryPerformanceCounter(&now);
+		QueryPerformanceFrequency(&frequency);
+		return (double)now.QuadPart / (double)frequency.QuadPart;
+	}
+
+	void PrintObjResult(const char* label, const ObjLoadStats& stats)
+	{
+		double megabytes = stats.bytes / (1024.0 * 1024.0);
+		std::cout << "    " << label << ": " << stats.seconds * 1000.0 << "ms, "
+			<< megabytes / stats.seconds << " MB/s, "
+			<< stats.triangles / stats.seconds << " tris/s" << std::endl;
+	}
+
+	// True if any part of the triangle could end up on screen facing the camera
+	bool TriangleVisible(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c, const Frustum& frustum, XMVECTOR eye)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&a);
+		XMVECTOR normal = XMVector3Cross(XMLoadFloat3(&b) - p0, XMLoadFloat3(&c) - p0);
+		if (XMVectorGetX(XMVector3Dot(normal, eye - p0)) <= 0.0f)
+		{
+			return false;
+		}
+		for (int i = 0; i < 6; i++)
+		{
+			XMFLOAT4 planeValues = frustum.GetPlane(i);
+			XMVECTOR plane = XMLoadFloat4(&planeValues);
+			if (XMVectorGetX(XMPlaneDotCoord(plane, XMLoadFloat3(&a))) < 0.0f &&
+				XMVectorGetX(XMPlaneDotCoord(plane, XMLoadFloat3(&b))) < 0.0f &&
+				XMVectorGetX(XMPlaneDotCoord(plane, XMLoadFloat3(&c))) < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// The shape of the old per-object path: a script found through a base pointer with RTTI
+	struct LegacyScript
+	{
+		virtual ~LegacyScript() {}
+	};
+	struct LegacyBullet : LegacyScript
+	{
+		bool isActive;
+		XMFLOAT3 position;
+		XMFLOAT3 velocity;
+	};
+	struct LegacyTarget : LegacyScript
+	{
+		bool isActive;
+	};
+
+	// A sphere with rings from pole to pole, bulged in and out so rays graze it and cells cut it unevenly
+	void BuildLumpySphere(int rings, int segments, std::vector<Vertex>& vertices, std::vector<int>& indices)
+	{
+		vertices.clear();
+		indices.clear();
+		for (int ring = 0; ring <= rings; ring++)
+		{
+			for (int segment = 0; segment <= segments; segment++)
+			{
+				float theta = 3.14159265f * ring / rings;
+				float phi = 6.28318531f * segment / segments;
+				float radius = 1.0f + 0.15f * sinf(theta * 7.0f) * cosf(phi * 5.0f);
+				Vertex vertex;
+				vertex.Normal = XMFLOAT3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+				vertex.Position = XMFLOAT3(vertex.Normal.x * radius, vertex.Normal.y * radius, vertex.Normal.z * radius);
+				vertex.UV = XMFLOAT2(segment / (float)segments, ring / (float)rings);
+				vertex.Tangent = XMFLOAT3(1.0f, 0.0f, 0.0f);
+				vertices.push_back(vertex);
+			}
+		}
+		for (int ring = 0; ring < rings; ring++)
+		{
+			for (int segment = 0; segment < segments; segment++)
+			{
+				int corner = ring * (segments + 1) + segment;
+				int quad[6] = { corner, corner + segments + 1, corner + 1, corner + 1, corner + segments + 1, corner + segments + 2 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+}
+
+bool Benchmarks::RunAll()
+{
+	struct Entry
+	{
+		const char* name;
+		bool (*run)();
+	};
+	const Entry entries[] =
+	{
+		{ "ObjImport", &Benchmarks::ObjImport },
+		{ "Tangents", &Benchmarks::Tangents },
+		{ "VertexPacking", &Benchmarks::VertexPacking },
+		{ "MeshletCulling", &Benchmarks::MeshletCulling },
+		{ "GeometryAllocator", &Benchmarks::GeometryAllocator },
+		{ "Transforms", &Benchmarks::Transforms },
+		{ "Hierarchy", &Benchmarks::Hierarchy },
+		{ "Entities", &Benchmarks::Entities },
+		{ "JobScaling", &Benchmarks::JobScaling },
+		{ "FrameHandoff", &Benchmarks::FrameHandoff },
+		{ "Interpolation", &Benchmarks::Interpolation },
+		{ "SphereCulling", &Benchmarks::SphereCulling },
+		{ "SceneBvh", &Benchmarks::SceneBvh },
+		{ "Occlusion", &Benchmarks::Occlusion },
+		{ "Broadphase", &Benchmarks::Broadphase },
+		{ "Narrowphase", &Benchmarks::Narrowphase },
+		{ "SweptCollision", &Benchmarks::SweptCollision },
+		{ "MeshRays", &Benchmarks::MeshRays },
+		{ "Physics", &Benchmarks::Physics },
+		{ "Shatter", &Benchmarks::Shatter }
+	};
+	const int entryCount = (int)(sizeof(entries) / sizeof(entries[0]));
+
+	std::cout << "---- Benchmarks ----" << std::endl;
+	std::vector<const char*> failed;
+	for (int i = 0; i < entryCount; i++)
+	{
+		if (!entries[i].run())
+		{
+			failed.push_back(entries[i].name);
+		}
+	}
+
+	// One line at the end, so a failed check can't scroll by unnoticed
+	if (failed.empty())
+	{
+		std::cout << "All " << entryCount << " passed" << std::endl;
+	}
+	else
+	{
+		std::cout << failed.size() << " of " << entryCount << " FAILED:";
+		for (size_t i = 0; i < failed.size(); i++)
+		{
+			std::cout << " " << failed[i];
+		}
+		std::cout << std::endl;
+	}
+	std::cout << "--------------------" << std::endl;
+	return failed.empty();
+}
+
+bool Benchmarks::ObjImport()
+{
+	std::cout << "OBJ import" << std::endl;
+
+	// Every model that ships with the game, plus a large generated sphere
+	std::vector<std::string> files;
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA("models\\*.obj", &findData);
+	if (find != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			std::string name = findData.cFileName;
+			if (name != "benchmark_synthetic.obj")
+			{
+				files.push_back("models\\" + name);
+			}
+		} while (FindNextFileA(find, &findData));
+		FindClose(find);
+	}
+
+	if (ObjLoader::WriteSyntheticObj(SyntheticObjFile, 1000, 1000)) // ~2M triangles
+	{
+		files.push_back(SyntheticObjFile);
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		std::vector<Vertex> verts, legacyVerts;
+		std::vector<int> indices, legacyIndices;
+		ObjLoadStats fast, legacy;
+		if (!ObjLoader::Load(files[i].c_str(), verts, indices, &fast))
+		{
+			continue;
+		}
+		bool identical = ObjLoader::LoadLegacy(files[i].c_str(), legacyVerts, legacyIndices, &legacy) &&
+			verts.size() == legacyVerts.size() && indices == legacyIndices &&
+			(verts.empty() || memcmp(&verts[0], &legacyVerts[0], verts.size() * sizeof(Vertex)) == 0);
+		ok = ok && identical;
+
+		std::cout << "  " << files[i] << " (" << fast.bytes / 1024 << " KB, " << fast.triangles << " tris)" << std::endl;
+		PrintObjResult("mapped + parallel", fast);
+		PrintObjResult("legacy sscanf    ", legacy);
+		std::cout << "    speedup: " << legacy.seconds / fast.seconds << "x (" << (identical ? "same mesh" : "MISMATCH") << ")" << std::endl;
+	}
+
+	DeleteFileA(SyntheticObjFile);
+	return ok;
+}
+
+bool Benchmarks::Tangents()
+{
+	std::cout << "Tangents" << std::endl;
+
+	std::vector<Vertex> verts;
+	std::vector<int> indices;
+	if (!ObjLoader::WriteSyntheticObj(SyntheticObjFile, 1000, 1000) || !ObjLoader::Load(SyntheticObjFile, verts, indices))
+	{
+		std::cout << "  couldn't write " << SyntheticObjFile << " (FAILED)" << std::endl;
+		return false;
+	}
+	DeleteFileA(SyntheticObjFile);
+	MeshOptimizer::WeldVertices(verts, indices);
+
+	std::vector<Vertex> legacy = verts;
+	double start = GetSeconds();
+	TangentGenerator::GenerateLegacy(&legacy[0], (int)legacy.size(), &indices[0], (int)indices.size());
+	double legacySeconds = GetSeconds() - start;
+
+	start = GetSeconds();
+	TangentGenerator::Generate(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+	double batchedSeconds = GetSeconds() - start;
+	bool identical = memcmp(&verts[0], &legacy[0], verts.size() * sizeof(Vertex)) == 0;
+
+	start = GetSeconds();
+	TangentGenerator::Generate(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), TANGENTS_MIKKTSPACE);
+	double mikkSeconds = GetSeconds() - start;
+
+	std::cout << "  " << indices.size() / 3 << " tris, " << verts.size() << " verts" << std::endl;
+	std::cout << "    legacy:     " << legacySeconds * 1000.0 << "ms" << std::endl;
+	std::cout << "    batched:    " << batchedSeconds * 1000.0 << "ms (" << legacySeconds / batchedSeconds << "x, " << (identical ? "bitwise identical" : "MISMATCH") << ")" << std::endl;
+	std::cout << "    mikktspace: " << mikkSeconds * 1000.0 << "ms" << std::endl;
+	return identical;
+}
+
+bool Benchmarks::VertexPacking()
+{
+	std::cout << "Vertex packing" << std::endl;
+
+	std::vector<Vertex> verts;
+	std::vector<int> indices;
+	if (!ObjLoader::WriteSyntheticObj(SyntheticObjFile, 300, 300) || !ObjLoader::Load(SyntheticObjFile, verts, indices))
+	{
+		return false;
+	}
+	DeleteFileA(SyntheticObjFile);
+	MeshOptimizer::WeldVertices(verts, indices);
+	TangentGenerator::Generate(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+
+	// Stretch the UVs over a wider range so the half floats get exercised
+	for (size_t i = 0; i < verts.size(); i++)
+	{
+		verts[i].UV.x = verts[i].UV.x * 37.0f - 5.0f;
+		verts[i].UV.y = verts[i].UV.y * 0.01f;
+	}
+
+	std::vector<PackedVertex> packed;
+	XMFLOAT3 offset, scale;
+	VertexPacker::Pack(&verts[0], (int)verts.size(), packed, offset, scale);
+
+	float worstPosition[3] = { 0, 0, 0 };
+	float worstUV = 0.0f;
+	float worstAngle = 0.0f;
+	for (size_t i = 0; i < verts.size(); i++)
+	{
+		Vertex v = VertexPacker::Unpack(packed[i], offset, scale);
+		const float* a = &verts[i].Position.x;
+		const float* b = &v.Position.x;
+		const float* extent = &scale.x;
+		for (int k = 0; k < 3; k++)
+		{
+			worstPosition[k] = max(worstPosition[k], fabsf(a[k] - b[k]) / extent[k]); // In units of the box extent
+		}
+
+		const float* uvA = &verts[i].UV.x;
+		const float* uvB = &v.UV.x;
+		for (int k = 0; k < 2; k++)
+		{
+			float allowed = max(fabsf(uvA[k]) * VertexPacker::MaxUVRelativeError, 1.0f / (1 << 25));
+			worstUV = max(worstUV, fabsf(uvA[k] - uvB[k]) / allowed); // 1 is right at the bound
+		}
+
+		const XMFLOAT3* directions[2][2] = { { &verts[i].Normal, &v.Normal }, { &verts[i].Tangent, &v.Tangent } };
+		for (int k = 0; k < 2; k++)
+		{
+			XMVECTOR original = XMLoadFloat3(directions[k][0]);
+			if (XMVectorGetX(XMVector3LengthSq(original)) == 0.0f)
+			{
+				continue; // Nothing to compare against, degenerate UVs leave a zero tangent
+			}
+			float cosine = XMVectorGetX(XMVector3Dot(XMVector3Normalize(original), XMLoadFloat3(directions[k][1])));
+			worstAngle = max(worstAngle, acosf(min(cosine, 1.0f)) * 57.2957795f);
+		}
+	}
+
+	float positionBound = 0.51f / 65535.0f; // Half a 16 bit step, with room for float rounding
+	bool positionOk = worstPosition[0] <= positionBound && worstPosition[1] <= positionBound && worstPosition[2] <= positionBound;
+	bool uvOk = worstUV <= 1.0f;
+	bool directionOk = worstAngle <= VertexPacker::MaxDirectionErrorDegrees;
+
+	std::cout << "  " << verts.size() << " verts, " << sizeof(Vertex) << " -> " << sizeof(PackedVertex) << " bytes each" << std::endl;
+	std::cout << "    position: " << max(worstPosition[0], max(worstPosition[1], worstPosition[2])) * 65535.0f << " steps " << (positionOk ? "ok" : "FAILED") << std::endl;
+	std::cout << "    uv:       " << worstUV << " of bound " << (uvOk ? "ok" : "FAILED") << std::endl;
+	std::cout << "    normal/tangent: " << worstAngle << " degrees " << (directionOk ? "ok" : "FAILED") << std::endl;
+	return positionOk && uvOk && directionOk;
+}
+
+bool Benchmarks::MeshletCulling()
+{
+	std::cout << "Meshlet culling" << std::endl;
+
+	std::vector<Vertex> verts;
+	std::vector<int> indices;
+	if (!ObjLoader::WriteSyntheticObj(SyntheticObjFile, 300, 300) || !ObjLoader::Load(SyntheticObjFile, verts, indices))
+	{
+		return false;
+	}
+	DeleteFileA(SyntheticObjFile);
+	MeshOptimizer::WeldVertices(verts, indices);
+	MeshOptimizer::OptimizeVertexCache(indices, verts.size());
+
+	double start = GetSeconds();
+	std::vector<Meshlet> meshlets = MeshOptimizer::BuildMeshlets(verts, indices);
+	double buildSeconds = GetSeconds() - start;
+
+	int largestVerts = 0;
+	int largestTris = 0;
+	for (size_t i = 0; i < meshlets.size(); i++)
+	{
+		largestVerts = max(largestVerts, meshlets[i].vertexCount);
+		largestTris = max(largestTris, meshlets[i].indexCount / 3);
+	}
+	bool limitsOk = largestVerts <= 64 && largestTris <= 124;
+	std::cout << "  " << indices.size() / 3 << " tris -> " << meshlets.size() << " meshlets in " << buildSeconds * 1000.0 << "ms, "
+		<< "largest " << largestVerts << " verts / " << largestTris << " tris " << (limitsOk ? "ok" : "FAILED") << std::endl;
+
+	// The generated mesh is a unit sphere, cameras use the game's projection
+	struct View
+	{
+		const char* name;
+		XMFLOAT3 eye;
+		XMFLOAT3 target;
+	};
+	const View views[] =
+	{
+		{ "whole mesh on screen", XMFLOAT3(0.0f, 0.0f, -4.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) },
+		{ "whole mesh, from above", XMFLOAT3(2.0f, 2.5f, -2.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) },
+		{ "close up", XMFLOAT3(0.0f, 0.3f, -1.6f), XMFLOAT3(0.0f, 0.0f, 0.0f) },
+		{ "close, off center", XMFLOAT3(0.5f, 0.0f, -1.5f), XMFLOAT3(1.5f, 0.0f, 0.0f) },
+		{ "near the surface", XMFLOAT3(0.0f, 0.0f, -1.1f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ "looking away", XMFLOAT3(0.0f, 0.0f, -3.0f), XMFLOAT3(0.0f, 0.0f, -4.0f) },
+	};
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 100.0f);
+
+	bool conservative = true;
+	for (int v = 0; v < (int)(sizeof(views) / sizeof(views[0])); v++)
+	{
+		XMVECTOR eye = XMLoadFloat3(&views[v].eye);
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixLookAtLH(eye, XMLoadFloat3(&views[v].target), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * projection);
+		Frustum frustum(viewProjection);
+
+		std::vector<DrawRange> ranges;
+		MeshletCullStats stats;
+		const int repeats = 100;
+		start = GetSeconds();
+		for (int r = 0; r < repeats; r++)
+		{
+			ranges.clear();
+			MeshletCuller::Cull(&meshlets[0], (int)meshlets.size(), frustum, views[v].eye, ranges, &stats);
+		}
+		double cullSeconds = (GetSeconds() - start) / repeats;
+
+		// Every triangle outside the draw ranges has to be invisible
+		int lost = 0;
+		size_t rangeIndex = 0;
+		for (size_t t = 0; t < indices.size(); t += 3)
+		{
+			while (rangeIndex < ranges.size() && (int)t >= ranges[rangeIndex].indexOffset + ranges[rangeIndex].indexCount) rangeIndex++;
+			bool drawn = rangeIndex < ranges.size() && (int)t >= ranges[rangeIndex].indexOffset;
+			if (!drawn && TriangleVisible(verts[indices[t]].Position, verts[indices[t + 1]].Position, verts[indices[t + 2]].Position, frustum, eye))
+			{
+				lost++;
+			}
+		}
+		conservative = conservative && lost == 0;
+
+		float total = (float)(indices.size() / 3);
+		std::cout << "    " << views[v].name << ": " << (stats.frustumCulled + stats.backfaceCulled) * 100.0f / total << "% rejected ("
+			<< stats.frustumCulled * 100.0f / total << "% frustum, " << stats.backfaceCulled * 100.0f / total << "% backface), "
+			<< ranges.size() << " draws, " << cullSeconds * 1000000.0 << "us" << (lost ? ", VISIBLE TRIANGLES CULLED" : "") << std::endl;
+	}
+	return limitsOk && conservative;
+}
+
+bool Benchmarks::GeometryAllocator()
+{
+	std::cout << "Geometry allocator" << std::endl;
+
+	// Every slot of the space remembers which handle owns it, so overlaps and lost data both show up
+	const int capacity = 1 << 20;
+	OffsetAllocator allocator(capacity);
+	std::vector<int> owner(capacity, -1);
+	std::vector<int> live;
+	unsigned int seed = 1;
+	bool ok = true;
+	int failedAllocations = 0;
+	int operations = 0;
+
+	double start = GetSeconds();
+	for (int round = 0; round < 20 && ok; round++)
+	{
+		for (int i = 0; i < 2000; i++, operations++)
+		{
+			NextSeed(seed);
+			if (live.empty() || (seed >> 16) % 3 != 0) // Two allocations per free on average
+			{
+				int size = 1 + (int)((seed >> 8) % 2048);
+				int handle = allocator.Allocate(size);
+				if (handle < 0)
+				{
+					failedAllocations++;
+					ok = ok && allocator.GetLargestFree() < size; // Only allowed to fail when nothing fits
+					continue;
+				}
+				int offset = allocator.GetOffset(handle);
+				for (int k = offset; k < offset + size; k++)
+				{
+					ok = ok && owner[k] == -1;
+					owner[k] = handle;
+				}
+				live.push_back(handle);
+			}
+			else
+			{
+				size_t pick = (seed >> 4) % live.size();
+				int handle = live[pick];
+				int offset = allocator.GetOffset(handle);
+				for (int k = offset; k < offset + allocator.GetSize(handle); k++)
+				{
+					owner[k] = -1;
+				}
+				allocator.Free(handle);
+				live[pick] = live.back();
+				live.pop_back();
+			}
+		}
+
+		// Move the owners along with the blocks, then check they landed packed and intact
+		std::vector<OffsetMove> moves = allocator.Defragment();
+		std::vector<int> moved(capacity, -1);
+		int end = 0;
+		for (size_t m = 0; m < moves.size(); m++)
+		{
+			ok = ok && moves[m].to == end && owner[moves[m].from] == moves[m].handle;
+			for (int k = 0; k < moves[m].size; k++)
+			{
+				moved[moves[m].to + k] = owner[moves[m].from + k];
+			}
+			end += moves[m].size;
+		}
+		owner.swap(moved);
+		ok = ok && moves.size() == live.size() && end == allocator.GetUsed() && allocator.GetLargestFree() == capacity - end;
+	}
+	double seconds = GetSeconds() - start;
+
+	// Freeing everything has to merge back into one range
+	for (size_t i = 0; i < live.size(); i++)
+	{
+		allocator.Free(live[i]);
+	}
+	ok = ok && allocator.GetUsed() == 0 && allocator.GetLargestFree() == capacity;
+
+	std::cout << "  " << operations << " operations and 20 defragments in " << seconds * 1000.0 << "ms, "
+		<< failedAllocations << " allocations didn't fit, " << (ok ? "ok" : "FAILED") << std::endl;
+	return ok;
+}
+
+bool Benchmarks::Transforms()
+{
+	std::cout << "Transforms" << std::endl;
+
+	// What every GameObject used to hold and recalculate on its own
+	struct LegacyTransform
+	{
+		XMFLOAT4X4 worldMatrix;
+		XMFLOAT3 position;
+		XMFLOAT4 rotationQuaternion;
+		XMFLOAT3 scale;
+	};
+
+	const int objectCount = 100000;
+	std::vector<LegacyTransform> legacy(objectCount);
+	TransformStore store;
+	std::vector<int> handles(objectCount);
+	unsigned int seed = 1;
+	for (int i = 0; i < objectCount; i++)
+	{
+		float random[7];
+		for (int k = 0; k < 7; k++)
+		{
+			random[k] = NextRandom(seed);
+		}
+		LegacyTransform& t = legacy[i];
+		t.position = XMFLOAT3(random[0] * 200.0f - 100.0f, random[1] * 200.0f - 100.0f, random[2] * 200.0f - 100.0f);
+		XMStoreFloat4(&t.rotationQuaternion, XMQuaternionRotationRollPitchYaw(random[3] * 6.3f, random[4] * 6.3f, random[5] * 6.3f));
+		t.scale = XMFLOAT3(0.5f + random[6], 1.5f - random[6], 1.0f);
+
+		handles[i] = store.Add();
+		store.SetPosition(handles[i], t.position);
+		store.SetRotation(handles[i], t.rotationQuaternion);
+		store.SetScale(handles[i], t.scale);
+	}
+
+	double start = GetSeconds();
+	for (int i = 0; i < objectCount; i++)
+	{
+		LegacyTransform& t = legacy[i];
+		XMMATRIX world = XMMatrixScaling(t.scale.x, t.scale.y, t.scale.z) *
+			XMMatrixRotationQuaternion(XMLoadFloat4(&t.rotationQuaternion)) *
+			XMMatrixTranslation(t.position.x, t.position.y, t.position.z);
+		XMStoreFloat4x4(&t.worldMatrix, XMMatrixTranspose(world));
+	}
+	double legacySeconds = GetSeconds() - start;
+
+	start = GetSeconds();
+	int rebuilt = store.UpdateWorldMatrices();
+	double batchedSeconds = GetSeconds() - start;
+
+	// Different operation order, so only close rather than identical
+	float largestError = 0.0f;
+	for (int i = 0; i < objectCount; i++)
+	{
+		const XMFLOAT4X4& batched = store.GetWorldMatrix(handles[i]);
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				float magnitude = fabsf(legacy[i].worldMatrix(r, c)) > 1.0f ? fabsf(legacy[i].worldMatrix(r, c)) : 1.0f;
+				float error = fabsf(batched(r, c) - legacy[i].worldMatrix(r, c)) / magnitude;
+				largestError = error > largestError ? error : largestError;
+			}
+		}
+	}
+	bool ok = rebuilt == objectCount && largestError < 1e-5f && !store.IsDirty(handles[0]);
+
+	// Removing packs the store, so every handle has to still find its own transform afterwards
+	for (int i = 0; i < objectCount; i += 3)
+	{
+		store.Remove(handles[i]);
+	}
+	int moved = 0;
+	for (int i = 1; i < objectCount; i += 7)
+	{
+		if (i % 3 != 0)
+		{
+			store.SetPosition(handles[i], XMFLOAT3(legacy[i].position.x + 1.0f, legacy[i].position.y, legacy[i].position.z));
+			moved++;
+		}
+	}
+	ok = ok && store.GetCount() == objectCount - (objectCount + 2) / 3 && store.UpdateWorldMatrices() == moved;
+	for (int i = 0; i < objectCount && ok; i++)
+	{
+		if (i % 3 == 0)
+		{
+			continue;
+		}
+		float expectedX = legacy[i].worldMatrix(0, 3) + (i % 7 == 1 ? 1.0f : 0.0f);
+		ok = fabsf(store.GetWorldMatrix(handles[i])(0, 3) - expectedX) <= 1e-4f && store.GetPosition(handles[i]).y == legacy[i].position.y;
+	}
+
+	std::cout << "  " << objectCount << " objects" << std::endl;
+	std::cout << "    per-object: " << legacySeconds * 1000.0 << "ms" << std::endl;
+	std::cout << "    batched:    " << batchedSeconds * 1000.0 << "ms (" << legacySeconds / batchedSeconds << "x, largest error " << largestError << ", " << (ok ? "ok" : "FAILED") << ")" << std::endl;
+	return ok;
+}
+
+bool Benchmarks::Hierarchy()
+{
+	std::cout << "Hierarchy" << std::endl;
+
+	// Racks of targets with a few markers on each, plus loose objects mixed in. Everything is
+	// added before it is parented, so the store has to sort the depths out itself.
+	const int rackCount = 40;
+	const int targetsPerRack = 5;
+	const int markersPerTarget = 3;
+	TransformStore store;
+	std::vector<int> racks, targets, markers, loose;
+	unsigned int seed = 7;
+	for (int r = 0; r < rackCount; r++)
+	{
+		for (int t = 0; t < targetsPerRack; t++)
+		{
+			for (int m = 0; m < markersPerTarget; m++)
+			{
+				markers.push_back(store.Add());
+			}
+			targets.push_back(store.Add());
+		}
+		racks.push_back(store.Add());
+		loose.push_back(store.Add());
+	}
+	std::vector<int> all;
+	all.insert(all.end(), markers.begin(), markers.end());
+	all.insert(all.end(), targets.begin(), targets.end());
+	all.insert(all.end(), racks.begin(), racks.end());
+	all.insert(all.end(), loose.begin(), loose.end());
+	for (size_t i = 0; i < all.size(); i++)
+	{
+		float random = NextRandom(seed);
+		XMFLOAT4 rotation;
+		XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(random, random * 2.0f, random * 3.0f));
+		store.SetPosition(all[i], XMFLOAT3(random * 4.0f, 1.0f - random, (float)(i % 9)));
+		store.SetRotation(all[i], rotation);
+		store.SetScale(all[i], XMFLOAT3(1.0f + random, 1.0f, 2.0f - random));
+	}
+	bool ok = true;
+	for (size_t t = 0; t < targets.size(); t++)
+	{
+		ok = ok && store.SetParent(targets[t], racks[t / targetsPerRack]);
+	}
+	for (size_t m = 0; m < markers.size(); m++)
+	{
+		ok = ok && store.SetParent(markers[m], targets[m / markersPerTarget]);
+	}
+	ok = ok && !store.SetParent(racks[0], markers[0]); // Would make a loop
+	ok = ok && store.UpdateWorldMatrices() == (int)all.size();
+
+	// Expected world matrices straight from the chain of local ones
+	std::vector<XMFLOAT4X4> before(all.size());
+	for (size_t i = 0; i < all.size(); i++)
+	{
+		before[i] = store.GetWorldMatrix(all[i]);
+	}
+	auto matches = [&](int handle) -> bool
+	{
+		XMMATRIX world = XMMatrixIdentity();
+		for (int h = handle; h >= 0; h = store.GetParent(h))
+		{
+			XMFLOAT3 p = store.GetPosition(h);
+			XMFLOAT3 s = store.GetScale(h);
+			XMFLOAT4 q = store.GetRotation(h);
+			world = world * XMMatrixScaling(s.x, s.y, s.z) * XMMatrixRotationQuaternion(XMLoadFloat4(&q)) * XMMatrixTranslation(p.x, p.y, p.z);
+		}
+		XMFLOAT4X4 expected;
+		XMStoreFloat4x4(&expected, XMMatrixTranspose(world));
+		const XMFLOAT4X4& actual = store.GetWorldMatrix(handle);
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				if (fabsf(actual(r, c) - expected(r, c)) > 1e-4f * (1.0f + fabsf(expected(r, c))))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+	for (size_t i = 0; i < all.size() && ok; i++)
+	{
+		ok = matches(all[i]);
+	}
+
+	// Moving a rack has to touch exactly the rack, its targets and their markers
+	int movedRack = rackCount / 2;
+	XMFLOAT3 rackPosition = store.GetPosition(racks[movedRack]);
+	store.SetPosition(racks[movedRack], XMFLOAT3(rackPosition.x + 3.0f, rackPosition.y, rackPosition.z));
+	int rebuilt = store.UpdateWorldMatrices();
+	ok = ok && rebuilt == 1 + targetsPerRack * (1 + markersPerTarget);
+	for (size_t i = 0; i < all.size(); i++)
+	{
+		int handle = all[i];
+		int root = handle;
+		while (store.GetParent(root) >= 0)
+		{
+			root = store.GetParent(root);
+		}
+		if (root == racks[movedRack])
+		{
+			ok = ok && matches(handle) && memcmp(&before[i], &store.GetWorldMatrix(handle), sizeof(XMFLOAT4X4)) != 0;
+		}
+		else
+		{
+			ok = ok && memcmp(&before[i], &store.GetWorldMatrix(handle), sizeof(XMFLOAT4X4)) == 0;
+		}
+	}
+
+	// One target deeper down, and nothing at all when nothing moved
+	store.SetScale(targets[3], XMFLOAT3(0.5f, 0.5f, 0.5f));
+	int targetRebuilt = store.UpdateWorldMatrices();
+	ok = ok && targetRebuilt == 1 + markersPerTarget && matches(markers[3 * markersPerTarget]);
+	ok = ok && store.UpdateWorldMatrices() == 0;
+
+	// A rack rebuilt on its own still leaves its targets and markers to the next batched pass
+	int soloRack = rackCount / 4;
+	rackPosition = store.GetPosition(racks[soloRack]);
+	store.SetPosition(racks[soloRack], XMFLOAT3(rackPosition.x, rackPosition.y + 2.0f, rackPosition.z));
+	store.UpdateWorldMatrix(racks[soloRack]);
+	ok = ok && matches(racks[soloRack]);
+	int soloRebuilt = store.UpdateWorldMatrices();
+	ok = ok && soloRebuilt == 1 + targetsPerRack * (1 + markersPerTarget) &&
+		matches(targets[soloRack * targetsPerRack]) && matches(markers[soloRack * targetsPerRack * markersPerTarget]);
+
+	// Removing a target turns its markers into roots, which keep their local transform
+	store.Remove(targets[0]);
+	ok = ok && store.UpdateWorldMatrices() == markersPerTarget && store.GetParent(markers[0]) == -1 && matches(markers[0]) && matches(markers[markersPerTarget]);
+
+	std::cout << "  " << all.size() << " transforms, moving one rack rebuilt " << rebuilt << ", one target " << targetRebuilt
+		<< ", " << (ok ? "ok" : "FAILED") << std::endl;
+	return ok;
+}
+
+bool Benchmarks::Entities()
+{
+	std::cout << "Entities" << std::endl;
+
+	// Bullets and targets interleaved like they get created, a third of the bullets in flight
+	const int objectCount = 100000;
+	std::vector<LegacyScript*> legacy;
+	EntityWorld world;
+	TransformStore transforms;
+	std::vector<int> bulletEntities;
+	unsigned int seed = 3;
+	for (int i = 0; i < objectCount; i++)
+	{
+		NextSeed(seed);
+		bool active = (seed >> 16) % 3 == 0;
+		int entity = world.Create();
+		if (i % 4 == 3)
+		{
+			LegacyTarget* target = new LegacyTarget();
+			target->isActive = true;
+			legacy.push_back(target);
+			TargetComponent component = { 0.0f, -1 };
+			world.Add(entity, component);
+			world.Add(entity, ActiveTag());
+			continue;
+		}
+
+		LegacyBullet* bullet = new LegacyBullet();
+		bullet->isActive = active;
+		bullet->position = XMFLOAT3((float)(i % 100), 0.0f, 0.0f);
+		bullet->velocity = XMFLOAT3(1.0f, (float)(seed >> 24), -2.0f);
+		legacy.push_back(bullet);
+
+		TransformComponent transform = { transforms.Add() };
+		VelocityComponent velocity = { bullet->velocity };
+		BulletComponent component = { (int)bulletEntities.size() };
+		transforms.SetPosition(transform.handle, bullet->position);
+		world.Add(entity, transform);
+		world.Add(entity, velocity);
+		world.Add(entity, component);
+		if (active)
+		{
+			world.Add(entity, ActiveTag());
+		}
+		bulletEntities.push_back(entity);
+	}
+
+	const float deltaTime = 1.0f / 60.0f;
+	int legacyMoved = 0;
+	double start = GetSeconds();
+	for (size_t i = 0; i < legacy.size(); i++)
+	{
+		LegacyBullet* bullet = dynamic_cast<LegacyBullet*>(legacy[i]);
+		if (bullet != nullptr && bullet->isActive)
+		{
+			bullet->position.x += bullet->velocity.x * deltaTime;
+			bullet->position.y += bullet->velocity.y * deltaTime;
+			bullet->position.z += bullet->velocity.z * deltaTime;
+			legacyMoved++;
+		}
+	}
+	double legacySeconds = GetSeconds() - start;
+
+	int queryMoved = 0;
+	start = GetSeconds();
+	world.Each<TransformComponent, VelocityComponent>(EntityWorld::MaskOf<BulletComponent, ActiveTag>(), 0, [&](int entity, TransformComponent& transform, VelocityComponent& velocity)
+	{
+		XMFLOAT3 position = transforms.GetPosition(transform.handle);
+		position.x += velocity.value.x * deltaTime;
+		position.y += velocity.value.y * deltaTime;
+		position.z += velocity.value.z * deltaTime;
+		transforms.SetPosition(transform.handle, position);
+		queryMoved++;
+	});
+	double querySeconds = GetSeconds() - start;
+
+	// Same bullets moved to the same place
+	bool ok = queryMoved == legacyMoved && world.Count<BulletComponent, ActiveTag>() == legacyMoved;
+	int bullet = 0;
+	for (size_t i = 0; i < legacy.size() && ok; i++)
+	{
+		LegacyBullet* legacyBullet = dynamic_cast<LegacyBullet*>(legacy[i]);
+		if (legacyBullet != nullptr)
+		{
+			int entity = bulletEntities[bullet];
+			XMFLOAT3 position = transforms.GetPosition(world.Get<TransformComponent>(entity)->handle);
+			ok = world.Get<BulletComponent>(entity)->slot == bullet && world.Has<ActiveTag>(entity) == legacyBullet->isActive &&
+				memcmp(&position, &legacyBullet->position, sizeof(XMFLOAT3)) == 0;
+			bullet++;
+		}
+	}
+
+	// Deactivating moves entities between archetypes, and destroying fills the hole, without losing anything
+	for (size_t i = 0; i < bulletEntities.size(); i += 2)
+	{
+		world.Remove<ActiveTag>(bulletEntities[i]);
+	}
+	for (size_t i = 1; i < bulletEntities.size(); i += 4)
+	{
+		world.Destroy(bulletEntities[i]);
+	}
+	int stillActive = 0;
+	world.Each<BulletComponent>(EntityWorld::MaskOf<ActiveTag>(), 0, [&](int entity, BulletComponent& component)
+	{
+		ok = ok && component.slot % 2 == 1 && component.slot % 4 != 1 && bulletEntities[component.slot] == entity;
+		stillActive++;
+	});
+	int surviving = 0;
+	for (size_t i = 3; i < bulletEntities.size(); i += 4)
+	{
+		surviving += world.Has<ActiveTag>(bulletEntities[i]) ? 1 : 0;
+	}
+	ok = ok && stillActive == surviving && world.Count<TargetComponent>() == objectCount / 4 && world.Count<VelocityComponent>(EntityWorld::MaskOf<TargetComponent>()) == (int)bulletEntities.size() - (int)(bulletEntities.size() + 2) / 4;
+
+	for (size_t i = 0; i < legacy.size(); i++)
+	{
+		delete legacy[i];
+	}
+
+	std::cout << "  " << objectCount << " objects, " << legacyMoved << " bullets in flight" << std::endl;
+	std::cout << "    dynamic_cast: " << legacySeconds * 1000.0 << "ms" << std::endl;
+	std::cout << "    query:        " << querySeconds * 1000.0 << "ms (" << legacySeconds / querySeconds << "x, " << (ok ? "ok" : "FAILED") << ")" << std::endl;
+	return ok;
+}
+
+bool Benchmarks::JobScaling()
+{
+	std::cout << "Job scaling" << std::endl;
+
+	// Eight deep chains of transforms, so every level of the hierarchy has plenty to split up
+	const int objectCount = 1 << 20;
+	const int repeats = 3;
+	const float deltaTime = 1.0f / 60.0f;
+	TransformStore transforms;
+	EntityWorld world;
+	std::vector<int> handles(objectCount);
+	std::vector<XMFLOAT3> startPositions(objectCount);
+	unsigned int seed = 5;
+	for (int i = 0; i < objectCount; i++)
+	{
+		float random[6];
+		for (int k = 0; k < 6; k++)
+		{
+			random[k] = NextRandom(seed);
+		}
+		handles[i] = transforms.Add();
+		startPositions[i] = XMFLOAT3(random[0] * 10.0f - 5.0f, random[1] * 10.0f - 5.0f, random[2] * 10.0f - 5.0f);
+		XMFLOAT4 rotation;
+		XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(random[3] * 6.3f, random[4] * 6.3f, random[5] * 6.3f));
+		transforms.SetPosition(handles[i], startPositions[i]);
+		transforms.SetRotation(handles[i], rotation);
+		if (i % 8 != 0)
+		{
+			transforms.SetParent(handles[i], handles[i - 1]);
+		}
+
+		int entity = world.Create();
+		TransformComponent transform = { handles[i] };
+		VelocityComponent velocity = { XMFLOAT3(random[3], -random[4], 1.0f) };
+		world.Add(entity, transform);
+		world.Add(entity, velocity);
+		world.Add(entity, ActiveTag());
+	}
+
+	// Everything on one thread first, the answer every other thread count has to match
+	transforms.UpdateWorldMatrices();
+	std::vector<XMFLOAT4X4> expected(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		expected[i] = transforms.GetWorldMatrix(handles[i]);
+	}
+
+	// The same job split as the game, 1, 2, 4... threads and then every hardware thread
+	std::vector<int> threadCounts;
+	int hardwareThreads = (int)std::thread::hardware_concurrency();
+	for (int threads = 1; threads < hardwareThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(hardwareThreads > 1 ? hardwareThreads : 1);
+
+	bool ok = true;
+	double singleRebuild = 0.0;
+	double singleMove = 0.0;
+	std::cout << "  " << objectCount << " transforms, " << hardwareThreads << " hardware threads" << std::endl;
+	for (size_t t = 0; t < threadCounts.size(); t++)
+	{
+		JobSystem jobs(threadCounts[t]);
+		double rebuildSeconds = 1e9;
+		double moveSeconds = 1e9;
+		for (int r = 0; r < repeats; r++)
+		{
+			for (int i = 0; i < objectCount; i++)
+			{
+				transforms.SetPosition(handles[i], startPositions[i]); // Everything dirty again
+			}
+			double start = GetSeconds();
+			int rebuilt = transforms.UpdateWorldMatrices(&jobs);
+			double seconds = GetSeconds() - start;
+			rebuildSeconds = seconds < rebuildSeconds ? seconds : rebuildSeconds;
+			ok = ok && rebuilt == objectCount;
+
+			start = GetSeconds();
+			world.ParallelEach<TransformComponent, VelocityComponent>(jobs, 256, EntityWorld::MaskOf<ActiveTag>(), 0, [&](int entity, TransformComponent& transform, VelocityComponent& velocity)
+			{
+				XMFLOAT3 position = transforms.GetPosition(transform.handle);
+				position.x += velocity.value.x * deltaTime;
+				position.y += velocity.value.y * deltaTime;
+				position.z += velocity.value.z * deltaTime;
+				transforms.SetPosition(transform.handle, position);
+			});
+			seconds = GetSeconds() - start;
+			moveSeconds = seconds < moveSeconds ? seconds : moveSeconds;
+		}
+
+		// Each run moved everything once from the start, so the positions don't depend on the thread count either
+		for (int i = 0; i < objectCount && ok; i++)
+		{
+			XMFLOAT3 position = transforms.GetPosition(handles[i]);
+			VelocityComponent* velocity = world.Get<VelocityComponent>(i);
+			ok = memcmp(&transforms.GetWorldMatrix(handles[i]), &expected[i], sizeof(XMFLOAT4X4)) == 0 &&
+				fabsf(position.x - (startPositions[i].x + velocity->value.x * deltaTime)) <= 1e-5f &&
+				fabsf(position.z - (startPositions[i].z + velocity->value.z * deltaTime)) <= 1e-5f;
+		}
+
+		// A job held back on a counter only starts once everything on it has finished
+		JobCounter first;
+		JobCounter second;
+		std::atomic<int> finished(0);
+		int seenBySecond = -1;
+		for (int i = 0; i < 64; i++)
+		{
+			jobs.Run([&finished]() { finished++; }, &first);
+		}
+		jobs.Run([&finished, &seenBySecond]() { seenBySecond = finished; }, &second, &first);
+		jobs.Wait(second);
+		ok = ok && seenBySecond == 64 && first.GetValue() == 0 && second.GetValue() == 0;
+
+		if (t == 0)
+		{
+			singleRebuild = rebuildSeconds;
+			singleMove = moveSeconds;
+		}
+		std::cout << "    " << threadCounts[t] << (threadCounts[t] == 1 ? " thread:  " : " threads: ")
+			<< "rebuild " << rebuildSeconds * 1000.0 << "ms (" << singleRebuild / rebuildSeconds << "x), "
+			<< "move " << moveSeconds * 1000.0 << "ms (" << singleMove / moveSeconds << "x)" << std::endl;
+	}
+
+	std::cout << "    " << (ok ? "ok" : "FAILED") << std::endl;
+	return ok;
+}
+
+bool Benchmarks::FrameHandoff()
+{
+	std::cout << "Frame handoff" << std::endl;
+
+	// Stands in for a FrameSnapshot, big enough that a torn copy would show
+	struct TestFrame
+	{
+		unsigned int frame;
+		std::vector<unsigned int> payload;
+	};
+
+	const unsigned int frameCount = 200000;
+	const int payloadSize = 1024;
+	TripleBuffer<TestFrame> frames;
+	std::atomic<bool> ok(true);
+
+	double start = GetSeconds();
+	std::thread simulation([&]()
+	{
+		for (unsigned int f = 1; f <= frameCount; f++)
+		{
+			TestFrame& frame = frames.GetWriteSlot();
+			frame.frame = f;
+			frame.payload.assign(payloadSize, f);
+			frames.Publish();
+		}
+	});
+
+	// Reads as fast as it can, like Draw with no vsync
+	unsigned int lastSeen = 0;
+	int acquired = 0;
+	while (lastSeen < frameCount)
+	{
+		if (!frames.Acquire())
+		{
+			continue;
+		}
+		TestFrame& frame = frames.GetReadSlot();
+		bool whole = frame.payload.size() == (size_t)payloadSize;
+		for (int i = 0; i < payloadSize && whole; i++)
+		{
+			whole = frame.payload[i] == frame.frame;
+		}
+		if (!whole || frame.frame <= lastSeen)
+		{
+			ok = false;
+			break;
+		}
+		lastSeen = frame.frame;
+		acquired++;
+	}
+	simulation.join();
+	double seconds = GetSeconds() - start;
+
+	// Nothing new was published after the last frame
+	ok = ok && !frames.Acquire() && frames.GetReadSlot().frame == frameCount;
+
+	std::cout << "  " << frameCount << " frames published, " << acquired << " acquired, the rest overwritten before the reader got to them" << std::endl;
+	std::cout << "    " << seconds * 1000.0 << "ms, " << frameCount / seconds << " handoffs/s (" << (ok ? "ok" : "FAILED") << ")" << std::endl;
+	return ok;
+}
+
+bool Benchmarks::Interpolation()
+{
+	std::cout << "Interpolation" << std::endl;
+
+	// Small racks of four, like the targets, so parents move their children between steps too
+	const int objectCount = 4000;
+	TransformStore store;
+	std::vector<int> handles(objectCount);
+	unsigned int seed = 7;
+	float random[7];
+	for (int i = 0; i < objectCount; i++)
+	{
+		for (int k = 0; k < 7; k++)
+		{
+			random[k] = NextRandom(seed);
+		}
+		handles[i] = store.Add();
+		XMFLOAT4 rotation;
+		XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(random[3] * 6.3f, random[4] * 6.3f, random[5] * 6.3f));
+		store.SetPosition(handles[i], XMFLOAT3(random[0] * 20.0f - 10.0f, random[1] * 20.0f - 10.0f, random[2] * 20.0f - 10.0f));
+		store.SetRotation(handles[i], rotation);
+		store.SetScale(handles[i], XMFLOAT3(0.5f + random[6], 0.5f + random[6], 0.5f + random[6]));
+		if (i % 4 != 0)
+		{
+			store.SetParent(handles[i], handles[i - i % 4]);
+		}
+	}
+	store.UpdateWorldMatrices();
+
+	// One step: save, move every third object, teleport every tenth
+	std::vector<XMFLOAT4X4> before(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		before[i] = store.GetWorldMatrix(handles[i]);
+	}
+	store.SavePreviousWorldMatrices();
+	for (int i = 0; i < objectCount; i++)
+	{
+		if (i % 3 == 0)
+		{
+			XMFLOAT3 position = store.GetPosition(handles[i]);
+			store.SetPosition(handles[i], XMFLOAT3(position.x + 0.5f, position.y, position.z - 0.25f));
+			XMFLOAT4 rotation = store.GetRotation(handles[i]);
+			XMStoreFloat4(&rotation, XMQuaternionMultiply(XMLoadFloat4(&rotation), XMQuaternionRotationRollPitchYaw(0.0f, 0.1f, 0.0f)));
+			store.SetRotation(handles[i], rotation);
+		}
+		if (i % 10 == 0)
+		{
+			store.SkipInterpolation(handles[i]);
+		}
+	}
+	store.UpdateWorldMatrices();
+
+	// Removing shuffles slots, the previous matrices have to move with them
+	for (int i = 3; i < objectCount; i += 40)
+	{
+		store.Remove(handles[i]);
+		handles[i] = -1;
+	}
+
+	bool ok = true;
+	float largestError = 0.0f;
+	for (int i = 0; i < objectCount && ok; i++)
+	{
+		if (handles[i] < 0)
+		{
+			continue;
+		}
+		const XMFLOAT4X4& previous = store.GetPreviousWorldMatrix(handles[i]);
+		const XMFLOAT4X4& current = store.GetWorldMatrix(handles[i]);
+		const XMFLOAT4X4& expectedPrevious = i % 10 == 0 ? current : before[i];
+		ok = memcmp(&previous, &expectedPrevious, sizeof(XMFLOAT4X4)) == 0;
+
+		// Both ends exactly enough to not pop, and the position halfway in the middle
+		XMFLOAT4X4 start = TransformStore::Interpolate(previous, current, 0.0f);
+		XMFLOAT4X4 end = TransformStore::Interpolate(previous, current, 1.0f);
+		XMFLOAT4X4 middle = TransformStore::Interpolate(previous, current, 0.5f);
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				float error = fabsf(start(r, c) - previous(r, c));
+				error = fabsf(end(r, c) - current(r, c)) > error ? fabsf(end(r, c) - current(r, c)) : error;
+				largestError = error > largestError ? error : largestError;
+			}
+			float halfway = fabsf(middle(r, 3) - (previous(r, 3) + current(r, 3)) * 0.5f); // Transposed, so column 3 is the translation
+			largestError = halfway > largestError ? halfway : largestError;
+		}
+	}
+	ok = ok && largestError < 1e-3f;
+
+	// Roughly what Draw pays per object every frame
+	std::vector<XMFLOAT4X4> drawn(objectCount);
+	double start = GetSeconds();
+	for (int i = 0; i < objectCount; i++)
+	{
+		if (handles[i] >= 0)
+		{
+			drawn[i] = TransformStore::Interpolate(store.GetPreviousWorldMatrix(handles[i]), store.GetWorldMatrix(handles[i]), 0.3f);
+		}
+	}
+	double seconds = GetSeconds() - start;
+
+	std::cout << "  " << objectCount << " transforms, a third moved, largest error " << largestError << std::endl;
+	std::cout << "    interpolate: " << seconds * 1e9 / objectCount << "ns per object (" << (ok ? "ok" : "FAILED") << ")" << std::endl;
+	return ok;
+}
+
+bool Benchmarks::SphereCulling()
+{
+	std::cout << "Sphere culling" << std::endl;
+
+	// A field of objects all around the camera, so about a tenth are in view
+	const int sphereCount = 1 << 20;
+	SphereBatch spheres;
+	unsigned int seed = 11;
+	for (int i = 0; i < sphereCount; i++)
+	{
+		float random[4];
+		for (int k = 0; k < 4; k++)
+		{
+			random[k] = NextRandom(seed);
+		}
+		spheres.Add(XMFLOAT3(random[0] * 200.0f - 100.0f, random[1] * 40.0f - 20.0f, random[2] * 200.0f - 100.0f), 0.1f + random[3] * 2.0f);
+	}
+
+	// The game's camera and light, one perspective and one orthographic
+	XMFLOAT4X4 matrices[2];
+	XMStoreFloat4x4(&matrices[0], XMMatrixLookToLH(XMVectorSet(0, 0, -5, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)) *
+		XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 100.0f));
+	XMStoreFloat4x4(&matrices[1], XMMatrixLookAtLH(XMVectorSet(0, 4, -10, 0), XMVectorSet(0, 0, 0, 0), XMVectorSet(0, 1, 0, 0)) *
+		XMMatrixOrthographicLH(10.0f, 10.0f, 0.1f, 100.0f));
+	const char* names[2] = { "camera", "light" };
+
+	bool ok = true;
+	std::vector<int> oneAtATime;
+	std::vector<int> batched;
+	oneAtATime.reserve(sphereCount);
+	for (int f = 0; f < 2; f++)
+	{
+		Frustum frustum(matrices[f]);
+
+		oneAtATime.clear();
+		double start = GetSeconds();
+		for (int i = 0; i < sphereCount; i++)
+		{
+			if (frustum.IntersectsSphere(XMFLOAT3(spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]), spheres.radius[i]))
+			{
+				oneAtATime.push_back(i);
+			}
+		}
+		double scalarSeconds = GetSeconds() - start;
+
+		start = GetSeconds();
+		int visible = frustum.CullSpheres(spheres, batched);
+		double batchedSeconds = GetSeconds() - start;
+
+		// Same plane math in the same order, so exactly the same spheres
+		bool agree = visible == (int)oneAtATime.size() && batched == oneAtATime;
+		ok = ok && agree;
+		std::cout << "  " << names[f] << ": " << visible << " of " << sphereCount << " visible" << std::endl;
+		std::cout << "    one at a time: " << scalarSeconds * 1000.0 << "ms" << std::endl;
+		std::cout << "    batched:       " << batchedSeconds * 1000.0 << "ms (" << scalarSeconds / batchedSeconds << "x, " << (agree ? "ok" : "FAILED") << ")" << std::endl;
+	}
+	return ok;
+}
+
+bool Benchmarks::SceneBvh()
+{
+	std::cout << "Scene BVH" << std::endl;
+
+	// Spheres scattered through a level, each drifting its own way
+	const int objectCount = 20000;
+	std::vector<XMFLOAT3> centers(objectCount);
+	std::vector<XMFLOAT3> velocities(objectCount);
+	std::vector<float> radii(objectCount);
+	std::vector<int> proxies(objectCount);
+	unsigned int seed = 13;
+	auto random = [&seed]() { return NextRandom(seed); };
+
+	DynamicBVH tree;
+	double start = GetSeconds();
+	for (int i = 0; i < objectCount; i++)
+	{
+		centers[i] = XMFLOAT3(random() * 200.0f - 100.0f, random() * 40.0f - 20.0f, random() * 200.0f - 100.0f);
+		velocities[i] = XMFLOAT3(random() * 0.2f - 0.1f, random() * 0.2f - 0.1f, random() * 0.2f - 0.1f);
+		radii[i] = 0.2f + random() * 1.5f;
+		proxies[i] = tree.CreateProxy(Aabb::FromSphere(centers[i], radii[i]), i);
+	}
+	double buildSeconds = GetSeconds() - start;
+	bool ok = tree.Validate();
+
+	// A few seconds of movement, with a batch of objects destroyed and respawned every step
+	int reinserted = 0;
+	start = GetSeconds();
+	for (int step = 0; step < 120; step++)
+	{
+		for (int i = 0; i < objectCount; i++)
+		{
+			centers[i].x += velocities[i].x;
+			centers[i].y += velocities[i].y;
+			centers[i].z += velocities[i].z;
+			reinserted += tree.MoveProxy(proxies[i], Aabb::FromSphere(centers[i], radii[i]), velocities[i]) ? 1 : 0;
+		}
+		for (int k = 0; k < 50; k++)
+		{
+			int i = (int)(random() * objectCount) % objectCount;
+			tree.DestroyProxy(proxies[i]);
+			centers[i] = XMFLOAT3(random() * 200.0f - 100.0f, random() * 40.0f - 20.0f, random() * 200.0f - 100.0f);
+			proxies[i] = tree.CreateProxy(Aabb::FromSphere(centers[i], radii[i]), i);
+		}
+	}
+	double moveSeconds = GetSeconds() - start;
+	ok = ok && tree.Validate() && tree.GetProxyCount() == objectCount;
+	std::cout << "  " << objectCount << " proxies, height " << tree.GetHeight() << std::endl;
+	std::cout << "    build: " << buildSeconds * 1000.0 << "ms" << std::endl;
+	std::cout << "    120 steps of moves: " << moveSeconds * 1000.0 << "ms, " << reinserted * 100.0 / (120.0 * objectCount) << "% reinserted" << std::endl;
+
+	// Box queries find exactly the fat boxes a brute force search does
+	bool queriesAgree = true;
+	for (int q = 0; q < 200; q++)
+	{
+		Aabb box;
+		XMFLOAT3 corner(random() * 200.0f - 100.0f, random() * 40.0f - 20.0f, random() * 200.0f - 100.0f);
+		box.min = corner;
+		box.max = XMFLOAT3(corner.x + random() * 10.0f, corner.y + random() * 10.0f, corner.z + random() * 10.0f);
+		std::vector<int> found, expected;
+		tree.QueryBox(box, [&](int proxy) { found.push_back(tree.GetUserData(proxy)); return true; });
+		for (int i = 0; i < objectCount; i++)
+		{
+			if (tree.GetFatBox(proxies[i]).Overlaps(box))
+			{
+				expected.push_back(i);
+			}
+		}
+		std::sort(found.begin(), found.end());
+		queriesAgree = queriesAgree && found == expected;
+	}
+
+	// And frustum queries, against the game's camera looking into the middle of it
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixLookToLH(XMVectorSet(0, 0, -60, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)) *
+		XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 100.0f));
+	Frustum frustum(viewProjection);
+	std::vector<int> inView, expectedInView;
+	tree.QueryFrustum(frustum, [&](int proxy) { inView.push_back(tree.GetUserData(proxy)); return true; });
+	for (int i = 0; i < objectCount; i++)
+	{
+		const Aabb& box = tree.GetFatBox(proxies[i]);
+		if (frustum.IntersectsBox(box.min, box.max))
+		{
+			expectedInView.push_back(i);
+		}
+	}
+	std::sort(inView.begin(), inView.end());
+	queriesAgree = queriesAgree && inView == expectedInView;
+	ok = ok && queriesAgree;
+	std::cout << "    box and frustum queries: " << inView.size() << " in view (" << (queriesAgree ? "ok" : "FAILED") << ")" << std::endl;
+
+	// Shotgun blasts from all over, aimed roughly into the middle, against the real spheres
+	const int rayCount = 4096;
+	std::vector<XMFLOAT3> origins(rayCount), directions(rayCount);
+	for (int r = 0; r < rayCount; r += RayPacket::MaxRays)
+	{
+		XMFLOAT3 muzzle(random() * 200.0f - 100.0f, random() * 40.0f - 20.0f, -110.0f);
+		XMFLOAT3 aim(random() * 0.4f - 0.2f, random() * 0.2f - 0.1f, 1.0f);
+		for (int pellet = 0; pellet < RayPacket::MaxRays; pellet++)
+		{
+			origins[r + pellet] = muzzle;
+			directions[r + pellet] = XMFLOAT3(aim.x + random() * 0.02f - 0.01f, aim.y + random() * 0.02f - 0.01f, aim.z);
+		}
+	}
+	const float reach = 250.0f;
+
+	std::vector<float> bruteDistances(rayCount);
+	start = GetSeconds();
+	for (int r = 0; r < rayCount; r++)
+	{
+		bruteDistances[r] = -1.0f;
+		for (int i = 0; i < objectCount; i++)
+		{
+			float distance = DynamicBVH::IntersectRaySphere(origins[r], directions[r], centers[i], radii[i]);
+			if (distance >= 0.0f && distance <= reach && (bruteDistances[r] < 0.0f || distance < bruteDistances[r]))
+			{
+				bruteDistances[r] = distance;
+			}
+		}
+	}
+	double bruteSeconds = GetSeconds() - start;
+
+	std::vector<float> closestDistances(rayCount);
+	std::vector<bool> anyHits(rayCount);
+	start = GetSeconds();
+	for (int r = 0; r < rayCount; r++)
+	{
+		RayHit hit;
+		bool found = tree.RayCastClosest(origins[r], directions[r], reach, [&](int proxy, float maxDistance)
+		{
+			int i = tree.GetUserData(proxy);
+			return DynamicBVH::IntersectRaySphere(origins[r], directions[r], centers[i], radii[i]);
+		}, hit);
+		closestDistances[r] = found ? hit.distance : -1.0f;
+	}
+	double closestSeconds = GetSeconds() - start;
+
+	start = GetSeconds();
+	for (int r = 0; r < rayCount; r++)
+	{
+		anyHits[r] = tree.RayCastAny(origins[r], directions[r], reach, [&](int proxy, float maxDistance)
+		{
+			int i = tree.GetUserData(proxy);
+			return DynamicBVH::IntersectRaySphere(origins[r], directions[r], centers[i], radii[i]);
+		});
+	}
+	double anySeconds = GetSeconds() - start;
+
+	std::vector<float> packetDistances(rayCount);
+	start = GetSeconds();
+	for (int first = 0; first < rayCount; first += RayPacket::MaxRays)
+	{
+		RayPacket packet;
+		for (int r = first; r < first + RayPacket::MaxRays && r < rayCount; r++)
+		{
+			packet.Add(origins[r], directions[r], reach);
+		}
+		RayHit hits[RayPacket::MaxRays];
+		tree.RayCastPacket(packet, [&](int proxy, int ray, float maxDistance)
+		{
+			int i = tree.GetUserData(proxy);
+			return DynamicBVH::IntersectRaySphere(packet.GetOrigin(ray), packet.direction[ray], centers[i], radii[i]);
+		}, hits);
+		for (int r = 0; r < packet.count; r++)
+		{
+			packetDistances[first + r] = hits[r].proxy != -1 ? hits[r].distance : -1.0f;
+		}
+	}
+	double packetSeconds = GetSeconds() - start;
+
+	// The same sphere test on the same candidates, so the same distances exactly
+	int hitCount = 0;
+	bool raysAgree = true;
+	for (int r = 0; r < rayCount; r++)
+	{
+		hitCount += bruteDistances[r] >= 0.0f ? 1 : 0;
+		raysAgree = raysAgree && closestDistances[r] == bruteDistances[r] && packetDistances[r] == bruteDistances[r] && anyHits[r] == (bruteDistances[r] >= 0.0f);
+	}
+	ok = ok && raysAgree;
+	std::cout << "  " << rayCount << " rays, " << hitCount << " hit" << std::endl;
+	std::cout << "    brute force: " << bruteSeconds * 1000.0 << "ms" << std::endl;
+	std::cout << "    closest:     " << closestSeconds * 1000.0 << "ms (" << bruteSeconds / closestSeconds << "x)" << std::endl;
+	std::cout << "    any:         " << anySeconds * 1000.0 << "ms (" << bruteSeconds / anySeconds << "x)" << std::endl;
+	std::cout << "    packets:     " << packetSeconds * 1000.0 << "ms (" << bruteSeconds / packetSeconds << "x, " << (raysAgree ? "ok" : "FAILED") << ")" << std::endl;
+	return ok;
+}
+
+bool Benchmarks::Occlusion()
+{
+	std::cout << "Occlusion culling" << std::endl;
+
+	// Golden buffers first. With an identity view projection, positions are already
+	// clip space, so occluders can be placed on exact pixel edges of a 64x32 buffer.
+	OcclusionCuller culler(64, 32);
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	const int quad[6] = { 0, 1, 2, 0, 2, 3 };
+
+	// A flat quad over pixels 16-47 by 8-23, and a slanted one over the left half
+	// getting deeper to the right, which passes behind the flat one
+	XMFLOAT3 flat[4] = { XMFLOAT3(-0.5f, 0.5f, 0.25f), XMFLOAT3(0.5f, 0.5f, 0.25f), XMFLOAT3(0.5f, -0.5f, 0.25f), XMFLOAT3(-0.5f, -0.5f, 0.25f) };
+	XMFLOAT3 slanted[4] = { XMFLOAT3(-1.0f, 1.0f, 0.25f), XMFLOAT3(0.0f, 1.0f, 0.5f), XMFLOAT3(0.0f, -1.0f, 0.5f), XMFLOAT3(-1.0f, -1.0f, 0.25f) };
+	culler.Begin(identity);
+	culler.RenderOccluder(flat, 4, quad, 6, identity);
+	culler.RenderOccluder(slanted, 4, quad, 6, identity);
+	culler.Finish();
+
+	const float* depth = culler.GetDepth();
+	float worstError = 0.0f;
+	for (int y = 0; y < 32; y++)
+	{
+		for (int x = 0; x < 64; x++)
+		{
+			float golden = 1.0f;
+			if (x >= 16 && x < 48 && y >= 8 && y < 24)
+			{
+				golden = 0.25f;
+			}
+			if (x < 32)
+			{
+				float ndcX = (x + 0.5f) / 32.0f - 1.0f;
+				float slantedDepth = 0.5f + 0.25f * ndcX;
+				golden = slantedDepth < golden ? slantedDepth : golden;
+			}
+			float error = fabsf(depth[y * 64 + x] - golden);
+			worstError = error > worstError ? error : worstError;
+		}
+	}
+	bool ok = worstError < 1e-5f;
+
+	// Boxes behind the flat quad are hidden, in front of it or past its edge they aren't
+	struct Probe
+	{
+		XMFLOAT3 boxMin, boxMax;
+		bool visible;
+	};
+	const Probe probes[] = {
+		{ XMFLOAT3(0.05f, -0.3f, 0.3f), XMFLOAT3(0.3f, 0.3f, 0.4f), false }, // Behind the flat quad
+		{ XMFLOAT3(0.05f, -0.3f, 0.1f), XMFLOAT3(0.3f, 0.3f, 0.2f), true }, // In front of it
+		{ XMFLOAT3(0.4f, -0.3f, 0.3f), XMFLOAT3(0.7f, 0.3f, 0.4f), true }, // Sticking out past its right edge
+		{ XMFLOAT3(-0.9f, -0.9f, 0.6f), XMFLOAT3(-0.6f, 0.9f, 0.7f), false }, // Behind the slanted quad
+		{ XMFLOAT3(-0.9f, -0.9f, 0.2f), XMFLOAT3(-0.6f, 0.9f, 0.7f), true }, // Reaching in front of it
+		{ XMFLOAT3(2.0f, 2.0f, 0.5f), XMFLOAT3(3.0f, 3.0f, 0.6f), false }, // Off screen
+		{ XMFLOAT3(0.1f, -0.1f, -0.5f), XMFLOAT3(0.2f, 0.1f, 0.5f), true }, // Through the near plane
+	};
+	bool probesAgree = true;
+	for (int i = 0; i < (int)(sizeof(probes) / sizeof(probes[0])); i++)
+	{
+		probesAgree = probesAgree && culler.IsVisible(probes[i].boxMin, probes[i].boxMax) == probes[i].visible;
+	}
+	ok = ok && probesAgree;
+
+	// A quad through the near plane only lands where it's in front of the camera, the right half
+	XMFLOAT3 crossing[4] = { XMFLOAT3(-1.0f, 1.0f, -0.5f), XMFLOAT3(1.0f, 1.0f, 0.5f), XMFLOAT3(1.0f, -1.0f, 0.5f), XMFLOAT3(-1.0f, -1.0f, -0.5f) };
+	culler.Begin(identity);
+	culler.RenderOccluder(crossing, 4, quad, 6, identity);
+	culler.Finish();
+	float worstClipError = 0.0f;
+	for (int y = 0; y < 32; y++)
+	{
+		for (int x = 0; x < 64; x++)
+		{
+			float golden = x < 32 ? 1.0f : 0.5f * ((x + 0.5f) / 32.0f - 1.0f);
+			float error = fabsf(depth[y * 64 + x] - golden);
+			worstClipError = error > worstClipError ? error : worstClipError;
+		}
+	}
+	ok = ok && worstClipError < 1e-5f;
+	std::cout << "  golden buffers: error " << worstError << ", clipped " << worstClipError << ", probes " << (probesAgree ? "ok" : "FAILED") << std::endl;
+
+	// Then speed, with a wall of random triangles in front of a crowd of boxes, at the game's buffer size
+	OcclusionCuller big(256, 144);
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixLookToLH(XMVectorSet(0, 0, -5, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)) *
+		XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 100.0f));
+	unsigned int seed = 17;
+	auto random = [&seed]() { return NextRandom(seed); };
+	const int triangleCount = 4000;
+	std::vector<XMFLOAT3> positions(triangleCount * 3);
+	std::vector<int> indices(triangleCount * 3);
+	for (int i = 0; i < triangleCount * 3; i += 3)
+	{
+		XMFLOAT3 center(random() * 8.0f - 4.0f, random() * 4.0f - 2.0f, 5.0f + random() * 2.0f);
+		for (int k = 0; k < 3; k++)
+		{
+			positions[i + k] = XMFLOAT3(center.x + random() * 1.6f - 0.8f, center.y + random() * 1.6f - 0.8f, center.z + random() * 0.5f);
+			indices[i + k] = i + k;
+		}
+	}
+	const int boxCount = 100000;
+	std::vector<XMFLOAT3> boxMins(boxCount), boxMaxes(boxCount);
+	for (int i = 0; i < boxCount; i++)
+	{
+		float size = 0.05f + random() * 0.3f;
+		boxMins[i] = XMFLOAT3(random() * 8.0f - 4.0f, random() * 4.0f - 2.0f, 4.0f + random() * 10.0f);
+		boxMaxes[i] = XMFLOAT3(boxMins[i].x + size, boxMins[i].y + size, boxMins[i].z + size);
+	}
+
+	double start = GetSeconds();
+	big.Begin(viewProjection);
+	big.RenderOccluder(&positions[0], (int)positions.size(), &indices[0], (int)indices.size(), XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1));
+	big.Finish();
+	double rasterSeconds = GetSeconds() - start;
+
+	int hidden = 0;
+	start = GetSeconds();
+	for (int i = 0; i < boxCount; i++)
+	{
+		hidden += big.IsVisible(boxMins[i], boxMaxes[i]) ? 0 : 1;
+	}
+	double testSeconds = GetSeconds() - start;
+
+	std::cout << "  " << big.GetWidth() << "x" << big.GetHeight() << ", " << big.GetTriangleCount() << " occluder tris, " << hidden << " of " << boxCount << " boxes hidden" << std::endl;
+	std::cout << "    rasterize: " << rasterSeconds * 1000.0 << "ms, " << big.GetTriangleCount() / rasterSeconds / 1e6 << " Mtris/s" << std::endl;
+	std::cout << "    test:      " << testSeconds * 1000.0 << "ms, " << boxCount / testSeconds / 1e6 << " M boxes/s (" << (ok ? "ok" : "FAILED") << ")" << std::endl;
+	return ok;
+}
+
+bool Benchmarks::Broadphase()
+{
+	std::cout << "Broadphase" << std::endl;
+	unsigned int seed = 19;
+	auto random = [&seed]() { return NextRandom(seed); };
+
+	// Half bullets and half targets at the same density every time, so the pairs grow with the count.
+	// Bullets fly fast and small, targets drift slow and big, and some of each respawn every step.
+	bool ok = true;
+	const int counts[3] = { 1000, 4000, 16000 };
+	for (int c = 0; c < 3; c++)
+	{
+		const int objectCount = counts[c];
+		const float extent = 2.0f * cbrtf((float)objectCount);
+		std::vector<XMFLOAT3> centers(objectCount);
+		std::vector<XMFLOAT3> velocities(objectCount);
+		std::vector<float> radii(objectCount);
+		std::vector<int> proxies(objectCount);
+		auto spawn = [&](int i)
+		{
+			centers[i] = XMFLOAT3(random() * extent, random() * extent, random() * extent);
+			float speed = i % 2 == 0 ? 0.3f : 0.02f;
+			velocities[i] = XMFLOAT3((random() * 2.0f - 1.0f) * speed, (random() * 2.0f - 1.0f) * speed, (random() * 2.0f - 1.0f) * speed);
+			radii[i] = i % 2 == 0 ? 0.15f : 0.4f + random() * 0.2f;
+		};
+
+		SpatialHashGrid grid(1.0f);
+		for (int i = 0; i < objectCount; i++)
+		{
+			spawn(i);
+			bool bullet = i % 2 == 0;
+			proxies[i] = grid.Add(Aabb::FromSphere(centers[i], radii[i]), i, bullet ? LAYER_BULLET : LAYER_TARGET, bullet ? LAYER_TARGET : LAYER_BULLET);
+		}
+
+		const int stepCount = 30;
+		size_t pairCount = 0;
+		double moveSeconds = 0;
+		double findSeconds = 0;
+		std::vector<BroadphasePair> found;
+		for (int step = 0; step < stepCount; step++)
+		{
+			double start = GetSeconds();
+			for (int i = 0; i < objectCount; i++)
+			{
+				centers[i].x += velocities[i].x;
+				centers[i].y += velocities[i].y;
+				centers[i].z += velocities[i].z;
+				grid.Move(proxies[i], Aabb::FromSphere(centers[i], radii[i]));
+			}
+			for (int k = 0; k < objectCount / 100; k++)
+			{
+				int i = (int)(random() * objectCount) % objectCount;
+				grid.Remove(proxies[i]);
+				spawn(i);
+				bool bullet = i % 2 == 0;
+				proxies[i] = grid.Add(Aabb::FromSphere(centers[i], radii[i]), i, bullet ? LAYER_BULLET : LAYER_TARGET, bullet ? LAYER_TARGET : LAYER_BULLET);
+			}
+			double moved = GetSeconds();
+			const std::vector<BroadphasePair>& pairs = grid.FindPairs();
+			double end = GetSeconds();
+			moveSeconds += moved - start;
+			findSeconds += end - moved;
+			pairCount += pairs.size();
+			found = pairs;
+		}
+
+		// Every bullet against every target, on the last step's boxes
+		std::vector<BroadphasePair> expected;
+		double start = GetSeconds();
+		for (int a = 0; a < objectCount; a++)
+		{
+			for (int b = a + 1; b < objectCount; b++)
+			{
+				unsigned int layersA = grid.GetLayers(proxies[a]);
+				unsigned int layersB = grid.GetLayers(proxies[b]);
+				if (layersA != layersB && grid.GetBox(proxies[a]).Overlaps(grid.GetBox(proxies[b])))
+				{
+					BroadphasePair pair;
+					pair.proxyA = proxies[a] < proxies[b] ? proxies[a] : proxies[b];
+					pair.proxyB = proxies[a] < proxies[b] ? proxies[b] : proxies[a];
+					expected.push_back(pair);
+				}
+			}
+		}
+		double bruteSeconds = GetSeconds() - start;
+		std::sort(expected.begin(), expected.end(), [](const BroadphasePair& a, const BroadphasePair& b)
+		{
+			return a.proxyA != b.proxyA ? a.proxyA < b.proxyA : a.proxyB < b.proxyB;
+		});
+		bool pairsAgree = found.size() == expected.size() && grid.GetProxyCount() == objectCount;
+		for (size_t i = 0; pairsAgree && i < found.size(); i++)
+		{
+			pairsAgree = found[i].proxyA == expected[i].proxyA && found[i].proxyB == expected[i].proxyB;
+		}
+		ok = ok && pairsAgree;
+
+		std::cout << "  " << objectCount << " objects, " << grid.GetCellCount() << " cells, " << pairCount / stepCount << " pairs a step" << std::endl;
+		std::cout << "    move:        " << moveSeconds * 1000.0 / stepCount << "ms a step" << std::endl;
+		std::cout << "    find pairs:  " << findSeconds * 1000.0 / stepCount << "ms a step" << std::endl;
+		std::cout << "    brute force: " << bruteSeconds * 1000.0 << "ms (" << bruteSeconds * stepCount / findSeconds << "x, " << (pairsAgree ? "ok" : "FAILED") << ")" << std::endl;
+	}
+
+	// A cell 2^21 cells out has the same key as the one at the origin, so a pair
+	// over there lands in the origin's Cell and must still be found
+	SpatialHashGrid grid(1.0f);
+	XMFLOAT3 far(2097152.5f, 0.5f, 0.5f);
+	grid.Add(Aabb::FromSphere(XMFLOAT3(0.5f, 0.5f, 0.5f), 0.25f), 0, LAYER_TARGET, LAYER_BULLET);
+	int farTarget = grid.Add(Aabb::FromSphere(far, 0.25f), 1, LAYER_TARGET, LAYER_BULLET);
+	int farBullet = grid.Add(Aabb::FromSphere(far, 0.125f), 2, LAYER_BULLET, LAYER_TARGET);
+	const std::vector<BroadphasePair>& aliased = grid.FindPairs();
+	bool aliasFound = grid.GetCellCount() == 1 && aliased.size() == 1 && aliased[0].proxyA == farTarget && aliased[0].proxyB == farBullet;
+	ok = ok && aliasFound;
+	std::cout << "  Wrapped cell key (" << (aliasFound ? "ok" : "FAILED") << ")" << std::endl;
+	return ok;
+}
+
+bool Benchmarks::Narrowphase()
+{
+	std::cout << "Narrowphase" << std::endl;
+	unsigned int seed = 23;
+	auto random = [&seed]() { return NextRandom(seed); };
+
+	// A volley of bullets through a crowd of targets, each a unit mesh's bounds under its own world matrix
+	const int bulletCount = 256;
+	const int targetCount = 4096;
+	MeshBounds local;
+	local.boxMin = XMFLOAT3(-0.5f, -0.5f, -0.5f);
+	local.boxMax = XMFLOAT3(0.5f, 0.5f, 0.5f);
+	local.sphereCenter = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	local.sphereRadius = 0.8660254f;
+	std::vector<XMFLOAT4X4> bulletWorlds(bulletCount), targetWorlds(targetCount);
+	SphereBatch bullets, targets;
+	for (int i = 0; i < bulletCount + targetCount; i++)
+	{
+		float scale = i < bulletCount ? 0.3f : 0.5f + random();
+		XMFLOAT4X4& world = i < bulletCount ? bulletWorlds[i] : targetWorlds[i - bulletCount];
+		XMStoreFloat4x4(&world, XMMatrixScaling(scale, scale, scale) * XMMatrixRotationY(random() * 6.28f) * XMMatrixTranslation(random() * 40.0f - 20.0f, random() * 10.0f - 5.0f, random() * 40.0f - 20.0f));
+		MeshBounds bounds = local.Transform(world);
+		(i < bulletCount ? bullets : targets).Add(bounds.sphereCenter, bounds.sphereRadius);
+	}
+
+	// What Collider::collidesWith does for every pair: both world bounds, then the sphere test
+	std::vector<SphereHit> colliderHits;
+	double start = GetSeconds();
+	for (int i = 0; i < bulletCount; i++)
+	{
+		for (int j = 0; j < targetCount; j++)
+		{
+			MeshBounds a = local.Transform(bulletWorlds[i]);
+			MeshBounds b = local.Transform(targetWorlds[j]);
+			if (SphereNarrowphase::Overlaps(a.sphereCenter, a.sphereRadius, b.sphereCenter, b.sphereRadius))
+			{
+				SphereHit hit = { i, j };
+				colliderHits.push_back(hit);
+			}
+		}
+	}
+	double colliderSeconds = GetSeconds() - start;
+
+	// The same test on spheres worked out once each, a pair at a time
+	std::vector<SphereHit> scalarHits;
+	start = GetSeconds();
+	for (int i = 0; i < bulletCount; i++)
+	{
+		XMFLOAT3 center(bullets.centerX[i], bullets.centerY[i], bullets.centerZ[i]);
+		for (int j = 0; j < targetCount; j++)
+		{
+			if (SphereNarrowphase::Overlaps(center, bullets.radius[i], XMFLOAT3(targets.centerX[j], targets.centerY[j], targets.centerZ[j]), targets.radius[j]))
+			{
+				SphereHit hit = { i, j };
+				scalarHits.push_back(hit);
+			}
+		}
+	}
+	double scalarSeconds = GetSeconds() - start;
+
+	// One bullet against a lane's worth of targets
+	std::vector<SphereHit> oneHits;
+	std::vector<int> indices;
+	start = GetSeconds();
+	for (int i = 0; i < bulletCount; i++)
+	{
+		SphereNarrowphase::TestOne(XMFLOAT3(bullets.centerX[i], bullets.centerY[i], bullets.centerZ[i]), bullets.radius[i], targets, indices);
+		for (size_t k = 0; k < indices.size(); k++)
+		{
+			SphereHit hit = { i, indices[k] };
+			oneHits.push_back(hit);
+		}
+	}
+	double oneSeconds = GetSeconds() - start;
+
+	// Every bullet against every target in one call
+	std::vector<SphereHit> allHits;
+	start = GetSeconds();
+	SphereNarrowphase::TestAll(bullets, targets, allHits);
+	double allSeconds = GetSeconds() - start;
+
+	// Candidate pairs side by side, like the game feeds in from the broadphase, about a third of them hits
+	SphereBatch pairA, pairB;
+	std::vector<int> expectedPairs;
+	for (int k = 0; k < 1 << 18; k++)
+	{
+		int i = (int)(random() * bulletCount) % bulletCount;
+		int j = (int)(random() * targetCount) % targetCount;
+		XMFLOAT3 center(targets.centerX[j], targets.centerY[j], targets.centerZ[j]);
+		XMFLOAT3 nearby(center.x + random() * 3.0f - 1.5f, center.y + random() * 3.0f - 1.5f, center.z + random() * 3.0f - 1.5f);
+		pairA.Add(nearby, bullets.radius[i]);
+		pairB.Add(center, targets.radius[j]);
+		if (SphereNarrowphase::Overlaps(nearby, bullets.radius[i], center, targets.radius[j]))
+		{
+			expectedPairs.push_back(k);
+		}
+	}
+	std::vector<int> pairHits;
+	start = GetSeconds();
+	SphereNarrowphase::TestPairs(pairA, pairB, pairHits);
+	double pairSeconds = GetSeconds() - start;
+
+	// Same math in the same order, so exactly the same hits
+	auto same = [](const std::vector<SphereHit>& a, const std::vector<SphereHit>& b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t k = 0; k < a.size(); k++)
+		{
+			if (a[k].a != b[k].a || a[k].b != b[k].b)
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+	bool agree = same(scalarHits, colliderHits) && same(oneHits, colliderHits) && same(allHits, colliderHits);
+	bool pairsAgree = pairHits == expectedPairs;
+	std::cout << "  " << bulletCount << " bullets against " << targetCount << " targets, " << colliderHits.size() << " hits" << std::endl;
+	std::cout << "    collider:    " << colliderSeconds * 1000.0 << "ms" << std::endl;
+	std::cout << "    scalar:      " << scalarSeconds * 1000.0 << "ms (" << colliderSeconds / scalarSeconds << "x)" << std::endl;
+	std::cout << "    one by one:  " << oneSeconds * 1000.0 << "ms (" << colliderSeconds / oneSeconds << "x)" << std::endl;
+	std::cout << "    all at once: " << allSeconds * 1000.0 << "ms (" << colliderSeconds / allSeconds << "x, " << (agree ? "ok" : "FAILED") << ")" << std::endl;
+	std::cout << "  " << pairA.GetCount() << " candidate pairs, " << pairHits.size() << " hits" << std::endl;
+	std::cout << "    pairs:       " << pairSeconds * 1000.0 << "ms, " << pairA.GetCount() / pairSeconds / 1e6 << " M pairs/s (" << (pairsAgree ? "ok" : "FAILED") << ")" << std::endl;
+	return agree && pairsAgree;
+}
+
+bool Benchmarks::SweptCollision()
+{
+	std::cout << "Swept collision" << std::endl;
+	unsigned int seed = 29;
+	auto random = [&seed]() { return NextRandom(seed); };
+	auto randomPoint = [&](float size)
+	{
+		return XMFLOAT3(random() * size - size * 0.5f, random() * size - size * 0.5f, random() * size - size * 0.5f);
+	};
+
+	// Times of impact land between the last sub step that's clear and the first that touches.
+	// Sweeps aimed near the boxes' corners and edges check the rounded parts too.
+	const int subSteps = 2000;
+	const int sweepCount = 2000;
+	int sphereHits = 0;
+	int boxHits = 0;
+	bool timesAgree = true;
+	for (int k = 0; k < sweepCount; k++)
+	{
+		float radius = 0.1f + random() * 0.5f;
+		XMFLOAT3 start = randomPoint(8.0f);
+		XMFLOAT3 target = randomPoint(1.5f);
+		XMFLOAT3 displacement((target.x - start.x) * 2.0f, (target.y - start.y) * 2.0f, (target.z - start.z) * 2.0f);
+		XMFLOAT3 boxMin(-0.5f, -0.3f, -0.4f);
+		XMFLOAT3 boxMax(0.4f, 0.5f, 0.3f);
+		float sphereTime = SphereNarrowphase::SweepSphere(start, displacement, radius, XMFLOAT3(0.0f, 0.0f, 0.0f), 0.7f);
+		float boxTime = SphereNarrowphase::SweepBox(start, displacement, radius, boxMin, boxMax);
+
+		int firstSphere = -1;
+		int firstBox = -1;
+		for (int step = 0; step <= subSteps && (firstSphere == -1 || firstBox == -1); step++)
+		{
+			float t = step / (float)subSteps;
+			XMFLOAT3 p(start.x + displacement.x * t, start.y + displacement.y * t, start.z + displacement.z * t);
+			if (firstSphere == -1 && SphereNarrowphase::Overlaps(p, radius, XMFLOAT3(0.0f, 0.0f, 0.0f), 0.7f))
+			{
+				firstSphere = step;
+			}
+			float outsideX = p.x < boxMin.x ? boxMin.x - p.x : (p.x > boxMax.x ? p.x - boxMax.x : 0.0f);
+			float outsideY = p.y < boxMin.y ? boxMin.y - p.y : (p.y > boxMax.y ? p.y - boxMax.y : 0.0f);
+			float outsideZ = p.z < boxMin.z ? boxMin.z - p.z : (p.z > boxMax.z ? p.z - boxMax.z : 0.0f);
+			if (firstBox == -1 && outsideX * outsideX + outsideY * outsideY + outsideZ * outsideZ <= radius * radius)
+			{
+				firstBox = step;
+			}
+		}
+
+		// A sweep that only grazes can fall between two sub steps, so only hits the sub steps see are checked both ways
+		const float slack = 1e-4f;
+		auto check = [&](float time, int first)
+		{
+			if (first == -1)
+			{
+				return true;
+			}
+			float latest = first / (float)subSteps;
+			float earliest = (first - 1) / (float)subSteps;
+			return time >= 0.0f && time <= latest + slack && time >= earliest - slack;
+		};
+		timesAgree = timesAgree && check(sphereTime, firstSphere) && check(boxTime, firstBox);
+		sphereHits += sphereTime >= 0.0f ? 1 : 0;
+		boxHits += boxTime >= 0.0f ? 1 : 0;
+	}
+	std::cout << "  " << sweepCount << " sweeps, " << sphereHits << " hit the sphere, " << boxHits << " hit the box (" << (timesAgree ? "ok" : "FAILED") << ")" << std::endl;
+
+	// The batch against one at a time, on a broadphase's worth of candidate pairs
+	SweptSphereBatch moving;
+	SphereBatch still;
+	for (int k = 0; k < 1 << 18; k++)
+	{
+		XMFLOAT3 center = randomPoint(40.0f);
+		XMFLOAT3 offset = randomPoint(4.0f);
+		XMFLOAT3 start(center.x + offset.x, center.y + offset.y, center.z + offset.z);
+		moving.Add(start, 0.15f, XMFLOAT3(-offset.x * 2.0f * random(), -offset.y * 2.0f * random(), -offset.z * 2.0f * random()));
+		still.Add(center, 0.4f + random() * 0.4f);
+	}
+	std::vector<int> expected;
+	std::vector<float> expectedTimes;
+	double start = GetSeconds();
+	for (int k = 0; k < moving.GetCount(); k++)
+	{
+		float t = SphereNarrowphase::SweepSphere(XMFLOAT3(moving.start.centerX[k], moving.start.centerY[k], moving.start.centerZ[k]), XMFLOAT3(moving.moveX[k], moving.moveY[k], moving.moveZ[k]), moving.start.radius[k],
+			XMFLOAT3(still.centerX[k], still.centerY[k], still.centerZ[k]), still.radius[k]);
+		if (t >= 0.0f)
+		{
+			expected.push_back(k);
+			expectedTimes.push_back(t);
+		}
+	}
+	double scalarSeconds = GetSeconds() - start;
+	std::vector<int> hits;
+	std::vector<float> times;
+	start = GetSeconds();
+	SphereNarrowphase::SweepPairs(moving, still, hits, times);
+	double batchSeconds = GetSeconds() - start;
+	bool batchAgrees = hits == expected && times == expectedTimes;
+	std::cout << "  " << moving.GetCount() << " swept pairs, " << hits.size() << " hits" << std::endl;
+	std::cout << "    one at a time: " << scalarSeconds * 1000.0 << "ms" << std::endl;
+	std::cout << "    batched:       " << batchSeconds * 1000.0 << "ms (" << scalarSeconds / batchSeconds << "x, " << (batchAgrees ? "ok" : "FAILED") << ")" << std::endl;
+
+	// The game's bullets at 20 units a second, through targets half a unit across, at coarser and coarser steps.
+	// Discrete checks at the end of each step miss what they jump over, sweeps shouldn't miss anything.
+	const float stepRates[3] = { 60.0f, 20.0f, 5.0f };
+	const int shotCount = 4000;
+	bool sweepsCatchAll = true;
+	for (int r = 0; r < 3; r++)
+	{
+		float deltaTime = 1.0f / stepRates[r];
+		int discreteHits = 0;
+		int sweptHits = 0;
+		for (int shot = 0; shot < shotCount; shot++)
+		{
+			// Every shot passes within a target radius of its center somewhere along 20 units of flight
+			XMFLOAT3 center(0.0f, 0.0f, 5.0f + random() * 10.0f);
+			XMFLOAT3 velocity(0.0f, 0.0f, 20.0f);
+			XMFLOAT3 position(random() * 0.4f - 0.2f, random() * 0.4f - 0.2f, -random() * 20.0f * deltaTime);
+			bool discrete = false;
+			bool swept = false;
+			for (float travelled = 0.0f; travelled < 25.0f; travelled += velocity.z * deltaTime)
+			{
+				XMFLOAT3 displacement(velocity.x * deltaTime, velocity.y * deltaTime, velocity.z * deltaTime);
+				swept = swept || SphereNarrowphase::SweepSphere(position, displacement, 0.15f, center, 0.25f) >= 0.0f;
+				position = XMFLOAT3(position.x + displacement.x, position.y + displacement.y, position.z + displacement.z);
+				discrete = discrete || SphereNarrowphase::Overlaps(position, 0.15f, center, 0.25f);
+			}
+			discreteHits += discrete ? 1 : 0;
+			sweptHits += swept ? 1 : 0;
+		}
+		sweepsCatchAll = sweepsCatchAll && sweptHits == shotCount;
+		std::cout << "    " << stepRates[r] << " steps/s: discrete " << discreteHits << ", swept " << sweptHits << " of " << shotCount << " shots" << std::endl;
+	}
+	return timesAgree && batchAgrees && sweepsCatchAll;
+}
+
+bool Benchmarks::MeshRays()
+{
+	std::cout << "Mesh rays" << std::endl;
+	unsigned int seed = 31;
+	auto random = [&seed]() { return NextRandom(seed); };
+	auto randomPoint = [&](float size)
+	{
+		return XMFLOAT3(random() * size - size * 0.5f, random() * size - size * 0.5f, random() * size - size * 0.5f);
+	};
+
+	// A lumpy sphere, so rays get near plenty of triangles they don't hit and some hit it twice
+	const int rings = 160;
+	const int segments = 320;
+	std::vector<Vertex> vertices;
+	std::vector<int> indices;
+	BuildLumpySphere(rings, segments, vertices, indices);
+	int triangleCount = (int)indices.size() / 3;
+
+	MeshBVH bvh;
+	double start = GetSeconds();
+	bvh.Build(&vertices[0], (int)vertices.size(), &indices[0], (int)indices.size());
+	double buildSeconds = GetSeconds() - start;
+	std::cout << "  " << triangleCount << " triangles, built in " << buildSeconds * 1000.0 << "ms, " << bvh.GetNodeCount() << " nodes, depth " << bvh.GetDepth() << std::endl;
+
+	// Rays from outside aimed through the middle, most hitting and some passing by
+	const int rayCount = 1 << 18;
+	std::vector<XMFLOAT3> origins(rayCount);
+	std::vector<XMFLOAT3> directions(rayCount);
+	for (int k = 0; k < rayCount; k++)
+	{
+		origins[k] = randomPoint(8.0f);
+		origins[k].z -= 6.0f;
+		XMFLOAT3 target = randomPoint(2.6f);
+		directions[k] = XMFLOAT3(target.x - origins[k].x, target.y - origins[k].y, target.z - origins[k].z);
+	}
+
+	// Against every triangle for a slice of them, the tree has to find the same nearest distance
+	const int checkedRays = 1000;
+	bool closestAgrees = true;
+	int checkedHits = 0;
+	for (int k = 0; k < checkedRays; k++)
+	{
+		float nearest = 100.0f;
+		int nearestTriangle = -1;
+		for (int t = 0; t < triangleCount; t++)
+		{
+			float distance, u, v;
+			if (MeshBVH::IntersectTriangle(origins[k], directions[k], vertices[indices[t * 3]].Position, vertices[indices[t * 3 + 1]].Position, vertices[indices[t * 3 + 2]].Position, distance, u, v) && distance < nearest)
+			{
+				nearest = distance;
+				nearestTriangle = t;
+			}
+		}
+		MeshRayHit hit;
+		bool found = bvh.RayCast(origins[k], directions[k], 100.0f, hit);
+		closestAgrees = closestAgrees && found == (nearestTriangle != -1) && (!found || hit.distance == nearest);
+		if (found)
+		{
+			// The point is on the ray and the interpolated normal faces roughly away from the middle, like the lumps do
+			XMFLOAT3 point(origins[k].x + directions[k].x * hit.distance, origins[k].y + directions[k].y * hit.distance, origins[k].z + directions[k].z * hit.distance);
+			float facing = hit.normal.x * point.x + hit.normal.y * point.y + hit.normal.z * point.z;
+			closestAgrees = closestAgrees && fabsf(hit.point.x - point.x) <= 1e-5f && fabsf(hit.point.y - point.y) <= 1e-5f && fabsf(hit.point.z - point.z) <= 1e-5f &&
+				facing > 0.0f && hit.uv.x >= 0.0f && hit.uv.x <= 1.0f && hit.uv.y >= 0.0f && hit.uv.y <= 1.0f;
+			checkedHits++;
+		}
+	}
+	std::cout << "  " << checkedRays << " rays against every triangle, " << checkedHits << " hits (" << (closestAgrees ? "ok" : "FAILED") << ")" << std::endl;
+
+	// An instance scaled, turned and moved, against the same mesh with the transform baked into its vertices
+	XMFLOAT4X4 instance;
+	XMStoreFloat4x4(&instance, XMMatrixScaling(2.0f, 0.5f, 1.5f) * XMMatrixRotationY(0.7f) * XMMatrixTranslation(3.0f, -1.0f, 2.0f));
+	std::vector<Vertex> baked = vertices;
+	for (size_t i = 0; i < baked.size(); i++)
+	{
+		XMStoreFloat3(&baked[i].Position, XMVector3TransformCoord(XMLoadFloat3(&baked[i].Position), XMLoadFloat4x4(&instance)));
+	}
+	MeshBVH bakedBvh;
+	bakedBvh.Build(&baked[0], (int)baked.size(), &indices[0], (int)indices.size());
+	bool instanceAgrees = true;
+	int grazes = 0;
+	for (int k = 0; k < checkedRays; k++)
+	{
+		XMFLOAT3 origin(origins[k].x + 3.0f, origins[k].y - 1.0f, origins[k].z + 2.0f);
+		MeshRayHit instanceHit, bakedHit;
+		bool instanceFound = bvh.RayCastInstance(origin, directions[k], 100.0f, instance, instanceHit);
+		bool bakedFound = bakedBvh.RayCast(origin, directions[k], 100.0f, bakedHit);
+
+		// Rounding differs between the two, so a ray grazing an edge can land on either side of it
+		if (instanceFound && bakedFound)
+		{
+			instanceAgrees = instanceAgrees && fabsf(instanceHit.distance - bakedHit.distance) <= 1e-3f * instanceHit.distance &&
+				fabsf(instanceHit.point.x - bakedHit.point.x) <= 1e-3f && fabsf(instanceHit.point.y - bakedHit.point.y) <= 1e-3f && fabsf(instanceHit.point.z - bakedHit.point.z) <= 1e-3f;
+		}
+		else if (instanceFound != bakedFound)
+		{
+			grazes++;
+		}
+	}
+	instanceAgrees = instanceAgrees && grazes <= checkedRays / 100;
+	std::cout << "  " << checkedRays << " rays at a moved, turned and scaled instance against the same mesh baked in place, " << grazes << " grazing disagreements (" << (instanceAgrees ? "ok" : "FAILED") << ")" << std::endl;
+
+	// Rays per second, one thread and then every hardware thread
+	int hardwareThreads = (int)std::thread::hardware_concurrency();
+	hardwareThreads = hardwareThreads > 1 ? hardwareThreads : 1;
+	std::vector<float> singleDistances(rayCount);
+	start = GetSeconds();
+	for (int k = 0; k < rayCount; k++)
+	{
+		MeshRayHit hit;
+		singleDistances[k] = bvh.RayCast(origins[k], directions[k], 100.0f, hit) ? hit.distance : -1.0f;
+	}
+	double singleSeconds = GetSeconds() - start;
+	std::vector<float> parallelDistances(rayCount);
+	JobSystem jobs(hardwareThreads);
+	start = GetSeconds();
+	jobs.ParallelFor(rayCount, 1024, [&](int first, int last)
+	{
+		for (int k = first; k < last; k++)
+		{
+			MeshRayHit hit;
+			parallelDistances[k] = bvh.RayCast(origins[k], directions[k], 100.0f, hit) ? hit.distance : -1.0f;
+		}
+	});
+	double parallelSeconds = GetSeconds() - start;
+	bool threadsAgree = singleDistances == parallelDistances;
+	std::cout << "    1 thread:  " << rayCount / singleSeconds / 1e6 << "M rays/s" << std::endl;
+	std::cout << "    " << hardwareThreads << (hardwareThreads == 1 ? " thread:  " : " threads: ") << rayCount / parallelSeconds / 1e6 << "M rays/s (" << singleSeconds / parallelSeconds << "x, " << (threadsAgree ? "ok" : "FAILED") << ")" << std::endl;
+	return closestAgrees && instanceAgrees && threadsAgree;
+}
+
+bool Benchmarks::Physics()
+{
+	std::cout << "Physics" << std::endl;
+	const float deltaTime = 1.0f / 60.0f;
+	auto settle = [&](PhysicsWorld& physics, int maxSteps)
+	{
+		int steps = 0;
+		while (physics.GetAwakeCount() > 0 && steps < maxSteps)
+		{
+			physics.Step(deltaTime);
+			steps++;
+		}
+		return steps;
+	};
+
+	// A ball, a tipped box, a stack of five, a ball on a ledge and a ball thrown at the floor, well apart on one floor
+	PhysicsWorld physics;
+	physics.AddPlane(XMFLOAT3(0.0f, 1.0f, 0.0f), 0.0f);
+	int ball = physics.AddSphere(XMFLOAT3(0.0f, 2.0f, 0.0f), 0.5f, 1.0f, 0);
+	XMFLOAT4 tipped;
+	XMStoreFloat4(&tipped, XMQuaternionRotationRollPitchYaw(0.35f, 0.2f, 0.5f));
+	int box = physics.AddBox(XMFLOAT3(5.0f, 2.0f, 0.0f), tipped, XMFLOAT3(0.5f, 0.3f, 0.4f), 1.0f, 1);
+	int stack[5];
+	for (int k = 0; k < 5; k++)
+	{
+		stack[k] = physics.AddBox(XMFLOAT3(10.0f, 0.51f + 1.01f * k, 0.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 0.5f), 1.0f, 2 + k);
+	}
+	physics.AddBox(XMFLOAT3(15.0f, 1.0f, 0.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), 0.0f, 7);
+	int ledgeBall = physics.AddSphere(XMFLOAT3(15.2f, 3.0f, 0.1f), 0.3f, 1.0f, 8);
+	int thrown = physics.AddSphere(XMFLOAT3(20.0f, 3.0f, 0.0f), 0.25f, 1.0f, 9);
+	physics.SetVelocity(thrown, XMFLOAT3(0.0f, -40.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f)); // Most of a metre a step
+	float lowest = 3.0f;
+	int steps = 0;
+	while (physics.GetAwakeCount() > 0 && steps < 1200)
+	{
+		physics.Step(deltaTime);
+		lowest = physics.GetPosition(thrown).y < lowest ? physics.GetPosition(thrown).y : lowest;
+		steps++;
+	}
+
+	// The box ends up flat on a face, so one of its axes points straight up and it sits at that half extent
+	XMFLOAT4 boxRotation = physics.GetRotation(box);
+	XMFLOAT3 up; // World up in the box's own axes
+	XMStoreFloat3(&up, XMVector3Rotate(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), XMQuaternionConjugate(XMLoadFloat4(&boxRotation))));
+	float boxHeight = physics.GetPosition(box).y;
+	bool flat = (fabsf(up.x) > 0.999f && fabsf(boxHeight - 0.5f) < 0.02f) || (fabsf(up.y) > 0.999f && fabsf(boxHeight - 0.3f) < 0.02f) || (fabsf(up.z) > 0.999f && fabsf(boxHeight - 0.4f) < 0.02f);
+	XMFLOAT3 top = physics.GetPosition(stack[4]);
+	bool rests = physics.GetAwakeCount() == 0 &&
+		fabsf(physics.GetPosition(ball).y - 0.5f) < 0.02f &&
+		flat &&
+		fabsf(top.x - 10.0f) < 0.05f && fabsf(top.z) < 0.05f && fabsf(top.y - 4.5f) < 0.05f &&
+		fabsf(physics.GetPosition(ledgeBall).y - 2.3f) < 0.02f &&
+		lowest > 0.2f && fabsf(physics.GetPosition(thrown).y - 0.25f) < 0.02f;
+	std::cout << "  Ball, tipped box, stack of 5, ball on a ledge and a thrown ball asleep after " << steps << " steps, stack top at "
+		<< top.x << ", " << top.y << ", " << top.z << " (" << (rests ? "ok" : "FAILED") << ")" << std::endl;
+
+	// Knocking the top of the stack wakes the stack and nothing else, and it all settles again
+	physics.ApplyImpulse(stack[4], XMFLOAT3(3.0f, 0.0f, 0.0f), XMFLOAT3(10.0f, 4.9f, 0.0f));
+	int woken = physics.GetAwakeCount();
+	bool stackWoke = woken == 5 && physics.IsAwake(stack[0]) && !physics.IsAwake(ball) && !physics.IsAwake(box);
+	steps = settle(physics, 1200);
+	bool resettled = physics.GetAwakeCount() == 0 && physics.GetPosition(stack[4]).x > 10.5f;
+	std::cout << "  Knocked the top off: " << woken << " woke, asleep again after " << steps << " steps (" << (stackWoke && resettled ? "ok" : "FAILED") << ")" << std::endl;
+
+	// Fields of settled debris, pairs of boxes stacked and balls between them. Once they're asleep a step
+	// shouldn't cost more with more of them, and knocking a few only costs those few.
+	bool scales = true;
+	const int counts[3] = { 1000, 4000, 16000 };
+	for (int c = 0; c < 3; c++)
+	{
+		PhysicsWorld field;
+		field.AddPlane(XMFLOAT3(0.0f, 1.0f, 0.0f), 0.0f);
+		int side = (int)sqrtf((float)counts[c] / 3.0f) + 1;
+		std::vector<int> bodies;
+		for (int i = 0; i < counts[c]; i++)
+		{
+			float x = (float)(i / 3 % side), z = (float)(i / 3 / side);
+			if (i % 3 == 2)
+			{
+				bodies.push_back(field.AddSphere(XMFLOAT3(x + 0.5f, 0.3f, z + 0.5f), 0.2f, 0.5f, i));
+				continue;
+			}
+			bodies.push_back(field.AddBox(XMFLOAT3(x + 0.05f * (i % 3), 0.26f + 0.51f * (i % 3), z), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT3(0.25f, 0.25f, 0.25f), 1.0f, i));
+		}
+
+		double start = GetSeconds();
+		const int awakeSteps = 10;
+		for (int s = 0; s < awakeSteps; s++)
+		{
+			field.Step(deltaTime);
+		}
+		double awakeSeconds = (GetSeconds() - start) / awakeSteps;
+		int settleSteps = awakeSteps + settle(field, 1200);
+		bool asleep = field.GetAwakeCount() == 0;
+
+		start = GetSeconds();
+		const int sleepingSteps = 100;
+		for (int s = 0; s < sleepingSteps; s++)
+		{
+			field.Step(deltaTime);
+		}
+		double sleepingSeconds = (GetSeconds() - start) / sleepingSteps;
+		asleep = asleep && field.GetAwakeCount() == 0 && field.GetContactCount() == 0;
+
+		for (int k = 0; k < 10; k++)
+		{
+			int body = bodies[(k * 7919) % bodies.size()];
+			field.ApplyImpulse(body, XMFLOAT3(0.0f, 2.0f, 0.0f), field.GetPosition(body));
+		}
+		int knocked = field.GetAwakeCount();
+		start = GetSeconds();
+		field.Step(deltaTime);
+		double knockedSeconds = GetSeconds() - start;
+		scales = scales && asleep && knocked <= 30;
+		std::cout << "    " << counts[c] << " bodies: awake " << awakeSeconds * 1000.0 << "ms a step, asleep after " << settleSteps << " steps, then "
+			<< sleepingSeconds * 1000.0 << "ms a step, " << knocked << " knocked awake " << knockedSeconds * 1000.0 << "ms (" << (asleep ? "ok" : "FAILED") << ")" << std::endl;
+	}
+	return rests && stackWoke && resettled && scales;
+}
+
+bool Benchmarks::Shatter()
+{
+	std::cout << "Shatter" << std::endl;
+	unsigned int seed = 37;
+	auto random = [&seed]() { return NextRandom(seed); };
+
+	// A coarser lumpy sphere than the ray test's, since a pattern is built once per mesh
+	const int rings = 40;
+	const int segments = 80;
+	std::vector<Vertex> vertices;
+	std::vector<int> indices;
+	BuildLumpySphere(rings, segments, vertices, indices);
+
+	// Signed volume of a triangle list measured from origin, the same wherever origin is only if the surface is closed
+	auto volume = [](const Vertex* triangleVertices, const int* triangleIndices, int indexCount, XMVECTOR origin)
+	{
+		double sum = 0.0;
+		for (int i = 0; i < indexCount; i += 3)
+		{
+			XMVECTOR a = XMLoadFloat3(&triangleVertices[triangleIndices[i]].Position) - origin;
+			XMVECTOR b = XMLoadFloat3(&triangleVertices[triangleIndices[i + 1]].Position) - origin;
+			XMVECTOR c = XMLoadFloat3(&triangleVertices[triangleIndices[i + 2]].Position) - origin;
+			sum += XMVectorGetX(XMVector3Dot(a, XMVector3Cross(b, c))) / 6.0;
+		}
+		return sum;
+	};
+	double meshVolume = volume(&vertices[0], &indices[0], (int)indices.size(), XMVectorZero());
+
+	FracturePattern pattern;
+	double start = GetSeconds();
+	pattern.Build(&vertices[0], (int)vertices.size(), &indices[0], (int)indices.size(), FracturePattern::DefaultShardCount, FracturePattern::DefaultSeed);
+	double buildSeconds = GetSeconds() - start;
+
+	// Every shard is a closed piece of the inside, and together they're all of it
+	bool closed = pattern.GetShardCount() > 0;
+	double shardVolume = 0.0;
+	for (int s = 0; s < pattern.GetShardCount(); s++)
+	{
+		const FractureShard& shard = pattern.GetShard(s);
+		const int* shardIndices = pattern.GetIndices() + shard.firstIndex;
+		double here = volume(pattern.GetVertices(), shardIndices, shard.indexCount, XMVectorZero());
+		double moved = volume(pattern.GetVertices(), shardIndices, shard.indexCount, XMVectorSet(3.0f, -2.0f, 5.0f, 0.0f));
+		closed = closed && fabs(here - moved) <= fabs(here) * 1e-3 && here * meshVolume > 0.0;
+		shardVolume += here;
+	}
+	bool whole = fabs(shardVolume - meshVolume) <= fabs(meshVolume) * 1e-3;
+	std::cout << "  " << pattern.GetShardCount() << " shards, " << pattern.GetVertexCount() << " verts, " << pattern.GetIndexCount() / 3 << " tris in "
+		<< buildSeconds * 1000.0 << "ms, volume " << shardVolume << " of " << meshVolume << " (" << (closed && whole ? "ok" : "FAILED") << ")" << std::endl;
+
+	// Through the cache file and back, and a different mesh or different cells don't read
+	const char* cacheFile = "benchmark_shatter.sgshards";
+	const unsigned long long sourceHash = 0x5ca77e4edull;
+	FracturePattern cached;
+	bool roundTrip = pattern.Write(cacheFile, sourceHash) &&
+		!cached.Read(cacheFile, sourceHash + 1, FracturePattern::DefaultShardCount, FracturePattern::DefaultSeed) &&
+		!cached.Read(cacheFile, sourceHash, FracturePattern::DefaultShardCount, FracturePattern::DefaultSeed + 1) &&
+		cached.Read(cacheFile, sourceHash, FracturePattern::DefaultShardCount, FracturePattern::DefaultSeed) &&
+		cached.GetShardCount() == pattern.GetShardCount() && cached.GetVertexCount() == pattern.GetVertexCount() && cached.GetIndexCount() == pattern.GetIndexCount() &&
+		memcmp(cached.GetVertices(), pattern.GetVertices(), sizeof(Vertex) * pattern.GetVertexCount()) == 0 &&
+		memcmp(cached.GetIndices(), pattern.GetIndices(), sizeof(int) * pattern.GetIndexCount()) == 0;
+	DeleteFileA(cacheFile);
+	std::cout << "  Cache round trip (" << (roundTrip ? "ok" : "FAILED") << ")" << std::endl;
+
+	// Five hundred objects breaking on the same step, strewn about a range
+	const float deltaTime = 1.0f / 60.0f;
+	const float floorHeight = -5.0f;
+	const int shatters = 500;
+	ShardPool pool(16384, 3.0f, floorHeight);
+	int patternId = pool.AddPattern(&pattern);
+	std::vector<XMFLOAT4X4> worlds(shatters);
+	std::vector<XMFLOAT3> hits(shatters);
+	for (int i = 0; i < shatters; i++)
+	{
+		XMFLOAT3 position(random() * 40.0f - 20.0f, random() * 8.0f - 2.0f, random() * 20.0f);
+		XMMATRIX world = XMMatrixScaling(0.5f, 0.5f, 0.5f) * XMMatrixRotationRollPitchYaw(random() * 6.0f, random() * 6.0f, 0.0f) * XMMatrixTranslation(position.x, position.y, position.z);
+		XMStoreFloat4x4(&worlds[i], XMMatrixTranspose(world));
+		hits[i] = XMFLOAT3(position.x, position.y, position.z - 0.5f);
+	}
+	const XMFLOAT3 rackVelocity(1.0f, 0.0f, 0.0f);
+	const XMFLOAT3 bulletVelocity(0.0f, 0.0f, 20.0f);
+	start = GetSeconds();
+	for (int i = 0; i < shatters; i++)
+	{
+		pool.Shatter(patternId, worlds[i], rackVelocity, hits[i], bulletVelocity);
+	}
+	double shatterSeconds = (GetSeconds() - start) / shatters;
+	bool placed = pool.GetLivingCount() == shatters * pattern.GetShardCount() && pool.GetRecycledCount() == 0;
+	std::cout << "  " << shatters << " at once: " << pool.GetLivingCount() << " shards, " << shatterSeconds * 1000000.0 << "us a shatter (" << (placed ? "ok" : "FAILED") << ")" << std::endl;
+
+	// A target sliding along its rack, stepped in Game's order. Its velocity only shows once the world matrices
+	// are updated, and then its shards get the same burst a still target's would, carried along by the slide.
+	TransformStore transforms;
+	int rack = transforms.Add();
+	int target = transforms.Add();
+	transforms.SetParent(target, rack);
+	transforms.SetPosition(rack, XMFLOAT3(0.0f, 1.0f, 2.0f));
+	transforms.SetScale(target, XMFLOAT3(0.5f, 0.5f, 0.5f));
+	transforms.UpdateWorldMatrices();
+	transforms.SavePreviousWorldMatrices();
+	const float slide = 0.05f;
+	transforms.SetPosition(target, XMFLOAT3(slide, 0.0f, 0.0f));
+	XMFLOAT3 staleVelocity = transforms.GetWorldVelocity(target, deltaTime);
+	transforms.UpdateWorldMatrices();
+	XMFLOAT3 slideVelocity = transforms.GetWorldVelocity(target, deltaTime);
+	bool carried = staleVelocity.x == 0.0f && fabsf(slideVelocity.x - slide / deltaTime) < 1e-3f && slideVelocity.y == 0.0f && slideVelocity.z == 0.0f;
+	ShardPool stillPool(pattern.GetShardCount(), 3.0f, floorHeight), slidingPool(pattern.GetShardCount(), 3.0f, floorHeight);
+	stillPool.AddPattern(&pattern);
+	slidingPool.AddPattern(&pattern);
+	const XMFLOAT4X4& targetWorld = transforms.GetWorldMatrix(target);
+	XMFLOAT3 targetHit(targetWorld._14, targetWorld._24, targetWorld._34 - 0.5f);
+	stillPool.Shatter(0, targetWorld, XMFLOAT3(0.0f, 0.0f, 0.0f), targetHit, bulletVelocity);
+	slidingPool.Shatter(0, targetWorld, slideVelocity, targetHit, bulletVelocity);
+	stillPool.Update(deltaTime);
+	slidingPool.Update(deltaTime);
+	ShardSnapshot stillShards, slidingShards;
+	stillPool.CopyToSnapshot(stillShards);
+	slidingPool.CopyToSnapshot(slidingShards);
+	carried = carried && stillShards.instances.size() == slidingShards.instances.size();
+	for (size_t k = 0; k < stillShards.instances.size() && carried; k++)
+	{
+		const XMFLOAT3& still = stillShards.instances[k].position;
+		const XMFLOAT3& sliding = slidingShards.instances[k].position;
+		carried = fabsf(sliding.x - still.x - slideVelocity.x * deltaTime) < 1e-4f && sliding.y == still.y && sliding.z == still.z;
+	}
+	std::cout << "  Sliding target: " << slideVelocity.x << " units/s carried on to its shards (" << (carried ? "ok" : "FAILED") << ")" << std::endl;
+
+	// A second of flight both ways, each step snapshotted like a frame. Groups stay in order and cover every
+	// shard, the snapshot stops growing after the first, and nothing sinks through the floor.
+	ShardSnapshot snapshot;
+	JobSystem jobs;
+	bool grouped = true;
+	bool reused = true;
+	bool aboveFloor = true;
+	const ShardInstance* instanceData = nullptr;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		JobSystem* passJobs = pass == 0 ? nullptr : &jobs;
+		double updateSeconds = 0.0;
+		double snapshotSeconds = 0.0;
+		const int steps = 30;
+		for (int s = 0; s < steps; s++)
+		{
+			start = GetSeconds();
+			pool.Update(deltaTime, passJobs);
+			updateSeconds += GetSeconds() - start;
+			start = GetSeconds();
+			pool.CopyToSnapshot(snapshot);
+			snapshotSeconds += GetSeconds() - start;
+
+			if (instanceData != nullptr && snapshot.instances.data() != instanceData)
+			{
+				reused = false;
+			}
+			instanceData = snapshot.instances.data();
+			for (size_t g = 1; g < snapshot.groupStarts.size(); g++)
+			{
+				grouped = grouped && snapshot.groupStarts[g] >= snapshot.groupStarts[g - 1];
+			}
+			grouped = grouped && snapshot.groupStarts.back() == pool.GetLivingCount() && (int)snapshot.instances.size() == pool.GetLivingCount();
+			for (size_t k = 0; k < snapshot.instances.size(); k++)
+			{
+				aboveFloor = aboveFloor && snapshot.instances[k].position.y >= floorHeight;
+			}
+		}
+		std::cout << "    " << (pass == 0 ? "One thread" : "Job system") << ": update " << updateSeconds / steps * 1000.0 << "ms, snapshot "
+			<< snapshotSeconds / steps * 1000.0 << "ms a step" << std::endl;
+	}
+	std::cout << "  Grouped " << (grouped ? "ok" : "FAILED") << ", snapshot reused " << (reused ? "ok" : "FAILED") << ", above the floor " << (aboveFloor ? "ok" : "FAILED") << std::endl;
+
+	// Another five hundred fill it, and the oldest make way
+	for (int i = 0; i < shatters; i++)
+	{
+		pool.Shatter(patternId, worlds[i], rackVelocity, hits[i], bulletVelocity);
+	}
+	int overflow = 2 * shatters * pattern.GetShardCount() - pool.GetMaxShards();
+	bool recycled = pool.GetLivingCount() == pool.GetMaxShards() && pool.GetRecycledCount() == overflow;
+	std::cout << "  Overflowed: " << pool.GetRecycledCount() << " recycled early (" << (recycled ? "ok" : "FAILED") << ")" << std::endl;
+
+	// And once their time is up they're all gone
+	for (int s = 0; s < 200; s++)
+	{
+		pool.Update(deltaTime, &jobs);
+	}
+	bool expired = pool.GetLivingCount() == 0;
+	std::cout << "  Expired (" << (expired ? "ok" : "FAILED") << ")" << std::endl;
+	return closed && whole && roundTrip && placed && carried && grouped && reused && aboveFloor && recycled && expired;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// --------------------------------------------------------
+// Console benchmarks for the CPU-side engine systems
+//
+// Always compiled, but only run from Game::Init when the
+// build defines RUN_BENCHMARKS. Results go to stdout, which
+// is the debug console window in debug builds.
+// --------------------------------------------------------
+class Benchmarks
+{
+public:
+	static bool RunAll(); // Runs every benchmark and prints which checks failed, true if none did
+
+	static bool ObjImport(); // MB/s and triangles/s of ObjLoader against the legacy parser, and checks they build the same mesh
+	static bool Tangents(); // Batched tangent generation against the legacy loop, and checks they match bit for bit
+	static bool VertexPacking(); // Checks PackedVertex round trips stay inside the documented error bounds
+	static bool MeshletCulling(); // Triangles rejected per camera view, and checks nothing visible was culled
+	static bool GeometryAllocator(); // Random allocate/free/defragment on OffsetAllocator, checking no two blocks ever overlap
+	static bool Transforms(); // Batched TransformStore update of 100k objects against the per-object path, and checks they match
+	static bool Hierarchy(); // Checks moving a parent rebuilds exactly it and its descendants, with the right world matrices
+	static bool Entities(); // EntityWorld query over active bullets against dynamic_cast on scattered scripts, and checks they agree
+	static bool JobScaling(); // Transform rebuilds and the movement query at every thread count, and checks they match one thread
+	static bool FrameHandoff(); // TripleBuffer between two threads, checking the reader only ever sees whole frames, newest first
+	static bool Interpolation(); // Checks previous world matrices follow every move and interpolating between them lands on both ends
+	static bool SphereCulling(); // 1M bounding spheres through the batched frustum test against one at a time, and checks they agree
+	static bool SceneBvh(); // Proxies moving through the dynamic tree, checking box, frustum and ray queries against brute force
+	static bool Occlusion(); // Checks rasterized occluders against golden depth buffers, then boxes tested per second
+	static bool Broadphase(); // Bullet and target pairs from the hash grid at growing counts, checked against brute force
+	static bool Narrowphase(); // Batched sphere tests against the Collider's per pair path, and checks they find the same hits
+	static bool SweptCollision(); // Checks times of impact against small sub steps, and how many hits coarse steps lose without them
+	static bool MeshRays(); // Checks closest hits against every triangle, then rays per second on one thread and on all of them
+	static bool Physics(); // Checks bodies come to rest and sleep where they should, then step times awake and settled at growing counts
+	static bool Shatter(); // Checks a pattern's shards are closed and fill the mesh, then times hundreds of glass targets breaking at once into one pool
+};
+
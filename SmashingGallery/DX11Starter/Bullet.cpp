@@ -1,10 +1,10 @@
 #include "Bullet.h"
+#include "GameObject.h"
 
 
 
 Bullet::Bullet()
 {
-	isActive = false;
 }
 
 
@@ -15,6 +15,21 @@ Bullet::~Bullet()
 void Bullet::Start(GameObject* parent)
 {
 	gameObject = parent;
+	BulletComponent bullet = { 0 };
+	GameObject::GetEntityWorld().Add(parent->GetEntity(), bullet);
+	ColliderComponent collider = { -1, LAYER_BULLET, LAYER_TARGET };
+	GameObject::GetEntityWorld().Add(parent->GetEntity(), collider);
+	parent->SetActive(false); // Waits in the magazine until fired
+}
+
+bool Bullet::IsActive()
+{
+	return gameObject->IsActive();
+}
+
+void Bullet::SetActive(bool active)
+{
+	gameObject->SetActive(active);
 }
 
 void Bullet::Update()
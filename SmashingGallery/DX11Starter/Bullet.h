@@ -8,7 +8,9 @@ public:
 	~Bullet();
 
 	GameObject* gameObject;
-	bool isActive;
+
+	bool IsActive(); // Whether the GameObject's entity has the ActiveTag
+	void SetActive(bool active);
 
 	void Start(GameObject* parent) override; // Called to do initialization
 	void Update() override; // Called by the parent GameObject each frame
@@ -36,6 +36,24 @@ XMFLOAT4 Camera::GetRotationQuaternion()
 	return rotationQuaternion;
 }
 
+float Camera::GetPixelsPerUnit(XMFLOAT3 point)
+{
+	float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&point) - XMLoadFloat3(&position)));
+	return projectionScale / max(distance, 0.1f); // Clamped to the near plane
+}
+
+XMFLOAT4X4 Camera::GetViewProjectionMatrix()
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixTranspose(XMLoadFloat4x4(&viewMatrix)) * XMMatrixTranspose(XMLoadFloat4x4(&projectionMatrix))); // Both stored transposed for the shader
+	return viewProjection;
+}
+
+Frustum Camera::GetFrustum()
+{
+	return Frustum(GetViewProjectionMatrix());
+}
+
 /*Transforms*/
 int Camera::Translate(float xOffset, float yOffset, float zOffset) // Translate by an amount
 {
@@ -94,6 +112,7 @@ int Camera::MouseRotate(int mouseXOffset, int mouseYOffset) // Rotate using mous
 int Camera::UpdateProjectionMatrix(unsigned int width, unsigned int height)
 {
 	XMStoreFloat4x4(&projectionMatrix, XMMatrixTranspose(XMMatrixPerspectiveFovLH(0.25f*3.1415926535f, (float)width/height,	0.1f, 100.0f))); // Update with new w/h
+	projectionScale = height / (2.0f * tanf(0.125f*3.1415926535f)); // Half the vertical FOV
 	return 1;
 }
 
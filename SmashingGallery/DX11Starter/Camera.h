@@ -4,6 +4,7 @@
 #include <string>
 #include <DirectXMath.h>
 #include "Vertex.h"
+#include "Frustum.h"
 using namespace DirectX;
 
 class Camera
@@ -19,6 +20,9 @@ public:
 	XMFLOAT3 GetPosition();
 	XMFLOAT3 GetDirection();
 	XMFLOAT4 GetRotationQuaternion();
+	float GetPixelsPerUnit(XMFLOAT3 point); // Screen pixels one world unit covers at this point, for picking LODs
+	XMFLOAT4X4 GetViewProjectionMatrix(); // Row vector view * projection, not transposed like the two above
+	Frustum GetFrustum(); // World space planes of the current view and projection
 
 	/*Transforms*/
 	int Translate(float xOffset, float yOffset, float zOffset); // Translate by an amount
@@ -41,6 +45,7 @@ private:
 	XMFLOAT3 direction; // Normalized forward vector representing view direction
 	XMFLOAT4 rotationQuaternion; // Rotation around each axis in degrees, Z axis will always be 0 for first person
 	XMFLOAT3 up; // The camera's up vector
+	float projectionScale; // Pixels one world unit covers at a distance of one
 	bool changed; // Whether a transform parameter has been modified this frame
 };
 
@@ -1,5 +1,6 @@
 #include "Collider.h"
 #include "GameObject.h"
+#include "SphereNarrowphase.h"
 
 
 Collider::Collider()
@@ -8,16 +9,9 @@ Collider::Collider()
 
 bool Collider::collidesWith(GameObject &object, GameObject &other)
 {
-	XMVECTOR objPos = XMLoadFloat3(&object.GetPosition());
-	XMVECTOR othPos = XMLoadFloat3(&other.GetPosition());
-
-	XMVECTOR dist = XMVectorSubtract(objPos, othPos); // Distance between centers
-
-	if (XMVectorGetX(XMVector3Dot(dist, dist)) > ((object.GetScale().x + other.GetScale().x)*(object.GetScale().x + other.GetScale().x)))
-	{
-		return false; // If the distance between sphere centers is not less than the radiuses, they are not colliding
-	}
-	return true; // Otherwise, they're colliding
+	MeshBounds objBounds = object.GetWorldBounds(); // Spheres around the actual geometry
+	MeshBounds othBounds = other.GetWorldBounds();
+	return SphereNarrowphase::Overlaps(objBounds.sphereCenter, objBounds.sphereRadius, othBounds.sphereCenter, othBounds.sphereRadius); // The same test as the batched paths, so one object agrees with many
 }
 
 bool Collider::checkBounds(GameObject &object) // Returns true if out of bounds
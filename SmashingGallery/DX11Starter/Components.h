@@ -0,0 +1,74 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+class GameObject;
+
+// --------------------------------------------------------
+// Component types stored in the EntityWorld
+//
+// All plain data, since the world moves them between
+// archetypes with memcpy. Empty structs are tags, only
+// whether an entity has one matters.
+// --------------------------------------------------------
+
+// Handle into GameObject::GetTransformStore()
+struct TransformComponent
+{
+	int handle;
+};
+
+// World units per second
+struct VelocityComponent
+{
+	DirectX::XMFLOAT3 value;
+};
+
+// Back to the GameObject facade, for drawing and colliders
+struct ObjectComponent
+{
+	GameObject* object;
+};
+
+// Added by the Bullet script
+struct BulletComponent
+{
+	int slot; // Index into Game's bullets array
+};
+
+// Added by the target script
+struct TargetComponent
+{
+	float phase; // Offset into the side to side motion
+	int proxy; // In Game's scene tree, -1 while it isn't in it
+};
+
+// In Game's broadphase grid, which only pairs it with colliders whose layers are in its mask and whose mask has its layers
+struct ColliderComponent
+{
+	int proxy; // -1 while it isn't in the grid
+	unsigned int layers; // CollisionLayer bits
+	unsigned int mask;
+};
+
+// A knocked down target's body in Game's PhysicsWorld, which moves its transform from then on
+struct RigidBodyComponent
+{
+	int body;
+};
+
+// Breaks into pieces instead of just disappearing when hit
+struct ShatterComponent
+{
+	int pattern; // In Game's ShardPool and ShardRenderer
+};
+
+// Bits for ColliderComponent's layers and mask
+enum CollisionLayer
+{
+	LAYER_BULLET = 1,
+	LAYER_TARGET = 2
+};
+
+struct ActiveTag {}; // Updated, collided with and drawn
+struct GlassTag {}; // Drawn with the glass shaders
@@ -2,6 +2,7 @@
 
 #include <WindowsX.h>
 #include <sstream>
+#include <thread>
 
 // Define the static instance variable so our OS-level 
 // message handling function below can talk to our object
@@ -46,8 +47,13 @@ DXCore::DXCore(
 	this->width = windowWidth;
 	this->height = windowHeight;
 	this->titleBarStats = debugTitleBarStats;
+	this->pipelined = false;
+	this->fixedTimeStep = 1.0f / 60.0f;
+	this->maxStepsPerFrame = 5;
 
 	// Initialize fields
+	simulationTime = 0.0;
+	stopSimulation = false;
 	fpsFrameCount = 0;
 	fpsTimeElapsed = 0.0f;
 	
@@ -353,6 +359,13 @@ HRESULT DXCore::Run()
 	// Give subclass a chance to initialize
 	Init();
 
+	// Simulation of the next frame overlaps submitting this one
+	std::thread simulation;
+	if (pipelined)
+	{
+		simulation = std::thread(&DXCore::SimulationLoop, this);
+	}
+
 	// Our overall game and message loop
 	MSG msg = {};
 	while (msg.message != WM_QUIT)
@@ -373,11 +386,19 @@ HRESULT DXCore::Run()
 				UpdateTitleBarStats();
 
 			// The game loop
-			Update(deltaTime, totalTime);
+			if (!pipelined)
+				StepSimulation((currentTime - startTime) * perfCounterSeconds);
 			Draw(deltaTime, totalTime);
 		}
 	}
 
+	// Before anything Update uses gets destroyed
+	if (pipelined)
+	{
+		stopSimulation = true;
+		simulation.join();
+	}
+
 	// We'll end up here once we get a WM_QUIT message,
 	// which usually comes from the user closing the window
 	return (HRESULT)msg.wParam;
@@ -418,6 +439,50 @@ void DXCore::UpdateTimer()
 }
 
 
+// --------------------------------------------------------
+// Calls Update once per fixed step that's come due, so the
+// simulation runs at the same rate whatever the frame rate
+// --------------------------------------------------------
+int DXCore::StepSimulation(double now)
+{
+	int steps = 0;
+	while (now - simulationTime >= fixedTimeStep)
+	{
+		if (steps == maxStepsPerFrame)
+		{
+			simulationTime = now; // Too far behind, drop the rest instead of spiralling
+			break;
+		}
+		simulationTime += fixedTimeStep;
+		Update(fixedTimeStep, (float)simulationTime);
+		steps++;
+	}
+	return steps;
+}
+
+// --------------------------------------------------------
+// Steps the simulation on its own thread, sleeping between
+// steps instead of spinning on tiny ones
+// --------------------------------------------------------
+void DXCore::SimulationLoop()
+{
+	while (!stopSimulation)
+	{
+		__int64 now;
+		QueryPerformanceCounter((LARGE_INTEGER*)&now);
+		double seconds = (now - startTime) * perfCounterSeconds;
+		if (StepSimulation(seconds) == 0)
+		{
+			// Sleeps can overshoot by a millisecond or more, so yield for the last bit
+			if (simulationTime + fixedTimeStep - seconds > 0.002)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			else
+				std::this_thread::yield();
+		}
+	}
+}
+
+
 // --------------------------------------------------------
 // Updates the window's title bar with several stats once
 // per second, including:
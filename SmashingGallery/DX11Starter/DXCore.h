@@ -3,6 +3,7 @@
 #include <Windows.h>
 #include <d3d11.h>
 #include <string>
+#include <atomic>
 
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
@@ -40,8 +41,8 @@ public:
 	
 	// Pure virtual methods for setup and game functionality
 	virtual void Init()										= 0;
-	virtual void Update(float deltaTime, float totalTime)	= 0;
-	virtual void Draw(float deltaTime, float totalTime)		= 0;
+	virtual void Update(float deltaTime, float totalTime)	= 0;	// Always fixedTimeStep, and the simulated time at the end of the step
+	virtual void Draw(float deltaTime, float totalTime)		= 0;	// Real time, usually a little past the last step
 
 	// Convenience methods for handling mouse input, since we
 	// can easily grab mouse input from OS-level messages
@@ -55,6 +56,18 @@ protected:
 	HWND		hWnd;			// The handle to the window itself
 	std::string titleBarText;	// Custom text in window's title bar
 	bool		titleBarStats;	// Show extra stats in title bar?
+
+	// Update runs on its own thread while Draw runs on this one.
+	// They must only share state through a lock-free handoff,
+	// and Update mustn't touch the device context.
+	bool		pipelined;
+
+	// Update runs in steps of exactly this many seconds, as many
+	// as have come due since the last frame. If more than
+	// maxStepsPerFrame are due it gives up on catching up, so a
+	// slow frame can't make the next one slower still.
+	float		fixedTimeStep;
+	int			maxStepsPerFrame;
 	
 	// Size of the window's client area
 	unsigned int width;
@@ -85,7 +98,13 @@ private:
 	int fpsFrameCount;
 	float fpsTimeElapsed;
 	
+	// Simulation timing
+	double simulationTime; // Seconds since start the last step ended at
+	std::atomic<bool> stopSimulation;
+
 	void UpdateTimer();			// Updates the timer for this frame
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
+	int StepSimulation(double now);	// Runs every step due by now, returns how many
+	void SimulationLoop();		// Steps on its own thread until stopSimulation
 };
 
@@ -0,0 +1,493 @@
+#include "DynamicBVH.h"
+#include <cmath>
+#include <cstring>
+#include "SimdLanes.h"
+using namespace DirectX;
+using namespace SimdLanes;
+
+namespace
+{
+	// Scalar versions with the same unordered behaviour, so single rays and packets agree exactly
+	inline float MinOf(float a, float b) { return a < b ? a : b; }
+	inline float MaxOf(float a, float b) { return a > b ? a : b; }
+}
+
+bool Aabb::Contains(const Aabb& other) const
+{
+	return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+		other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+}
+
+bool Aabb::Overlaps(const Aabb& other) const
+{
+	return min.x <= other.max.x && other.min.x <= max.x &&
+		min.y <= other.max.y && other.min.y <= max.y &&
+		min.z <= other.max.z && other.min.z <= max.z;
+}
+
+float Aabb::GetSurfaceArea() const
+{
+	float x = max.x - min.x;
+	float y = max.y - min.y;
+	float z = max.z - min.z;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+Aabb Aabb::Union(const Aabb& a, const Aabb& b)
+{
+	Aabb box;
+	box.min = XMFLOAT3(MinOf(a.min.x, b.min.x), MinOf(a.min.y, b.min.y), MinOf(a.min.z, b.min.z));
+	box.max = XMFLOAT3(MaxOf(a.max.x, b.max.x), MaxOf(a.max.y, b.max.y), MaxOf(a.max.z, b.max.z));
+	return box;
+}
+
+Aabb Aabb::FromSphere(const XMFLOAT3& center, float radius)
+{
+	Aabb box;
+	box.min = XMFLOAT3(center.x - radius, center.y - radius, center.z - radius);
+	box.max = XMFLOAT3(center.x + radius, center.y + radius, center.z + radius);
+	return box;
+}
+
+RayPacket::RayPacket()
+{
+	memset(this, 0, sizeof(RayPacket));
+	for (int r = 0; r < MaxRays; r++)
+	{
+		maxDistance[r] = -1.0f;
+	}
+}
+
+bool RayPacket::Add(const XMFLOAT3& origin, const XMFLOAT3& rayDirection, float rayMaxDistance)
+{
+	if (count == MaxRays)
+	{
+		return false;
+	}
+	originX[count] = origin.x;
+	originY[count] = origin.y;
+	originZ[count] = origin.z;
+	inverseX[count] = rayDirection.x != 0.0f ? 1.0f / rayDirection.x : 1e30f;
+	inverseY[count] = rayDirection.y != 0.0f ? 1.0f / rayDirection.y : 1e30f;
+	inverseZ[count] = rayDirection.z != 0.0f ? 1.0f / rayDirection.z : 1e30f;
+	direction[count] = rayDirection;
+	maxDistance[count] = rayMaxDistance;
+	count++;
+	return true;
+}
+
+XMFLOAT3 RayPacket::GetOrigin(int ray) const
+{
+	return XMFLOAT3(originX[ray], originY[ray], originZ[ray]);
+}
+
+DynamicBVH::DynamicBVH(float margin, float predictionTime)
+{
+	root = Null;
+	freeList = Null;
+	proxyCount = 0;
+	this->margin = margin;
+	this->predictionTime = predictionTime;
+}
+
+DynamicBVH::~DynamicBVH()
+{
+}
+
+int DynamicBVH::CreateProxy(const Aabb& box, int userData)
+{
+	int proxy = AllocateNode();
+	Node& node = nodes[proxy];
+	node.box.min = XMFLOAT3(box.min.x - margin, box.min.y - margin, box.min.z - margin);
+	node.box.max = XMFLOAT3(box.max.x + margin, box.max.y + margin, box.max.z + margin);
+	node.userData = userData;
+	InsertLeaf(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void DynamicBVH::DestroyProxy(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	proxyCount--;
+}
+
+bool DynamicBVH::MoveProxy(int proxy, const Aabb& box, const XMFLOAT3& displacement)
+{
+	// The box it would get if it went back in now: the margin, plus room to keep moving the same way
+	Aabb fat;
+	fat.min = XMFLOAT3(box.min.x - margin, box.min.y - margin, box.min.z - margin);
+	fat.max = XMFLOAT3(box.max.x + margin, box.max.y + margin, box.max.z + margin);
+	float ahead[3] = { displacement.x * predictionTime, displacement.y * predictionTime, displacement.z * predictionTime };
+	float* fatMin = &fat.min.x;
+	float* fatMax = &fat.max.x;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (ahead[axis] < 0.0f)
+		{
+			fatMin[axis] += ahead[axis];
+		}
+		else
+		{
+			fatMax[axis] += ahead[axis];
+		}
+	}
+
+	const Aabb& current = nodes[proxy].box;
+	if (current.Contains(box))
+	{
+		// Still inside, which is fine unless a fast move left it far bigger than it needs to be now
+		Aabb huge;
+		float slack = 4.0f * margin;
+		huge.min = XMFLOAT3(fat.min.x - slack, fat.min.y - slack, fat.min.z - slack);
+		huge.max = XMFLOAT3(fat.max.x + slack, fat.max.y + slack, fat.max.z + slack);
+		if (huge.Contains(current))
+		{
+			return false;
+		}
+	}
+
+	RemoveLeaf(proxy);
+	nodes[proxy].box = fat;
+	InsertLeaf(proxy);
+	return true;
+}
+
+int DynamicBVH::GetUserData(int proxy) const
+{
+	return nodes[proxy].userData;
+}
+
+const Aabb& DynamicBVH::GetFatBox(int proxy) const
+{
+	return nodes[proxy].box;
+}
+
+int DynamicBVH::GetProxyCount() const
+{
+	return proxyCount;
+}
+
+int DynamicBVH::GetHeight() const
+{
+	return root == Null ? 0 : nodes[root].height;
+}
+
+bool DynamicBVH::Validate() const
+{
+	int freeCount = 0;
+	for (int node = freeList; node != Null; node = nodes[node].parent)
+	{
+		if (nodes[node].height != -1 || ++freeCount > (int)nodes.size())
+		{
+			return false;
+		}
+	}
+	if (root == Null)
+	{
+		return proxyCount == 0 && freeCount == (int)nodes.size();
+	}
+
+	int leaves = 0;
+	bool ok = nodes[root].parent == Null;
+	int height = ValidateNode(root, leaves, ok);
+	int internalNodes = leaves - 1; // Every internal node has exactly two children
+	return ok && height == nodes[root].height && leaves == proxyCount && leaves + internalNodes + freeCount == (int)nodes.size();
+}
+
+float DynamicBVH::IntersectRaySphere(const XMFLOAT3& origin, const XMFLOAT3& direction, const XMFLOAT3& center, float radius)
+{
+	// |origin + t * direction - center| = radius, solved for the smaller t
+	float mx = origin.x - center.x, my = origin.y - center.y, mz = origin.z - center.z;
+	float a = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
+	float b = mx * direction.x + my * direction.y + mz * direction.z;
+	float c = mx * mx + my * my + mz * mz - radius * radius;
+	if (c <= 0.0f)
+	{
+		return 0.0f; // Starts inside
+	}
+	if (b > 0.0f || a == 0.0f)
+	{
+		return -1.0f; // Outside and pointing away
+	}
+	float discriminant = b * b - a * c;
+	if (discriminant < 0.0f)
+	{
+		return -1.0f;
+	}
+	return (-b - sqrtf(discriminant)) / a;
+}
+
+int DynamicBVH::AllocateNode()
+{
+	int index;
+	if (freeList == Null)
+	{
+		index = (int)nodes.size();
+		nodes.push_back(Node());
+	}
+	else
+	{
+		index = freeList;
+		freeList = nodes[index].parent;
+	}
+	Node& node = nodes[index];
+	node.parent = Null;
+	node.child1 = Null;
+	node.child2 = Null;
+	node.height = 0;
+	node.userData = -1;
+	return index;
+}
+
+void DynamicBVH::FreeNode(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+void DynamicBVH::InsertLeaf(int leaf)
+{
+	if (root == Null)
+	{
+		root = leaf;
+		nodes[leaf].parent = Null;
+		return;
+	}
+
+	// Walk down to the best sibling. Pairing with a node costs a new parent the size of both,
+	// and every node above it grows too, so stop once going further down can't be cheaper.
+	Aabb leafBox = nodes[leaf].box;
+	int index = root;
+	while (nodes[index].child1 != Null)
+	{
+		const Node& node = nodes[index];
+		float area = node.box.GetSurfaceArea();
+		float combinedArea = Aabb::Union(node.box, leafBox).GetSurfaceArea();
+		float cost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - area); // Paid by this node whichever child the leaf ends up under
+
+		float childCosts[2];
+		int children[2] = { node.child1, node.child2 };
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& child = nodes[children[i]];
+			float grownArea = Aabb::Union(child.box, leafBox).GetSurfaceArea();
+			childCosts[i] = (child.child1 == Null ? grownArea : grownArea - child.box.GetSurfaceArea()) + inheritedCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+		{
+			break;
+		}
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode(); // Can move nodes, so everything below goes by index
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = Aabb::Union(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent == Null)
+	{
+		root = newParent;
+	}
+	else if (nodes[oldParent].child1 == sibling)
+	{
+		nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		nodes[oldParent].child2 = newParent;
+	}
+
+	Refit(oldParent);
+}
+
+void DynamicBVH::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = Null;
+		return;
+	}
+
+	// The leaf's parent goes too, and its sibling takes the parent's place
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	nodes[sibling].parent = grandParent;
+	if (grandParent == Null)
+	{
+		root = sibling;
+	}
+	else if (nodes[grandParent].child1 == parent)
+	{
+		nodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		nodes[grandParent].child2 = sibling;
+	}
+	FreeNode(parent);
+	nodes[leaf].parent = Null;
+
+	Refit(grandParent);
+}
+
+void DynamicBVH::Refit(int node)
+{
+	while (node != Null)
+	{
+		node = Balance(node);
+		Node& refit = nodes[node];
+		const Node& child1 = nodes[refit.child1];
+		const Node& child2 = nodes[refit.child2];
+		refit.height = 1 + (child1.height > child2.height ? child1.height : child2.height);
+		refit.box = Aabb::Union(child1.box, child2.box);
+		node = refit.parent;
+	}
+}
+
+int DynamicBVH::Balance(int a)
+{
+	if (nodes[a].child1 == Null || nodes[a].height < 2)
+	{
+		return a;
+	}
+	int b = nodes[a].child1;
+	int c = nodes[a].child2;
+	int balance = nodes[c].height - nodes[b].height;
+	if (balance >= -1 && balance <= 1)
+	{
+		return a;
+	}
+
+	// The taller child takes a's place, with a and its own taller child under it.
+	// a keeps its shorter child and takes the other grandchild in place of the taller one.
+	int up = balance > 1 ? c : b;
+	int stay = up == c ? b : c;
+	int keep = nodes[nodes[up].child1].height > nodes[nodes[up].child2].height ? nodes[up].child1 : nodes[up].child2;
+	int moved = keep == nodes[up].child1 ? nodes[up].child2 : nodes[up].child1;
+
+	int parent = nodes[a].parent;
+	nodes[up].parent = parent;
+	if (parent == Null)
+	{
+		root = up;
+	}
+	else if (nodes[parent].child1 == a)
+	{
+		nodes[parent].child1 = up;
+	}
+	else
+	{
+		nodes[parent].child2 = up;
+	}
+	nodes[up].child1 = a;
+	nodes[up].child2 = keep;
+	nodes[a].parent = up;
+	if (up == c)
+	{
+		nodes[a].child2 = moved;
+	}
+	else
+	{
+		nodes[a].child1 = moved;
+	}
+	nodes[moved].parent = a;
+
+	nodes[a].box = Aabb::Union(nodes[stay].box, nodes[moved].box);
+	nodes[a].height = 1 + (nodes[stay].height > nodes[moved].height ? nodes[stay].height : nodes[moved].height);
+	nodes[up].box = Aabb::Union(nodes[a].box, nodes[keep].box);
+	nodes[up].height = 1 + (nodes[a].height > nodes[keep].height ? nodes[a].height : nodes[keep].height);
+	return up;
+}
+
+int DynamicBVH::ValidateNode(int node, int& leaves, bool& ok) const
+{
+	const Node& n = nodes[node];
+	if (n.child1 == Null)
+	{
+		ok = ok && n.child2 == Null && n.height == 0;
+		leaves++;
+		return 0;
+	}
+	const Node& child1 = nodes[n.child1];
+	const Node& child2 = nodes[n.child2];
+	ok = ok && child1.parent == node && child2.parent == node;
+	int height1 = ValidateNode(n.child1, leaves, ok);
+	int height2 = ValidateNode(n.child2, leaves, ok);
+	int height = 1 + (height1 > height2 ? height1 : height2);
+
+	Aabb united = Aabb::Union(child1.box, child2.box);
+	ok = ok && n.height == height && memcmp(&united, &n.box, sizeof(Aabb)) == 0;
+	return height;
+}
+
+float DynamicBVH::RayEntry(const Aabb& box, const XMFLOAT3& origin, const XMFLOAT3& inverse, float maxDistance) const
+{
+	// Slabs, in the same order as PacketMask
+	float t1 = (box.min.x - origin.x) * inverse.x;
+	float t2 = (box.max.x - origin.x) * inverse.x;
+	float entry = MinOf(t1, t2);
+	float exit = MaxOf(t1, t2);
+	t1 = (box.min.y - origin.y) * inverse.y;
+	t2 = (box.max.y - origin.y) * inverse.y;
+	entry = MaxOf(entry, MinOf(t1, t2));
+	exit = MinOf(exit, MaxOf(t1, t2));
+	t1 = (box.min.z - origin.z) * inverse.z;
+	t2 = (box.max.z - origin.z) * inverse.z;
+	entry = MaxOf(entry, MinOf(t1, t2));
+	exit = MinOf(exit, MaxOf(t1, t2));
+	entry = MaxOf(entry, 0.0f);
+	exit = MinOf(exit, maxDistance);
+	return entry <= exit ? entry : -1.0f;
+}
+
+int DynamicBVH::PacketMask(const Aabb& box, const RayPacket& rays, const float* maxDistance) const
+{
+	Lanes minX = Splat(box.min.x), minY = Splat(box.min.y), minZ = Splat(box.min.z);
+	Lanes maxX = Splat(box.max.x), maxY = Splat(box.max.y), maxZ = Splat(box.max.z);
+	int mask = 0;
+	for (int first = 0; first < rays.count; first += LaneCount)
+	{
+		Lanes inverse = Load(rays.inverseX + first);
+		Lanes origin = Load(rays.originX + first);
+		Lanes t1 = Mul(Sub(minX, origin), inverse);
+		Lanes t2 = Mul(Sub(maxX, origin), inverse);
+		Lanes entry = Min(t1, t2);
+		Lanes exit = Max(t1, t2);
+		inverse = Load(rays.inverseY + first);
+		origin = Load(rays.originY + first);
+		t1 = Mul(Sub(minY, origin), inverse);
+		t2 = Mul(Sub(maxY, origin), inverse);
+		entry = Max(entry, Min(t1, t2));
+		exit = Min(exit, Max(t1, t2));
+		inverse = Load(rays.inverseZ + first);
+		origin = Load(rays.originZ + first);
+		t1 = Mul(Sub(minZ, origin), inverse);
+		t2 = Mul(Sub(maxZ, origin), inverse);
+		entry = Max(entry, Min(t1, t2));
+		exit = Min(exit, Max(t1, t2));
+		entry = Max(entry, Splat(0.0f));
+		exit = Min(exit, Load(maxDistance + first));
+		mask |= Mask(LessEqual(entry, exit)) << first; // Slots past count have a negative maxDistance, so never set
+	}
+	return mask;
+}
+
+XMFLOAT3 DynamicBVH::Inverse(const XMFLOAT3& direction)
+{
+	// Same as RayPacket::Add, a huge number keeps a zero component from making 0 * infinity
+	return XMFLOAT3(direction.x != 0.0f ? 1.0f / direction.x : 1e30f,
+		direction.y != 0.0f ? 1.0f / direction.y : 1e30f,
+		direction.z != 0.0f ? 1.0f / direction.z : 1e30f);
+}
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Frustum.h"
+
+// World space axis aligned box
+struct Aabb
+{
+	DirectX::XMFLOAT3 min;
+	DirectX::XMFLOAT3 max;
+
+	bool Contains(const Aabb& other) const;
+	bool Overlaps(const Aabb& other) const;
+	float GetSurfaceArea() const;
+	static Aabb Union(const Aabb& a, const Aabb& b);
+	static Aabb FromSphere(const DirectX::XMFLOAT3& center, float radius);
+};
+
+// Closest thing a ray ran into
+struct RayHit
+{
+	int proxy; // -1 when nothing was hit
+	float distance; // Along the ray, in lengths of its direction
+};
+
+// Up to MaxRays rays traced through the tree together, one
+// array per component so the box tests run across the rays
+struct RayPacket
+{
+	static const int MaxRays = 8;
+
+	float originX[MaxRays], originY[MaxRays], originZ[MaxRays];
+	float inverseX[MaxRays], inverseY[MaxRays], inverseZ[MaxRays]; // 1 / direction, huge rather than infinite for a zero
+	DirectX::XMFLOAT3 direction[MaxRays];
+	float maxDistance[MaxRays]; // -1 for the unused slots, so they never hit
+	int count;
+
+	RayPacket();
+	bool Add(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& rayDirection, float rayMaxDistance); // False when it's full
+	DirectX::XMFLOAT3 GetOrigin(int ray) const;
+};
+
+// --------------------------------------------------------
+// Bounding volume hierarchy of moving boxes
+//
+// Every proxy is a leaf holding a fat box: the real box plus
+// a margin, stretched ahead along the way it's moving. While
+// the real box stays inside, MoveProxy does nothing at all, so
+// slow or small movements cost nothing. When it escapes, the
+// leaf comes out and goes back in next to the sibling that
+// grows the tree's surface area the least. Either way, the
+// boxes and heights of the nodes above are refit on the way
+// back to the root, and any node whose children differ in
+// height by more than one is rotated, so the tree stays
+// balanced however the proxies move.
+//
+// Queries take a callback per leaf. QueryBox and QueryFrustum
+// callbacks return false to stop early. Ray casts call
+// test(proxy, maxDistance), which returns the distance along
+// the ray where the proxy's real shape is hit, or a negative
+// number for a miss; fat boxes only decide which proxies are
+// worth testing. RayCastClosest tries the nearer child first
+// and skips anything beyond the best hit so far. RayCastPacket traces a packet of rays at once, for
+// spread or burst weapons, testing each node against every
+// ray in SIMD.
+//
+// Proxy ids are node indices and stay put until destroyed.
+// Nothing here is safe against writes from another thread.
+// --------------------------------------------------------
+class DynamicBVH
+{
+public:
+	DynamicBVH(float margin = 0.1f, float predictionTime = 2.0f); // predictionTime is in lengths of the displacement passed to MoveProxy
+	~DynamicBVH();
+
+	int CreateProxy(const Aabb& box, int userData);
+	void DestroyProxy(int proxy);
+	bool MoveProxy(int proxy, const Aabb& box, const DirectX::XMFLOAT3& displacement); // True if the leaf had to be reinserted
+
+	int GetUserData(int proxy) const;
+	const Aabb& GetFatBox(int proxy) const;
+	int GetProxyCount() const;
+	int GetHeight() const; // 0 for a single leaf or an empty tree
+	bool Validate() const; // Checks every link, height, box and count
+
+	template<typename F> void QueryBox(const Aabb& box, F f) const; // f(proxy) for every fat box overlapping it
+	template<typename F> void QueryFrustum(const Frustum& frustum, F f) const; // f(proxy) for every fat box not fully outside it
+	template<typename F> bool RayCastClosest(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, F test, RayHit& hit) const;
+	template<typename F> bool RayCastAny(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, F test) const; // Stops at the first hit, for line of sight
+	template<typename F> int RayCastPacket(const RayPacket& rays, F test, RayHit* hits) const; // test(proxy, ray, maxDistance), hits gets one per ray, returns how many hit
+
+	static float IntersectRaySphere(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, const DirectX::XMFLOAT3& center, float radius); // Distance to the sphere, 0 from inside, -1 for a miss
+
+private:
+	static const int Null = -1;
+	static const int StackSize = 256; // Traversals push at most one node per level, and balancing keeps levels near log2 of the leaves
+
+	struct Node
+	{
+		Aabb box; // Fat for leaves, exactly both children's otherwise
+		int parent; // Next free node while on the free list
+		int child1; // Null for leaves
+		int child2;
+		int height; // 0 for leaves, -1 while free
+		int userData;
+	};
+
+	std::vector<Node> nodes;
+	int root;
+	int freeList;
+	int proxyCount;
+	float margin;
+	float predictionTime;
+
+	int AllocateNode();
+	void FreeNode(int node);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	void Refit(int node); // Balances and refits every node from here to the root
+	int Balance(int node); // One rotation if its children are off by two or more, returns whatever is in its place now
+	int ValidateNode(int node, int& leaves, bool& ok) const; // Height of the subtree
+
+	float RayEntry(const Aabb& box, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverse, float maxDistance) const; // Where the ray enters the box, or -1
+	int PacketMask(const Aabb& box, const RayPacket& rays, const float* maxDistance) const; // Bit per ray that enters the box before its maxDistance
+	static DirectX::XMFLOAT3 Inverse(const DirectX::XMFLOAT3& direction);
+};
+
+template<typename F>
+void DynamicBVH::QueryBox(const Aabb& box, F f) const
+{
+	if (root == Null)
+	{
+		return;
+	}
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = root;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		if (!node.box.Overlaps(box))
+		{
+			continue;
+		}
+		if (node.child1 == Null)
+		{
+			if (!f((int)(&node - &nodes[0])))
+			{
+				return;
+			}
+		}
+		else
+		{
+			stack[top++] = node.child1;
+			stack[top++] = node.child2;
+		}
+	}
+}
+
+template<typename F>
+void DynamicBVH::QueryFrustum(const Frustum& frustum, F f) const
+{
+	if (root == Null)
+	{
+		return;
+	}
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = root;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+		if (!frustum.IntersectsBox(node.box.min, node.box.max))
+		{
+			continue;
+		}
+		if (node.child1 == Null)
+		{
+			if (!f((int)(&node - &nodes[0])))
+			{
+				return;
+			}
+		}
+		else
+		{
+			stack[top++] = node.child1;
+			stack[top++] = node.child2;
+		}
+	}
+}
+
+template<typename F>
+bool DynamicBVH::RayCastClosest(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, F test, RayHit& hit) const
+{
+	hit.proxy = Null;
+	hit.distance = maxDistance;
+	if (root == Null)
+	{
+		return false;
+	}
+	DirectX::XMFLOAT3 inverse = Inverse(direction);
+	int stack[StackSize];
+	int top = 0;
+	if (RayEntry(nodes[root].box, origin, inverse, maxDistance) >= 0.0f)
+	{
+		stack[top++] = root;
+	}
+	while (top > 0)
+	{
+		int index = stack[--top];
+		const Node& node = nodes[index];
+		if (RayEntry(node.box, origin, inverse, hit.distance) < 0.0f)
+		{
+			continue; // Was in reach when pushed, but something closer has been hit since
+		}
+		if (node.child1 == Null)
+		{
+			float distance = test(index, hit.distance);
+			if (distance >= 0.0f && distance <= hit.distance)
+			{
+				hit.proxy = index;
+				hit.distance = distance;
+			}
+			continue;
+		}
+
+		// Push the farther child first, so the nearer one is tried first and can cut the other short
+		float entry1 = RayEntry(nodes[node.child1].box, origin, inverse, hit.distance);
+		float entry2 = RayEntry(nodes[node.child2].box, origin, inverse, hit.distance);
+		int nearChild = node.child1, farChild = node.child2;
+		float nearEntry = entry1, farEntry = entry2;
+		if (entry2 >= 0.0f && (entry1 < 0.0f || entry2 < entry1))
+		{
+			nearChild = node.child2;
+			farChild = node.child1;
+			nearEntry = entry2;
+			farEntry = entry1;
+		}
+		if (farEntry >= 0.0f)
+		{
+			stack[top++] = farChild;
+		}
+		if (nearEntry >= 0.0f)
+		{
+			stack[top++] = nearChild;
+		}
+	}
+	return hit.proxy != Null;
+}
+
+template<typename F>
+bool DynamicBVH::RayCastAny(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, F test) const
+{
+	if (root == Null)
+	{
+		return false;
+	}
+	DirectX::XMFLOAT3 inverse = Inverse(direction);
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = root;
+	while (top > 0)
+	{
+		int index = stack[--top];
+		const Node& node = nodes[index];
+		if (RayEntry(node.box, origin, inverse, maxDistance) < 0.0f)
+		{
+			continue;
+		}
+		if (node.child1 == Null)
+		{
+			float distance = test(index, maxDistance);
+			if (distance >= 0.0f && distance <= maxDistance)
+			{
+				return true;
+			}
+			continue;
+		}
+		stack[top++] = node.child1;
+		stack[top++] = node.child2;
+	}
+	return false;
+}
+
+template<typename F>
+int DynamicBVH::RayCastPacket(const RayPacket& rays, F test, RayHit* hits) const
+{
+	float best[RayPacket::MaxRays];
+	for (int r = 0; r < RayPacket::MaxRays; r++)
+	{
+		best[r] = rays.maxDistance[r]; // Shrinks as rays hit, which prunes the boxes behind
+		if (r < rays.count)
+		{
+			hits[r].proxy = Null;
+			hits[r].distance = rays.maxDistance[r];
+		}
+	}
+	if (root == Null || rays.count == 0)
+	{
+		return 0;
+	}
+
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = root;
+	while (top > 0)
+	{
+		int index = stack[--top];
+		const Node& node = nodes[index];
+		int mask = PacketMask(node.box, rays, best); // Rays that are done or already hit something nearer drop out
+		if (mask == 0)
+		{
+			continue;
+		}
+		if (node.child1 == Null)
+		{
+			for (int r = 0; r < rays.count; r++)
+			{
+				if ((mask >> r) & 1)
+				{
+					float distance = test(index, r, best[r]);
+					if (distance >= 0.0f && distance <= best[r])
+					{
+						hits[r].proxy = index;
+						hits[r].distance = distance;
+						best[r] = distance;
+					}
+				}
+			}
+			continue;
+		}
+		stack[top++] = node.child2;
+		stack[top++] = node.child1;
+	}
+
+	int hitCount = 0;
+	for (int r = 0; r < rays.count; r++)
+	{
+		hitCount += hits[r].proxy != Null ? 1 : 0;
+	}
+	return hitCount;
+}
@@ -1,4 +1,5 @@
 #include "Emitter.h"
+#include "GeometryPool.h"
 
 using namespace DirectX;
 
@@ -92,20 +93,24 @@ Emitter::~Emitter()
 	indexBuffer->Release();
 }
 
-void Emitter::Update(float dt)
+void Emitter::Update(float dt, JobSystem* jobs)
 {
-	if (firstAliveIndex < firstDeadIndex)
+	// The k-th living particle, counting from the oldest
+	auto updateRange = [this, dt](int first, int last)
 	{
-		for (int i = firstAliveIndex; i < firstDeadIndex; i++)
-			UpdateSingleParticle(dt, i);
-	}
+		for (int k = first; k < last; k++)
+			UpdateSingleParticle(dt, (firstAliveIndex + k) % maxParticles);
+	};
+	if (jobs != nullptr)
+		jobs->ParallelFor(livingParticleCount, 1024, updateRange);
 	else
-	{
-		for (int i = firstAliveIndex; i < maxParticles; i++)
-			UpdateSingleParticle(dt, i);
+		updateRange(0, livingParticleCount);
 
-		for (int i = 0; i < firstDeadIndex; i++)
-			UpdateSingleParticle(dt, i);
+	// Everything lives as long, so the ones that just died are all at the front
+	while (livingParticleCount > 0 && particles[firstAliveIndex].Age >= lifetime)
+	{
+		firstAliveIndex = (firstAliveIndex + 1) % maxParticles;
+		livingParticleCount--;
 	}
 
 	timeSinceEmit += dt;
@@ -124,12 +129,7 @@ void Emitter::UpdateSingleParticle(float dt, int index)
 
 	particles[index].Age += dt;
 	if (particles[index].Age >= lifetime)
-	{
-		firstAliveIndex = firstAliveIndex +1;
-		firstAliveIndex %= maxParticles;
-		livingParticleCount = livingParticleCount - 1;
-		return;
-	}
+		return; // Update retires it
 
 	float agePercent = particles[index].Age / lifetime;
 
@@ -173,57 +173,62 @@ void Emitter::SpawnParticle()
 	livingParticleCount = livingParticleCount +1;
 }
 
-void Emitter::CopyParticlesToGPU(ID3D11DeviceContext* context)
+void Emitter::CopyToSnapshot(ParticleSnapshot& snapshot)
 {
-	if (firstAliveIndex < firstDeadIndex)
+	if (snapshot.vertices.size() != (size_t)maxParticles * 4)
 	{
-		for (int i = firstAliveIndex; i < firstDeadIndex; i++)
-			CopyOneParticle(i);
-	}
-	else
-	{
-		for (int i = firstAliveIndex; i < maxParticles; i++)
-			CopyOneParticle(i);
-		for (int i = 0; i < firstDeadIndex; i++)
-			CopyOneParticle(i);
+		snapshot.vertices.assign(localParticleVertices, localParticleVertices + maxParticles * 4);
 	}
+	for (int k = 0; k < livingParticleCount; k++)
+		CopyOneParticle((firstAliveIndex + k) % maxParticles, &snapshot.vertices[0]);
+
+	snapshot.firstAliveIndex = firstAliveIndex;
+	snapshot.firstDeadIndex = firstDeadIndex;
+	snapshot.livingParticleCount = livingParticleCount;
+}
 
+void Emitter::CopyParticlesToGPU(ID3D11DeviceContext* context, const ParticleSnapshot& snapshot)
+{
 	D3D11_MAPPED_SUBRESOURCE mapped = {};
 	context->Map(vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
 
-	memcpy(mapped.pData, localParticleVertices, sizeof(ParticleVertex) * 4 * maxParticles);
+	memcpy(mapped.pData, &snapshot.vertices[0], sizeof(ParticleVertex) * 4 * maxParticles);
 
 	context->Unmap(vertexBuffer, 0);
 }
 
-void Emitter::CopyOneParticle(int index)
+void Emitter::CopyOneParticle(int index, ParticleVertex* vertices)
 {
 	int i = index * 4;
 
-	localParticleVertices[i + 0].Position = particles[index].Position;
-	localParticleVertices[i + 1].Position = particles[index].Position;
-	localParticleVertices[i + 2].Position = particles[index].Position;
-	localParticleVertices[i + 3].Position = particles[index].Position;
+	vertices[i + 0].Position = particles[index].Position;
+	vertices[i + 1].Position = particles[index].Position;
+	vertices[i + 2].Position = particles[index].Position;
+	vertices[i + 3].Position = particles[index].Position;
 
-	localParticleVertices[i + 0].Size = particles[index].Size;
-	localParticleVertices[i + 1].Size = particles[index].Size;
-	localParticleVertices[i + 2].Size = particles[index].Size;
-	localParticleVertices[i + 3].Size = particles[index].Size;
+	vertices[i + 0].Size = particles[index].Size;
+	vertices[i + 1].Size = particles[index].Size;
+	vertices[i + 2].Size = particles[index].Size;
+	vertices[i + 3].Size = particles[index].Size;
 
-	localParticleVertices[i + 0].Color = particles[index].Color;
-	localParticleVertices[i + 1].Color = particles[index].Color;
-	localParticleVertices[i + 2].Color = particles[index].Color;
-	localParticleVertices[i + 3].Color = particles[index].Color;
+	vertices[i + 0].Color = particles[index].Color;
+	vertices[i + 1].Color = particles[index].Color;
+	vertices[i + 2].Color = particles[index].Color;
+	vertices[i + 3].Color = particles[index].Color;
 }
 
-void Emitter::Draw(ID3D11DeviceContext* context, Camera* camera)
+void Emitter::Draw(ID3D11DeviceContext* context, Camera* camera, const ParticleSnapshot& snapshot)
 {
-	CopyParticlesToGPU(context);
+	if (snapshot.livingParticleCount == 0)
+		return; // The wrapped case below would draw every dead particle
+
+	CopyParticlesToGPU(context, snapshot);
 
 	UINT stride = sizeof(ParticleVertex);
 	UINT offset = 0;
 	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
 	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	GeometryPool::InvalidateBinding(); // The next mesh draw has to bind the pool again
 
 	vs->SetMatrix4x4("view", camera->GetViewMatrix());
 	vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());
@@ -234,14 +239,14 @@ void Emitter::Draw(ID3D11DeviceContext* context, Camera* camera)
 	ps->SetShader();
 	ps->CopyAllBufferData();
 
-	if (firstAliveIndex < firstDeadIndex)
+	if (snapshot.firstAliveIndex < snapshot.firstDeadIndex)
 	{
-		context->DrawIndexed(livingParticleCount * 6, firstAliveIndex * 6, 0);
+		context->DrawIndexed(snapshot.livingParticleCount * 6, snapshot.firstAliveIndex * 6, 0);
 	}
 	else
 	{
-		context->DrawIndexed(firstDeadIndex * 6, 0, 0);
-		context->DrawIndexed((maxParticles - firstAliveIndex) * 6, firstAliveIndex * 6, 0);
+		context->DrawIndexed(snapshot.firstDeadIndex * 6, 0, 0);
+		context->DrawIndexed((maxParticles - snapshot.firstAliveIndex) * 6, snapshot.firstAliveIndex * 6, 0);
 	}
 
 }
@@ -2,9 +2,11 @@
 
 #include <d3d11.h>
 #include <DirectXMath.h>
+#include <vector>
 
 #include "Camera.h"
 #include "SimpleShader.h"
+#include "JobSystem.h"
 
 struct Particle
 {
@@ -23,6 +25,17 @@ struct ParticleVertex
 	float Size;
 };
 
+// What Draw needs from the emitter, so it can draw on another thread while Update carries on
+struct ParticleSnapshot
+{
+	ParticleSnapshot() : firstAliveIndex(0), firstDeadIndex(0), livingParticleCount(0) {}
+
+	std::vector<ParticleVertex> vertices; // 4 per particle, only the living ones are current
+	int firstAliveIndex;
+	int firstDeadIndex;
+	int livingParticleCount;
+};
+
 class Emitter
 {
 public:
@@ -44,14 +57,15 @@ public:
 	);
 	~Emitter();
 
-	void Update(float dt);
+	void Update(float dt, JobSystem* jobs = nullptr); // Particles are split across the jobs if there are any
 
-	void UpdateSingleParticle(float dt, int index);
+	void UpdateSingleParticle(float dt, int index); // Only touches that particle, so it can run on any thread
 	void SpawnParticle();
 
-	void CopyParticlesToGPU(ID3D11DeviceContext* context);
-	void CopyOneParticle(int index);
-	void Draw(ID3D11DeviceContext* context, Camera* camera);
+	void CopyToSnapshot(ParticleSnapshot& snapshot); // On the thread that calls Update
+	void CopyParticlesToGPU(ID3D11DeviceContext* context, const ParticleSnapshot& snapshot);
+	void CopyOneParticle(int index, ParticleVertex* vertices);
+	void Draw(ID3D11DeviceContext* context, Camera* camera, const ParticleSnapshot& snapshot); // Only reads the snapshot, never the live particles
 
 private:
 	int particlesPerSecond;
@@ -76,7 +90,7 @@ private:
 	int firstAliveIndex;
 
 	// Rendering
-	ParticleVertex* localParticleVertices;
+	ParticleVertex* localParticleVertices; // Corner UVs every snapshot starts from
 	ID3D11Buffer* vertexBuffer;
 	ID3D11Buffer* indexBuffer;
 
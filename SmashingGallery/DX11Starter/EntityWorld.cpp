@@ -0,0 +1,139 @@
+#include "EntityWorld.h"
+
+namespace
+{
+	std::vector<int>& ComponentSizes() // Function static, so ComponentId works during static initialization too
+	{
+		static std::vector<int> sizes;
+		return sizes;
+	}
+}
+
+EntityWorld::EntityWorld()
+{
+	count = 0;
+	FindArchetype(0); // Where new entities start
+}
+
+EntityWorld::~EntityWorld()
+{
+}
+
+int EntityWorld::Create()
+{
+	int entity;
+	if (!freeEntities.empty())
+	{
+		entity = freeEntities.back();
+		freeEntities.pop_back();
+	}
+	else
+	{
+		entity = (int)records.size();
+		records.push_back(EntityRecord());
+	}
+
+	int empty = FindArchetype(0);
+	records[entity].archetype = empty;
+	records[entity].row = (int)archetypes[empty].entities.size();
+	archetypes[empty].entities.push_back(entity);
+	count++;
+	return entity;
+}
+
+void EntityWorld::Destroy(int entity)
+{
+	RemoveRow(records[entity].archetype, records[entity].row);
+	records[entity].archetype = -1;
+	freeEntities.push_back(entity);
+	count--;
+}
+
+int EntityWorld::GetCount()
+{
+	return count;
+}
+
+int EntityWorld::RegisterComponent(int size)
+{
+	std::vector<int>& sizes = ComponentSizes();
+	sizes.push_back(size);
+	return (int)sizes.size() - 1; // Past MaxComponents the masks overflow, so keep the component list short
+}
+
+int EntityWorld::GetComponentSize(int id)
+{
+	return ComponentSizes()[id];
+}
+
+int EntityWorld::FindArchetype(ComponentMask mask)
+{
+	std::unordered_map<ComponentMask, int>::iterator found = archetypeOfMask.find(mask);
+	if (found != archetypeOfMask.end())
+	{
+		return found->second;
+	}
+	archetypes.push_back(Archetype());
+	archetypes.back().mask = mask;
+	int index = (int)archetypes.size() - 1;
+	archetypeOfMask[mask] = index;
+	return index;
+}
+
+void EntityWorld::MoveTo(int entity, ComponentMask mask)
+{
+	int from = records[entity].archetype;
+	int fromRow = records[entity].row;
+	int to = FindArchetype(mask); // Before taking references, this can grow the archetype list
+	Archetype& source = archetypes[from];
+	Archetype& destination = archetypes[to];
+
+	int row = (int)destination.entities.size();
+	destination.entities.push_back(entity);
+	for (int id = 0; id < MaxComponents; id++)
+	{
+		if ((mask >> id) & 1)
+		{
+			int size = GetComponentSize(id);
+			std::vector<char>& column = destination.columns[id];
+			column.resize(column.size() + size);
+			if ((source.mask >> id) & 1)
+			{
+				memcpy(&column[row * size], &source.columns[id][fromRow * size], size);
+			}
+			else
+			{
+				memset(&column[row * size], 0, size);
+			}
+		}
+	}
+
+	RemoveRow(from, fromRow);
+	records[entity].archetype = to;
+	records[entity].row = row;
+}
+
+void EntityWorld::RemoveRow(int archetype, int row)
+{
+	Archetype& table = archetypes[archetype];
+	int last = (int)table.entities.size() - 1;
+	for (int id = 0; id < MaxComponents; id++)
+	{
+		if ((table.mask >> id) & 1)
+		{
+			int size = GetComponentSize(id);
+			std::vector<char>& column = table.columns[id];
+			if (row != last)
+			{
+				memcpy(&column[row * size], &column[last * size], size);
+			}
+			column.resize(column.size() - size);
+		}
+	}
+	if (row != last)
+	{
+		table.entities[row] = table.entities[last];
+		records[table.entities[row]].row = row;
+	}
+	table.entities.pop_back();
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include "JobSystem.h"
+
+typedef unsigned int ComponentMask; // One bit per component type
+
+// --------------------------------------------------------
+// Entity-component storage grouped into archetypes
+//
+// Every entity with the same set of components lives in the
+// same archetype, which keeps one tightly packed array per
+// component. Each runs a function over the matching rows of
+// every matching archetype, so hot loops read contiguous
+// memory and never need RTTI to find out what something is.
+//
+// Components must be plain data (they're moved with memcpy),
+// and there can be at most 32 types. Adding or removing a
+// component moves the entity to another archetype, so don't
+// do either inside Each; collect the entities and change
+// them afterwards.
+// --------------------------------------------------------
+class EntityWorld
+{
+public:
+	EntityWorld();
+	~EntityWorld();
+
+	int Create(); // New entity with no components
+	void Destroy(int entity);
+	int GetCount(); // Live entities
+
+	template<typename T> void Add(int entity, const T& component); // Overwrites if it's already there
+	template<typename T> void Remove(int entity);
+	template<typename T> bool Has(int entity);
+	template<typename T> T* Get(int entity); // nullptr if the entity doesn't have one
+
+	// Calls f(entity, T&...) for every entity that has all of T and with, and none of without
+	template<typename... T, typename F> void Each(ComponentMask with, ComponentMask without, F f);
+	template<typename... T, typename F> void ParallelEach(JobSystem& jobs, int minPerJob, ComponentMask with, ComponentMask without, F f); // Each split into jobs, f mustn't touch other entities
+	template<typename... T> int Count(ComponentMask without = 0); // Entities that have all of T and none of without
+
+	template<typename T> static int ComponentId();
+	template<typename... T> static ComponentMask MaskOf();
+
+private:
+	static const int MaxComponents = 32;
+
+	struct Archetype
+	{
+		ComponentMask mask;
+		std::vector<int> entities; // Entity in each row
+		std::vector<char> columns[MaxComponents]; // Indexed by component id, empty unless the bit is in the mask
+	};
+
+	struct EntityRecord
+	{
+		int archetype; // -1 once destroyed
+		int row;
+	};
+
+	std::vector<Archetype> archetypes;
+	std::unordered_map<ComponentMask, int> archetypeOfMask;
+	std::vector<EntityRecord> records; // Indexed by entity
+	std::vector<int> freeEntities; // Reused first
+	int count;
+
+	static int RegisterComponent(int size);
+	static int GetComponentSize(int id);
+	int FindArchetype(ComponentMask mask); // Creates it the first time
+	void MoveTo(int entity, ComponentMask mask); // Copies the components both archetypes share
+	void RemoveRow(int archetype, int row); // Fills the hole with the last row
+
+	template<typename T> static T* Column(Archetype& archetype);
+	template<typename F, typename... T> static void EachRow(const int* entities, int rows, F& f, T*... columns);
+};
+
+template<typename T>
+int EntityWorld::ComponentId()
+{
+	static int id = RegisterComponent(sizeof(T));
+	return id;
+}
+
+template<typename... T>
+ComponentMask EntityWorld::MaskOf()
+{
+	ComponentMask mask = 0;
+	int expand[] = { 0, (mask |= 1u << ComponentId<T>(), 0)... };
+	(void)expand;
+	return mask;
+}
+
+template<typename T>
+void EntityWorld::Add(int entity, const T& component)
+{
+	ComponentMask bit = 1u << ComponentId<T>();
+	if ((archetypes[records[entity].archetype].mask & bit) == 0)
+	{
+		MoveTo(entity, archetypes[records[entity].archetype].mask | bit);
+	}
+	*Get<T>(entity) = component;
+}
+
+template<typename T>
+void EntityWorld::Remove(int entity)
+{
+	ComponentMask bit = 1u << ComponentId<T>();
+	if ((archetypes[records[entity].archetype].mask & bit) != 0)
+	{
+		MoveTo(entity, archetypes[records[entity].archetype].mask & ~bit);
+	}
+}
+
+template<typename T>
+bool EntityWorld::Has(int entity)
+{
+	return (archetypes[records[entity].archetype].mask & (1u << ComponentId<T>())) != 0;
+}
+
+template<typename T>
+T* EntityWorld::Get(int entity)
+{
+	const EntityRecord& record = records[entity];
+	Archetype& archetype = archetypes[record.archetype];
+	if ((archetype.mask & (1u << ComponentId<T>())) == 0)
+	{
+		return nullptr;
+	}
+	return Column<T>(archetype) + record.row;
+}
+
+template<typename... T, typename F>
+void EntityWorld::Each(ComponentMask with, ComponentMask without, F f)
+{
+	ComponentMask required = with | MaskOf<T...>();
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		Archetype& archetype = archetypes[a];
+		if ((archetype.mask & required) == required && (archetype.mask & without) == 0 && !archetype.entities.empty())
+		{
+			EachRow(&archetype.entities[0], (int)archetype.entities.size(), f, Column<T>(archetype)...);
+		}
+	}
+}
+
+template<typename... T, typename F>
+void EntityWorld::ParallelEach(JobSystem& jobs, int minPerJob, ComponentMask with, ComponentMask without, F f)
+{
+	ComponentMask required = with | MaskOf<T...>();
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		Archetype& archetype = archetypes[a];
+		if ((archetype.mask & required) == required && (archetype.mask & without) == 0 && !archetype.entities.empty())
+		{
+			jobs.ParallelFor((int)archetype.entities.size(), minPerJob, [&](int first, int last)
+			{
+				EachRow(&archetype.entities[first], last - first, f, (Column<T>(archetype) + first)...);
+			});
+		}
+	}
+}
+
+template<typename... T>
+int EntityWorld::Count(ComponentMask without)
+{
+	ComponentMask required = MaskOf<T...>();
+	int matching = 0;
+	for (size_t a = 0; a < archetypes.size(); a++)
+	{
+		if ((archetypes[a].mask & required) == required && (archetypes[a].mask & without) == 0)
+		{
+			matching += (int)archetypes[a].entities.size();
+		}
+	}
+	return matching;
+}
+
+template<typename T>
+T* EntityWorld::Column(Archetype& archetype)
+{
+	return reinterpret_cast<T*>(archetype.columns[ComponentId<T>()].data());
+}
+
+template<typename F, typename... T>
+void EntityWorld::EachRow(const int* entities, int rows, F& f, T*... columns)
+{
+	for (int row = 0; row < rows; row++)
+	{
+		f(entities[row], columns[row]...);
+	}
+}
@@ -0,0 +1,500 @@
+#include "FracturePattern.h"
+#include "MappedFile.h"
+#include "SeededRandom.h"
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int PatternVersion = 1;
+
+	// At the start of a .sgshards file, followed by the shard table, the vertices and the indices
+	struct FracturePatternHeader
+	{
+		char magic[4]; // "SGFP"
+		unsigned int version;
+		unsigned long long sourceHash; // Hash of the OBJ file contents
+		int requestedShards;
+		unsigned int seed;
+		unsigned int shardCount; // Cells that kept some of the mesh
+		unsigned int vertexCount;
+		unsigned int indexCount;
+		unsigned int padding;
+	};
+
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	inline XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	inline float PlaneDistance(const XMFLOAT4& plane, const XMFLOAT3& p) // Positive past the plane, toward the neighbour
+	{
+		return plane.x * p.x + plane.y * p.y + plane.z * p.z - plane.w;
+	}
+}
+
+FracturePattern::FracturePattern()
+{
+	requestedShards = 0;
+	builtSeed = 0;
+}
+
+FracturePattern::~FracturePattern()
+{
+}
+
+void FracturePattern::Build(const Vertex* sourceVertices, int vertexCount, const int* sourceIndices, int indexCount, int shardCount, unsigned int seed)
+{
+	shards.clear();
+	vertices.clear();
+	indices.clear();
+	requestedShards = shardCount;
+	builtSeed = seed;
+	int triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0 || shardCount <= 0)
+	{
+		return;
+	}
+
+	XMFLOAT3 boxMin = sourceVertices[0].Position;
+	XMFLOAT3 boxMax = boxMin;
+	for (int i = 1; i < vertexCount; i++)
+	{
+		const XMFLOAT3& p = sourceVertices[i].Position;
+		boxMin = XMFLOAT3(fminf(boxMin.x, p.x), fminf(boxMin.y, p.y), fminf(boxMin.z, p.z));
+		boxMax = XMFLOAT3(fmaxf(boxMax.x, p.x), fmaxf(boxMax.y, p.y), fmaxf(boxMax.z, p.z));
+	}
+	XMFLOAT3 middle((boxMin.x + boxMax.x) * 0.5f, (boxMin.y + boxMax.y) * 0.5f, (boxMin.z + boxMax.z) * 0.5f);
+	float size = fmaxf(boxMax.x - boxMin.x, fmaxf(boxMax.y - boxMin.y, boxMax.z - boxMin.z));
+	float tolerance = size * 1e-5f; // Seeds closer than this are in the same spot
+
+	// Seeds start at a point on the surface picked by area, then move in toward the middle
+	// by the cube root of a random fraction, which spreads them evenly through anything
+	// the middle can see all of, like the spheres and boxes targets are made of
+	unsigned int state = seed;
+	auto random = [&state]() { return SeededRandom::NextRandom(state); };
+	std::vector<float> areaSums(triangleCount);
+	float totalArea = 0.0f;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		const XMFLOAT3& a = sourceVertices[sourceIndices[t * 3]].Position;
+		XMFLOAT3 normal = Cross(Subtract(sourceVertices[sourceIndices[t * 3 + 1]].Position, a), Subtract(sourceVertices[sourceIndices[t * 3 + 2]].Position, a));
+		totalArea += sqrtf(Dot(normal, normal));
+		areaSums[t] = totalArea;
+	}
+	std::vector<XMFLOAT3> seeds(shardCount);
+	for (int k = 0; k < shardCount; k++)
+	{
+		int t = (int)(std::upper_bound(areaSums.begin(), areaSums.end(), random() * totalArea) - areaSums.begin());
+		t = t < triangleCount ? t : triangleCount - 1;
+		float u = random();
+		float v = random();
+		if (u + v > 1.0f)
+		{
+			u = 1.0f - u;
+			v = 1.0f - v;
+		}
+		const XMFLOAT3& a = sourceVertices[sourceIndices[t * 3]].Position;
+		const XMFLOAT3& b = sourceVertices[sourceIndices[t * 3 + 1]].Position;
+		const XMFLOAT3& c = sourceVertices[sourceIndices[t * 3 + 2]].Position;
+		XMFLOAT3 surface(a.x + (b.x - a.x) * u + (c.x - a.x) * v, a.y + (b.y - a.y) * u + (c.y - a.y) * v, a.z + (b.z - a.z) * u + (c.z - a.z) * v);
+		float pull = cbrtf(random());
+		seeds[k] = XMFLOAT3(middle.x + (surface.x - middle.x) * pull, middle.y + (surface.y - middle.y) * pull, middle.z + (surface.z - middle.z) * pull);
+	}
+
+	std::vector<int> neighbours;
+	std::vector<float> neighbourDistances(shardCount);
+	std::vector<XMFLOAT4> planes;
+	std::vector<Vertex> polygon, clipped;
+	for (int cell = 0; cell < shardCount; cell++)
+	{
+		// Bisectors with every other seed, nearest first since they cut away the most
+		const XMFLOAT3& own = seeds[cell];
+		neighbours.clear();
+		bool duplicate = false;
+		for (int other = 0; other < shardCount; other++)
+		{
+			if (other == cell)
+			{
+				continue;
+			}
+			XMFLOAT3 offset = Subtract(seeds[other], own);
+			neighbourDistances[other] = Dot(offset, offset);
+			if (neighbourDistances[other] <= tolerance * tolerance)
+			{
+				duplicate = duplicate || other < cell; // The first of two seeds in the same spot takes the whole cell
+				continue;
+			}
+			neighbours.push_back(other);
+		}
+		if (duplicate)
+		{
+			continue;
+		}
+		std::sort(neighbours.begin(), neighbours.end(), [&](int a, int b) { return neighbourDistances[a] < neighbourDistances[b]; });
+		planes.resize(neighbours.size());
+		for (size_t n = 0; n < neighbours.size(); n++)
+		{
+			const XMFLOAT3& other = seeds[neighbours[n]];
+			XMFLOAT3 normal = Subtract(other, own);
+			float inverseLength = 1.0f / sqrtf(Dot(normal, normal));
+			normal = XMFLOAT3(normal.x * inverseLength, normal.y * inverseLength, normal.z * inverseLength);
+			XMFLOAT3 halfway((own.x + other.x) * 0.5f, (own.y + other.y) * 0.5f, (own.z + other.z) * 0.5f);
+			planes[n] = XMFLOAT4(normal.x, normal.y, normal.z, Dot(normal, halfway));
+		}
+
+		// Each triangle clipped down to the part inside the cell, then the faces
+		// where the cell's planes pass through the inside of the mesh
+		int firstVertex = (int)vertices.size();
+		int firstIndex = (int)indices.size();
+		for (int t = 0; t < triangleCount; t++)
+		{
+			polygon.assign(1, sourceVertices[sourceIndices[t * 3]]);
+			polygon.push_back(sourceVertices[sourceIndices[t * 3 + 1]]);
+			polygon.push_back(sourceVertices[sourceIndices[t * 3 + 2]]);
+			for (size_t p = 0; p < planes.size() && !polygon.empty(); p++)
+			{
+				Clip(polygon, clipped, planes[p]);
+			}
+			AddPolygon(polygon);
+		}
+		AddCaps(sourceVertices, sourceIndices, triangleCount, planes, polygon, clipped);
+		if ((int)indices.size() == firstIndex)
+		{
+			continue; // The cell missed the mesh
+		}
+
+		// Centered on its volume, found from tetrahedra fanned out from the seed, so
+		// it tumbles about where its weight is. Open meshes fall back to the vertices' average
+		FractureShard shard;
+		double volume = 0.0;
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		for (size_t i = firstIndex; i < indices.size(); i += 3)
+		{
+			XMFLOAT3 a = Subtract(vertices[indices[i]].Position, own);
+			XMFLOAT3 b = Subtract(vertices[indices[i + 1]].Position, own);
+			XMFLOAT3 c = Subtract(vertices[indices[i + 2]].Position, own);
+			double tetrahedron = Dot(a, Cross(b, c)) / 6.0;
+			volume += tetrahedron;
+			sum[0] += tetrahedron * (a.x + b.x + c.x) * 0.25;
+			sum[1] += tetrahedron * (a.y + b.y + c.y) * 0.25;
+			sum[2] += tetrahedron * (a.z + b.z + c.z) * 0.25;
+		}
+		if (fabs(volume) > (double)size * size * size * 1e-9)
+		{
+			shard.center = XMFLOAT3(own.x + (float)(sum[0] / volume), own.y + (float)(sum[1] / volume), own.z + (float)(sum[2] / volume));
+		}
+		else
+		{
+			sum[0] = sum[1] = sum[2] = 0.0;
+			for (size_t i = firstVertex; i < vertices.size(); i++)
+			{
+				sum[0] += vertices[i].Position.x;
+				sum[1] += vertices[i].Position.y;
+				sum[2] += vertices[i].Position.z;
+			}
+			double count = (double)(vertices.size() - firstVertex);
+			shard.center = XMFLOAT3((float)(sum[0] / count), (float)(sum[1] / count), (float)(sum[2] / count));
+		}
+		float radiusSquared = 0.0f;
+		for (size_t i = firstVertex; i < vertices.size(); i++)
+		{
+			vertices[i].Position = Subtract(vertices[i].Position, shard.center);
+			radiusSquared = fmaxf(radiusSquared, Dot(vertices[i].Position, vertices[i].Position));
+		}
+		shard.radius = sqrtf(radiusSquared);
+		shard.firstIndex = firstIndex;
+		shard.indexCount = (int)indices.size() - firstIndex;
+		shards.push_back(shard);
+	}
+}
+
+void FracturePattern::AddCaps(const Vertex* sourceVertices, const int* sourceIndices, int triangleCount, const std::vector<XMFLOAT4>& planes, std::vector<Vertex>& polygon, std::vector<Vertex>& scratch)
+{
+	std::vector<XMFLOAT3> entries, exits;
+	for (size_t k = 0; k < planes.size(); k++)
+	{
+		// Where the plane cuts the whole mesh. Walking each triangle in its winding, the
+		// surface leaves the cell's side at one point and comes back at another
+		const XMFLOAT4& plane = planes[k];
+		entries.clear();
+		exits.clear();
+		XMFLOAT3 middle(0.0f, 0.0f, 0.0f);
+		for (int t = 0; t < triangleCount; t++)
+		{
+			const XMFLOAT3* corners[3] = { &sourceVertices[sourceIndices[t * 3]].Position, &sourceVertices[sourceIndices[t * 3 + 1]].Position, &sourceVertices[sourceIndices[t * 3 + 2]].Position };
+			float distances[3] = { PlaneDistance(plane, *corners[0]), PlaneDistance(plane, *corners[1]), PlaneDistance(plane, *corners[2]) };
+			int found = 0;
+			XMFLOAT3 entry, exit;
+			for (int c = 0; c < 3; c++)
+			{
+				int next = (c + 1) % 3;
+				float da = distances[c];
+				float db = distances[next];
+				if ((da <= 0.0f) == (db <= 0.0f))
+				{
+					continue;
+				}
+				float s = da / (da - db);
+				const XMFLOAT3& a = *corners[c];
+				const XMFLOAT3& b = *corners[next];
+				XMFLOAT3 point(a.x + (b.x - a.x) * s, a.y + (b.y - a.y) * s, a.z + (b.z - a.z) * s);
+				if (da <= 0.0f)
+				{
+					exit = point;
+				}
+				else
+				{
+					entry = point;
+				}
+				found++;
+			}
+			if (found == 2)
+			{
+				entries.push_back(entry);
+				exits.push_back(exit);
+				middle = XMFLOAT3(middle.x + entry.x + exit.x, middle.y + entry.y + exit.y, middle.z + entry.z + exit.z);
+			}
+		}
+		if (entries.empty())
+		{
+			continue;
+		}
+		float scale = 0.5f / entries.size();
+		middle = XMFLOAT3(middle.x * scale, middle.y * scale, middle.z * scale);
+
+		// Flat, facing the neighbour, textured by where it is on the plane
+		XMFLOAT3 normal(plane.x, plane.y, plane.z);
+		XMFLOAT3 axis = fabsf(normal.x) < 0.5f ? XMFLOAT3(1.0f, 0.0f, 0.0f) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+		XMFLOAT3 tangent = Cross(axis, normal);
+		float inverseLength = 1.0f / sqrtf(Dot(tangent, tangent));
+		tangent = XMFLOAT3(tangent.x * inverseLength, tangent.y * inverseLength, tangent.z * inverseLength);
+		XMFLOAT3 bitangent = Cross(normal, tangent);
+		auto capVertex = [&](const XMFLOAT3& position)
+		{
+			Vertex vertex;
+			vertex.Position = position;
+			vertex.UV = XMFLOAT2(Dot(position, tangent), Dot(position, bitangent));
+			vertex.Normal = normal;
+			vertex.Tangent = tangent;
+			return vertex;
+		};
+
+		// The cross section as a fan, wound back against the surface's outline, cut
+		// down to this cell's face by the other planes
+		for (size_t e = 0; e < entries.size(); e++)
+		{
+			polygon.assign(1, capVertex(middle));
+			polygon.push_back(capVertex(entries[e]));
+			polygon.push_back(capVertex(exits[e]));
+			for (size_t p = 0; p < planes.size() && !polygon.empty(); p++)
+			{
+				if (p != k)
+				{
+					Clip(polygon, scratch, planes[p]);
+				}
+			}
+			AddPolygon(polygon);
+		}
+	}
+}
+
+void FracturePattern::AddPolygon(const std::vector<Vertex>& polygon)
+{
+	int base = (int)vertices.size();
+	vertices.insert(vertices.end(), polygon.begin(), polygon.end());
+	for (int k = 1; k + 1 < (int)polygon.size(); k++)
+	{
+		indices.push_back(base);
+		indices.push_back(base + k);
+		indices.push_back(base + k + 1);
+	}
+}
+
+void FracturePattern::Clip(std::vector<Vertex>& polygon, std::vector<Vertex>& scratch, const XMFLOAT4& plane)
+{
+	bool outside = false;
+	for (size_t k = 0; k < polygon.size() && !outside; k++)
+	{
+		outside = PlaneDistance(plane, polygon[k].Position) > 0.0f;
+	}
+	if (!outside)
+	{
+		return;
+	}
+	scratch.clear();
+	for (size_t k = 0; k < polygon.size(); k++)
+	{
+		const Vertex& a = polygon[k];
+		const Vertex& b = polygon[(k + 1) % polygon.size()];
+		float da = PlaneDistance(plane, a.Position);
+		float db = PlaneDistance(plane, b.Position);
+		if (da <= 0.0f)
+		{
+			scratch.push_back(a);
+		}
+		if ((da < 0.0f && db > 0.0f) || (da > 0.0f && db < 0.0f))
+		{
+			scratch.push_back(Lerp(a, b, da / (da - db)));
+		}
+	}
+	polygon.swap(scratch);
+	if (polygon.size() < 3)
+	{
+		polygon.clear();
+	}
+}
+
+Vertex FracturePattern::Lerp(const Vertex& a, const Vertex& b, float t)
+{
+	Vertex result;
+	XMStoreFloat3(&result.Position, XMVectorLerp(XMLoadFloat3(&a.Position), XMLoadFloat3(&b.Position), t));
+	XMStoreFloat2(&result.UV, XMVectorLerp(XMLoadFloat2(&a.UV), XMLoadFloat2(&b.UV), t));
+	XMStoreFloat3(&result.Normal, XMVectorLerp(XMLoadFloat3(&a.Normal), XMLoadFloat3(&b.Normal), t)); // The shaders normalize these
+	XMStoreFloat3(&result.Tangent, XMVectorLerp(XMLoadFloat3(&a.Tangent), XMLoadFloat3(&b.Tangent), t));
+	return result;
+}
+
+bool FracturePattern::IsBuilt() const
+{
+	return !shards.empty();
+}
+
+bool FracturePattern::Read(const char* file, unsigned long long sourceHash, int shardCount, unsigned int seed)
+{
+	MappedFile mapped(file);
+	if (!mapped.IsOpen() || mapped.GetSize() < sizeof(FracturePatternHeader))
+	{
+		return false;
+	}
+	FracturePatternHeader header;
+	memcpy(&header, mapped.GetData(), sizeof(header));
+	size_t expected = sizeof(header) + (size_t)header.shardCount * sizeof(FractureShard) + (size_t)header.vertexCount * sizeof(Vertex) + (size_t)header.indexCount * sizeof(int);
+	if (memcmp(header.magic, "SGFP", 4) != 0 || header.version != PatternVersion || mapped.GetSize() != expected ||
+		(sourceHash != 0 && header.sourceHash != sourceHash) || header.requestedShards != shardCount || header.seed != seed)
+	{
+		return false;
+	}
+
+	const char* data = mapped.GetData() + sizeof(header);
+	std::vector<FractureShard> readShards(header.shardCount);
+	std::vector<Vertex> readVertices(header.vertexCount);
+	std::vector<int> readIndices(header.indexCount);
+	if (header.shardCount > 0) memcpy(&readShards[0], data, header.shardCount * sizeof(FractureShard));
+	data += header.shardCount * sizeof(FractureShard);
+	if (header.vertexCount > 0) memcpy(&readVertices[0], data, header.vertexCount * sizeof(Vertex));
+	data += header.vertexCount * sizeof(Vertex);
+	if (header.indexCount > 0) memcpy(&readIndices[0], data, header.indexCount * sizeof(int));
+
+	// Nothing may point outside the file's own arrays
+	for (size_t s = 0; s < readShards.size(); s++)
+	{
+		if (readShards[s].firstIndex < 0 || readShards[s].indexCount < 0 || readShards[s].firstIndex > (int)header.indexCount - readShards[s].indexCount)
+		{
+			return false;
+		}
+	}
+	for (size_t i = 0; i < readIndices.size(); i++)
+	{
+		if (readIndices[i] < 0 || readIndices[i] >= (int)header.vertexCount)
+		{
+			return false;
+		}
+	}
+
+	shards.swap(readShards);
+	vertices.swap(readVertices);
+	indices.swap(readIndices);
+	requestedShards = shardCount;
+	builtSeed = seed;
+	return true;
+}
+
+bool FracturePattern::Write(const char* file, unsigned long long sourceHash) const
+{
+	FracturePatternHeader header = {};
+	memcpy(header.magic, "SGFP", 4);
+	header.version = PatternVersion;
+	header.sourceHash = sourceHash;
+	header.requestedShards = requestedShards;
+	header.seed = builtSeed;
+	header.shardCount = (unsigned int)shards.size();
+	header.vertexCount = (unsigned int)vertices.size();
+	header.indexCount = (unsigned int)indices.size();
+
+	// Written aside and swapped in, like the mesh cache
+	std::string tempFile = std::string(file) + ".tmp";
+	{
+		std::ofstream out(tempFile.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+		{
+			return false;
+		}
+		out.write((const char*)&header, sizeof(header));
+		if (!shards.empty()) out.write((const char*)&shards[0], shards.size() * sizeof(FractureShard));
+		if (!vertices.empty()) out.write((const char*)&vertices[0], vertices.size() * sizeof(Vertex));
+		if (!indices.empty()) out.write((const char*)&indices[0], indices.size() * sizeof(int));
+		if (!out.good())
+		{
+			out.close();
+			DeleteFileA(tempFile.c_str());
+			return false;
+		}
+	}
+	return MoveFileExA(tempFile.c_str(), file, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+std::string FracturePattern::GetCachePath(const char* objFile)
+{
+	std::string path = objFile;
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("\\/");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+	{
+		path.erase(dot); // Drop the .obj
+	}
+	return path + ".sgshards";
+}
+
+int FracturePattern::GetShardCount() const
+{
+	return (int)shards.size();
+}
+
+const FractureShard& FracturePattern::GetShard(int shard) const
+{
+	return shards[shard];
+}
+
+const Vertex* FracturePattern::GetVertices() const
+{
+	return vertices.empty() ? nullptr : &vertices[0];
+}
+
+int FracturePattern::GetVertexCount() const
+{
+	return (int)vertices.size();
+}
+
+const int* FracturePattern::GetIndices() const
+{
+	return indices.empty() ? nullptr : &indices[0];
+}
+
+int FracturePattern::GetIndexCount() const
+{
+	return (int)indices.size();
+}
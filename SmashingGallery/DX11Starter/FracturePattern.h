@@ -0,0 +1,74 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include <string>
+#include "Vertex.h"
+
+// One piece of a FracturePattern, a range of its index buffer
+struct FractureShard
+{
+	DirectX::XMFLOAT3 center; // Object space, where the piece sat in the whole mesh. Its vertices are measured from here
+	float radius; // Around center, holding every vertex
+	int firstIndex;
+	int indexCount;
+};
+
+// --------------------------------------------------------
+// A mesh cut into Voronoi cells ahead of time, ready to
+// break apart
+//
+// Seed points are scattered through the mesh, and every
+// triangle is clipped to the region nearer each seed than any
+// other. Each face of a cell gets the mesh's cross section on
+// its plane, fanned from the middle and cut down by the cell's
+// other planes, so on a closed mesh every shard is closed too,
+// even ones that never reach the surface. The faces are exact
+// for convex meshes; on concave ones a cross section with
+// several outlines still encloses the right volume but its
+// fan can fold over itself.
+//
+// Each shard's vertices are relative to its own center, so a
+// shard can be drawn anywhere by one rotation and position.
+// All the shards share one vertex and index buffer, back to
+// back.
+//
+// Building is slow enough to keep out of the game, so Mesh
+// stores the result in a file next to the OBJ and a hit only
+// has to look shards up.
+// --------------------------------------------------------
+class FracturePattern
+{
+public:
+	FracturePattern();
+	~FracturePattern();
+
+	void Build(const Vertex* vertices, int vertexCount, const int* indices, int indexCount, int shardCount, unsigned int seed); // Triangle list, seed picks the cells, empty cells are dropped
+	bool IsBuilt() const;
+
+	bool Read(const char* file, unsigned long long sourceHash, int shardCount, unsigned int seed); // False unless built from the same source with the same cells, a sourceHash of 0 trusts any source
+	bool Write(const char* file, unsigned long long sourceHash) const;
+	static std::string GetCachePath(const char* objFile);
+
+	int GetShardCount() const;
+	const FractureShard& GetShard(int shard) const;
+	const Vertex* GetVertices() const;
+	int GetVertexCount() const;
+	const int* GetIndices() const;
+	int GetIndexCount() const;
+
+	static const int DefaultShardCount = 24;
+	static const unsigned int DefaultSeed = 1;
+
+private:
+	std::vector<FractureShard> shards;
+	std::vector<Vertex> vertices;
+	std::vector<int> indices;
+	int requestedShards; // What Build was asked for, so the cache can tell
+	unsigned int builtSeed;
+
+	void AddCaps(const Vertex* sourceVertices, const int* sourceIndices, int triangleCount, const std::vector<DirectX::XMFLOAT4>& planes, std::vector<Vertex>& polygon, std::vector<Vertex>& scratch); // A cell's faces, where its planes cross the inside of the mesh
+	void AddPolygon(const std::vector<Vertex>& polygon); // Fanned into triangles
+	static void Clip(std::vector<Vertex>& polygon, std::vector<Vertex>& scratch, const DirectX::XMFLOAT4& plane); // Keeps the part behind the plane, empty if nothing is
+	static Vertex Lerp(const Vertex& a, const Vertex& b, float t);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+#include "Camera.h"
+#include "Emitter.h"
+#include "ShardPool.h"
+
+class GameObject;
+
+// One object to draw and where, world matrices transposed like the store's
+struct DrawItem
+{
+	GameObject* object; // Only its mesh and material are read, and those never change after Init
+	DirectX::XMFLOAT4X4 previousWorldMatrix; // End of the step before
+	DirectX::XMFLOAT4X4 worldMatrix; // End of this step
+	DirectX::XMFLOAT4X4 drawnMatrix; // Between the two, filled in by Draw for the moment it's drawing
+	int lod;
+};
+
+// --------------------------------------------------------
+// Everything Game::Draw reads from one simulated frame
+//
+// Update fills one at the end of every step and hands it
+// over through a TripleBuffer, so Draw can run on another
+// thread without touching anything Update is changing. Each
+// object carries its matrix from the step before too, and
+// Draw interpolates between them by how far real time has got
+// past the snapshot's. The vectors are cleared rather than
+// freed between frames, so after the first few frames no
+// allocations happen.
+// --------------------------------------------------------
+struct FrameSnapshot
+{
+	FrameSnapshot() : camera(1, 1), time(0.0f), score(0), frame(0) {}
+
+	Camera camera; // A copy, with this frame's view and projection
+	float time; // Simulated time at the end of the step
+	std::vector<DrawItem> targets; // Opaque, also drawn into the shadow map and the render texture
+	std::vector<DrawItem> walls;
+	std::vector<DrawItem> bullets;
+	std::vector<DrawItem> glass; // Every object is a Glass
+	ParticleSnapshot particles;
+	ShardSnapshot shards;
+	int score;
+	unsigned int frame; // How many Updates ran before this one was taken
+};
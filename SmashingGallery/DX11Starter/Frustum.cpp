@@ -0,0 +1,141 @@
+#include "Frustum.h"
+#include "SimdLanes.h"
+using namespace DirectX;
+using namespace SimdLanes;
+
+void SphereBatch::Clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	radius.clear();
+}
+
+void SphereBatch::Add(const XMFLOAT3& center, float sphereRadius)
+{
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	radius.push_back(sphereRadius);
+}
+
+int SphereBatch::GetCount() const
+{
+	return (int)radius.size();
+}
+
+Frustum::Frustum()
+{
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f); // Everything is inside
+	}
+}
+
+Frustum::Frustum(const XMFLOAT4X4& viewProjection)
+{
+	// Gribb/Hartmann: each plane is the w column plus or minus another column.
+	// D3D clip z runs 0 to w, so the near plane is the z column on its own.
+	const XMFLOAT4X4& m = viewProjection;
+	XMVECTOR x = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR y = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR z = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR w = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	XMVECTOR extracted[6] = { w + x, w - x, w + y, w - y, z, w - z };
+	for (int i = 0; i < 6; i++)
+	{
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(extracted[i]));
+	}
+}
+
+bool Frustum::IntersectsSphere(XMFLOAT3 center, float radius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const XMFLOAT4& p = planes[i];
+		if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::IntersectsBox(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		// The corner farthest along the normal, if even that's behind the plane the rest are too
+		const XMFLOAT4& p = planes[i];
+		float x = p.x >= 0.0f ? boxMax.x : boxMin.x;
+		float y = p.y >= 0.0f ? boxMax.y : boxMin.y;
+		float z = p.z >= 0.0f ? boxMax.z : boxMin.z;
+		if (p.x * x + p.y * y + p.z * z + p.w < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int Frustum::CullSpheres(const SphereBatch& spheres, std::vector<int>& visible) const
+{
+	int count = spheres.GetCount();
+	visible.resize(count); // Room for all of them, trimmed at the end
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	Lanes planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = Splat(planes[p].x);
+		planeY[p] = Splat(planes[p].y);
+		planeZ[p] = Splat(planes[p].z);
+		planeW[p] = Splat(planes[p].w);
+	}
+
+	const float* x = &spheres.centerX[0];
+	const float* y = &spheres.centerY[0];
+	const float* z = &spheres.centerZ[0];
+	const float* r = &spheres.radius[0];
+	int* out = &visible[0];
+	int found = 0;
+	int i = 0;
+	for (; i + LaneCount <= count; i += LaneCount)
+	{
+		Lanes cx = Load(x + i), cy = Load(y + i), cz = Load(z + i);
+		Lanes negativeRadius = Negate(Load(r + i));
+		Lanes inside = NotLess(Splat(0.0f), Splat(0.0f)); // All ones
+		for (int p = 0; p < 6; p++)
+		{
+			Lanes distance = Add(Add(Add(Mul(planeX[p], cx), Mul(planeY[p], cy)), Mul(planeZ[p], cz)), planeW[p]); // Same order as IntersectsSphere, so they agree exactly
+			inside = And(inside, NotLess(distance, negativeRadius));
+		}
+
+		// Write every lane's index but only move past the visible ones, so there's no branch per sphere
+		int mask = Mask(inside);
+		for (int lane = 0; lane < LaneCount; lane++)
+		{
+			out[found] = i + lane;
+			found += (mask >> lane) & 1;
+		}
+	}
+	for (; i < count; i++)
+	{
+		if (IntersectsSphere(XMFLOAT3(x[i], y[i], z[i]), r[i]))
+		{
+			out[found++] = i;
+		}
+	}
+
+	visible.resize(found);
+	return found;
+}
+
+XMFLOAT4 Frustum::GetPlane(int index) const
+{
+	return planes[index];
+}
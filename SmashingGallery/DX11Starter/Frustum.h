@@ -0,0 +1,38 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// World space bounding spheres, one array per component so
+// Frustum::CullSpheres can test several at a time
+struct SphereBatch
+{
+	std::vector<float> centerX, centerY, centerZ, radius;
+
+	void Clear();
+	void Add(const DirectX::XMFLOAT3& center, float sphereRadius);
+	int GetCount() const;
+};
+
+// --------------------------------------------------------
+// The six clip planes of a view projection matrix
+//
+// Built from world * view * projection, the planes come out in
+// that object's own space, so bounds can be tested without
+// transforming them first. Plane normals point inward and are
+// normalized, so distances are in the space's units.
+// --------------------------------------------------------
+class Frustum
+{
+public:
+	Frustum();
+	Frustum(const DirectX::XMFLOAT4X4& viewProjection); // Row vector matrix as DirectXMath builds it, not the transposed shader copy
+
+	bool IntersectsSphere(DirectX::XMFLOAT3 center, float radius) const; // False only when the sphere is fully outside a plane
+	bool IntersectsBox(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax) const; // Axis aligned, false only when the box is fully outside a plane
+	int CullSpheres(const SphereBatch& spheres, std::vector<int>& visible) const; // IntersectsSphere on a whole batch in SIMD, visible gets the indices that pass in order, returns how many
+	DirectX::XMFLOAT4 GetPlane(int index) const; // Left, right, bottom, top, near, far
+
+private:
+	DirectX::XMFLOAT4 planes[6]; // xyz normal, w distance
+};
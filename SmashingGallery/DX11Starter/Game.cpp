@@ -3,8 +3,10 @@
 #include <iostream>
 #include "WICTextureLoader.h"
 #include "Bullet.h"
+#include "Benchmarks.h"
 #include <math.h>
 #include <string>
+#include <algorithm>
 
 // For the DirectX Math library
 using namespace DirectX;
@@ -31,7 +33,20 @@ Game::Game(HINSTANCE hInstance)
 	shadowVS = 0;
 	glassVertexShader = 0;
 	glassPixelShader = 0;
+	shardVertexShader = 0;
+	shards = 0;
+	shardRenderer = 0;
 	renderToTextureTexture = 0;
+	jobs = 0;
+	occlusion = 0;
+	broadphase = 0;
+	physics = 0;
+	simulatedFrames = 0;
+	cursorX = 0;
+	cursorY = 0;
+	pendingSize = 0;
+
+	pipelined = true; // Update on its own thread, see DXCore::Run
 
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
@@ -53,6 +68,7 @@ Game::~Game()
 	delete mesh1;
 	delete mesh2;
 	delete mesh3;
+	delete geometryPool; // After the meshes, they give their ranges back on delete
 	delete camera;
 	delete material;
 	delete wallMat;
@@ -97,6 +113,7 @@ Game::~Game()
 	{
 		delete glassTargets[i];
 	}
+	delete targetRack;
 
 	for (int i = 0; i < 5; i++)
 	{
@@ -114,6 +131,13 @@ Game::~Game()
 	delete particleVertexShader;
 	delete particlePixelShader;
 	delete emitter;
+	delete shardVertexShader;
+	delete shards;
+	delete shardRenderer;
+	delete occlusion;
+	delete broadphase;
+	delete physics;
+	delete jobs; // Last, nothing above queues work
 }
 
 // --------------------------------------------------------
@@ -125,9 +149,22 @@ void Game::Init()
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
+	jobs = new JobSystem(pipelined ? (int)std::thread::hardware_concurrency() - 1 : 0); // One thread per core, less the one drawing when pipelined
 	LoadShaders();
 	camera = new Camera(width, height);
 	LoadGeometry();
+	occlusion = new OcclusionCuller(256, 144); // A fifth of the screen each way is plenty for walls
+	broadphase = new SpatialHashGrid(1.0f); // About a target across
+	physics = new PhysicsWorld();
+	physics->AddPlane(XMFLOAT3(0, 1, 0), -5); // Floor
+	physics->AddPlane(XMFLOAT3(1, 0, 0), -5); // Left wall
+	physics->AddPlane(XMFLOAT3(-1, 0, 0), -5); // Right wall
+	physics->AddPlane(XMFLOAT3(0, 0, -1), -5); // Back wall
+
+#if defined(RUN_BENCHMARKS)
+	// Build with RUN_BENCHMARKS defined to time the CPU-side systems
+	Benchmarks::RunAll();
+#endif
 
 	mousePos = XMFLOAT3(0, 0, -5);
 
@@ -299,6 +336,10 @@ void Game::Init()
 
 	XMStoreFloat4x4(&shadowProjectionMatrix, XMMatrixTranspose(shadowProj));
 
+	XMFLOAT4X4 shadowViewProjection;
+	XMStoreFloat4x4(&shadowViewProjection, shadowView * shadowProj);
+	shadowFrustum = Frustum(shadowViewProjection);
+
 
 	material = new Material(vertexShader, pixelShader, shaderResourceViews[0], normalShaderResourceViews[0], samplerState1);
 	wallMat = new Material(vertexShader, pixelShader, shaderResourceViews[1], normalShaderResourceViews[1], samplerState1);
@@ -321,6 +362,33 @@ void Game::Init()
 	walls[4] = new GameObject(mesh2, wallMat, { new Script() });
 	glassTargets[0] = new Glass(mesh1, glassMaterial, { new target() });
 	glassTargets[1] = new Glass(mesh3, glassMaterial2, { new target() });
+	targetRack = new GameObject(nullptr, nullptr, {});
+	targetRack->SetActive(false); // Only a parent, never drawn
+	for (int i = 0; i < 3; i++)
+	{
+		targets[i]->SetParent(targetRack);
+		GameObject::GetEntityWorld().Get<TargetComponent>(targets[i]->GetEntity())->phase = 2.0f * i;
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		glassTargets[i]->SetParent(targetRack);
+		GameObject::GetEntityWorld().Get<TargetComponent>(glassTargets[i]->GetEntity())->phase = 2.0f * (i + 4);
+	}
+
+	// Room for every shard of a few hundred glass targets at once, the oldest make way after that
+	shards = new ShardPool(8192, 3.0f, -5.0f); // Lying on the floor for a while before they go
+	shardRenderer = new ShardRenderer(device, shards->GetMaxShards(), shardVertexShader, glassPixelShader);
+	GlassMat* glassMaterials[2] = { glassMaterial, glassMaterial2 };
+	for (int i = 0; i < 2; i++)
+	{
+		const FracturePattern* fracture = glassTargets[i]->GetMesh()->GetFracturePattern();
+		if (fracture != nullptr)
+		{
+			ShatterComponent shatter = { shards->AddPattern(fracture) };
+			shardRenderer->SetPattern(shatter.pattern, fracture, glassMaterials[i], device);
+			GameObject::GetEntityWorld().Add(glassTargets[i]->GetEntity(), shatter);
+		}
+	}
 
 
 	targets[0]->SetPosition(0, 1.5f, 2);
@@ -357,10 +425,7 @@ void Game::Init()
 	walls[4]->SetScale(5, 5, 5);
 
 
-	for (int i = 0; i < 5; i++)
-	{
-		walls[i]->CalculateWorldMatrix();
-	}
+	GameObject::GetTransformStore().UpdateWorldMatrices(jobs); // Walls, targets and the rack in one pass
 
 	prevMousePos.x = NULL;
 	light1 = { XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f), XMFLOAT4(0.6f, 0.6f, 0.57f, 1.0f), XMFLOAT3(0.0f, -0.5f, 1.0f) };
@@ -378,9 +443,14 @@ void Game::Init()
 	{
 		bullets[i] = new GameObject(mesh1, bulletMaterial, { new Bullet() });
 		bullets[i]->SetScale(0.3f, 0.3f, 0.3f);
+		GameObject::GetEntityWorld().Get<BulletComponent>(bullets[i]->GetEntity())->slot = i;
 		inactiveBullets[i] = i;
 	}
 	score = 0;
+
+	GameObject::GetTransformStore().SavePreviousWorldMatrices(); // Nothing to slide in from
+	UpdateSceneTree();
+	PublishFrame(0.0f); // So the first Draw has something, even if Update hasn't run yet
 }
 
 // --------------------------------------------------------
@@ -411,6 +481,9 @@ void Game::LoadShaders()
 
 	particlePixelShader = new SimplePixelShader(device, context);
 	particlePixelShader->LoadShaderFile(L"ParticlePixelShader.cso");
+
+	shardVertexShader = new SimpleVertexShader(device, context);
+	shardVertexShader->LoadShaderFile(L"ShardVShader.cso");
 }
 
 // --------------------------------------------------------
@@ -418,9 +491,10 @@ void Game::LoadShaders()
 // --------------------------------------------------------
 void Game::LoadGeometry()
 {
-	mesh1 = new Mesh("models\\sphere.obj", device);
-	mesh2 = new Mesh("models\\quad.obj", device);
-	mesh3 = new Mesh("models\\cube.obj", device);
+	geometryPool = new GeometryPool(device, sizeof(Vertex), DXGI_FORMAT_R16_UINT, 1 << 16, 1 << 18); // Grows if the models outgrow it
+	mesh1 = new Mesh("models\\sphere.obj", device, MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_OVERDRAW | MESH_GENERATE_LODS | MESH_BUILD_MESHLETS | MESH_BUILD_BVH | MESH_BUILD_FRACTURE, geometryPool);
+	mesh2 = new Mesh("models\\quad.obj", device, MESH_OPTIMIZE_VERTEX_CACHE | MESH_KEEP_OCCLUDER, geometryPool); // The walls, which are also occluders
+	mesh3 = new Mesh("models\\cube.obj", device, MESH_OPTIMIZE_VERTEX_CACHE | MESH_BUILD_BVH | MESH_BUILD_FRACTURE, geometryPool); // The glass cube, so shots line up on its faces rather than a sphere around it
 	head = 0;
 	tail = 0; // Initialize queue tracers
 
@@ -435,7 +509,9 @@ void Game::OnResize()
 {
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
-	camera->UpdateProjectionMatrix(width, height);
+
+	// The camera belongs to Update's thread, so it picks this up next frame
+	pendingSize = ((unsigned long long)width << 32) | height;
 }
 
 // --------------------------------------------------------
@@ -447,55 +523,127 @@ void Game::Update(float deltaTime, float totalTime)
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
 
-	for (int i = 0; i < 20; i++) // Update active bullets
+	// Input and resizes from the window, which could have arrived on another thread
+	unsigned long long size = pendingSize.exchange(0);
+	if (size != 0)
 	{
-		if (dynamic_cast<Bullet*>(bullets[i]->scripts[0])->isActive)
-		{
-			bullets[i]->Update(deltaTime);
-			for (int j = 0; j < 3; j++) // Checks this bullet against all targets (will turn into octree if extra performance is needed later)
-			{
-				if (dynamic_cast<target*>(targets[j]->scripts[0])->isActive)
-				{
-					if (bullets[i]->collider.collidesWith(*bullets[i], *targets[j]))
-					{
-						dynamic_cast<Bullet*>(bullets[i]->scripts[0])->isActive = false;
-						dynamic_cast<target*>(targets[j]->scripts[0])->isActive = false;
-						score += 1;
-						//std::cout << score << std::endl;
-					}
-				}
-			}
-			for (int j = 0; j < 2; j++) // Checks this bullet against all targets (will turn into octree if extra performance is needed later)
-			{
-				if (dynamic_cast<target*>(glassTargets[j]->scripts[0])->isActive)
-				{
-					if (bullets[i]->collider.collidesWith(*bullets[i], *glassTargets[j]))
-					{
-						dynamic_cast<Bullet*>(bullets[i]->scripts[0])->isActive = false;
-						dynamic_cast<target*>(glassTargets[j]->scripts[0])->isActive = false;
-						score += 1;
-						std::cout << score << std::endl;
-					}
-				}
-			}
-			if (bullets[i]->collider.checkBounds(*bullets[i]))
-			{
-				dynamic_cast<Bullet*>(bullets[i]->scripts[0])->isActive = false;
+		camera->UpdateProjectionMatrix((unsigned int)(size >> 32), (unsigned int)(size & 0xffffffff));
+	}
+	mousePos.x = cursorX;
+	mousePos.y = cursorY;
 
-			}
-			if (!(dynamic_cast<Bullet*>(bullets[i]->scripts[0]))->isActive) // If the bullet went out of bounds or was otherwise destroyed, add it back to the inactive queue
-			{
-				ReloadBullet(i);
-			}
-			else if (bullets[i]->GetChanged())
-			{
-				bullets[i]->CalculateWorldMatrix();
-			}
-		}
+	// Where everything was, so Draw can interpolate from there to where this step leaves it
+	GameObject::GetTransformStore().SavePreviousWorldMatrices();
+
+	EntityWorld& world = GameObject::GetEntityWorld();
+	TransformStore& transforms = GameObject::GetTransformStore();
 
-		emitter->Update(deltaTime);
+	// Move everything active that has a velocity, each entity only touches its own transform so it's split across the jobs
+	world.ParallelEach<TransformComponent, VelocityComponent>(*jobs, 256, EntityWorld::MaskOf<ActiveTag>(), 0, [&](int entity, TransformComponent& transform, VelocityComponent& velocity)
+	{
+		if (velocity.value.x != 0 || velocity.value.y != 0 || velocity.value.z != 0)
+		{
+			XMFLOAT3 position = transforms.GetPosition(transform.handle);
+			position.x += velocity.value.x * deltaTime;
+			position.y += velocity.value.y * deltaTime;
+			position.z += velocity.value.z * deltaTime;
+			transforms.SetPosition(transform.handle, position);
+		}
+	});
+
+	// Check the bullet and target pairs the broadphase finds touching. Layers keep out
+	// bullet on bullet and target on target, so every pair is one of each.
+	// Bullets are swept along this step's path, so even at a coarse step they can't
+	// jump over a target, and each one stops at the first target it reaches.
+	// The pairs come out in the same order every run, so the same shots score the same way.
+	UpdateBroadphase(deltaTime);
+	std::vector<int> hitTargets;
+	std::vector<XMFLOAT3> hitVelocities; // Of the bullet that hit each target
+	std::vector<XMFLOAT3> hitPoints;
+	std::vector<int> spentBullets;
+	const std::vector<BroadphasePair>& pairs = broadphase->FindPairs();
+	pairBullets.Clear();
+	pairTargets.Clear();
+	for (size_t i = 0; i < pairs.size(); i++)
+	{
+		int bulletProxy = broadphase->GetLayers(pairs[i].proxyA) == LAYER_BULLET ? pairs[i].proxyA : pairs[i].proxyB;
+		int targetProxy = bulletProxy == pairs[i].proxyA ? pairs[i].proxyB : pairs[i].proxyA;
+		const XMFLOAT4& bullet = colliderSpheres[bulletProxy];
+		const XMFLOAT3& sweep = colliderSweeps[bulletProxy];
+		const XMFLOAT4& target = colliderSpheres[targetProxy];
+		pairBullets.Add(XMFLOAT3(bullet.x - sweep.x, bullet.y - sweep.y, bullet.z - sweep.z), bullet.w, sweep);
+		pairTargets.Add(XMFLOAT3(target.x, target.y, target.z), target.w);
+	}
+	SphereNarrowphase::SweepPairs(pairBullets, pairTargets, pairHits, pairTimes); // A lane's worth of pairs at a time
+	std::vector<int> hitOrder(pairHits.size());
+	for (size_t h = 0; h < hitOrder.size(); h++)
+	{
+		hitOrder[h] = (int)h;
+	}
+	std::sort(hitOrder.begin(), hitOrder.end(), [&](int a, int b) { return pairTimes[a] != pairTimes[b] ? pairTimes[a] < pairTimes[b] : a < b; }); // Earliest first
+	for (size_t h = 0; h < hitOrder.size(); h++)
+	{
+		const BroadphasePair& pair = pairs[pairHits[hitOrder[h]]];
+		int bulletProxy = pair.proxyA;
+		int targetProxy = pair.proxyB;
+		if (broadphase->GetLayers(pair.proxyA) != LAYER_BULLET)
+		{
+			std::swap(bulletProxy, targetProxy);
+		}
+		int bullet = broadphase->GetUserData(bulletProxy);
+		int target = broadphase->GetUserData(targetProxy);
+		int slot = world.Get<BulletComponent>(bullet)->slot;
+		if (std::find(hitTargets.begin(), hitTargets.end(), target) != hitTargets.end() || // Only hit once
+			std::find(spentBullets.begin(), spentBullets.end(), slot) != spentBullets.end()) // Already stopped in something nearer
+		{
+			continue;
+		}
+		score += 1;
+		if (world.Has<GlassTag>(target))
+		{
+			std::cout << score << std::endl;
+		}
+		hitTargets.push_back(target);
+		spentBullets.push_back(slot);
+
+		// Where the bullet was when it touched, brought in to the target's surface
+		const XMFLOAT4& bulletSphere = colliderSpheres[bulletProxy];
+		const XMFLOAT3& sweep = colliderSweeps[bulletProxy];
+		const XMFLOAT4& targetSphere = colliderSpheres[targetProxy];
+		float back = 1.0f - pairTimes[hitOrder[h]];
+		XMVECTOR center = XMVectorSet(targetSphere.x, targetSphere.y, targetSphere.z, 0);
+		XMVECTOR touch = XMVectorSet(bulletSphere.x - sweep.x * back, bulletSphere.y - sweep.y * back, bulletSphere.z - sweep.z * back, 0);
+		XMFLOAT3 point;
+		XMStoreFloat3(&point, XMVectorMultiplyAdd(XMVector3Normalize(XMVectorSubtract(touch, center)), XMVectorReplicate(targetSphere.w), center));
+		hitVelocities.push_back(world.Get<VelocityComponent>(bullet)->value);
+		hitPoints.push_back(point);
+	}
+	world.Each<ObjectComponent, BulletComponent>(EntityWorld::MaskOf<ActiveTag>(), 0, [&](int entity, ObjectComponent& object, BulletComponent& bullet)
+	{
+		if (object.object->collider.checkBounds(*object.object) && std::find(spentBullets.begin(), spentBullets.end(), bullet.slot) == spentBullets.end())
+		{
+			spentBullets.push_back(bullet.slot);
+		}
+	});
+	for (size_t i = 0; i < hitTargets.size(); i++)
+	{
+		if (!world.Has<GlassTag>(hitTargets[i])) // Glass waits for the world matrices, below
+		{
+			const float bulletMass = 0.1f; // A tenth of a target, so one goes over at a couple of units a second
+			KnockDown(hitTargets[i], XMFLOAT3(hitVelocities[i].x * bulletMass, hitVelocities[i].y * bulletMass, hitVelocities[i].z * bulletMass), hitPoints[i]);
+		}
+	}
+	for (size_t i = 0; i < spentBullets.size(); i++) // If the bullet hit something or went out of bounds, add it back to the inactive queue
+	{
+		bullets[spentBullets[i]]->SetActive(false);
+		ReloadBullet(spentBullets[i]);
+	}
 
+	for (int i = 0; i < 20; i++) // Once per bullet slot, the rate the particles have always run at
+	{
+		emitter->Update(deltaTime, jobs);
 	}
+	shards->Update(deltaTime, jobs);
 
 	float right = 0;
 	float forward = 0;
@@ -517,30 +665,261 @@ void Game::Update(float deltaTime, float totalTime)
 		camera->MoveRelative(forward, right, 0);
 	}
 
-	//has to be updated with the amount of targets added
-	for (int i = 0; i < 3; i++)
+	// Slide every active target side to side
+	world.Each<TransformComponent, TargetComponent>(EntityWorld::MaskOf<ActiveTag>(), 0, [&](int entity, TransformComponent& transform, TargetComponent& motion)
+	{
+		XMFLOAT3 position = transforms.GetPosition(transform.handle);
+		position.x = sin(totalTime * 1.6f + motion.phase) * 2;
+		transforms.SetPosition(transform.handle, position);
+	});
+
+	// Knocked down targets fall and tumble. Only bodies still awake moved, so a floor
+	// of settled ones costs nothing here, or in the world matrix update after
+	physics->Step(deltaTime);
+	const std::vector<int>& movedBodies = physics->GetMovedBodies();
+	for (size_t i = 0; i < movedBodies.size(); i++)
+	{
+		int handle = world.Get<TransformComponent>(physics->GetUserData(movedBodies[i]))->handle;
+		transforms.SetPosition(handle, physics->GetPosition(movedBodies[i]));
+		transforms.SetRotation(handle, physics->GetRotation(movedBodies[i]));
+	}
+
+	GameObject::GetTransformStore().UpdateWorldMatrices(jobs); // Every world matrix that changed this frame, in one batched pass
+
+	// Glass hit this step breaks once its world matrix has caught up with the slide, so the pieces carry it on
+	for (size_t i = 0; i < hitTargets.size(); i++)
 	{
-		if (dynamic_cast<target*>(targets[i]->scripts[0])->isActive)
+		if (world.Has<GlassTag>(hitTargets[i]))
 		{
-			targets[i]->SetPosition(sin(totalTime * 1.6f + (2 * i)) * 2, targets[i]->GetPosition().y, targets[i]->GetPosition().z);
-			if (targets[i]->GetChanged()) { targets[i]->CalculateWorldMatrix(); }
+			Shatter(hitTargets[i], hitPoints[i], hitVelocities[i], deltaTime);
 		}
 	}
+	UpdateSceneTree(); // Where the targets are for the next step's ray casts
 
-	for (int i = 0; i < 2; i++)
+
+	camera->Update();
+
+	PublishFrame(totalTime);
+}
+
+void Game::PublishFrame(float time)
+{
+	FrameSnapshot& frame = frames.GetWriteSlot();
+	frame.camera = *camera;
+	frame.time = time;
+	frame.targets.clear();
+	frame.walls.clear();
+	frame.bullets.clear();
+	frame.glass.clear();
+
+	EntityWorld& world = GameObject::GetEntityWorld();
+	world.Each<ObjectComponent>(EntityWorld::MaskOf<TargetComponent, ActiveTag>(), EntityWorld::MaskOf<GlassTag>(), [&](int entity, ObjectComponent& object)
+	{
+		DrawItem item = { object.object, object.object->GetPreviousWorldMatrix(), object.object->GetWorldMatrix(), XMFLOAT4X4(), ChooseLod(object.object) };
+		frame.targets.push_back(item);
+	});
+	world.Each<ObjectComponent>(EntityWorld::MaskOf<RigidBodyComponent, ActiveTag>(), EntityWorld::MaskOf<GlassTag>(), [&](int entity, ObjectComponent& object)
 	{
-		if (dynamic_cast<target*>(glassTargets[i]->scripts[0])->isActive)
+		DrawItem item = { object.object, object.object->GetPreviousWorldMatrix(), object.object->GetWorldMatrix(), XMFLOAT4X4(), ChooseLod(object.object) };
+		frame.targets.push_back(item);
+	});
+	for (int i = 0; i < 5; i++)
+	{
+		DrawItem item = { walls[i], walls[i]->GetPreviousWorldMatrix(), walls[i]->GetWorldMatrix(), XMFLOAT4X4(), 0 };
+		frame.walls.push_back(item);
+	}
+	world.Each<ObjectComponent>(EntityWorld::MaskOf<BulletComponent, ActiveTag>(), 0, [&](int entity, ObjectComponent& object)
+	{
+		DrawItem item = { object.object, object.object->GetPreviousWorldMatrix(), object.object->GetWorldMatrix(), XMFLOAT4X4(), ChooseLod(object.object) };
+		frame.bullets.push_back(item);
+	});
+	world.Each<ObjectComponent>(EntityWorld::MaskOf<GlassTag, ActiveTag>(), 0, [&](int entity, ObjectComponent& object)
+	{
+		DrawItem item = { object.object, object.object->GetPreviousWorldMatrix(), object.object->GetWorldMatrix(), XMFLOAT4X4(), 0 };
+		frame.glass.push_back(item);
+	});
+
+	emitter->CopyToSnapshot(frame.particles);
+	shards->CopyToSnapshot(frame.shards);
+	frame.score = score;
+	frame.frame = simulatedFrames++;
+	frames.Publish();
+}
+
+void Game::Interpolate(std::vector<DrawItem>& items, float t)
+{
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		items[i].drawnMatrix = TransformStore::Interpolate(items[i].previousWorldMatrix, items[i].worldMatrix, t);
+	}
+}
+
+void Game::UpdateSceneTree()
+{
+	EntityWorld& world = GameObject::GetEntityWorld();
+	world.Each<ObjectComponent, TargetComponent>(EntityWorld::MaskOf<ActiveTag>(), 0, [&](int entity, ObjectComponent& object, TargetComponent& target)
+	{
+		MeshBounds bounds = object.object->GetWorldBounds();
+		Aabb box = Aabb::FromSphere(bounds.sphereCenter, bounds.sphereRadius); // The colliders are spheres, and the mesh's box doesn't always hold its sphere
+		if (target.proxy == -1)
 		{
-			glassTargets[i]->SetPosition(sin(totalTime * 1.6f + (2 * (i+4))) * 2, glassTargets[i]->GetPosition().y, glassTargets[i]->GetPosition().z);
-			if (glassTargets[i]->GetChanged()) { glassTargets[i]->CalculateWorldMatrix(); }
+			target.proxy = sceneTree.CreateProxy(box, entity);
+			return;
 		}
+		XMFLOAT4X4 now = object.object->GetWorldMatrix();
+		XMFLOAT4X4 before = object.object->GetPreviousWorldMatrix();
+		XMFLOAT3 displacement(now._14 - before._14, now._24 - before._24, now._34 - before._34); // Stored transposed
+		sceneTree.MoveProxy(target.proxy, box, displacement);
+	});
+	world.Each<TargetComponent>(0, EntityWorld::MaskOf<ActiveTag>(), [&](int entity, TargetComponent& target)
+	{
+		if (target.proxy != -1)
+		{
+			sceneTree.DestroyProxy(target.proxy);
+			target.proxy = -1;
+		}
+	});
+}
+
+void Game::KnockDown(int entity, XMFLOAT3 impulse, XMFLOAT3 point)
+{
+	EntityWorld& world = GameObject::GetEntityWorld();
+	TargetComponent* target = world.Get<TargetComponent>(entity);
+	if (target->proxy != -1)
+	{
+		sceneTree.DestroyProxy(target->proxy);
 	}
+	world.Remove<TargetComponent>(entity); // No more sliding, or being shot at
+	ColliderComponent* collider = world.Get<ColliderComponent>(entity);
+	if (collider->proxy != -1)
+	{
+		broadphase->Remove(collider->proxy);
+	}
+	world.Remove<ColliderComponent>(entity);
+
+	// Off the rack where it is now, so the body can own its transform outright
+	GameObject* object = world.Get<ObjectComponent>(entity)->object;
+	XMFLOAT4X4 worldMatrix = object->GetWorldMatrix();
+	XMFLOAT3 position(worldMatrix._14, worldMatrix._24, worldMatrix._34); // Stored transposed
+	float radius = object->GetWorldBounds().sphereRadius;
+	object->SetParent(nullptr);
+	object->SetPosition(position.x, position.y, position.z);
+
+	RigidBodyComponent body = { physics->AddSphere(position, radius, 1.0f, entity) };
+	physics->SetTransform(body.body, position, object->GetRotationQuaternion()); // Turned the way it already was
+	world.Add(entity, body);
+	physics->ApplyImpulse(body.body, impulse, point);
+}
 
+void Game::Shatter(int entity, XMFLOAT3 point, XMFLOAT3 bulletVelocity, float deltaTime)
+{
+	EntityWorld& world = GameObject::GetEntityWorld();
+	GameObject* object = world.Get<ObjectComponent>(entity)->object;
+	ShatterComponent* shatter = world.Get<ShatterComponent>(entity);
+	if (shatter != nullptr)
+	{
+		// Only right after this step's world matrix update, before that the two matrices are the same
+		XMFLOAT3 velocity = GameObject::GetTransformStore().GetWorldVelocity(world.Get<TransformComponent>(entity)->handle, deltaTime);
+		shards->Shatter(shatter->pattern, object->GetWorldMatrix(), velocity, point, bulletVelocity);
+	}
+	object->SetActive(false);
+}
 
-	camera->Update();
+void Game::UpdateBroadphase(float deltaTime)
+{
+	EntityWorld& world = GameObject::GetEntityWorld();
+	world.Each<ObjectComponent, ColliderComponent, VelocityComponent>(EntityWorld::MaskOf<ActiveTag>(), 0, [&](int entity, ObjectComponent& object, ColliderComponent& collider, VelocityComponent& velocity)
+	{
+		// The box covers where the sphere was at the start of the step as well as where it is now
+		MeshBounds bounds = object.object->GetWorldBounds();
+		XMFLOAT3 sweep(velocity.value.x * deltaTime, velocity.value.y * deltaTime, velocity.value.z * deltaTime);
+		XMFLOAT3 start(bounds.sphereCenter.x - sweep.x, bounds.sphereCenter.y - sweep.y, bounds.sphereCenter.z - sweep.z);
+		Aabb box = Aabb::Union(Aabb::FromSphere(start, bounds.sphereRadius), Aabb::FromSphere(bounds.sphereCenter, bounds.sphereRadius));
+		if (collider.proxy == -1)
+		{
+			collider.proxy = broadphase->Add(box, entity, collider.layers, collider.mask);
+		}
+		else
+		{
+			broadphase->Move(collider.proxy, box);
+		}
+		if ((int)colliderSpheres.size() <= collider.proxy)
+		{
+			colliderSpheres.resize(collider.proxy + 1);
+			colliderSweeps.resize(collider.proxy + 1);
+		}
+		colliderSpheres[collider.proxy] = XMFLOAT4(bounds.sphereCenter.x, bounds.sphereCenter.y, bounds.sphereCenter.z, bounds.sphereRadius);
+		colliderSweeps[collider.proxy] = sweep;
+	});
+	world.Each<ColliderComponent>(0, EntityWorld::MaskOf<ActiveTag>(), [&](int entity, ColliderComponent& collider)
+	{
+		if (collider.proxy != -1)
+		{
+			broadphase->Remove(collider.proxy);
+			collider.proxy = -1;
+		}
+	});
 }
 
-void Game::RenderToTexture()
+int Game::RayCastTargets(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, MeshRayHit* impact)
+{
+	EntityWorld& world = GameObject::GetEntityWorld();
+	RayHit hit;
+	MeshRayHit closest; // The tree keeps every hit within reach, so the last one kept is the closest
+	bool found = sceneTree.RayCastClosest(origin, direction, maxDistance, [&](int proxy, float reach)
+	{
+		GameObject* object = world.Get<ObjectComponent>(sceneTree.GetUserData(proxy))->object;
+		const MeshBVH* triangles = object->GetMesh()->GetTriangleBvh();
+		if (triangles != nullptr)
+		{
+			// The tree's box only says the ray is near, the triangles say where it lands
+			XMFLOAT4X4 transform = object->GetWorldMatrix();
+			XMStoreFloat4x4(&transform, XMMatrixTranspose(XMLoadFloat4x4(&transform))); // Stored transposed for the shader
+			MeshRayHit meshHit;
+			if (!triangles->RayCastInstance(origin, direction, reach, transform, meshHit))
+			{
+				return -1.0f;
+			}
+			closest = meshHit;
+			return meshHit.distance;
+		}
+
+		MeshBounds bounds = object->GetWorldBounds();
+		float distance = DynamicBVH::IntersectRaySphere(origin, direction, bounds.sphereCenter, bounds.sphereRadius);
+		if (distance >= 0.0f && distance <= reach)
+		{
+			closest.distance = distance;
+			closest.triangle = -1;
+			closest.point = XMFLOAT3(origin.x + direction.x * distance, origin.y + direction.y * distance, origin.z + direction.z * distance);
+			XMStoreFloat3(&closest.normal, XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&closest.point), XMLoadFloat3(&bounds.sphereCenter))));
+			closest.uv = XMFLOAT2(0.0f, 0.0f);
+		}
+		return distance;
+	}, hit);
+	if (!found)
+	{
+		return -1;
+	}
+	if (impact != nullptr)
+	{
+		*impact = closest;
+	}
+	return sceneTree.GetUserData(hit.proxy);
+}
+
+void Game::GatherSpheres(const std::vector<DrawItem>& items, SphereBatch& spheres)
+{
+	spheres.Clear();
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixTranspose(XMLoadFloat4x4(&items[i].drawnMatrix))); // Stored transposed for the shader
+		MeshBounds bounds = items[i].object->GetMesh()->GetBounds().Transform(world);
+		spheres.Add(bounds.sphereCenter, bounds.sphereRadius);
+	}
+}
+
+void Game::RenderToTexture(FrameSnapshot& frame)
 {
 	context->OMSetRenderTargets(1, &renderTargetView, depthStencilView);
 	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
@@ -560,8 +939,8 @@ void Game::RenderToTexture()
 	//  - This is actually a complex process of copying data to a local buffer
 	//    and then copying that entire buffer to the GPU.  
 	//  - The "SimpleShader" class handles all of that for you.
-	vertexShader->SetMatrix4x4("view", camera->GetViewMatrix());
-	vertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+	vertexShader->SetMatrix4x4("view", frame.camera.GetViewMatrix());
+	vertexShader->SetMatrix4x4("projection", frame.camera.GetProjectionMatrix());
 	// We need to pass the shadow "creation" matrices in here
 	// so we can reconstruct the shadow map position
 	vertexShader->SetMatrix4x4("shadowView", shadowViewMatrix);
@@ -576,25 +955,23 @@ void Game::RenderToTexture()
 	//wallMat->shaderResourceView = shadowSRV;
 
 
-	//has to be updated with the amount of targets added
-	for (int i = 0; i < 3; i++)
+	for (size_t i = 0; i < visibleTargets.size(); i++)
 	{
-		if (dynamic_cast<target*>(targets[i]->scripts[0])->isActive)
-		{
-			targets[i]->Draw(context);
-		}
+		DrawItem& item = frame.targets[visibleTargets[i]];
+		item.object->Draw(context, item.drawnMatrix, item.lod, &frame.camera);
 	}
 
-	for (int i = 0; i < 5; i++)
+	for (size_t i = 0; i < visibleWalls.size(); i++)
 	{
-		walls[i]->Draw(context);
+		DrawItem& item = frame.walls[visibleWalls[i]];
+		item.object->Draw(context, item.drawnMatrix, item.lod, nullptr);
 	}
 
 	context->OMSetRenderTargets(1, &backBufferRTV, depthStencilView);
 
 }
 
-void Game::RenderShadowMap()
+void Game::RenderShadowMap(FrameSnapshot& frame)
 {
 	// Change which depth buffer I'm rendering into
 	context->OMSetRenderTargets(0, 0, shadowDSV);
@@ -621,30 +998,21 @@ void Game::RenderShadowMap()
 	// Turn OFF the pixel shader
 	context->PSSetShader(0, 0, 0);
 
-	// Render all of the entities in the scene
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-
-	for (int i = 0; i < 3; i++)
+	// Render all of the active targets in the scene, other than glass
+	for (size_t i = 0; i < shadowCasters.size(); i++)
 	{
-		if (dynamic_cast<target*>(targets[i]->scripts[0])->isActive)
-		{
-			// Grab the data from the first entity's mesh
-			GameObject* ge = targets[i];
-			ID3D11Buffer* vb = ge->GetMesh()->GetVertexBuffer();
-			ID3D11Buffer* ib = ge->GetMesh()->GetIndexBuffer();
+		// Grab the data from the entity's mesh
+		GameObject* ge = frame.targets[shadowCasters[i]].object;
 
-			// Set buffers in the input assembler
-			context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
-			context->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
+		// Set buffers in the input assembler, skipped when they're already the shared pool
+		ge->GetMesh()->Bind(context);
 
-			// Use the SHADOW VERT SHADER
-			shadowVS->SetMatrix4x4("world", ge->GetWorldMatrix());
-			shadowVS->CopyAllBufferData();
+		// Use the SHADOW VERT SHADER
+		shadowVS->SetMatrix4x4("world", frame.targets[shadowCasters[i]].drawnMatrix);
+		shadowVS->CopyAllBufferData();
 
-			// Finally do the actual drawing
-			context->DrawIndexed(ge->GetMesh()->GetIndexCount(), 0, 0);
-		}
+		// Finally do the actual drawing
+		context->DrawIndexed(ge->GetMesh()->GetIndexCount(), ge->GetMesh()->GetFirstIndex(), ge->GetMesh()->GetBaseVertex());
 	}
 
 	// Now that shadow rendering is done, put back all
@@ -679,6 +1047,15 @@ bool Game::NoBullets()
 	return true;
 }
 
+int Game::ChooseLod(GameObject* object)
+{
+	XMFLOAT3 scale = object->GetScale();
+	float largestScale = max(scale.x, max(scale.y, scale.z)); // Object space error grows with the scale
+	XMFLOAT4X4 world = object->GetWorldMatrix();
+	XMFLOAT3 position(world._14, world._24, world._34); // Stored transposed, and the position alone is relative to any parent
+	return object->GetMesh()->SelectLod(camera->GetPixelsPerUnit(position) * largestScale);
+}
+
 void Game::Fire() // Fires a bullet
 {
 	if (NoBullets())
@@ -698,9 +1075,20 @@ void Game::Fire() // Fires a bullet
 	XMFLOAT3 dir = camera->GetDirection();
 	bullets[currentBullet]->SetPosition(pos.x, pos.y, pos.z); // Set the position and direction of the bullet, then fire it
 	bullets[currentBullet]->SetVelocity(dir.x * 20, dir.y * 20, dir.z * 20);
-	dynamic_cast<Bullet*>(bullets[currentBullet]->scripts[0])->isActive = true;
+	bullets[currentBullet]->SetActive(true);
+	bullets[currentBullet]->SkipInterpolation(); // Appears at the muzzle, rather than flying in from where it last stopped
 	fireCD = 1.0f;
-	std::cout << "Firing: " << currentBullet << std::endl;
+
+	// Straight out from the cursor is where the bullet will go, so this is what it's lined up on
+	MeshRayHit impact;
+	if (RayCastTargets(pos, dir, 30.0f, &impact) != -1)
+	{
+		std::cout << "Firing: " << currentBullet << " (on target, " << impact.distance << " away at " << impact.point.x << ", " << impact.point.y << ", " << impact.point.z << ")" << std::endl;
+	}
+	else
+	{
+		std::cout << "Firing: " << currentBullet << std::endl;
+	}
 }
 
 // --------------------------------------------------------
@@ -708,12 +1096,54 @@ void Game::Fire() // Fires a bullet
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	// The newest frame Update has finished, or the last one drawn again if it hasn't finished another
+	frames.Acquire();
+	FrameSnapshot& frame = frames.GetReadSlot();
+
+	// Drawn one step behind, so there's always a step on either side to interpolate between
+	float t = (totalTime - frame.time) / fixedTimeStep;
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	Interpolate(frame.targets, t);
+	Interpolate(frame.walls, t);
+	Interpolate(frame.bullets, t);
+	Interpolate(frame.glass, t);
+
+	// Only what each pass can see gets drawn
+	GatherSpheres(frame.targets, targetSpheres);
+	GatherSpheres(frame.walls, wallSpheres);
+	GatherSpheres(frame.bullets, bulletSpheres);
+	GatherSpheres(frame.glass, glassSpheres);
+	Frustum view = frame.camera.GetFrustum();
+	view.CullSpheres(targetSpheres, visibleTargets);
+	view.CullSpheres(wallSpheres, visibleWalls);
+	view.CullSpheres(bulletSpheres, visibleBullets);
+	view.CullSpheres(glassSpheres, visibleGlass);
+	shadowFrustum.CullSpheres(targetSpheres, shadowCasters);
+
+	// Then whatever is entirely behind the walls. Shadow casters don't need to be seen to cast.
+	occlusion->Begin(frame.camera.GetViewProjectionMatrix());
+	for (size_t i = 0; i < visibleWalls.size(); i++)
+	{
+		DrawItem& item = frame.walls[visibleWalls[i]];
+		Mesh* mesh = item.object->GetMesh();
+		if (mesh->GetOccluderPositions() != nullptr)
+		{
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixTranspose(XMLoadFloat4x4(&item.drawnMatrix))); // Stored transposed for the shader
+			occlusion->RenderOccluder(mesh->GetOccluderPositions(), mesh->GetOccluderVertexCount(), mesh->GetOccluderIndices(), mesh->GetIndexCount(), world);
+		}
+	}
+	occlusion->Finish();
+	occlusion->CullSpheres(targetSpheres, visibleTargets);
+	occlusion->CullSpheres(bulletSpheres, visibleBullets);
+	occlusion->CullSpheres(glassSpheres, visibleGlass);
 
 	// Before we do anything the user can see, render
 	// the shadow map from the light's point of view
-	RenderShadowMap();
+	GeometryPool::InvalidateBinding(); // Last frame's UI drawing left its own buffers bound
+	RenderShadowMap(frame);
 
-	RenderToTexture();
+	RenderToTexture(frame);
 	// Background color (Cornflower Blue in this case) for clearing
 	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
 
@@ -736,8 +1166,8 @@ void Game::Draw(float deltaTime, float totalTime)
 	//  - This is actually a complex process of copying data to a local buffer
 	//    and then copying that entire buffer to the GPU.  
 	//  - The "SimpleShader" class handles all of that for you.
-	vertexShader->SetMatrix4x4("view", camera->GetViewMatrix());
-	vertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+	vertexShader->SetMatrix4x4("view", frame.camera.GetViewMatrix());
+	vertexShader->SetMatrix4x4("projection", frame.camera.GetProjectionMatrix());
 	// We need to pass the shadow "creation" matrices in here
 	// so we can reconstruct the shadow map position
 	vertexShader->SetMatrix4x4("shadowView", shadowViewMatrix);
@@ -752,26 +1182,22 @@ void Game::Draw(float deltaTime, float totalTime)
 	//wallMat->shaderResourceView = renderToTextureSRV;
 
 
-	//has to be updated with the amount of targets added
-	for (int i = 0; i < 3; i++)
+	for (size_t i = 0; i < visibleTargets.size(); i++)
 	{
-		if (dynamic_cast<target*>(targets[i]->scripts[0])->isActive)
-		{
-			targets[i]->Draw(context);
-		}
+		DrawItem& item = frame.targets[visibleTargets[i]];
+		item.object->Draw(context, item.drawnMatrix, item.lod, &frame.camera);
 	}
 
-	for (int i = 0; i < 5; i++)
+	for (size_t i = 0; i < visibleWalls.size(); i++)
 	{
-		walls[i]->Draw(context);
+		DrawItem& item = frame.walls[visibleWalls[i]];
+		item.object->Draw(context, item.drawnMatrix, item.lod, nullptr);
 	}
 
-	for (int i = 0; i < 20; i++) // Draw active bullets
+	for (size_t i = 0; i < visibleBullets.size(); i++) // Draw active bullets
 	{
-		if (dynamic_cast<Bullet*>(bullets[i]->scripts[0])->isActive)
-		{
-			bullets[i]->Draw(context);
-		}
+		DrawItem& item = frame.bullets[visibleBullets[i]];
+		item.object->Draw(context, item.drawnMatrix, item.lod, &frame.camera);
 	}
 	//wallMat->shaderResourceView = shaderResourceView2;
 
@@ -779,7 +1205,7 @@ void Game::Draw(float deltaTime, float totalTime)
 	float blend[4] = { 1,1,1,1 };
 	context->OMSetBlendState(particleBlendState, blend, 0xffffffff);
 	context->OMSetDepthStencilState(particleDepthState, 0);
-	emitter->Draw(context, camera);
+	emitter->Draw(context, &frame.camera, frame.particles);
 	context->OMSetBlendState(0, blend, 0xffffffff);
 	context->OMSetDepthStencilState(0, 0);
 	
@@ -788,21 +1214,20 @@ void Game::Draw(float deltaTime, float totalTime)
 	glassVertexShader->SetShader();
 	glassPixelShader->SetShader();
 
-	glassVertexShader->SetMatrix4x4("view", camera->GetViewMatrix());
-	glassVertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+	glassVertexShader->SetMatrix4x4("view", frame.camera.GetViewMatrix());
+	glassVertexShader->SetMatrix4x4("projection", frame.camera.GetProjectionMatrix());
 	glassVertexShader->CopyBufferData("cameraData");
 
 	glassPixelShader->SetData("light1", &light1, 44);
 	glassPixelShader->SetData("light2", &light2, 44);
 	glassPixelShader->CopyBufferData("lightData");
 
-	for (int i = 0; i < 2; i++)
+	for (size_t i = 0; i < visibleGlass.size(); i++)
 	{
-		if (dynamic_cast<target*>(glassTargets[i]->scripts[0])->isActive)
-		{
-			glassTargets[i]->Draw(context);
-		}
+		DrawItem& item = frame.glass[visibleGlass[i]];
+		static_cast<Glass*>(item.object)->Draw(context, item.drawnMatrix); // Only Glass adds the GlassTag
 	}
+	shardRenderer->Draw(context, &frame.camera, frame.shards, t); // Uses the lights just set on the glass pixel shader
 
 	// Check out the texture that is stored in the font
 	ID3D11ShaderResourceView* fontTexture;
@@ -822,7 +1247,7 @@ void Game::Draw(float deltaTime, float totalTime)
 		XMFLOAT2(0, this->height - 100));
 	font->DrawString(
 		spriteBatch,
-		(std::to_wstring(score)).c_str(),
+		(std::to_wstring(frame.score)).c_str(),
 		XMFLOAT2(80, this->height - 50));
 
 	spriteBatch->End();
@@ -897,8 +1322,8 @@ void Game::OnMouseMove(WPARAM buttonState, int x, int y)
 	pX = (pX / this->width) * 7 - 3.5;
 	pY = -((pY / this->height) * 5 - 2.5);
 
-	mousePos.x = pX;
-	mousePos.y = pY;
+	cursorX = pX; // Update copies it into mousePos
+	cursorY = pY;
 
 	/*if (prevMousePos.x != NULL)
 	{
@@ -14,6 +14,17 @@
 #include "SpriteBatch.h"
 #include "SpriteFont.h"
 #include "Emitter.h"
+#include "JobSystem.h"
+#include "TripleBuffer.h"
+#include "FrameSnapshot.h"
+#include "DynamicBVH.h"
+#include "SpatialHashGrid.h"
+#include "SphereNarrowphase.h"
+#include "OcclusionCuller.h"
+#include "PhysicsWorld.h"
+#include "ShardPool.h"
+#include "ShardRenderer.h"
+#include <atomic>
 
 class Game
 	: public DXCore
@@ -47,6 +58,46 @@ private:
 	ID3D11BlendState* particleBlendState;
 	Emitter* emitter;
 
+	// Broken glass
+	SimpleVertexShader* shardVertexShader;
+	ShardPool* shards;
+	ShardRenderer* shardRenderer;
+
+	JobSystem* jobs; // Worker threads for the per-object and per-particle loops
+
+	// Handed from Update to Draw, which can be on different threads
+	TripleBuffer<FrameSnapshot> frames;
+	unsigned int simulatedFrames;
+	void PublishFrame(float time); // Copies what Draw needs into the next snapshot
+	void Interpolate(std::vector<DrawItem>& items, float t); // Fills in drawnMatrix
+
+	// Culling, only touched by Draw. Each visible list indexes the snapshot's list of the same name
+	Frustum shadowFrustum; // The light's box, it never moves
+	SphereBatch targetSpheres, wallSpheres, bulletSpheres, glassSpheres;
+	std::vector<int> visibleTargets, visibleWalls, visibleBullets, visibleGlass, shadowCasters;
+	void GatherSpheres(const std::vector<DrawItem>& items, SphereBatch& spheres); // World space bounds at the drawn matrices
+	OcclusionCuller* occlusion; // The walls, drawn small on the CPU to hide what's behind them
+
+	// Every active target, by the box around its bounding sphere, only touched by Update
+	DynamicBVH sceneTree;
+	void UpdateSceneTree(); // Moves active targets' proxies to where they are now, takes inactive ones out
+	int RayCastTargets(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, MeshRayHit* impact); // Entity of the closest active target the ray hits, or -1. Exact on meshes with a BVH, bounding spheres otherwise
+
+	// Every active collider, bullets and targets, for finding which ones touch
+	SpatialHashGrid* broadphase;
+	void UpdateBroadphase(float deltaTime); // Adds and moves active colliders' proxies to cover this step's path, takes inactive ones out
+	std::vector<DirectX::XMFLOAT4> colliderSpheres; // World space bounds by broadphase proxy, radius in w, from the last UpdateBroadphase
+	std::vector<DirectX::XMFLOAT3> colliderSweeps; // How far each proxy's sphere moved over that step
+	SweptSphereBatch pairBullets; // Each broadphase pair's bullet over the step and target where it is, for the batched narrow phase
+	SphereBatch pairTargets;
+	std::vector<int> pairHits;
+	std::vector<float> pairTimes;
+
+	// Knocked down targets tumbling onto the floor, and the floor and walls they land against
+	PhysicsWorld* physics;
+	void KnockDown(int entity, XMFLOAT3 impulse, XMFLOAT3 point); // Takes a target off the rack and out of the target systems and gives it a body, hit with impulse at point
+	void Shatter(int entity, XMFLOAT3 point, XMFLOAT3 bulletVelocity, float deltaTime); // Swaps a glass target for its shards, flying off from point. After the world matrix update, so they carry on its motion
+
 	// Initialization helper methods - feel free to customize, combine, etc.
 	void LoadShaders();
 	void LoadGeometry();
@@ -55,6 +106,7 @@ private:
 	Mesh* mesh1;
 	Mesh* mesh2;
 	Mesh* mesh3;
+	GeometryPool* geometryPool; // Shared buffers every mesh above is sub-allocated from
 
 	//for UI
 	DirectX::SpriteBatch* spriteBatch;
@@ -81,6 +133,7 @@ private:
 	GameObject* targets[3];
 	GameObject* walls[5];
 	Glass* glassTargets[2];
+	GameObject* targetRack; // Parent of every target, never drawn, moving it moves the whole rack
 
 	// The scene camera
 	Camera* camera;
@@ -88,8 +141,8 @@ private:
 	DirectionalLight light1;
 	DirectionalLight light2;
 
-	void RenderShadowMap();
-	void RenderToTexture();
+	void RenderShadowMap(FrameSnapshot& frame);
+	void RenderToTexture(FrameSnapshot& frame);
 
 	// Shadow stuff ---------------------------
 	int shadowMapSize;
@@ -121,8 +174,14 @@ private:
 
 	XMFLOAT3 mousePos;
 
+	// Written by the window messages, read at the start of Update
+	std::atomic<float> cursorX;
+	std::atomic<float> cursorY;
+	std::atomic<unsigned long long> pendingSize; // Width << 32 | height, 0 once the camera has it
+
 	void ReloadBullet(int i);
 	bool NoBullets(); // Returns a bool of whether there are any available bullets, ideally this never returns false
 	void Fire(); // Fires a bullet
+	int ChooseLod(GameObject* object); // Picks the mesh LOD for how big the object is on screen
 };
 
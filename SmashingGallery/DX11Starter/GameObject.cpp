@@ -5,13 +5,15 @@ GameObject::GameObject(Mesh* meshPtr, Material* matPtr, std::vector<Script*> pSc
 {
 	mesh = meshPtr;
 	material = matPtr;
-	position = XMFLOAT3(0.0f, 0.0f, 0.0f);
-	XMStoreFloat4(&rotationQuaternion, XMQuaternionIdentity());
-	scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
-	velocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
-	XMMATRIX W = XMMatrixIdentity();
-	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(W));
-	changed = true;
+	transform = GetTransformStore().Add(); // Starts at the identity, marked as changed
+	entity = GetEntityWorld().Create();
+	TransformComponent transformComponent = { transform };
+	VelocityComponent velocity = { XMFLOAT3(0.0f, 0.0f, 0.0f) };
+	ObjectComponent object = { this };
+	GetEntityWorld().Add(entity, transformComponent);
+	GetEntityWorld().Add(entity, velocity);
+	GetEntityWorld().Add(entity, object);
+	GetEntityWorld().Add(entity, ActiveTag());
 	// Initialize collider here
 	scripts = pScripts;
 
@@ -32,78 +34,114 @@ Mesh* GameObject::GetMesh()
 }
 XMFLOAT4X4 GameObject::GetWorldMatrix()
 {
-	return worldMatrix;
+	return GetTransformStore().GetWorldMatrix(transform);
+}
+XMFLOAT4X4 GameObject::GetPreviousWorldMatrix()
+{
+	return GetTransformStore().GetPreviousWorldMatrix(transform);
 }
 XMFLOAT3 GameObject::GetPosition()
 {
-	return position;
+	return GetTransformStore().GetPosition(transform);
 }
 XMFLOAT4 GameObject::GetRotationQuaternion()
 {
-	return rotationQuaternion;
+	return GetTransformStore().GetRotation(transform);
 }
 XMFLOAT3 GameObject::GetScale()
 {
-	return scale;
+	return GetTransformStore().GetScale(transform);
 }
 XMFLOAT3 GameObject::GetVelocity()
 {
-	return velocity;
+	return GetEntityWorld().Get<VelocityComponent>(entity)->value;
+}
+MeshBounds GameObject::GetWorldBounds()
+{
+	if (GetChanged())
+	{
+		CalculateWorldMatrix();
+	}
+	XMFLOAT4X4 world = GetWorldMatrix();
+	XMStoreFloat4x4(&world, XMMatrixTranspose(XMLoadFloat4x4(&world))); // Stored transposed for the shader
+	return mesh->GetBounds().Transform(world);
 }
 bool GameObject::GetChanged()
 {
-	return changed;
+	return GetTransformStore().IsDirty(transform);
+}
+int GameObject::GetEntity()
+{
+	return entity;
+}
+bool GameObject::IsActive()
+{
+	return GetEntityWorld().Has<ActiveTag>(entity);
 }
 
 /*Transform Methods*/
 int GameObject::Translate(float xOffset, float yOffset, float zOffset) // Translate by an amount
 {
+	XMFLOAT3 position = GetPosition();
 	position.x += xOffset;
 	position.y += yOffset;
 	position.z += zOffset;
-	changed = true;
+	GetTransformStore().SetPosition(transform, position);
 	return 1;
 }
 
 int GameObject::Rotate(float xEulerOffset, float yEulerOffset, float zEulerOffset) // Rotate by an amount
 {
+	XMFLOAT4 rotationQuaternion = GetRotationQuaternion();
 	XMStoreFloat4(&rotationQuaternion, XMQuaternionNormalize(XMQuaternionMultiply(XMQuaternionRotationRollPitchYaw(xEulerOffset, yEulerOffset, zEulerOffset), XMLoadFloat4(&rotationQuaternion))));
-	changed = true;
+	GetTransformStore().SetRotation(transform, rotationQuaternion);
 	return 1;
 }
 
 int GameObject::Scale(float xScaleOffset, float yScaleOffset, float zScaleOffset) // Scale by an amount
 {
+	XMFLOAT3 scale = GetScale();
 	scale.x += xScaleOffset;
 	scale.y += yScaleOffset;
 	scale.z += zScaleOffset;
-	changed = true;
+	GetTransformStore().SetScale(transform, scale);
 	return 1;
 }
 
 int GameObject::SetPosition(float x, float y, float z) // Set the position
 {
-	position = XMFLOAT3(x, y, z);
-	changed = true;
+	GetTransformStore().SetPosition(transform, XMFLOAT3(x, y, z));
 	return 1;
 }
 
 int GameObject::SetRotation(float xEuler, float yEuler, float zEuler) // Set the rotation
 {
+	XMFLOAT4 rotationQuaternion;
 	XMStoreFloat4(&rotationQuaternion, XMQuaternionRotationRollPitchYaw(xEuler, yEuler, zEuler));
-	changed = true;
+	GetTransformStore().SetRotation(transform, rotationQuaternion);
 	return 1;
 }
 
 int GameObject::SetScale(float x, float y, float z) // Set the scale
 {
-	scale = XMFLOAT3(x, y, z);
-	changed = true;
+	GetTransformStore().SetScale(transform, XMFLOAT3(x, y, z));
+	return 1;
+}
+
+int GameObject::SetParent(GameObject* parent) // Set the parent
+{
+	return GetTransformStore().SetParent(transform, parent != nullptr ? parent->transform : -1) ? 1 : 0;
+}
+
+int GameObject::SkipInterpolation() // For teleports
+{
+	GetTransformStore().SkipInterpolation(transform);
 	return 1;
 }
 
 int GameObject::SetVelocity(float x, float y, float z) // Set the velocity
 {
+	XMFLOAT3& velocity = GetEntityWorld().Get<VelocityComponent>(entity)->value;
 	velocity.x = x;
 	velocity.y = y;
 	velocity.z = z;
@@ -112,12 +150,26 @@ int GameObject::SetVelocity(float x, float y, float z) // Set the velocity
 
 int GameObject::AddVelocity(float x, float y, float z) // Add to the existing velocity
 {
+	XMFLOAT3& velocity = GetEntityWorld().Get<VelocityComponent>(entity)->value;
 	velocity.x += x;
 	velocity.y += y;
 	velocity.z += z;
 	return 1;
 }
 
+int GameObject::SetActive(bool active) // Set whether it's active
+{
+	if (active)
+	{
+		GetEntityWorld().Add(entity, ActiveTag());
+	}
+	else
+	{
+		GetEntityWorld().Remove<ActiveTag>(entity);
+	}
+	return 1;
+}
+
 void GameObject::Update(float deltaTime)
 {
 	if (scripts.size() > 0) // Call the update for each script each cycle
@@ -128,46 +180,88 @@ void GameObject::Update(float deltaTime)
 		}
 	}
 
+	XMFLOAT3 velocity = GetVelocity();
 	if (velocity.x != 0 || velocity.y != 0 || velocity.z != 0)
 	{
 		Translate(velocity.x*deltaTime, velocity.y*deltaTime, velocity.z*deltaTime);
 	}
 }
 
-int GameObject::Draw(ID3D11DeviceContext* context)
+int GameObject::Draw(ID3D11DeviceContext* context, int lod, Camera* camera)
+{
+	return Draw(context, GetWorldMatrix(), lod, camera);
+}
+
+int GameObject::Draw(ID3D11DeviceContext* context, const XMFLOAT4X4& worldMatrix, int lod, Camera* camera)
 {
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
+	static std::vector<DrawRange> ranges; // Reused by every draw, which all happen on the render thread
+	ranges.clear();
+	if (camera != nullptr && lod == 0 && mesh->GetMeshletCount() > 0)
+	{
+		// Cull in object space, so the world matrix never touches the meshlet bounds.
+		// The whole object was already culled against the view by Game::Draw.
+		XMFLOAT4X4 view = camera->GetViewMatrix();
+		XMFLOAT4X4 projection = camera->GetProjectionMatrix();
+		XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&worldMatrix)); // Stored transposed for the shader
+		XMFLOAT4X4 worldViewProjection;
+		XMStoreFloat4x4(&worldViewProjection, world * XMMatrixTranspose(XMLoadFloat4x4(&view)) * XMMatrixTranspose(XMLoadFloat4x4(&projection)));
+		Frustum frustum(worldViewProjection);
+		XMFLOAT3 cameraPosition = camera->GetPosition();
+		XMStoreFloat3(&cameraPosition, XMVector3Transform(XMLoadFloat3(&cameraPosition), XMMatrixInverse(nullptr, world)));
+		if (MeshletCuller::Cull(mesh->GetMeshlets(), mesh->GetMeshletCount(), frustum, cameraPosition, ranges) == 0)
+		{
+			return 1;
+		}
+	}
+	if (ranges.empty())
+	{
+		MeshLod level = mesh->GetLod(lod);
+		DrawRange whole = { level.indexOffset, level.indexCount };
+		ranges.push_back(whole);
+	}
+
 	material->GetVertexShader()->SetMatrix4x4("world", worldMatrix);
+	if (mesh->IsPacked())
+	{
+		material->GetVertexShader()->SetFloat3("positionOffset", mesh->GetPositionOffset());
+		material->GetVertexShader()->SetFloat3("positionScale", mesh->GetPositionScale());
+	}
 	material->GetVertexShader()->CopyBufferData("perObjectData");
 	material->GetPixelShader()->SetSamplerState("basicSampler", material->GetSamplerState());
 	material->GetPixelShader()->SetShaderResourceView("diffuseTexture", material->GetShaderResourceView());
 	material->GetPixelShader()->SetShaderResourceView("normalTexture", material->GetNormalShaderResourceView());
-	ID3D11Buffer* vertBuff = mesh->GetVertexBuffer(); // Set the second object
-	context->IASetVertexBuffers(0, 1, &vertBuff, &stride, &offset);
-	context->IASetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
-
-	context->DrawIndexed(
-		mesh->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
-		0);    // Offset to add to each index when looking up vertices
+	mesh->Bind(context); // Pooled meshes only bind when the last draw used something else
+
+	int firstIndex = mesh->GetFirstIndex();
+	int baseVertex = mesh->GetBaseVertex();
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		context->DrawIndexed(
+			ranges[i].indexCount,     // The number of indices to use (we could draw a subset if we wanted)
+			firstIndex + ranges[i].indexOffset,     // Offset to the first index we want to use
+			baseVertex);    // Offset to add to each index when looking up vertices
+	}
 	return 1;
 }
 
-int GameObject::CalculateWorldMatrix() // Recalculates the world matrix and spits out the new one (also sets the stored one)
+int GameObject::CalculateWorldMatrix() // Recalculates the world matrix (sets the stored one)
 {
-	XMMATRIX world = XMMatrixScaling(scale.x, scale.y, scale.z) *
-		XMMatrixRotationQuaternion(XMLoadFloat4(&rotationQuaternion)) *
-		XMMatrixTranslation(position.x, position.y, position.z);
-	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(world));
-	changed = false;
-		/*std::cout << "[" << worldMatrix(0, 0) << ", " << worldMatrix(0, 1) << ", " << worldMatrix(0, 2) << ", " << worldMatrix(0, 3) << "]" << std::endl;
-		std::cout << "[" << worldMatrix(1, 0) << ", " << worldMatrix(1, 1) << ", " << worldMatrix(1, 2) << ", " << worldMatrix(1, 3) << "]" << std::endl;
-		std::cout << "[" << worldMatrix(2, 0) << ", " << worldMatrix(2, 1) << ", " << worldMatrix(2, 2) << ", " << worldMatrix(2, 3) << "]" << std::endl;
-		std::cout << "[" << worldMatrix(3, 0) << ", " << worldMatrix(3, 1) << ", " << worldMatrix(3, 2) << ", " << worldMatrix(3, 3) << "]" << std::endl;*/
+	GetTransformStore().UpdateWorldMatrix(transform);
 	return 1;
 }
 
+TransformStore& GameObject::GetTransformStore()
+{
+	static TransformStore store;
+	return store;
+}
+
+EntityWorld& GameObject::GetEntityWorld()
+{
+	static EntityWorld world;
+	return world;
+}
+
 GameObject::~GameObject()
 {
 	mesh = NULL; // Remove the pointer
@@ -176,4 +270,6 @@ GameObject::~GameObject()
 	{
 		delete s;
 	}
+	GetTransformStore().Remove(transform);
+	GetEntityWorld().Destroy(entity);
 }
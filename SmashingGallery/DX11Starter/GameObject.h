@@ -6,10 +6,22 @@
 #include <DirectXMath.h>
 #include "Collider.h"
 #include "Script.h"
+#include "Camera.h"
+#include "TransformStore.h"
+#include "EntityWorld.h"
+#include "Components.h"
 #include <vector>
 
 using namespace DirectX;
 
+// --------------------------------------------------------
+// A drawable object with scripts
+//
+// Also a facade over the entity it owns in the shared
+// EntityWorld, which holds its transform handle, velocity and
+// whether it's active. Hot loops should query the world for
+// those instead of going through GameObjects.
+// --------------------------------------------------------
 class GameObject
 {
 public:
@@ -19,12 +31,16 @@ public:
 	/*Getters*/
 	Mesh* GetMesh();
 	XMFLOAT4X4 GetWorldMatrix();
+	XMFLOAT4X4 GetPreviousWorldMatrix(); // From the simulation step before, for interpolating
 	XMFLOAT3 GetPosition();
 	XMFLOAT4 GetRotationQuaternion();
 	XMFLOAT3 GetScale();
 	XMFLOAT3 GetVelocity();
+	MeshBounds GetWorldBounds(); // The mesh's bounds moved by the world matrix, updating it first if needed
 
 	bool GetChanged();
+	int GetEntity();
+	bool IsActive();
 	
 	/*Transform Methods*/
 	int Translate(float xOffset, float yOffset, float zOffset); // Translate by an amount
@@ -35,28 +51,32 @@ public:
 	int SetRotation(float xEuler, float yEuler, float zEuler); // Set the rotation
 	int SetScale(float x, float y, float z); // Set the scale
 
+	int SetParent(GameObject* parent); // The transform becomes relative to the parent's, nullptr detaches. 0 if it would make a loop
+	int SkipInterpolation(); // Drawn exactly where it ends up this step, instead of sliding there from where it was
+
 	int SetVelocity(float x, float y, float z); // Set the velocity
 	int AddVelocity(float x, float y, float z); // Add to the existing velocity
+	int SetActive(bool active); // Adds or removes the ActiveTag
 
 	/*Components*/
 	Collider collider;
 	std::vector<Script*> scripts;
 
 	void Update(float deltaTime);
-	int Draw(ID3D11DeviceContext* context);
-	int CalculateWorldMatrix(); // Recalculates the world matrix
+	int Draw(ID3D11DeviceContext* context, int lod = 0, Camera* camera = nullptr); // With a camera, meshlets that can't be seen are skipped. Cull the whole object first
+	int Draw(ID3D11DeviceContext* context, const XMFLOAT4X4& worldMatrix, int lod, Camera* camera); // Drawn where worldMatrix says instead of the live transform
+	int CalculateWorldMatrix(); // Recalculates just this world matrix, prefer one UpdateWorldMatrices on the store per frame
+
+	static TransformStore& GetTransformStore(); // Shared by every GameObject
+	static EntityWorld& GetEntityWorld();
 
 
 
 protected:
 
 	/*Transform Vars*/
-	XMFLOAT4X4 worldMatrix; // The current transform, calculated using pos, rot, and sca
-	XMFLOAT3 position;
-	XMFLOAT4 rotationQuaternion;
-	XMFLOAT3 scale;
-	XMFLOAT3 velocity;
-	bool changed; // Whether a transform parameter has been modified this frame
+	int transform; // Handle into the TransformStore holding pos, rot, sca and the world matrix
+	int entity; // Holds the velocity and tags
 
 	/*Rendering Vars*/
 	Mesh* mesh;
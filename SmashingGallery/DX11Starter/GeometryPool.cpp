@@ -0,0 +1,237 @@
+#include "GeometryPool.h"
+
+GeometryPool* GeometryPool::boundPool = nullptr;
+
+GeometryPool::GeometryPool(ID3D11Device* device, UINT vertexStride, DXGI_FORMAT indexFormat, int vertexCapacity, int indexCapacity)
+	: vertexAllocator(vertexCapacity), indexAllocator(indexCapacity)
+{
+	this->device = device;
+	this->vertexStride = vertexStride;
+	this->indexFormat = indexFormat;
+	indexStride = indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+	// DEFAULT rather than IMMUTABLE, since meshes are copied in after creation
+	vertexBuffer = CreateBuffer(D3D11_BIND_VERTEX_BUFFER, vertexStride * vertexCapacity);
+	indexBuffer = CreateBuffer(D3D11_BIND_INDEX_BUFFER, indexStride * indexCapacity);
+}
+
+GeometryPool::~GeometryPool()
+{
+	if (boundPool == this) boundPool = nullptr;
+	if (vertexBuffer) vertexBuffer->Release();
+	if (indexBuffer) indexBuffer->Release();
+}
+
+int GeometryPool::Add(const void* vertices, int vertexCount, const void* indices, int indexCount)
+{
+	if (vertexCount <= 0 || indexCount <= 0 || vertexBuffer == nullptr || indexBuffer == nullptr || !Reserve(vertexCount, indexCount))
+	{
+		return -1;
+	}
+
+	Entry entry;
+	entry.vertexBlock = vertexAllocator.Allocate(vertexCount);
+	entry.indexBlock = indexAllocator.Allocate(indexCount);
+	entry.live = true;
+
+	ID3D11DeviceContext* context;
+	device->GetImmediateContext(&context);
+	D3D11_BOX box = { 0, 0, 0, 0, 1, 1 };
+	box.left = vertexAllocator.GetOffset(entry.vertexBlock) * vertexStride;
+	box.right = box.left + vertexCount * vertexStride;
+	context->UpdateSubresource(vertexBuffer, 0, &box, vertices, 0, 0);
+	box.left = indexAllocator.GetOffset(entry.indexBlock) * indexStride;
+	box.right = box.left + indexCount * indexStride;
+	context->UpdateSubresource(indexBuffer, 0, &box, indices, 0, 0);
+	context->Release();
+
+	// Reuse a dead entry so handles stay small
+	for (int i = 0; i < (int)entries.size(); i++)
+	{
+		if (!entries[i].live)
+		{
+			entries[i] = entry;
+			return i;
+		}
+	}
+	entries.push_back(entry);
+	return (int)entries.size() - 1;
+}
+
+void GeometryPool::Remove(int handle)
+{
+	if (handle < 0 || handle >= (int)entries.size() || !entries[handle].live)
+	{
+		return;
+	}
+	vertexAllocator.Free(entries[handle].vertexBlock);
+	indexAllocator.Free(entries[handle].indexBlock);
+	entries[handle].live = false;
+}
+
+GeometryRange GeometryPool::GetRange(int handle)
+{
+	const Entry& entry = entries[handle];
+	GeometryRange range;
+	range.baseVertex = vertexAllocator.GetOffset(entry.vertexBlock);
+	range.firstIndex = indexAllocator.GetOffset(entry.indexBlock);
+	range.vertexCount = vertexAllocator.GetSize(entry.vertexBlock);
+	range.indexCount = indexAllocator.GetSize(entry.indexBlock);
+	return range;
+}
+
+void GeometryPool::Defragment()
+{
+	// Copy into fresh buffers, D3D11 doesn't allow overlapping copies within one
+	ID3D11Buffer* newVertexBuffer = CreateBuffer(D3D11_BIND_VERTEX_BUFFER, vertexStride * vertexAllocator.GetCapacity());
+	ID3D11Buffer* newIndexBuffer = CreateBuffer(D3D11_BIND_INDEX_BUFFER, indexStride * indexAllocator.GetCapacity());
+	if (newVertexBuffer == nullptr || newIndexBuffer == nullptr)
+	{
+		if (newVertexBuffer) newVertexBuffer->Release();
+		if (newIndexBuffer) newIndexBuffer->Release();
+		return; // Stay fragmented rather than lose anything
+	}
+
+	ID3D11DeviceContext* context;
+	device->GetImmediateContext(&context);
+	CopyBlocks(context, newVertexBuffer, vertexBuffer, vertexAllocator.Defragment(), vertexStride);
+	CopyBlocks(context, newIndexBuffer, indexBuffer, indexAllocator.Defragment(), indexStride);
+	context->Release();
+
+	vertexBuffer->Release();
+	indexBuffer->Release();
+	vertexBuffer = newVertexBuffer;
+	indexBuffer = newIndexBuffer;
+	if (boundPool == this) boundPool = nullptr;
+}
+
+void GeometryPool::Bind(ID3D11DeviceContext* context)
+{
+	if (boundPool == this)
+	{
+		return;
+	}
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &offset);
+	context->IASetIndexBuffer(indexBuffer, indexFormat, 0);
+	boundPool = this;
+}
+
+void GeometryPool::InvalidateBinding()
+{
+	boundPool = nullptr;
+}
+
+UINT GeometryPool::GetVertexStride()
+{
+	return vertexStride;
+}
+
+DXGI_FORMAT GeometryPool::GetIndexFormat()
+{
+	return indexFormat;
+}
+
+ID3D11Buffer* GeometryPool::GetVertexBuffer()
+{
+	return vertexBuffer;
+}
+
+ID3D11Buffer* GeometryPool::GetIndexBuffer()
+{
+	return indexBuffer;
+}
+
+bool GeometryPool::Reserve(int vertexCount, int indexCount)
+{
+	bool vertexFits = vertexAllocator.GetLargestFree() >= vertexCount;
+	bool indexFits = indexAllocator.GetLargestFree() >= indexCount;
+	if (vertexFits && indexFits)
+	{
+		return true;
+	}
+
+	// Enough space in total, just in pieces
+	if (vertexAllocator.GetCapacity() - vertexAllocator.GetUsed() >= vertexCount &&
+		indexAllocator.GetCapacity() - indexAllocator.GetUsed() >= indexCount)
+	{
+		Defragment();
+		if (vertexAllocator.GetLargestFree() >= vertexCount && indexAllocator.GetLargestFree() >= indexCount)
+		{
+			return true;
+		}
+	}
+
+	// Double whichever is short, or more if one mesh needs it
+	int vertexCapacity = vertexAllocator.GetCapacity();
+	int indexCapacity = indexAllocator.GetCapacity();
+	if (vertexAllocator.GetLargestFree() < vertexCount) vertexCapacity = max(vertexCapacity * 2, vertexAllocator.GetUsed() + vertexCount);
+	if (indexAllocator.GetLargestFree() < indexCount) indexCapacity = max(indexCapacity * 2, indexAllocator.GetUsed() + indexCount);
+	if (!Grow(vertexCapacity, indexCapacity))
+	{
+		return false;
+	}
+	if (vertexAllocator.GetLargestFree() < vertexCount || indexAllocator.GetLargestFree() < indexCount)
+	{
+		Defragment(); // The new space is at the end, the free space before it might not touch it
+	}
+	return vertexAllocator.GetLargestFree() >= vertexCount && indexAllocator.GetLargestFree() >= indexCount;
+}
+
+bool GeometryPool::Grow(int vertexCapacity, int indexCapacity)
+{
+	ID3D11Buffer* newVertexBuffer = CreateBuffer(D3D11_BIND_VERTEX_BUFFER, vertexStride * vertexCapacity);
+	ID3D11Buffer* newIndexBuffer = CreateBuffer(D3D11_BIND_INDEX_BUFFER, indexStride * indexCapacity);
+	if (newVertexBuffer == nullptr || newIndexBuffer == nullptr)
+	{
+		if (newVertexBuffer) newVertexBuffer->Release();
+		if (newIndexBuffer) newIndexBuffer->Release();
+		return false;
+	}
+
+	// Nothing moves, so copy everything that was there
+	ID3D11DeviceContext* context;
+	device->GetImmediateContext(&context);
+	OffsetMove allVertices = { -1, 0, 0, vertexAllocator.GetCapacity() };
+	OffsetMove allIndices = { -1, 0, 0, indexAllocator.GetCapacity() };
+	CopyBlocks(context, newVertexBuffer, vertexBuffer, std::vector<OffsetMove>(1, allVertices), vertexStride);
+	CopyBlocks(context, newIndexBuffer, indexBuffer, std::vector<OffsetMove>(1, allIndices), indexStride);
+	context->Release();
+
+	vertexBuffer->Release();
+	indexBuffer->Release();
+	vertexBuffer = newVertexBuffer;
+	indexBuffer = newIndexBuffer;
+	vertexAllocator.Grow(vertexCapacity);
+	indexAllocator.Grow(indexCapacity);
+	if (boundPool == this) boundPool = nullptr;
+	return true;
+}
+
+ID3D11Buffer* GeometryPool::CreateBuffer(UINT bindFlags, UINT byteWidth)
+{
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = byteWidth;
+	desc.BindFlags = bindFlags;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+
+	ID3D11Buffer* buffer = nullptr;
+	if (byteWidth == 0 || FAILED(device->CreateBuffer(&desc, nullptr, &buffer)))
+	{
+		return nullptr;
+	}
+	return buffer;
+}
+
+void GeometryPool::CopyBlocks(ID3D11DeviceContext* context, ID3D11Buffer* destination, ID3D11Buffer* source, const std::vector<OffsetMove>& moves, UINT stride)
+{
+	for (size_t i = 0; i < moves.size(); i++)
+	{
+		if (moves[i].size <= 0) continue;
+		D3D11_BOX box = { moves[i].from * stride, 0, 0, (moves[i].from + moves[i].size) * stride, 1, 1 };
+		context->CopySubresourceRegion(destination, 0, moves[i].to * stride, 0, 0, source, 0, &box);
+	}
+}
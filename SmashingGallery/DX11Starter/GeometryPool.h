@@ -0,0 +1,72 @@
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+#include "OffsetAllocator.h"
+
+// Where one mesh's data lives inside a GeometryPool
+struct GeometryRange
+{
+	int baseVertex; // BaseVertexLocation for DrawIndexed, the mesh's indices start at 0
+	int firstIndex; // Add to StartIndexLocation
+	int vertexCount;
+	int indexCount;
+};
+
+// --------------------------------------------------------
+// One vertex buffer and one index buffer shared by many meshes
+//
+// Every mesh is a sub-allocation, so drawing any number of them
+// only binds the input assembler once. Space comes from two
+// OffsetAllocators; when neither has room the pool defragments,
+// and only if that isn't enough does it grow the buffers.
+// Both of those copy on the GPU into new buffers, then swap.
+// --------------------------------------------------------
+class GeometryPool
+{
+public:
+	GeometryPool(ID3D11Device* device, UINT vertexStride, DXGI_FORMAT indexFormat, int vertexCapacity, int indexCapacity);
+	~GeometryPool();
+
+	// Copies the data in and returns a handle, or -1 if the buffers couldn't be created.
+	// Indices must already be in the pool's index format.
+	int Add(const void* vertices, int vertexCount, const void* indices, int indexCount);
+	void Remove(int handle);
+	GeometryRange GetRange(int handle); // Changes after Defragment, so look it up at draw time
+
+	void Defragment(); // Packs every mesh to the front of the buffers
+
+	// Binds both buffers, unless this pool is already bound
+	void Bind(ID3D11DeviceContext* context);
+	static void InvalidateBinding(); // Call after anything else sets the vertex or index buffer
+
+	UINT GetVertexStride();
+	DXGI_FORMAT GetIndexFormat();
+	ID3D11Buffer* GetVertexBuffer();
+	ID3D11Buffer* GetIndexBuffer();
+
+private:
+	struct Entry
+	{
+		int vertexBlock; // OffsetAllocator handles
+		int indexBlock;
+		bool live;
+	};
+
+	ID3D11Device* device;
+	ID3D11Buffer* vertexBuffer;
+	ID3D11Buffer* indexBuffer;
+	UINT vertexStride;
+	UINT indexStride;
+	DXGI_FORMAT indexFormat;
+	OffsetAllocator vertexAllocator;
+	OffsetAllocator indexAllocator;
+	std::vector<Entry> entries;
+
+	static GeometryPool* boundPool; // Pool the input assembler was last set to, if nothing has changed it since
+
+	bool Reserve(int vertexCount, int indexCount); // Defragments or grows until both fit
+	bool Grow(int vertexCapacity, int indexCapacity);
+	ID3D11Buffer* CreateBuffer(UINT bindFlags, UINT byteWidth);
+	void CopyBlocks(ID3D11DeviceContext* context, ID3D11Buffer* destination, ID3D11Buffer* source, const std::vector<OffsetMove>& moves, UINT stride);
+};
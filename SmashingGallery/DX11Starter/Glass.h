@@ -12,9 +12,11 @@ public:
 		padding.x = 0.0f;
 		padding.y = 0.0f;
 		padding.z = 0.0f;
+		GetEntityWorld().Add(entity, GlassTag());
 	};
 	~Glass();
 	int Draw(ID3D11DeviceContext* context);
+	int Draw(ID3D11DeviceContext* context, const XMFLOAT4X4& worldMatrix); // Drawn where worldMatrix says instead of the live transform
 private:
 	float refractionScale;
 	XMFLOAT3 padding;
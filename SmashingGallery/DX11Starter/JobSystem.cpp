@@ -0,0 +1,231 @@
+#include "JobSystem.h"
+
+namespace
+{
+	// Which system and deque the running thread belongs to, if any
+	thread_local JobSystem* currentSystem = nullptr;
+	thread_local int currentWorker = 0;
+}
+
+JobCounter::JobCounter()
+{
+	value = 0;
+}
+
+int JobCounter::GetValue()
+{
+	return value;
+}
+
+JobSystem::JobSystem(int threadCount)
+{
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency();
+	}
+	if (threadCount < 1)
+	{
+		threadCount = 1;
+	}
+
+	queuedJobs = 0;
+	stopping = false;
+	for (int i = 0; i < threadCount; i++)
+	{
+		workers.push_back(new Worker());
+	}
+	currentSystem = this;
+	currentWorker = 0;
+	for (int i = 1; i < threadCount; i++)
+	{
+		threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> sleeping(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		for (size_t j = 0; j < workers[i]->jobs.size(); j++)
+		{
+			delete workers[i]->jobs[j]; // Never ran
+		}
+		delete workers[i];
+	}
+	if (currentSystem == this)
+	{
+		currentSystem = nullptr;
+	}
+}
+
+int JobSystem::GetThreadCount()
+{
+	return (int)workers.size();
+}
+
+void JobSystem::Run(std::function<void()> job, JobCounter* counter, JobCounter* after)
+{
+	Job* queued = new Job();
+	queued->work = job;
+	queued->counter = counter;
+	if (counter != nullptr)
+	{
+		counter->value++; // Now, so waiting on it covers jobs that haven't started yet
+	}
+
+	if (after != nullptr)
+	{
+		// The last job on after takes the same lock before it queues the waiting ones
+		std::lock_guard<std::mutex> held(after->lock);
+		if (after->value > 0)
+		{
+			after->waiting.push_back(queued);
+			return;
+		}
+	}
+	Queue(queued);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	int worker = GetCurrentWorker();
+	while (counter.value > 0)
+	{
+		Job* job = Take(worker);
+		if (job != nullptr)
+		{
+			Execute(job);
+		}
+		else
+		{
+			std::this_thread::yield(); // What's left is running on other threads
+		}
+	}
+	std::lock_guard<std::mutex> settled(counter.lock); // The last job might not have let go of it yet
+}
+
+void JobSystem::ParallelFor(int count, int minPerJob, std::function<void(int, int)> work)
+{
+	int jobCount = minPerJob > 0 ? count / minPerJob : count;
+	int maxJobs = GetThreadCount() * 4; // A few per thread so stealing can even out uneven ranges
+	if (jobCount > maxJobs) jobCount = maxJobs;
+	if (jobCount <= 1)
+	{
+		if (count > 0)
+		{
+			work(0, count);
+		}
+		return;
+	}
+
+	JobCounter counter;
+	for (int i = 1; i < jobCount; i++)
+	{
+		int first = (int)((long long)count * i / jobCount);
+		int last = (int)((long long)count * (i + 1) / jobCount);
+		Run([&work, first, last]() { work(first, last); }, &counter);
+	}
+	work(0, (int)((long long)count / jobCount));
+	Wait(counter);
+}
+
+void JobSystem::Queue(Job* job)
+{
+	Worker* worker = workers[GetCurrentWorker()];
+	{
+		std::lock_guard<std::mutex> held(worker->lock);
+		worker->jobs.push_back(job);
+	}
+	queuedJobs++;
+	{
+		std::lock_guard<std::mutex> sleeping(sleepLock); // So a worker can't miss this between checking and sleeping
+	}
+	wake.notify_one();
+}
+
+JobSystem::Job* JobSystem::Take(int worker)
+{
+	int count = (int)workers.size();
+	for (int i = 0; i < count; i++)
+	{
+		Worker* victim = workers[(worker + i) % count];
+		std::lock_guard<std::mutex> held(victim->lock);
+		if (!victim->jobs.empty())
+		{
+			Job* job;
+			if (i == 0)
+			{
+				job = victim->jobs.back(); // Own work newest first, it's still in cache
+				victim->jobs.pop_back();
+			}
+			else
+			{
+				job = victim->jobs.front(); // Stolen work oldest first, it tends to be the biggest
+				victim->jobs.pop_front();
+			}
+			queuedJobs--;
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->work();
+	JobCounter* counter = job->counter;
+	delete job;
+
+	if (counter != nullptr)
+	{
+		// Under the lock, so a Wait that sees zero can't free the counter while it's still held here
+		std::vector<void*> ready;
+		{
+			std::lock_guard<std::mutex> held(counter->lock);
+			if (--counter->value == 0)
+			{
+				ready.swap(counter->waiting);
+			}
+		}
+		for (size_t i = 0; i < ready.size(); i++)
+		{
+			Queue((Job*)ready[i]);
+		}
+	}
+}
+
+void JobSystem::WorkerLoop(int worker)
+{
+	currentSystem = this;
+	currentWorker = worker;
+	while (true)
+	{
+		Job* job = Take(worker);
+		if (job != nullptr)
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> sleeping(sleepLock);
+		wake.wait(sleeping, [this]() { return stopping || queuedJobs > 0; });
+		if (stopping)
+		{
+			return;
+		}
+	}
+}
+
+int JobSystem::GetCurrentWorker()
+{
+	return currentSystem == this ? currentWorker : 0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Counts jobs that haven't finished yet
+//
+// Every job run with a counter adds one until it finishes.
+// Jobs can also be held back until a counter reaches zero,
+// which is how dependencies are expressed.
+// --------------------------------------------------------
+class JobCounter
+{
+public:
+	JobCounter();
+
+	int GetValue();
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int> value;
+	std::mutex lock; // Guards waiting against the last job finishing
+	std::vector<void*> waiting; // Jobs to queue once value hits zero
+};
+
+// --------------------------------------------------------
+// Work-stealing thread pool
+//
+// Every thread has its own deque. A thread pushes and pops
+// its own jobs at the back, and when it runs dry steals from
+// the front of the others'. The thread that created the
+// system counts as worker 0, and Wait and ParallelFor make it
+// help with the work instead of blocking. Any other thread
+// outside the pool counts as worker 0 too, so only one thread
+// outside it should use the system at a time.
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+	JobSystem(int threadCount = 0); // Including the calling thread, 0 or less for one per hardware thread
+	~JobSystem();
+
+	int GetThreadCount();
+
+	// Queues the job. It adds to counter until it finishes, and won't start before after reaches zero
+	void Run(std::function<void()> job, JobCounter* counter = nullptr, JobCounter* after = nullptr);
+	void Wait(JobCounter& counter); // Runs other jobs until the counter reaches zero
+
+	// Runs work(first, last) over [0, count) in ranges of at least minPerJob, and waits for them all
+	void ParallelFor(int count, int minPerJob, std::function<void(int, int)> work);
+
+private:
+	struct Job
+	{
+		std::function<void()> work;
+		JobCounter* counter;
+	};
+
+	struct Worker
+	{
+		std::deque<Job*> jobs;
+		std::mutex lock;
+	};
+
+	std::vector<Worker*> workers; // Worker 0 is the creating thread
+	std::vector<std::thread> threads;
+	std::atomic<int> queuedJobs;
+	std::atomic<bool> stopping;
+	std::mutex sleepLock;
+	std::condition_variable wake;
+
+	void Queue(Job* job);
+	Job* Take(int worker); // Own back first, then the front of everyone else's
+	void Execute(Job* job);
+	void WorkerLoop(int worker);
+	int GetCurrentWorker();
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// Read-only view of an entire file on disk, backed by a
+// memory mapping so the OS pages it in as it is touched
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile(const char* fileName);
+	~MappedFile();
+
+	bool IsOpen(); // False if the file is missing or could not be mapped
+	const char* GetData();
+	size_t GetSize();
+
+private:
+	HANDLE file; // Handle to the file itself
+	HANDLE mapping; // Handle to the file mapping object
+	const char* data; // Start of the mapped view
+	size_t size; // Size of the file in bytes
+};
+
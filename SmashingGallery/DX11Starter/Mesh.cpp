@@ -1,21 +1,94 @@
 #include "Mesh.h"
+#include "ObjLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "PackedVertex.h"
 #include <vector>;
-#include <fstream>;
 #include <iostream>;
 using namespace DirectX;
 
-Mesh::Mesh(Vertex vertexArray[], int vertexArrCount, int indexArray[], int indexArrCount, ID3D11Device* device)
+namespace
 {
+	struct LodSetting
+	{
+		float ratio; // Target triangle count as a fraction of LOD 0
+		float maxError; // Largest allowed error as a fraction of the mesh's radius
+	};
+
+	const LodSetting LodChain[] = { { 0.5f, 0.02f }, { 0.25f, 0.05f }, { 0.125f, 0.1f } };
+}
+
+Mesh::Mesh(Vertex vertexArray[], int vertexArrCount, int indexArray[], int indexArrCount, ID3D11Device* device, GeometryPool* pool)
+{
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
+	this->pool = pool;
+	poolHandle = -1;
+	packed = false;
+	keepOccluder = false;
+	bounds = MeshBounds::FromVertices(vertexArray, vertexArrCount);
 	FillBuffers(vertexArray, vertexArrCount, indexArray, indexArrCount, device);
 }
 
-Mesh::Mesh(char* objFile, ID3D11Device* device)
+Mesh::Mesh(char* objFile, ID3D11Device* device, unsigned int options, GeometryPool* pool)
 {
-	// File input object
-	std::ifstream obj(objFile);
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
+	this->pool = pool;
+	poolHandle = -1;
+	indexCount = 0;
+	bounds = MeshBounds();
+	packed = (options & MESH_PACK_VERTICES) != 0;
+	keepOccluder = (options & MESH_KEEP_OCCLUDER) != 0;
+
+	std::string cachePath = MeshCacheFile::GetCachePath(objFile);
+	unsigned int cacheOptions = options & ~(MESH_SKIP_CACHE | MESH_PACK_VERTICES | MESH_KEEP_OCCLUDER | MESH_BUILD_BVH | MESH_BUILD_FRACTURE); // Options that change what ends up in the cache, packing and the CPU copies happen at upload
+	MappedFile obj(objFile);
+	unsigned long long sourceHash = obj.IsOpen() ? MeshCacheFile::HashContent(obj.GetData(), obj.GetSize()) : 0;
+
+	if (!(options & MESH_SKIP_CACHE))
+	{
+		// A cache built from this exact OBJ is uploaded straight from its mapping,
+		// and a cache with no OBJ next to it is used as long as it decodes. Decode
+		// range checks everything, so a stale or corrupt one falls back to the OBJ
+		MeshCacheFile cache(cachePath.c_str());
+		if (cache.IsValid() && (!obj.IsOpen() || cache.Matches(sourceHash, cacheOptions)) && cache.Decode())
+		{
+			const MeshCacheHeader* header = cache.GetHeader();
+			if (header->vertexCount > 0 && header->indexCount > 0)
+			{
+				FillBuffers(cache.GetVertices(), (int)header->vertexCount, cache.GetIndices(), (int)header->indexCount, device);
+				bounds = header->bounds;
+				if (header->lodCount > 0)
+				{
+					lods.assign(cache.GetLods(), cache.GetLods() + header->lodCount);
+					indexCount = lods[0].indexCount;
+				}
+				if (header->meshletCount > 0)
+				{
+					meshlets.assign(cache.GetMeshlets(), cache.GetMeshlets() + header->meshletCount);
+				}
+				if (options & MESH_BUILD_BVH)
+				{
+					triangleBvh.Build(cache.GetVertices(), (int)header->vertexCount, cache.GetIndices(), indexCount);
+				}
+				if (options & MESH_BUILD_FRACTURE)
+				{
+					LoadFracture(objFile, sourceHash, cache.GetVertices(), (int)header->vertexCount, cache.GetIndices(), indexCount, true);
+				}
+			}
+			std::cout << "cache found: " << cachePath << " (" << indexCount / 3 << " tris, " << lods.size() << " LODs, " << meshlets.size() << " meshlets)" << std::endl;
+			return;
+		}
+	}
+
+	std::vector<Vertex> verts;           // Verts we're assembling
+	std::vector<int> indices;           // Indices of these verts
+	ObjLoadStats stats;
 
-	// Check for successful open
-	if (!obj.is_open())
+	// Check for successful load
+	if (!obj.IsOpen())
 	{
 		std::cout << "file not found" << std::endl; 
 		TCHAR s[100];
@@ -23,180 +96,193 @@ Mesh::Mesh(char* objFile, ID3D11Device* device)
 		std::cout << s << "|" << objFile << std::endl;
 		return;
 	}
+	ObjLoader::Parse(obj.GetData(), obj.GetSize(), verts, indices, &stats);
 
-	std::cout << "file found" << std::endl;
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<int> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-										 // Still have data left?
-	while (obj.good())
+	std::cout << "file found: " << objFile << " (" << stats.triangles << " tris in " << stats.seconds * 1000.0 << "ms)" << std::endl;
+	if (verts.empty())
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+		return; // Nothing to upload
+	}
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
+	// The loader emits one vertex per face corner, so share
+	// the identical ones to get a real indexed mesh
+	size_t cornerCount = verts.size();
+	MeshOptimizer::WeldVertices(verts, indices);
+	std::cout << "  welded " << cornerCount << " -> " << verts.size() << " verts" << std::endl;
+
+	CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), (options & MESH_TANGENTS_MIKKTSPACE) ? TANGENTS_MIKKTSPACE : TANGENTS_ACCUMULATE);
+
+	// Every level shares the vertex buffer, only the indices get coarser
+	std::vector<std::vector<int>> levels(1, indices);
+	std::vector<float> errors(1, 0.0f);
+	if (options & MESH_GENERATE_LODS)
+	{
+		float radius = MeshBounds::FromVertices(&verts[0], verts.size()).sphereRadius; // Not from the origin, models needn't be centred on it
+		for (int i = 0; i < (int)(sizeof(LodChain) / sizeof(LodChain[0])); i++)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
+			float error;
+			size_t target = (size_t)(indices.size() / 3 * LodChain[i].ratio) * 3;
+			std::vector<int> level = MeshOptimizer::Simplify(verts, indices, target, LodChain[i].maxError * radius, &error);
+			if (level.size() * 10 > levels.back().size() * 9)
+			{
+				continue; // Too close to the last level to be worth drawing
+			}
+			levels.push_back(level);
+			errors.push_back(error);
+			std::cout << "  LOD " << levels.size() - 1 << ": " << level.size() / 3 << " tris, error " << error << std::endl;
 		}
-		else if (chars[0] == 'f')
+	}
+
+	if (options & (MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_OVERDRAW))
+	{
+		VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(levels[0], verts.size());
+		for (size_t i = 0; i < levels.size(); i++)
 		{
-			// Read the face indices into an array
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
+			MeshOptimizer::OptimizeVertexCache(levels[i], verts.size()); // Overdraw clustering relies on a cache optimized order
+			if (options & MESH_OPTIMIZE_OVERDRAW)
 			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
+				MeshOptimizer::OptimizeOverdraw(levels[i], verts);
 			}
-	}		}
+		}
+		VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(levels[0], verts.size());
+		std::cout << "  ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+	}
 
-	CalculateTangents(&verts[0], vertCounter, &indices[0], indexCount);
+	// Meshlets take over the order of LOD 0, growing clusters out of the cache friendly order
+	std::vector<Meshlet> clusters;
+	if (options & MESH_BUILD_MESHLETS)
+	{
+		clusters = MeshOptimizer::BuildMeshlets(verts, levels[0]);
+		std::cout << "  " << clusters.size() << " meshlets" << std::endl;
+	}
 
-	// Close the file and create the actual buffers
-	obj.close();
+	// All levels go in one index buffer, LOD 0 first
+	std::vector<MeshLod> chain(levels.size());
+	indices.clear();
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		chain[i].indexOffset = (int)indices.size();
+		chain[i].indexCount = (int)levels[i].size();
+		chain[i].error = errors[i];
+		indices.insert(indices.end(), levels[i].begin(), levels[i].end());
+	}
+	if (options & (MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_OVERDRAW))
+	{
+		MeshOptimizer::OptimizeVertexFetch(verts, indices);
+	}
 
+	bounds = MeshBounds::FromVertices(&verts[0], verts.size());
+	if (!(options & MESH_SKIP_CACHE) && !MeshCacheFile::Write(cachePath.c_str(), sourceHash, cacheOptions, verts, indices, chain, clusters, bounds, (options & MESH_COMPRESS_CACHE) != 0))
+	{
+		std::cout << "  couldn't write cache " << cachePath << std::endl;
+	}
 
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
+	// - At this point, "verts" is a vector of unique Vertex structs, and can be used
 	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
 	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
+	// - The vector "indices" is similar. It's a vector of ints and
 	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
-	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
-	//    one, you'll need to write some extra code to handle cases when you don't.
-	FillBuffers(&verts[0], vertCounter, &indices[0], vertCounter, device);
+	FillBuffers(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), device);
+	lods = chain;
+	meshlets = clusters;
+	indexCount = lods[0].indexCount;
+	if (options & MESH_BUILD_BVH)
+	{
+		triangleBvh.Build(&verts[0], (int)verts.size(), &indices[0], indexCount); // LOD 0 is first
+		std::cout << "  BVH: " << triangleBvh.GetNodeCount() << " nodes, depth " << triangleBvh.GetDepth() << std::endl;
+	}
+	if (options & MESH_BUILD_FRACTURE)
+	{
+		LoadFracture(objFile, sourceHash, &verts[0], (int)verts.size(), &indices[0], indexCount, !(options & MESH_SKIP_CACHE));
+	}
+}
+
+void Mesh::LoadFracture(const char* objFile, unsigned long long sourceHash, const Vertex* vertices, int vertexCount, const int* indices, int indexCount, bool useCache)
+{
+	// Cutting the mesh up is too slow for every launch, so like the mesh cache
+	// the shards are kept next to the OBJ and rebuilt only when it changes
+	std::string shardPath = FracturePattern::GetCachePath(objFile);
+	if (useCache && fracture.Read(shardPath.c_str(), sourceHash, FracturePattern::DefaultShardCount, FracturePattern::DefaultSeed))
+	{
+		std::cout << "  shards found: " << shardPath << " (" << fracture.GetShardCount() << " shards)" << std::endl;
+		return;
+	}
+	fracture.Build(vertices, vertexCount, indices, indexCount, FracturePattern::DefaultShardCount, FracturePattern::DefaultSeed);
+	std::cout << "  shards: " << fracture.GetShardCount() << " shards, " << fracture.GetIndexCount() / 3 << " tris" << std::endl;
+	if (useCache && !fracture.Write(shardPath.c_str(), sourceHash))
+	{
+		std::cout << "  couldn't write shards " << shardPath << std::endl;
+	}
 }
 
-void Mesh::FillBuffers(Vertex vertexArray[], int vertexArrCount, int indexArray[], int indexArrCount, ID3D11Device* device)
+void Mesh::FillBuffers(const Vertex vertexArray[], int vertexArrCount, const int indexArray[], int indexArrCount, ID3D11Device* device)
 {
 	// Create the VERTEX BUFFER description -----------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
+	// Packed meshes are converted here so caches and LODs all work on full Vertex data
+	const void* vertexData = vertexArray;
+	std::vector<PackedVertex> packedVerts;
+	positionOffset = XMFLOAT3(0, 0, 0);
+	positionScale = XMFLOAT3(1, 1, 1);
+	if (packed)
+	{
+		VertexPacker::Pack(vertexArray, vertexArrCount, packedVerts, positionOffset, positionScale);
+		vertexData = packedVerts.empty() ? nullptr : &packedVerts[0];
+	}
+
+	// Half size indices whenever every vertex fits in 16 bits, unless the pool wants 32
+	indexFormat = vertexArrCount <= 65536 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	bool usePool = pool != nullptr && pool->GetVertexStride() == GetVertexStride() &&
+		(pool->GetIndexFormat() == DXGI_FORMAT_R32_UINT || indexFormat == DXGI_FORMAT_R16_UINT);
+	if (usePool)
+	{
+		indexFormat = pool->GetIndexFormat();
+	}
+	const void* indexData = indexArray;
+	std::vector<unsigned short> shortIndices;
+	if (indexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		shortIndices.assign(indexArray, indexArray + indexArrCount);
+		indexData = shortIndices.empty() ? nullptr : &shortIndices[0];
+	}
+
+	occluderPositions.clear();
+	occluderIndices.clear();
+	if (keepOccluder)
+	{
+		occluderPositions.resize(vertexArrCount);
+		for (int i = 0; i < vertexArrCount; i++)
+		{
+			occluderPositions[i] = vertexArray[i].Position;
+		}
+		occluderIndices.assign(indexArray, indexArray + indexArrCount);
+	}
+
+	indexCount = indexArrCount;
+	MeshLod full = { 0, indexArrCount, 0.0f };
+	lods.assign(1, full);
+	meshlets.clear();
+
+	// Pooled meshes are just a range of the pool's buffers
+	if (poolHandle >= 0)
+	{
+		pool->Remove(poolHandle);
+		poolHandle = -1;
+	}
+	if (usePool)
+	{
+		poolHandle = pool->Add(vertexData, vertexArrCount, indexData, indexArrCount);
+		if (poolHandle >= 0)
+		{
+			return;
+		}
+	}
+	pool = nullptr; // Doesn't fit the pool, so this mesh owns its buffers
+
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * vertexArrCount;       // Number of indices in the buffer
+	vbd.ByteWidth = GetVertexStride() * vertexArrCount;       // Number of indices in the buffer
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -205,7 +291,7 @@ void Mesh::FillBuffers(Vertex vertexArray[], int vertexArrCount, int indexArray[
 	// Create the proper struct to hold the initial vertex data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = vertexArray;
+	initialVertexData.pSysMem = vertexData;
 
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
@@ -218,7 +304,7 @@ void Mesh::FillBuffers(Vertex vertexArray[], int vertexArrCount, int indexArray[
 	//    it to create the buffer.  The description is then useless.
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(int) * indexArrCount;         // Number of indices in the buffer
+	ibd.ByteWidth = (indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(int)) * indexArrCount;         // Number of indices in the buffer
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER; // Tells DirectX this is an index buffer
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -227,8 +313,7 @@ void Mesh::FillBuffers(Vertex vertexArray[], int vertexArrCount, int indexArray[
 	// Create the proper struct to hold the initial index data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indexArray;
-	indexCount = indexArrCount;
+	initialIndexData.pSysMem = indexData;
 
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
@@ -237,83 +322,142 @@ void Mesh::FillBuffers(Vertex vertexArray[], int vertexArrCount, int indexArray[
 
 ID3D11Buffer* Mesh::GetVertexBuffer()
 {
-	return vertexBuffer;
+	return poolHandle >= 0 ? pool->GetVertexBuffer() : vertexBuffer;
 }
 
 ID3D11Buffer* Mesh::GetIndexBuffer()
 {
-	return indexBuffer;
+	return poolHandle >= 0 ? pool->GetIndexBuffer() : indexBuffer;
 }
 
-int Mesh::GetIndexCount()
+void Mesh::Bind(ID3D11DeviceContext* context)
 {
-	return indexCount;
+	if (poolHandle >= 0)
+	{
+		pool->Bind(context);
+		return;
+	}
+	UINT stride = GetVertexStride();
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	context->IASetIndexBuffer(indexBuffer, indexFormat, 0);
+	GeometryPool::InvalidateBinding();
 }
 
+bool Mesh::IsPooled()
+{
+	return poolHandle >= 0;
+}
 
-Mesh::~Mesh()
+int Mesh::GetBaseVertex()
 {
-	vertexBuffer->Release(); // Release the buffers from memory
-	indexBuffer->Release();
+	return poolHandle >= 0 ? pool->GetRange(poolHandle).baseVertex : 0;
 }
 
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, int* indices, int numIndices) // Calculate the tangents
+int Mesh::GetFirstIndex()
 {
-	for (int i = 0; i < numVerts; i++) // I fthey've changed we don't want residual
-	{
-		verts[i].Tangent = XMFLOAT3(0, 0, 0);
-	}
+	return poolHandle >= 0 ? pool->GetRange(poolHandle).firstIndex : 0;
+}
 
-	for (int i = 0; i < numVerts;) // Take it one tri at a time
-	{
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
+UINT Mesh::GetVertexStride()
+{
+	return packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
 
-		float x1 = v2->Position.x - v1->Position.x; // Vectors relative to tri position (basically edges)
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
+DXGI_FORMAT Mesh::GetIndexFormat()
+{
+	return indexFormat;
+}
 
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
+bool Mesh::IsPacked()
+{
+	return packed;
+}
 
-		float s1 = v2->UV.x - v1->UV.x; // Vectors relative to uv
-		float t1 = v2->UV.y - v1->UV.y;
+XMFLOAT3 Mesh::GetPositionOffset()
+{
+	return positionOffset;
+}
 
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
+XMFLOAT3 Mesh::GetPositionScale()
+{
+	return positionScale;
+}
 
-		float r = 1.0f / (s1 * t2 - s2 * t1); // Vectors for tangent calcs
+int Mesh::GetIndexCount()
+{
+	return indexCount;
+}
 
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
+MeshBounds Mesh::GetBounds()
+{
+	return bounds;
+}
 
-		v1->Tangent.x += tx; // Adjest each vert's tangents
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
+int Mesh::GetLodCount()
+{
+	return (int)lods.size();
+}
 
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
+MeshLod Mesh::GetLod(int level)
+{
+	return lods[level];
+}
 
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
+int Mesh::GetMeshletCount()
+{
+	return (int)meshlets.size();
+}
 
-	for (int i = 0; i < numVerts; i++) // Ortho check
-	{
-		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+const Meshlet* Mesh::GetMeshlets()
+{
+	return meshlets.empty() ? nullptr : &meshlets[0];
+}
+
+const XMFLOAT3* Mesh::GetOccluderPositions()
+{
+	return occluderPositions.empty() ? nullptr : &occluderPositions[0];
+}
+
+int Mesh::GetOccluderVertexCount()
+{
+	return (int)occluderPositions.size();
+}
+
+const int* Mesh::GetOccluderIndices()
+{
+	return occluderIndices.empty() ? nullptr : &occluderIndices[0];
+}
 
-		
-		tangent = XMVector3Normalize(tangent - normal * XMVector3Dot(normal, tangent)); // Gram-Schmidt
+const MeshBVH* Mesh::GetTriangleBvh()
+{
+	return triangleBvh.IsBuilt() ? &triangleBvh : nullptr;
+}
 
-		XMStoreFloat3(&verts[i].Tangent, tangent);
+const FracturePattern* Mesh::GetFracturePattern()
+{
+	return fracture.IsBuilt() ? &fracture : nullptr;
+}
+
+int Mesh::SelectLod(float pixelsPerUnit, float maxPixelError)
+{
+	int level = 0;
+	while (level + 1 < (int)lods.size() && lods[level + 1].error * pixelsPerUnit <= maxPixelError)
+	{
+		level++;
 	}
+	return level;
+}
+
+
+Mesh::~Mesh()
+{
+	if (vertexBuffer) vertexBuffer->Release(); // Release the buffers from memory
+	if (indexBuffer) indexBuffer->Release();
+	if (poolHandle >= 0) pool->Remove(poolHandle);
+}
+
+void Mesh::CalculateTangents(Vertex* verts, int numVerts, int* indices, int numIndices, TangentMode mode) // Calculate the tangents
+{
+	TangentGenerator::Generate(verts, numVerts, indices, numIndices, mode);
 }
@@ -5,24 +5,92 @@
 #include <string>
 #include <DirectXMath.h>
 #include "Vertex.h"
+#include "TangentGenerator.h"
+#include "Meshlet.h"
+#include "MeshBounds.h"
+#include "GeometryPool.h"
+#include "MeshBVH.h"
+#include "FracturePattern.h"
+#include <vector>
+
+// Optional processing for meshes loaded from OBJ files, combine with |
+enum MeshOptions
+{
+	MESH_OPTIONS_NONE = 0,
+	MESH_OPTIMIZE_VERTEX_CACHE = 1, // Reorder triangles for the post-transform cache and verts for fetch locality
+	MESH_OPTIMIZE_OVERDRAW = 2, // Reorder triangle clusters so outward facing ones draw first
+	MESH_COMPRESS_CACHE = 4, // Compress the vertex and index data in the binary cache
+	MESH_SKIP_CACHE = 8, // Always parse the OBJ and never read or write the binary cache
+	MESH_TANGENTS_MIKKTSPACE = 16, // Build tangents the way MikkTSpace bakers do, for externally authored normal maps
+	MESH_GENERATE_LODS = 32, // Build a chain of simplified index buffers for drawing at a distance
+	MESH_PACK_VERTICES = 64, // Upload 16 byte PackedVertex data, needs VertexShaderPacked to draw
+	MESH_BUILD_MESHLETS = 128, // Cluster LOD 0 into meshlets so hidden parts can be culled on the CPU
+	MESH_KEEP_OCCLUDER = 256, // Keep a copy of the positions and indices on the CPU, for drawing into an OcclusionCuller
+	MESH_BUILD_BVH = 512, // Build a MeshBVH over LOD 0's triangles, for exact ray hits
+	MESH_BUILD_FRACTURE = 1024 // Cut LOD 0 into Voronoi shards for it to break into, kept in a .sgshards file next to the OBJ
+};
+
+// One level of detail, a range of the mesh's index buffer
+struct MeshLod
+{
+	int indexOffset;
+	int indexCount;
+	float error; // Largest distance a vertex moved off the LOD 0 planes it replaced, in object space units
+};
 
 class Mesh
 {
 public:
-	Mesh(Vertex vertexArray[], int vertexArrCount, int indexArray[], int indexArrCount, ID3D11Device* device);
-	Mesh(char* objFile, ID3D11Device* device);
+	// With a pool, the data is sub-allocated from its buffers whenever the vertex and index formats fit
+	Mesh(Vertex vertexArray[], int vertexArrCount, int indexArray[], int indexArrCount, ID3D11Device* device, GeometryPool* pool = nullptr);
+	Mesh(char* objFile, ID3D11Device* device, unsigned int options = MESH_OPTIMIZE_VERTEX_CACHE, GeometryPool* pool = nullptr);
 	~Mesh();
 
-	void FillBuffers(Vertex vertexArray[], int vertexArrCount, int indexArray[], int indexArrCount, ID3D11Device* device);
+	void FillBuffers(const Vertex vertexArray[], int vertexArrCount, const int indexArray[], int indexArrCount, ID3D11Device* device);
 
-	ID3D11Buffer* GetVertexBuffer();
+	ID3D11Buffer* GetVertexBuffer(); // The pool's buffers for pooled meshes
 	ID3D11Buffer* GetIndexBuffer();
-	int GetIndexCount();
-	void CalculateTangents(Vertex* verts, int numVerts, int* indices, int numIndices);
+	void Bind(ID3D11DeviceContext* context); // Sets the input assembler, a no-op when the mesh's pool is already bound
+	bool IsPooled();
+	int GetBaseVertex(); // Add to every DrawIndexed, 0 unless pooled
+	int GetFirstIndex();
+	UINT GetVertexStride(); // sizeof(Vertex) or sizeof(PackedVertex)
+	DXGI_FORMAT GetIndexFormat(); // 16 bit whenever the vertex count allows it
+	bool IsPacked();
+	DirectX::XMFLOAT3 GetPositionOffset(); // Turns packed positions back into object space, see PackedVertex
+	DirectX::XMFLOAT3 GetPositionScale();
+	int GetIndexCount(); // Index count of LOD 0
+	MeshBounds GetBounds(); // Object space box and minimal sphere of every vertex
+	int GetLodCount();
+	MeshLod GetLod(int level);
+	int GetMeshletCount(); // 0 unless loaded with MESH_BUILD_MESHLETS
+	const Meshlet* GetMeshlets(); // Ranges of LOD 0, back to back in the index buffer
+	const DirectX::XMFLOAT3* GetOccluderPositions(); // nullptr unless loaded with MESH_KEEP_OCCLUDER
+	int GetOccluderVertexCount();
+	const int* GetOccluderIndices(); // Every LOD like the index buffer, so LOD 0 is the first GetIndexCount()
+	const MeshBVH* GetTriangleBvh(); // nullptr unless loaded with MESH_BUILD_BVH
+	const FracturePattern* GetFracturePattern(); // nullptr unless loaded with MESH_BUILD_FRACTURE
+	int SelectLod(float pixelsPerUnit, float maxPixelError = 1.0f); // Coarsest level whose error covers at most maxPixelError pixels on screen
+	void CalculateTangents(Vertex* verts, int numVerts, int* indices, int numIndices, TangentMode mode = TANGENTS_ACCUMULATE);
 
 private:
 	ID3D11Buffer* vertexBuffer; // Pointer to the buffer of vertices
 	ID3D11Buffer* indexBuffer; // Pointer to the buffer of indices of verts to be used to draw an object
 	int indexCount; // Number of indices in the buffer
+	std::vector<MeshLod> lods; // Level 0 is the full mesh, each one after is coarser
+	std::vector<Meshlet> meshlets;
+	bool keepOccluder;
+	std::vector<DirectX::XMFLOAT3> occluderPositions; // Empty unless keepOccluder
+	std::vector<int> occluderIndices;
+	MeshBVH triangleBvh; // Empty unless loaded with MESH_BUILD_BVH
+	FracturePattern fracture; // Empty unless loaded with MESH_BUILD_FRACTURE
+	void LoadFracture(const char* objFile, unsigned long long sourceHash, const Vertex* vertices, int vertexCount, const int* indices, int indexCount, bool useCache); // From its file, or built and saved there
+	MeshBounds bounds;
+	bool packed; // Vertex buffer holds PackedVertex instead of Vertex
+	DXGI_FORMAT indexFormat;
+	DirectX::XMFLOAT3 positionOffset;
+	DirectX::XMFLOAT3 positionScale;
+	GeometryPool* pool; // Set once the data lives in the pool instead of vertexBuffer and indexBuffer
+	int poolHandle;
 };
 
@@ -0,0 +1,448 @@
+#include "MeshBVH.h"
+#include <algorithm>
+#include <cmath>
+#include "SimdLanes.h"
+using namespace DirectX;
+using namespace SimdLanes;
+
+namespace
+{
+	const int BinCount = 12; // Split candidates tried along each axis
+	const int MaxSahLevel = 40; // Below this, nodes split at the median so the depth stays bounded
+	const int StackSize = 64;
+
+	inline float Component(const XMFLOAT3& v, int axis) { return (&v.x)[axis]; }
+
+	inline float SurfaceArea(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+	{
+		float x = boxMax.x - boxMin.x, y = boxMax.y - boxMin.y, z = boxMax.z - boxMin.z;
+		return 2.0f * (x * y + y * z + z * x);
+	}
+
+	inline void Grow(XMFLOAT3& boxMin, XMFLOAT3& boxMax, const XMFLOAT3& otherMin, const XMFLOAT3& otherMax)
+	{
+		boxMin = XMFLOAT3(std::min(boxMin.x, otherMin.x), std::min(boxMin.y, otherMin.y), std::min(boxMin.z, otherMin.z));
+		boxMax = XMFLOAT3(std::max(boxMax.x, otherMax.x), std::max(boxMax.y, otherMax.y), std::max(boxMax.z, otherMax.z));
+	}
+
+	// Scalar versions with the same unordered behaviour as the SSE instructions
+	inline float MinOf(float a, float b) { return a < b ? a : b; }
+	inline float MaxOf(float a, float b) { return a > b ? a : b; }
+}
+
+MeshBVH::MeshBVH()
+{
+	depth = 0;
+}
+
+MeshBVH::~MeshBVH()
+{
+}
+
+void MeshBVH::Build(const Vertex* vertices, int vertexCount, const int* indices, int indexCount)
+{
+	this->vertices.assign(vertices, vertices + vertexCount);
+	this->indices.assign(indices, indices + indexCount);
+	nodes.clear();
+	depth = 0;
+
+	int triangleCount = indexCount / 3;
+	std::vector<XMFLOAT3> centroids(triangleCount), boxMins(triangleCount), boxMaxes(triangleCount);
+	std::vector<int> order(triangleCount);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		const XMFLOAT3& a = vertices[indices[t * 3]].Position;
+		const XMFLOAT3& b = vertices[indices[t * 3 + 1]].Position;
+		const XMFLOAT3& c = vertices[indices[t * 3 + 2]].Position;
+		boxMins[t] = a;
+		boxMaxes[t] = a;
+		Grow(boxMins[t], boxMaxes[t], b, b);
+		Grow(boxMins[t], boxMaxes[t], c, c);
+		centroids[t] = XMFLOAT3((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f);
+		order[t] = t;
+	}
+	if (triangleCount > 0)
+	{
+		nodes.reserve(triangleCount * 2);
+		BuildNode(0, triangleCount, 1, order, centroids, boxMins, boxMaxes);
+	}
+
+	// Leaves point into order, so that's the slot order. A leaf's worth of padding
+	// past the end lets the last leaf load whole lanes, the extra ones are masked off.
+	std::vector<float>* arrays[9] = { &v0x, &v0y, &v0z, &edge1x, &edge1y, &edge1z, &edge2x, &edge2y, &edge2z };
+	for (int k = 0; k < 9; k++)
+	{
+		arrays[k]->assign(triangleCount + MaxLeafSize, 0.0f);
+	}
+	for (int slot = 0; slot < triangleCount; slot++)
+	{
+		int t = order[slot];
+		const XMFLOAT3& a = vertices[indices[t * 3]].Position;
+		const XMFLOAT3& b = vertices[indices[t * 3 + 1]].Position;
+		const XMFLOAT3& c = vertices[indices[t * 3 + 2]].Position;
+		v0x[slot] = a.x;
+		v0y[slot] = a.y;
+		v0z[slot] = a.z;
+		edge1x[slot] = b.x - a.x;
+		edge1y[slot] = b.y - a.y;
+		edge1z[slot] = b.z - a.z;
+		edge2x[slot] = c.x - a.x;
+		edge2y[slot] = c.y - a.y;
+		edge2z[slot] = c.z - a.z;
+	}
+	slotTriangles = order;
+}
+
+bool MeshBVH::IsBuilt() const
+{
+	return !nodes.empty();
+}
+
+int MeshBVH::BuildNode(int first, int count, int level, std::vector<int>& order, const std::vector<XMFLOAT3>& centroids, const std::vector<XMFLOAT3>& boxMins, const std::vector<XMFLOAT3>& boxMaxes)
+{
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+	depth = std::max(depth, level);
+
+	XMFLOAT3 boxMin = boxMins[order[first]], boxMax = boxMaxes[order[first]];
+	XMFLOAT3 centroidMin = centroids[order[first]], centroidMax = centroids[order[first]];
+	for (int i = first + 1; i < first + count; i++)
+	{
+		Grow(boxMin, boxMax, boxMins[order[i]], boxMaxes[order[i]]);
+		Grow(centroidMin, centroidMax, centroids[order[i]], centroids[order[i]]);
+	}
+
+	// Grown a hair, so rounding in the slab test can't miss a triangle lying flat on the box
+	float pad = 1e-5f * std::max(std::max(boxMax.x - boxMin.x, boxMax.y - boxMin.y), boxMax.z - boxMin.z) + 1e-7f;
+	nodes[index].boxMin = XMFLOAT3(boxMin.x - pad, boxMin.y - pad, boxMin.z - pad);
+	nodes[index].boxMax = XMFLOAT3(boxMax.x + pad, boxMax.y + pad, boxMax.z + pad);
+
+	// Binned surface area heuristic: a split costs one box test plus the triangles
+	// on each side weighted by how likely a ray through this node hits that side
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = 0.0f;
+	for (int axis = 0; axis < 3 && level < MaxSahLevel; axis++)
+	{
+		float low = Component(centroidMin, axis);
+		float extent = Component(centroidMax, axis) - low;
+		if (extent <= 0.0f)
+		{
+			continue;
+		}
+		int binCounts[BinCount] = {};
+		XMFLOAT3 binMins[BinCount], binMaxes[BinCount];
+		for (int i = first; i < first + count; i++)
+		{
+			int t = order[i];
+			int bin = std::min((int)((Component(centroids[t], axis) - low) * BinCount / extent), BinCount - 1);
+			if (binCounts[bin]++ == 0)
+			{
+				binMins[bin] = boxMins[t];
+				binMaxes[bin] = boxMaxes[t];
+			}
+			else
+			{
+				Grow(binMins[bin], binMaxes[bin], boxMins[t], boxMaxes[t]);
+			}
+		}
+
+		// Everything left of each split, then right of it
+		float leftCost[BinCount];
+		int leftCount = 0;
+		XMFLOAT3 sideMin, sideMax;
+		for (int b = 0; b < BinCount - 1; b++)
+		{
+			if (binCounts[b] > 0)
+			{
+				if (leftCount == 0)
+				{
+					sideMin = binMins[b];
+					sideMax = binMaxes[b];
+				}
+				else
+				{
+					Grow(sideMin, sideMax, binMins[b], binMaxes[b]);
+				}
+				leftCount += binCounts[b];
+			}
+			leftCost[b] = leftCount > 0 ? SurfaceArea(sideMin, sideMax) * leftCount : 0.0f;
+		}
+		int rightCount = 0;
+		for (int b = BinCount - 1; b > 0; b--)
+		{
+			if (binCounts[b] > 0)
+			{
+				if (rightCount == 0)
+				{
+					sideMin = binMins[b];
+					sideMax = binMaxes[b];
+				}
+				else
+				{
+					Grow(sideMin, sideMax, binMins[b], binMaxes[b]);
+				}
+				rightCount += binCounts[b];
+			}
+			if (rightCount == 0 || rightCount == count)
+			{
+				continue; // Splitting after bin b - 1 would leave a side empty
+			}
+			float cost = leftCost[b - 1] + SurfaceArea(sideMin, sideMax) * rightCount;
+			if (bestAxis == -1 || cost < bestCost)
+			{
+				bestAxis = axis;
+				bestSplit = b;
+				bestCost = cost;
+			}
+		}
+	}
+
+	// A small enough leaf is tested a lane's worth of triangles at a time, so stopping costs batches rather than triangles
+	float area = SurfaceArea(boxMin, boxMax);
+	float leafCost = area * (count <= MaxLeafSize ? (count + LaneCount - 1) / LaneCount : count);
+	bool split = bestAxis != -1 && area + bestCost < leafCost;
+	if (!split && count <= MaxLeafSize)
+	{
+		nodes[index].first = first;
+		nodes[index].count = count;
+		return index;
+	}
+
+	int middle;
+	if (split)
+	{
+		float low = Component(centroidMin, bestAxis);
+		float extent = Component(centroidMax, bestAxis) - low;
+		middle = (int)(std::partition(order.begin() + first, order.begin() + first + count, [&](int t)
+		{
+			return std::min((int)((Component(centroids[t], bestAxis) - low) * BinCount / extent), BinCount - 1) < bestSplit; // The same bins as above
+		}) - order.begin());
+	}
+	else
+	{
+		// Too many to stop but nothing worth splitting on, so halve along the widest spread of centroids
+		int axis = 0;
+		for (int a = 1; a < 3; a++)
+		{
+			if (Component(centroidMax, a) - Component(centroidMin, a) > Component(centroidMax, axis) - Component(centroidMin, axis))
+			{
+				axis = a;
+			}
+		}
+		middle = first + count / 2;
+		std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count, [&](int a, int b)
+		{
+			return Component(centroids[a], axis) < Component(centroids[b], axis);
+		});
+	}
+
+	BuildNode(first, middle - first, level + 1, order, centroids, boxMins, boxMaxes); // Lands right after this one
+	int second = BuildNode(middle, first + count - middle, level + 1, order, centroids, boxMins, boxMaxes);
+	nodes[index].first = second;
+	nodes[index].count = 0;
+	return index;
+}
+
+bool MeshBVH::RayCast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, MeshRayHit& hit) const
+{
+	if (nodes.empty())
+	{
+		return false;
+	}
+	XMFLOAT3 inverse(direction.x != 0.0f ? 1.0f / direction.x : 1e30f, direction.y != 0.0f ? 1.0f / direction.y : 1e30f, direction.z != 0.0f ? 1.0f / direction.z : 1e30f);
+
+	// Nearer child first, the other waits on the stack with where the ray enters it,
+	// and is skipped if a hit closer than that turns up in the meantime
+	float distance = maxDistance;
+	int bestSlot = -1;
+	float bestU = 0.0f, bestV = 0.0f;
+	int stack[StackSize];
+	float stackEntry[StackSize];
+	int top = 0;
+	int node = BoxEntry(nodes[0], origin, inverse, distance) >= 0.0f ? 0 : -1;
+	while (node != -1)
+	{
+		int index = node;
+		const Node& current = nodes[index];
+		node = -1;
+		if (current.count > 0)
+		{
+			float u, v;
+			int slot = TestLeaf(current, origin, direction, distance, u, v);
+			if (slot != -1)
+			{
+				bestSlot = slot;
+				bestU = u;
+				bestV = v;
+			}
+		}
+		else
+		{
+			int closer = index + 1;
+			int farther = current.first;
+			float closerEntry = BoxEntry(nodes[closer], origin, inverse, distance);
+			float fartherEntry = BoxEntry(nodes[farther], origin, inverse, distance);
+			if (fartherEntry >= 0.0f && (closerEntry < 0.0f || fartherEntry < closerEntry))
+			{
+				std::swap(closer, farther);
+				std::swap(closerEntry, fartherEntry);
+			}
+			if (closerEntry >= 0.0f)
+			{
+				node = closer;
+				if (fartherEntry >= 0.0f)
+				{
+					stack[top] = farther;
+					stackEntry[top++] = fartherEntry;
+				}
+			}
+		}
+		while (node == -1 && top > 0)
+		{
+			top--;
+			node = stackEntry[top] <= distance ? stack[top] : -1;
+		}
+	}
+	if (bestSlot == -1)
+	{
+		return false;
+	}
+
+	int triangle = slotTriangles[bestSlot];
+	const Vertex& a = vertices[indices[triangle * 3]];
+	const Vertex& b = vertices[indices[triangle * 3 + 1]];
+	const Vertex& c = vertices[indices[triangle * 3 + 2]];
+	float w = 1.0f - bestU - bestV;
+	hit.distance = distance;
+	hit.triangle = triangle;
+	hit.point = XMFLOAT3(origin.x + direction.x * distance, origin.y + direction.y * distance, origin.z + direction.z * distance);
+	XMVECTOR normal = XMVectorAdd(XMVectorAdd(XMVectorScale(XMLoadFloat3(&a.Normal), w), XMVectorScale(XMLoadFloat3(&b.Normal), bestU)), XMVectorScale(XMLoadFloat3(&c.Normal), bestV));
+	XMStoreFloat3(&hit.normal, XMVector3Normalize(normal));
+	hit.uv = XMFLOAT2(a.UV.x * w + b.UV.x * bestU + c.UV.x * bestV, a.UV.y * w + b.UV.y * bestU + c.UV.y * bestV);
+	return true;
+}
+
+bool MeshBVH::RayCastInstance(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, const XMFLOAT4X4& world, MeshRayHit& hit) const
+{
+	// Affine, so the same distance along the ray is the same point in both spaces
+	XMMATRIX toObject = XMMatrixInverse(nullptr, XMLoadFloat4x4(&world));
+	XMFLOAT3 localOrigin, localDirection;
+	XMStoreFloat3(&localOrigin, XMVector3TransformCoord(XMLoadFloat3(&origin), toObject));
+	XMStoreFloat3(&localDirection, XMVector3TransformNormal(XMLoadFloat3(&direction), toObject));
+	if (!RayCast(localOrigin, localDirection, maxDistance, hit))
+	{
+		return false;
+	}
+	hit.point = XMFLOAT3(origin.x + direction.x * hit.distance, origin.y + direction.y * hit.distance, origin.z + direction.z * hit.distance);
+	XMStoreFloat3(&hit.normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&hit.normal), XMMatrixTranspose(toObject)))); // Inverse transpose keeps it perpendicular under non-uniform scale
+	return true;
+}
+
+bool MeshBVH::IntersectTriangle(const XMFLOAT3& origin, const XMFLOAT3& direction, const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2, float& distance, float& u, float& v)
+{
+	// In the same order as TestLeaf, so they agree exactly
+	float e1x = v1.x - v0.x, e1y = v1.y - v0.y, e1z = v1.z - v0.z;
+	float e2x = v2.x - v0.x, e2y = v2.y - v0.y, e2z = v2.z - v0.z;
+	float px = direction.y * e2z - direction.z * e2y;
+	float py = direction.z * e2x - direction.x * e2z;
+	float pz = direction.x * e2y - direction.y * e2x;
+	float det = e1x * px + e1y * py + e1z * pz;
+	float inverseDet = 1.0f / det;
+	float sx = origin.x - v0.x, sy = origin.y - v0.y, sz = origin.z - v0.z;
+	u = (sx * px + sy * py + sz * pz) * inverseDet;
+	float qx = sy * e1z - sz * e1y;
+	float qy = sz * e1x - sx * e1z;
+	float qz = sx * e1y - sy * e1x;
+	v = (direction.x * qx + direction.y * qy + direction.z * qz) * inverseDet;
+	distance = (e2x * qx + e2y * qy + e2z * qz) * inverseDet;
+	return det != 0.0f && u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance >= 0.0f;
+}
+
+int MeshBVH::GetNodeCount() const
+{
+	return (int)nodes.size();
+}
+
+int MeshBVH::GetTriangleCount() const
+{
+	return (int)slotTriangles.size();
+}
+
+int MeshBVH::GetDepth() const
+{
+	return depth;
+}
+
+float MeshBVH::BoxEntry(const Node& node, const XMFLOAT3& origin, const XMFLOAT3& inverse, float maxDistance) const
+{
+	float t1 = (node.boxMin.x - origin.x) * inverse.x;
+	float t2 = (node.boxMax.x - origin.x) * inverse.x;
+	float entry = MinOf(t1, t2);
+	float exit = MaxOf(t1, t2);
+	t1 = (node.boxMin.y - origin.y) * inverse.y;
+	t2 = (node.boxMax.y - origin.y) * inverse.y;
+	entry = MaxOf(entry, MinOf(t1, t2));
+	exit = MinOf(exit, MaxOf(t1, t2));
+	t1 = (node.boxMin.z - origin.z) * inverse.z;
+	t2 = (node.boxMax.z - origin.z) * inverse.z;
+	entry = MaxOf(entry, MinOf(t1, t2));
+	exit = MinOf(exit, MaxOf(t1, t2));
+	entry = MaxOf(entry, 0.0f);
+	exit = MinOf(exit, maxDistance);
+	return entry <= exit ? entry : -1.0f;
+}
+
+int MeshBVH::TestLeaf(const Node& node, const XMFLOAT3& origin, const XMFLOAT3& direction, float& distance, float& u, float& v) const
+{
+	Lanes dx = Splat(direction.x), dy = Splat(direction.y), dz = Splat(direction.z);
+	Lanes ox = Splat(origin.x), oy = Splat(origin.y), oz = Splat(origin.z);
+	Lanes zero = Splat(0.0f), one = Splat(1.0f);
+	int found = -1;
+	int end = node.first + node.count;
+	for (int i = node.first; i < end; i += LaneCount)
+	{
+		// Moller-Trumbore, a lane's worth of triangles at once
+		Lanes e1x = Load(&edge1x[i]), e1y = Load(&edge1y[i]), e1z = Load(&edge1z[i]);
+		Lanes e2x = Load(&edge2x[i]), e2y = Load(&edge2y[i]), e2z = Load(&edge2z[i]);
+		Lanes px = Sub(Mul(dy, e2z), Mul(dz, e2y));
+		Lanes py = Sub(Mul(dz, e2x), Mul(dx, e2z));
+		Lanes pz = Sub(Mul(dx, e2y), Mul(dy, e2x));
+		Lanes det = Add(Add(Mul(e1x, px), Mul(e1y, py)), Mul(e1z, pz));
+		Lanes inverseDet = Div(one, det);
+		Lanes sx = Sub(ox, Load(&v0x[i])), sy = Sub(oy, Load(&v0y[i])), sz = Sub(oz, Load(&v0z[i]));
+		Lanes laneU = Mul(Add(Add(Mul(sx, px), Mul(sy, py)), Mul(sz, pz)), inverseDet);
+		Lanes qx = Sub(Mul(sy, e1z), Mul(sz, e1y));
+		Lanes qy = Sub(Mul(sz, e1x), Mul(sx, e1z));
+		Lanes qz = Sub(Mul(sx, e1y), Mul(sy, e1x));
+		Lanes laneV = Mul(Add(Add(Mul(dx, qx), Mul(dy, qy)), Mul(dz, qz)), inverseDet);
+		Lanes t = Mul(Add(Add(Mul(e2x, qx), Mul(e2y, qy)), Mul(e2z, qz)), inverseDet);
+		Lanes hit = And(And(NotEqual(det, zero), GreaterEqual(laneU, zero)), And(GreaterEqual(laneV, zero), LessEqual(Add(laneU, laneV), one)));
+		hit = And(hit, And(GreaterEqual(t, zero), Less(t, Splat(distance))));
+
+		int mask = Mask(hit);
+		if (end - i < LaneCount)
+		{
+			mask &= (1 << (end - i)) - 1; // Lanes past the leaf belong to the next one
+		}
+		if (mask == 0)
+		{
+			continue;
+		}
+		float times[LaneCount], us[LaneCount], vs[LaneCount];
+		Store(times, t);
+		Store(us, laneU);
+		Store(vs, laneV);
+		for (int lane = 0; lane < LaneCount; lane++)
+		{
+			if (((mask >> lane) & 1) && times[lane] < distance)
+			{
+				distance = times[lane];
+				u = us[lane];
+				v = vs[lane];
+				found = i + lane;
+			}
+		}
+	}
+	return found;
+}
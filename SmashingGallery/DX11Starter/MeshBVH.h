@@ -0,0 +1,76 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Vertex.h"
+
+// Where a ray met a mesh's surface
+struct MeshRayHit
+{
+	float distance; // Along the ray, in lengths of its direction
+	int triangle; // Index into the mesh's triangles, as they were given to Build
+	DirectX::XMFLOAT3 point;
+	DirectX::XMFLOAT3 normal; // Interpolated from the vertex normals and unit length
+	DirectX::XMFLOAT2 uv; // Interpolated texture coordinate
+};
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over a mesh's triangles
+//
+// Built once, top down, splitting each node where the surface
+// area heuristic says rays will cost least, tried at a handful
+// of bins along each axis. The nodes end up in one array, each
+// inner node's first child right after it, so walking down
+// mostly reads forward.
+//
+// Leaves hold up to MaxLeafSize triangles, stored an array per
+// component in leaf order, so a whole leaf is tested against a
+// ray several triangles at a time. Triangles count from both
+// sides. IntersectTriangle is the same test one at a time.
+//
+// Everything is in object space, so one tree serves every
+// GameObject drawing the mesh. RayCastInstance takes a world
+// space ray and the object's world matrix and moves the ray
+// into object space instead, with distances unchanged and the
+// hit moved back out to world space.
+// --------------------------------------------------------
+class MeshBVH
+{
+public:
+	MeshBVH();
+	~MeshBVH();
+
+	void Build(const Vertex* vertices, int vertexCount, const int* indices, int indexCount); // Triangle list, keeps its own copy
+	bool IsBuilt() const;
+
+	bool RayCast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, MeshRayHit& hit) const; // Closest hit in object space, false if none within maxDistance
+	bool RayCastInstance(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, const DirectX::XMFLOAT4X4& world, MeshRayHit& hit) const; // World space ray and hit, the matrix is row vector, not the transposed shader copy
+
+	static bool IntersectTriangle(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, const DirectX::XMFLOAT3& v0, const DirectX::XMFLOAT3& v1, const DirectX::XMFLOAT3& v2, float& distance, float& u, float& v); // Moller-Trumbore, u and v weight v1 and v2
+
+	int GetNodeCount() const;
+	int GetTriangleCount() const;
+	int GetDepth() const; // Levels from the root to the deepest leaf
+
+	static const int MaxLeafSize = 8;
+
+private:
+	struct Node
+	{
+		DirectX::XMFLOAT3 boxMin;
+		int first; // Leaf: first triangle slot. Inner: the second child, the first is the next node
+		DirectX::XMFLOAT3 boxMax;
+		int count; // Triangles in a leaf, 0 for inner nodes
+	};
+
+	std::vector<Node> nodes;
+	std::vector<float> v0x, v0y, v0z, edge1x, edge1y, edge1z, edge2x, edge2y, edge2z; // By slot, padded a leaf's worth past the end
+	std::vector<int> slotTriangles; // Which original triangle each slot holds
+	std::vector<Vertex> vertices; // For the hit's normal and uv
+	std::vector<int> indices;
+	int depth;
+
+	int BuildNode(int first, int count, int level, std::vector<int>& order, const std::vector<DirectX::XMFLOAT3>& centroids, const std::vector<DirectX::XMFLOAT3>& boxMins, const std::vector<DirectX::XMFLOAT3>& boxMaxes); // Returns the node's index
+	float BoxEntry(const Node& node, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverse, float maxDistance) const; // Where the ray enters, or -1
+	int TestLeaf(const Node& node, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float& distance, float& u, float& v) const; // Closest slot nearer than distance, or -1
+};
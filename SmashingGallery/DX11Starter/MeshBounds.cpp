@@ -0,0 +1,210 @@
+#include "MeshBounds.h"
+#include "SeededRandom.h"
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+using namespace DirectX;
+
+namespace
+{
+	// Sphere fitting runs in doubles, the circumsphere solves lose too much in floats
+	struct Point
+	{
+		double x, y, z;
+	};
+
+	struct Sphere
+	{
+		Point center;
+		double radiusSq;
+	};
+
+	inline Point Sub(const Point& a, const Point& b) { Point p = { a.x - b.x, a.y - b.y, a.z - b.z }; return p; }
+	inline double Dot(const Point& a, const Point& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline Point Cross(const Point& a, const Point& b) { Point p = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; return p; }
+	inline Point Mad(const Point& a, const Point& b, double s) { Point p = { a.x + b.x * s, a.y + b.y * s, a.z + b.z * s }; return p; }
+
+	inline bool Contains(const Sphere& s, const Point& p)
+	{
+		Point d = Sub(p, s.center);
+		return Dot(d, d) <= s.radiusSq * (1.0 + 1e-9) + 1e-18; // Points used to build the sphere must test as inside
+	}
+
+	Sphere SphereFrom2(const Point& a, const Point& b)
+	{
+		Sphere s;
+		s.center = Mad(a, Sub(b, a), 0.5);
+		Point d = Sub(b, a);
+		s.radiusSq = Dot(d, d) * 0.25;
+		return s;
+	}
+
+	Sphere SphereFrom3(const Point& a, const Point& b, const Point& c)
+	{
+		// Circumcircle, centered in the triangle's plane
+		Point ab = Sub(b, a);
+		Point ac = Sub(c, a);
+		Point n = Cross(ab, ac);
+		double nLengthSq = Dot(n, n);
+		if (nLengthSq <= 1e-30 * Dot(ab, ab) * Dot(ac, ac))
+		{
+			// Collinear, the farthest pair spans all three
+			Sphere s = SphereFrom2(a, b);
+			Sphere t = SphereFrom2(a, c);
+			Sphere u = SphereFrom2(b, c);
+			if (t.radiusSq > s.radiusSq) s = t;
+			if (u.radiusSq > s.radiusSq) s = u;
+			return s;
+		}
+		Point toCenter;
+		Point left = Cross(n, ab);
+		Point right = Cross(ac, n);
+		double abSq = Dot(ab, ab);
+		double acSq = Dot(ac, ac);
+		toCenter.x = (left.x * acSq + right.x * abSq) / (2.0 * nLengthSq);
+		toCenter.y = (left.y * acSq + right.y * abSq) / (2.0 * nLengthSq);
+		toCenter.z = (left.z * acSq + right.z * abSq) / (2.0 * nLengthSq);
+
+		Sphere s;
+		s.center = Mad(a, toCenter, 1.0);
+		s.radiusSq = Dot(toCenter, toCenter);
+		return s;
+	}
+
+	Sphere SphereFrom4(const Point& a, const Point& b, const Point& c, const Point& d)
+	{
+		// Circumsphere: solve 2(p - a) . x = |p - a|^2 for x = center - a
+		Point ab = Sub(b, a);
+		Point ac = Sub(c, a);
+		Point ad = Sub(d, a);
+		double det = Dot(ab, Cross(ac, ad));
+		double scale = sqrt(Dot(ab, ab) * Dot(ac, ac) * Dot(ad, ad));
+		if (fabs(det) <= 1e-12 * scale)
+		{
+			// Coplanar, one of the triangles' circles already covers the fourth point
+			Sphere candidates[4] = { SphereFrom3(a, b, c), SphereFrom3(a, b, d), SphereFrom3(a, c, d), SphereFrom3(b, c, d) };
+			const Point* points[4] = { &d, &c, &b, &a };
+			Sphere best = candidates[0];
+			best.radiusSq = DBL_MAX;
+			for (int i = 0; i < 4; i++)
+			{
+				if (Contains(candidates[i], *points[i]) && candidates[i].radiusSq < best.radiusSq)
+				{
+					best = candidates[i];
+				}
+			}
+			return best.radiusSq < DBL_MAX ? best : candidates[0];
+		}
+
+		double abSq = Dot(ab, ab);
+		double acSq = Dot(ac, ac);
+		double adSq = Dot(ad, ad);
+		Point cd = Cross(ac, ad);
+		Point db = Cross(ad, ab);
+		Point bc = Cross(ab, ac);
+		Point toCenter;
+		toCenter.x = (cd.x * abSq + db.x * acSq + bc.x * adSq) / (2.0 * det);
+		toCenter.y = (cd.y * abSq + db.y * acSq + bc.y * adSq) / (2.0 * det);
+		toCenter.z = (cd.z * abSq + db.z * acSq + bc.z * adSq) / (2.0 * det);
+
+		Sphere s;
+		s.center = Mad(a, toCenter, 1.0);
+		s.radiusSq = Dot(toCenter, toCenter);
+		return s;
+	}
+}
+
+MeshBounds MeshBounds::FromVertices(const Vertex* verts, size_t count)
+{
+	MeshBounds bounds = {};
+	if (count == 0)
+	{
+		return bounds;
+	}
+
+	XMVECTOR boxMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR boxMax = XMVectorReplicate(-FLT_MAX);
+	std::vector<Point> points(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[i].Position);
+		boxMin = XMVectorMin(boxMin, p);
+		boxMax = XMVectorMax(boxMax, p);
+		points[i].x = verts[i].Position.x;
+		points[i].y = verts[i].Position.y;
+		points[i].z = verts[i].Position.z;
+	}
+	XMStoreFloat3(&bounds.boxMin, boxMin);
+	XMStoreFloat3(&bounds.boxMax, boxMax);
+
+	// Welzl's algorithm is expected linear time only in random order, and mesh
+	// verts are anything but. A fixed seed keeps the result the same every load.
+	unsigned int seed = 12345u;
+	for (size_t i = count - 1; i > 0; i--)
+	{
+		size_t j = (size_t)(((unsigned long long)SeededRandom::NextSeed(seed) * (i + 1)) >> 32);
+		Point swap = points[i];
+		points[i] = points[j];
+		points[j] = swap;
+	}
+
+	// Iterative form: every point that falls outside must be on the boundary of the
+	// sphere of everything before it, so rebuild with it pinned to the surface
+	Sphere s = { points[0], 0.0 };
+	for (size_t i = 1; i < count; i++)
+	{
+		if (Contains(s, points[i])) continue;
+		s.center = points[i];
+		s.radiusSq = 0.0;
+		for (size_t j = 0; j < i; j++)
+		{
+			if (Contains(s, points[j])) continue;
+			s = SphereFrom2(points[i], points[j]);
+			for (size_t k = 0; k < j; k++)
+			{
+				if (Contains(s, points[k])) continue;
+				s = SphereFrom3(points[i], points[j], points[k]);
+				for (size_t l = 0; l < k; l++)
+				{
+					if (Contains(s, points[l])) continue;
+					s = SphereFrom4(points[i], points[j], points[k], points[l]);
+				}
+			}
+		}
+	}
+
+	// Round to floats, then grow the radius until every vertex is inside for real
+	bounds.sphereCenter = XMFLOAT3((float)s.center.x, (float)s.center.y, (float)s.center.z);
+	Point center = { bounds.sphereCenter.x, bounds.sphereCenter.y, bounds.sphereCenter.z };
+	double radiusSq = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		Point d = Sub(points[i], center);
+		radiusSq = std::max(radiusSq, Dot(d, d));
+	}
+	bounds.sphereRadius = (float)sqrt(radiusSq);
+	if ((double)bounds.sphereRadius * bounds.sphereRadius < radiusSq)
+	{
+		bounds.sphereRadius = nextafterf(bounds.sphereRadius, FLT_MAX);
+	}
+	return bounds;
+}
+
+MeshBounds MeshBounds::Transform(const XMFLOAT4X4& world) const
+{
+	// Arvo's method: the new half extents are the old ones through the absolute matrix
+	XMMATRIX m = XMLoadFloat4x4(&world);
+	XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&boxMin), XMLoadFloat3(&boxMax)), 0.5f);
+	XMVECTOR extents = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&boxMax), XMLoadFloat3(&boxMin)), 0.5f);
+	XMVECTOR newCenter = XMVector3Transform(center, m);
+	XMVECTOR newExtents = XMVectorAbs(m.r[0]) * XMVectorSplatX(extents) + XMVectorAbs(m.r[1]) * XMVectorSplatY(extents) + XMVectorAbs(m.r[2]) * XMVectorSplatZ(extents);
+
+	MeshBounds result;
+	XMStoreFloat3(&result.boxMin, XMVectorSubtract(newCenter, newExtents));
+	XMStoreFloat3(&result.boxMax, XMVectorAdd(newCenter, newExtents));
+	XMStoreFloat3(&result.sphereCenter, XMVector3Transform(XMLoadFloat3(&sphereCenter), m));
+	float largestScale = sqrtf(std::max(XMVectorGetX(XMVector3LengthSq(m.r[0])), std::max(XMVectorGetX(XMVector3LengthSq(m.r[1])), XMVectorGetX(XMVector3LengthSq(m.r[2])))));
+	result.sphereRadius = sphereRadius * largestScale;
+	return result;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Bounding box and bounding sphere of a set of vertices
+//
+// Meshes compute theirs once at load time (or read them from
+// the binary cache) in object space. GameObject::GetWorldBounds
+// moves them into world space for culling and collision.
+// --------------------------------------------------------
+struct MeshBounds
+{
+	DirectX::XMFLOAT3 boxMin;
+	DirectX::XMFLOAT3 boxMax;
+	DirectX::XMFLOAT3 sphereCenter; // Minimal enclosing sphere, not just the box's
+	float sphereRadius;
+
+	// Tight box plus the minimal sphere (Welzl's algorithm), all zero when there are no verts
+	static MeshBounds FromVertices(const Vertex* verts, size_t count);
+
+	// Box around the transformed box and a sphere scaled by the largest axis, both still
+	// contain every transformed vertex. Takes a row vector matrix, not the transposed shader copy.
+	MeshBounds Transform(const DirectX::XMFLOAT4X4& world) const;
+};
@@ -0,0 +1,392 @@
+#include "MeshCache.h"
+#include <fstream>
+#include <cstring>
+#include <cfloat>
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int CacheVersion = 4;
+	const size_t MinMatch = 4; // Shortest back reference worth encoding
+	const size_t LastLiterals = 5; // The end of a block is always stored as literals
+	const int HashBits = 14;
+
+	inline unsigned int Read32(const unsigned char* p)
+	{
+		unsigned int value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	void WriteLength(std::vector<unsigned char>& out, size_t length) // Continuation bytes for lengths of 15 or more
+	{
+		while (length >= 255)
+		{
+			out.push_back(255);
+			length -= 255;
+		}
+		out.push_back((unsigned char)length);
+	}
+
+	// LZ77 with the LZ4 block layout: token, literals, 16-bit offset, match
+	void Compress(const unsigned char* src, size_t size, std::vector<unsigned char>& out)
+	{
+		std::vector<int> table(1 << HashBits, -1);
+		size_t ip = 0;
+		size_t anchor = 0; // Start of the pending literals
+
+		while (size >= MinMatch + LastLiterals && ip < size - MinMatch - LastLiterals)
+		{
+			unsigned int sequence = Read32(src + ip);
+			unsigned int hash = (sequence * 2654435761u) >> (32 - HashBits);
+			int candidate = table[hash];
+			table[hash] = (int)ip;
+
+			if (candidate < 0 || ip - candidate > 65535 || Read32(src + candidate) != sequence)
+			{
+				ip++;
+				continue;
+			}
+
+			size_t matchLength = MinMatch;
+			while (ip + matchLength < size - LastLiterals && src[candidate + matchLength] == src[ip + matchLength])
+			{
+				matchLength++;
+			}
+
+			size_t literalLength = ip - anchor;
+			size_t extraMatch = matchLength - MinMatch;
+			out.push_back((unsigned char)(((literalLength < 15 ? literalLength : 15) << 4) | (extraMatch < 15 ? extraMatch : 15)));
+			if (literalLength >= 15) WriteLength(out, literalLength - 15);
+			out.insert(out.end(), src + anchor, src + ip);
+			size_t offset = ip - candidate;
+			out.push_back((unsigned char)(offset & 0xff));
+			out.push_back((unsigned char)(offset >> 8));
+			if (extraMatch >= 15) WriteLength(out, extraMatch - 15);
+
+			ip += matchLength;
+			anchor = ip;
+		}
+
+		// Whatever is left goes out as a literal-only sequence
+		size_t literalLength = size - anchor;
+		out.push_back((unsigned char)((literalLength < 15 ? literalLength : 15) << 4));
+		if (literalLength >= 15) WriteLength(out, literalLength - 15);
+		out.insert(out.end(), src + anchor, src + size);
+	}
+
+	bool ReadLength(const unsigned char*& ip, const unsigned char* end, size_t& length)
+	{
+		unsigned char b;
+		do
+		{
+			if (ip >= end) return false;
+			b = *ip++;
+			length += b;
+		} while (b == 255);
+		return true;
+	}
+
+	// Returns false if the block is corrupt or doesn't decode to exactly dstSize bytes
+	bool Decompress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize)
+	{
+		const unsigned char* ip = src;
+		const unsigned char* end = src + srcSize;
+		size_t op = 0;
+
+		while (ip < end)
+		{
+			unsigned char token = *ip++;
+			size_t literalLength = token >> 4;
+			if (literalLength == 15 && !ReadLength(ip, end, literalLength)) return false;
+			if (literalLength > (size_t)(end - ip) || literalLength > dstSize - op) return false;
+			memcpy(dst + op, ip, literalLength);
+			ip += literalLength;
+			op += literalLength;
+
+			if (ip >= end) break; // Final sequence has no match
+
+			if (end - ip < 2) return false;
+			size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			size_t matchLength = (token & 15);
+			if (matchLength == 15 && !ReadLength(ip, end, matchLength)) return false;
+			matchLength += MinMatch;
+			if (offset == 0 || offset > op || matchLength > dstSize - op) return false;
+			for (size_t i = 0; i < matchLength; i++, op++) // Byte at a time since the match may overlap itself
+			{
+				dst[op] = dst[op - offset];
+			}
+		}
+		return op == dstSize;
+	}
+
+	// Groups byte k of every 4-byte word together, so the slowly varying
+	// high bytes of floats and ints end up next to each other
+	void Shuffle(const unsigned char* src, size_t size, unsigned char* dst)
+	{
+		size_t words = size / 4;
+		for (size_t i = 0; i < words; i++)
+		{
+			for (size_t k = 0; k < 4; k++)
+			{
+				dst[k * words + i] = src[i * 4 + k];
+			}
+		}
+	}
+
+	void Unshuffle(const unsigned char* src, size_t size, unsigned char* dst)
+	{
+		size_t words = size / 4;
+		for (size_t i = 0; i < words; i++)
+		{
+			for (size_t k = 0; k < 4; k++)
+			{
+				dst[i * 4 + k] = src[k * words + i];
+			}
+		}
+	}
+
+	void CompressBlock(const void* data, size_t size, std::vector<unsigned char>& out)
+	{
+		std::vector<unsigned char> shuffled(size);
+		if (size > 0) Shuffle((const unsigned char*)data, size, &shuffled[0]);
+		Compress(size > 0 ? &shuffled[0] : nullptr, size, out);
+	}
+
+	bool DecompressBlock(const unsigned char* src, size_t srcSize, void* data, size_t size)
+	{
+		std::vector<unsigned char> shuffled(size);
+		if (size == 0) return true;
+		if (!Decompress(src, srcSize, &shuffled[0], size)) return false;
+		Unshuffle(&shuffled[0], size, (unsigned char*)data);
+		return true;
+	}
+}
+
+MeshCacheFile::MeshCacheFile(const char* cacheFile)
+	: file(cacheFile)
+{
+	header = nullptr;
+	vertices = nullptr;
+	indices = nullptr;
+	lods = nullptr;
+	meshlets = nullptr;
+	if (file.IsOpen() && file.GetSize() >= sizeof(MeshCacheHeader))
+	{
+		header = (const MeshCacheHeader*)file.GetData();
+	}
+}
+
+MeshCacheFile::~MeshCacheFile()
+{
+}
+
+bool MeshCacheFile::IsValid()
+{
+	if (header == nullptr || memcmp(header->magic, "SGMC", 4) != 0 || header->version != CacheVersion)
+	{
+		return false;
+	}
+
+	unsigned long long expected = (unsigned long long)sizeof(MeshCacheHeader) + header->vertexBytes + header->indexBytes + header->lodCount * sizeof(MeshLod) + header->meshletCount * sizeof(Meshlet);
+	if (file.GetSize() < expected)
+	{
+		return false; // Truncated
+	}
+	if (!(header->flags & MESH_CACHE_COMPRESSED))
+	{
+		return header->vertexBytes == header->vertexCount * sizeof(Vertex) && header->indexBytes == header->indexCount * sizeof(int);
+	}
+	return true;
+}
+
+bool MeshCacheFile::Matches(unsigned long long sourceHash, unsigned int options)
+{
+	return header != nullptr && header->sourceHash == sourceHash && header->options == options;
+}
+
+bool MeshCacheFile::Decode()
+{
+	const unsigned char* vertexBlock = (const unsigned char*)file.GetData() + sizeof(MeshCacheHeader);
+	const unsigned char* indexBlock = vertexBlock + header->vertexBytes;
+	lods = header->lodCount > 0 ? (const MeshLod*)(indexBlock + header->indexBytes) : nullptr;
+	meshlets = header->meshletCount > 0 ? (const Meshlet*)(indexBlock + header->indexBytes + header->lodCount * sizeof(MeshLod)) : nullptr;
+
+	if (!(header->flags & MESH_CACHE_COMPRESSED))
+	{
+		// Nothing to decode, point straight into the mapping
+		vertices = (const Vertex*)vertexBlock;
+		indices = (const int*)indexBlock;
+		return CheckRanges();
+	}
+
+	decodedVertices.resize(header->vertexCount);
+	decodedIndices.resize(header->indexCount);
+	if (!DecompressBlock(vertexBlock, header->vertexBytes, header->vertexCount ? &decodedVertices[0] : nullptr, header->vertexCount * sizeof(Vertex)) ||
+		!DecompressBlock(indexBlock, header->indexBytes, header->indexCount ? &decodedIndices[0] : nullptr, header->indexCount * sizeof(int)))
+	{
+		return false;
+	}
+
+	// Indices were stored as deltas from the previous index
+	for (size_t i = 1; i < decodedIndices.size(); i++)
+	{
+		decodedIndices[i] += decodedIndices[i - 1];
+	}
+
+	vertices = decodedVertices.empty() ? nullptr : &decodedVertices[0];
+	indices = decodedIndices.empty() ? nullptr : &decodedIndices[0];
+	return CheckRanges();
+}
+
+bool MeshCacheFile::CheckRanges()
+{
+	// Nothing may point outside the file's own arrays
+	int indexCount = (int)header->indexCount;
+	if (indexCount < 0 || (int)header->vertexCount < 0)
+	{
+		return false;
+	}
+	for (int i = 0; i < indexCount; i++)
+	{
+		if (indices[i] < 0 || indices[i] >= (int)header->vertexCount)
+		{
+			return false;
+		}
+	}
+	for (unsigned int i = 0; i < header->lodCount; i++)
+	{
+		MeshLod lod;
+		memcpy(&lod, lods + i, sizeof(lod)); // The table follows variable sized blocks, so it may not be aligned
+		if (lod.indexOffset < 0 || lod.indexCount < 0 || lod.indexCount % 3 != 0 || lod.indexOffset > indexCount - lod.indexCount)
+		{
+			return false;
+		}
+	}
+	for (unsigned int i = 0; i < header->meshletCount; i++)
+	{
+		Meshlet meshlet;
+		memcpy(&meshlet, meshlets + i, sizeof(meshlet));
+		if (meshlet.indexOffset < 0 || meshlet.indexCount < 0 || meshlet.indexCount % 3 != 0 || meshlet.indexOffset > indexCount - meshlet.indexCount)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+const MeshCacheHeader* MeshCacheFile::GetHeader()
+{
+	return header;
+}
+
+const Vertex* MeshCacheFile::GetVertices()
+{
+	return vertices;
+}
+
+const int* MeshCacheFile::GetIndices()
+{
+	return indices;
+}
+
+const MeshLod* MeshCacheFile::GetLods()
+{
+	return lods;
+}
+
+const Meshlet* MeshCacheFile::GetMeshlets()
+{
+	return meshlets;
+}
+
+bool MeshCacheFile::Write(const char* cacheFile, unsigned long long sourceHash, unsigned int options, const std::vector<Vertex>& verts, const std::vector<int>& indices, const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets, const MeshBounds& bounds, bool compress)
+{
+	MeshCacheHeader header = {};
+	memcpy(header.magic, "SGMC", 4);
+	header.version = CacheVersion;
+	header.flags = compress ? MESH_CACHE_COMPRESSED : 0;
+	header.options = options;
+	header.sourceHash = sourceHash;
+	header.vertexCount = (unsigned int)verts.size();
+	header.indexCount = (unsigned int)indices.size();
+	header.lodCount = (unsigned int)lods.size();
+	header.meshletCount = (unsigned int)meshlets.size();
+
+	header.bounds = bounds;
+
+	std::vector<unsigned char> vertexBlock, indexBlock;
+	if (compress)
+	{
+		std::vector<int> deltas(indices.size());
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			deltas[i] = indices[i] - (i > 0 ? indices[i - 1] : 0);
+		}
+		CompressBlock(verts.empty() ? nullptr : &verts[0], verts.size() * sizeof(Vertex), vertexBlock);
+		CompressBlock(deltas.empty() ? nullptr : &deltas[0], deltas.size() * sizeof(int), indexBlock);
+	}
+	else
+	{
+		const unsigned char* v = (const unsigned char*)(verts.empty() ? nullptr : &verts[0]);
+		const unsigned char* i = (const unsigned char*)(indices.empty() ? nullptr : &indices[0]);
+		vertexBlock.assign(v, v + verts.size() * sizeof(Vertex));
+		indexBlock.assign(i, i + indices.size() * sizeof(int));
+	}
+	header.vertexBytes = (unsigned int)vertexBlock.size();
+	header.indexBytes = (unsigned int)indexBlock.size();
+
+	// Write to a temp file and swap it in, so a crash never leaves a half written cache
+	std::string tempFile = std::string(cacheFile) + ".tmp";
+	{
+		std::ofstream out(tempFile.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+		{
+			return false;
+		}
+		out.write((const char*)&header, sizeof(header));
+		if (!vertexBlock.empty()) out.write((const char*)&vertexBlock[0], vertexBlock.size());
+		if (!indexBlock.empty()) out.write((const char*)&indexBlock[0], indexBlock.size());
+		if (!lods.empty()) out.write((const char*)&lods[0], lods.size() * sizeof(MeshLod));
+		if (!meshlets.empty()) out.write((const char*)&meshlets[0], meshlets.size() * sizeof(Meshlet));
+		if (!out.good())
+		{
+			out.close();
+			DeleteFileA(tempFile.c_str());
+			return false;
+		}
+	}
+	return MoveFileExA(tempFile.c_str(), cacheFile, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+unsigned long long MeshCacheFile::HashContent(const char* data, size_t size)
+{
+	// FNV-1a style, a word at a time so hashing keeps up with the disk
+	unsigned long long hash = 14695981039346656037ull;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		unsigned long long word;
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * 1099511628211ull;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; i++)
+	{
+		hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+	}
+	return hash ^ size;
+}
+
+std::string MeshCacheFile::GetCachePath(const char* objFile)
+{
+	std::string path = objFile;
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("\\/");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+	{
+		path.erase(dot); // Drop the .obj
+	}
+	return path + ".sgmesh";
+}
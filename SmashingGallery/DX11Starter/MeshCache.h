@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "Vertex.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// Header at the start of a binary mesh cache file
+//
+// The vertex block follows the header, then the index block
+// holding every LOD, then the raw MeshLod table. The vertex and
+// index blocks are raw arrays unless MESH_CACHE_COMPRESSED is set.
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	char magic[4]; // "SGMC"
+	unsigned int version;
+	unsigned int flags; // MeshCacheFlags
+	unsigned int options; // MeshOptions the data was processed with
+	unsigned long long sourceHash; // Hash of the OBJ file contents
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int vertexBytes; // Stored size of each block, smaller than the raw size when compressed
+	unsigned int indexBytes;
+	unsigned int lodCount; // Entries in the MeshLod table
+	unsigned int meshletCount; // Entries in the Meshlet table
+	MeshBounds bounds; // Object space, so a cache hit never walks the verts
+};
+
+enum MeshCacheFlags
+{
+	MESH_CACHE_COMPRESSED = 1 // Blocks are byte shuffled and LZ compressed
+};
+
+// --------------------------------------------------------
+// Binary cache of a fully processed mesh, stored next to
+// its OBJ so later launches skip parsing entirely
+//
+// Uncompressed caches are read straight out of the memory
+// mapping; compressed ones are decoded into local storage.
+// --------------------------------------------------------
+class MeshCacheFile
+{
+public:
+	MeshCacheFile(const char* cacheFile);
+	~MeshCacheFile();
+
+	bool IsValid(); // File exists and its header and sizes check out
+	bool Matches(unsigned long long sourceHash, unsigned int options); // Built from this source with these options
+	bool Decode(); // Must succeed before reading the data, fails if any index or range points outside the file
+
+	const MeshCacheHeader* GetHeader();
+	const Vertex* GetVertices();
+	const int* GetIndices();
+	const MeshLod* GetLods();
+	const Meshlet* GetMeshlets();
+
+	static bool Write(const char* cacheFile, unsigned long long sourceHash, unsigned int options, const std::vector<Vertex>& verts, const std::vector<int>& indices, const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets, const MeshBounds& bounds, bool compress);
+	static unsigned long long HashContent(const char* data, size_t size);
+	static std::string GetCachePath(const char* objFile);
+
+private:
+	bool CheckRanges();
+
+	MappedFile file;
+	const MeshCacheHeader* header;
+	const Vertex* vertices;
+	const int* indices;
+	const MeshLod* lods;
+	const Meshlet* meshlets;
+	std::vector<Vertex> decodedVertices; // Only used for compressed caches
+	std::vector<int> decodedIndices;
+};
+
@@ -0,0 +1,819 @@
+#include "MeshOptimizer.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <cfloat>
+using namespace DirectX;
+
+namespace
+{
+	inline unsigned int FloatBits(float f)
+	{
+		f += 0.0f; // Folds -0 into +0 so they hash the same
+		unsigned int bits;
+		memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	}
+
+	// Hashes the attributes that welding compares (tangents are generated afterwards)
+	inline unsigned int HashVertex(const Vertex& v)
+	{
+		const float attributes[8] = { v.Position.x, v.Position.y, v.Position.z, v.UV.x, v.UV.y, v.Normal.x, v.Normal.y, v.Normal.z };
+		unsigned int hash = 2166136261u; // FNV-1a over the bit patterns
+		for (int i = 0; i < 8; i++)
+		{
+			hash ^= FloatBits(attributes[i]);
+			hash *= 16777619u;
+		}
+		return hash ^ (hash >> 15);
+	}
+
+	inline bool SameVertex(const Vertex& a, const Vertex& b)
+	{
+		return a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+			a.UV.x == b.UV.x && a.UV.y == b.UV.y &&
+			a.Normal.x == b.Normal.x && a.Normal.y == b.Normal.y && a.Normal.z == b.Normal.z;
+	}
+
+	// Tuning values from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+	const int ForsythCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	float ForsythVertexScore(int cachePosition, int remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return -1.0f; // Nothing left to draw with this vertex
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				score = LastTriScore; // Used by the last triangle, fixed score so it isn't favored too much
+			}
+			else
+			{
+				float scaler = 1.0f / (ForsythCacheSize - 3);
+				score = powf(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+			}
+		}
+
+		// Boost vertices with few triangles left so they get finished off
+		score += ValenceBoostScale * powf((float)remainingTriangles, -ValenceBoostPower);
+		return score;
+	}
+
+	struct Cluster
+	{
+		size_t start; // First index of the cluster
+		size_t count; // Index count
+		float sortKey;
+	};
+}
+
+size_t MeshOptimizer::WeldVertices(std::vector<Vertex>& verts, std::vector<int>& indices)
+{
+	size_t count = verts.size();
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	// Open addressing table at most half full, holding indices of unique verts
+	size_t tableSize = 1;
+	while (tableSize < count * 2)
+	{
+		tableSize <<= 1;
+	}
+	size_t mask = tableSize - 1;
+	std::vector<int> table(tableSize, -1);
+	std::vector<int> remap(count);
+
+	size_t uniqueCount = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t slot = HashVertex(verts[i]) & mask;
+		while (table[slot] != -1 && !SameVertex(verts[table[slot]], verts[i]))
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		if (table[slot] == -1)
+		{
+			// First time we've seen this vertex, compact it into place
+			table[slot] = (int)uniqueCount;
+			verts[uniqueCount] = verts[i];
+			remap[i] = (int)uniqueCount;
+			uniqueCount++;
+		}
+		else
+		{
+			remap[i] = table[slot];
+		}
+	}
+
+	verts.resize(uniqueCount);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		indices[i] = remap[indices[i]];
+	}
+	return uniqueCount;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<int>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Vertex to triangle adjacency, packed into one array
+	std::vector<int> adjacencyCount(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacencyCount[indices[i]]++;
+	}
+	std::vector<int> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyStart[v + 1] = adjacencyStart[v] + adjacencyCount[v];
+	}
+	std::vector<int> adjacency(triangleCount * 3);
+	std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			int v = indices[t * 3 + c];
+			adjacency[fill[v]++] = (int)t;
+		}
+	}
+
+	// Per vertex scores, triangles are scored on demand from their verts
+	std::vector<int> remaining(adjacencyCount); // Triangles not yet emitted that use each vertex
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = ForsythVertexScore(-1, remaining[v]);
+	}
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<int> output;
+	output.reserve(triangleCount * 3);
+	int cache[ForsythCacheSize + 3];
+	int cacheCount = 0;
+	size_t scanCursor = 0; // Fallback search position when nothing in the cache is usable
+
+	int best = -1;
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		if (best < 0)
+		{
+			// Cache has nothing useful, take the next triangle we haven't drawn
+			while (emitted[scanCursor]) scanCursor++;
+			best = (int)scanCursor;
+		}
+
+		// Emit the triangle and pull it out of its vertices' adjacency
+		emitted[best] = true;
+		int newCache[ForsythCacheSize + 3];
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			int v = indices[best * 3 + c];
+			output.push_back(v);
+			newCache[newCount++] = v;
+
+			int* adj = &adjacency[adjacencyStart[v]];
+			for (int a = 0; a < remaining[v]; a++)
+			{
+				if (adj[a] == best)
+				{
+					adj[a] = adj[remaining[v] - 1]; // Swap remove from the live part of the list
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// Move the triangle's verts to the front of the LRU cache
+		for (int i = 0; i < cacheCount; i++)
+		{
+			int v = cache[i];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+			{
+				newCache[newCount++] = v;
+			}
+		}
+
+		// Rescore everything that was in the cache, including verts that just fell out
+		for (int i = 0; i < newCount; i++)
+		{
+			int v = newCache[i];
+			cachePosition[v] = i < ForsythCacheSize ? i : -1;
+			vertexScore[v] = ForsythVertexScore(cachePosition[v], remaining[v]);
+		}
+
+		// Find the best triangle touching the cache
+		best = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < newCount; i++)
+		{
+			int v = newCache[i];
+			int* adj = &adjacency[adjacencyStart[v]];
+			for (int a = 0; a < remaining[v]; a++)
+			{
+				int t = adj[a];
+				float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+
+		cacheCount = newCount < ForsythCacheSize ? newCount : ForsythCacheSize;
+		memcpy(cache, newCache, cacheCount * sizeof(int));
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<int>& indices, const std::vector<Vertex>& verts)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Split into clusters wherever the cache was effectively flushed (all three
+	// verts missed), so reordering whole clusters barely changes the ACMR
+	const unsigned int cacheSize = 16;
+	std::vector<unsigned int> timestamps(verts.size(), 0);
+	unsigned int time = cacheSize + 1;
+	std::vector<Cluster> clusters;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			int v = indices[t * 3 + c];
+			if (time - timestamps[v] > cacheSize)
+			{
+				timestamps[v] = time++;
+				misses++;
+			}
+		}
+		if (misses == 3 || clusters.empty())
+		{
+			Cluster cluster = { t * 3, 0, 0.0f };
+			clusters.push_back(cluster);
+		}
+		clusters.back().count += 3;
+	}
+
+	// Mesh centroid
+	XMVECTOR meshCenter = XMVectorZero();
+	for (size_t v = 0; v < verts.size(); v++)
+	{
+		meshCenter = XMVectorAdd(meshCenter, XMLoadFloat3(&verts[v].Position));
+	}
+	meshCenter = XMVectorScale(meshCenter, 1.0f / verts.size());
+
+	// Clusters facing away from the middle of the mesh are likely to occlude the rest
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		XMVECTOR center = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for (size_t k = clusters[i].start; k < clusters[i].start + clusters[i].count; k += 3)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&verts[indices[k]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&verts[indices[k + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&verts[indices[k + 2]].Position);
+			XMVECTOR cross = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)); // Length is twice the area
+			float triangleArea = XMVectorGetX(XMVector3Length(cross));
+			center = XMVectorAdd(center, XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), triangleArea / 3.0f));
+			normal = XMVectorAdd(normal, cross);
+			area += triangleArea;
+		}
+		if (area > 0.0f)
+		{
+			center = XMVectorScale(center, 1.0f / area);
+		}
+		normal = XMVector3Normalize(normal);
+		clusters[i].sortKey = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, meshCenter), normal));
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<int> output;
+	output.reserve(indices.size());
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		output.insert(output.end(), indices.begin() + clusters[i].start, indices.begin() + clusters[i].start + clusters[i].count);
+	}
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& verts, std::vector<int>& indices)
+{
+	std::vector<int> remap(verts.size(), -1);
+	std::vector<Vertex> ordered;
+	ordered.reserve(verts.size());
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		int v = indices[i];
+		if (remap[v] < 0)
+		{
+			remap[v] = (int)ordered.size();
+			ordered.push_back(verts[v]);
+		}
+		indices[i] = remap[v];
+	}
+	verts.swap(ordered); // Verts no triangle uses are dropped
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<int>& indices, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = { 0.0f, 0.0f };
+	if (indices.empty() || vertexCount == 0)
+	{
+		return stats;
+	}
+
+	// A vertex is still cached if fewer than cacheSize misses happened since it was loaded
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	size_t misses = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		int v = indices[i];
+		if (time - timestamps[v] > cacheSize)
+		{
+			timestamps[v] = time++;
+			misses++;
+		}
+	}
+
+	stats.acmr = (float)misses / (indices.size() / 3);
+	stats.atvr = (float)misses / vertexCount;
+	return stats;
+}
+
+namespace
+{
+	struct Quadric // Area weighted sum of squared distances to triangle planes, symmetric 4x4
+	{
+		double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+		double weight; // Total area, turns the error back into a mean squared distance
+	};
+
+	void AddPlane(Quadric& q, double a, double b, double c, double d, double w)
+	{
+		q.xx += w * a * a; q.xy += w * a * b; q.xz += w * a * c; q.xw += w * a * d;
+		q.yy += w * b * b; q.yz += w * b * c; q.yw += w * b * d;
+		q.zz += w * c * c; q.zw += w * c * d;
+		q.ww += w * d * d;
+		q.weight += w;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& o)
+	{
+		q.xx += o.xx; q.xy += o.xy; q.xz += o.xz; q.xw += o.xw;
+		q.yy += o.yy; q.yz += o.yz; q.yw += o.yw;
+		q.zz += o.zz; q.zw += o.zw;
+		q.ww += o.ww;
+		q.weight += o.weight;
+	}
+
+	double QuadricError(const Quadric& q, const XMFLOAT3& p)
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double error = q.xx * x * x + q.yy * y * y + q.zz * z * z + q.ww
+			+ 2.0 * (q.xy * x * y + q.xz * x * z + q.yz * y * z + q.xw * x + q.yw * y + q.zw * z);
+		return q.weight > 0.0 ? fabs(error) / q.weight : 0.0;
+	}
+
+	struct Collapse // Moves vertex "from" onto vertex "to"
+	{
+		int from;
+		int to;
+		double error; // Mean squared distance from the merged planes
+	};
+
+	XMVECTOR TriangleNormal(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+	{
+		XMVECTOR p = XMLoadFloat3(&a);
+		return XMVector3Cross(XMLoadFloat3(&b) - p, XMLoadFloat3(&c) - p);
+	}
+
+	// Largest of worst and p's distance to each of the listed planes
+	double PlaneDistance(const std::vector<XMFLOAT4>& planes, const std::vector<int>& around, const XMFLOAT3& p, double worst)
+	{
+		for (size_t i = 0; i < around.size(); i++)
+		{
+			const XMFLOAT4& plane = planes[around[i]];
+			double distance = fabs((double)plane.x * p.x + (double)plane.y * p.y + (double)plane.z * p.z + plane.w);
+			if (distance > worst) worst = distance;
+		}
+		return worst;
+	}
+}
+
+std::vector<int> MeshOptimizer::Simplify(const std::vector<Vertex>& verts, const std::vector<int>& indices, size_t targetIndexCount, float maxError, float* resultError)
+{
+	std::vector<int> result = indices;
+	size_t vertexCount = verts.size();
+	if (resultError)
+	{
+		*resultError = 0.0f;
+	}
+	if (vertexCount == 0)
+	{
+		return result;
+	}
+
+	// Verts that share a position (the copies along UV and normal seams) get one id
+	std::vector<int> order(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		order[i] = (int)i;
+	}
+	std::sort(order.begin(), order.end(), [&verts](int a, int b)
+	{
+		const XMFLOAT3& p = verts[a].Position;
+		const XMFLOAT3& q = verts[b].Position;
+		return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+	});
+	std::vector<int> positionId(vertexCount);
+	std::vector<int> wedgeCount;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const XMFLOAT3& p = verts[order[i]].Position;
+		if (i == 0 || p.x != verts[order[i - 1]].Position.x || p.y != verts[order[i - 1]].Position.y || p.z != verts[order[i - 1]].Position.z)
+		{
+			wedgeCount.push_back(0);
+		}
+		positionId[order[i]] = (int)wedgeCount.size() - 1;
+		wedgeCount.back()++;
+	}
+	size_t positionCount = wedgeCount.size();
+
+	// Seams and open borders never move, which keeps them exactly where they were
+	std::vector<bool> locked(positionCount, false);
+	for (size_t i = 0; i < positionCount; i++)
+	{
+		locked[i] = wedgeCount[i] > 1;
+	}
+	std::vector<unsigned long long> edges;
+	edges.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned long long a = positionId[result[i + k]], b = positionId[result[i + (k + 1) % 3]];
+			edges.push_back((a << 32) | b);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		unsigned long long reverse = (edges[i] << 32) | (edges[i] >> 32);
+		if (!std::binary_search(edges.begin(), edges.end(), reverse)) // Nothing on the other side
+		{
+			locked[edges[i] >> 32] = true;
+			locked[edges[i] & 0xffffffff] = true;
+		}
+	}
+
+	// The quadrics only order the collapses. The error that is bounded and reported is the
+	// largest distance from a position to any original plane merged into it, unweighted
+	std::vector<Quadric> quadrics(positionCount);
+	memset(&quadrics[0], 0, positionCount * sizeof(Quadric));
+	std::vector<XMFLOAT4> planes(result.size() / 3, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	std::vector<std::vector<int>> planesAround(positionCount); // Original triangles merged into each position
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		XMVECTOR normal = TriangleNormal(verts[result[i]].Position, verts[result[i + 1]].Position, verts[result[i + 2]].Position);
+		float length = XMVectorGetX(XMVector3Length(normal));
+		if (length == 0.0f)
+		{
+			continue;
+		}
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, normal / length);
+		const XMFLOAT3& p = verts[result[i]].Position;
+		double d = -(n.x * p.x + n.y * p.y + n.z * p.z);
+		planes[i / 3] = XMFLOAT4(n.x, n.y, n.z, (float)d);
+		for (int k = 0; k < 3; k++)
+		{
+			AddPlane(quadrics[positionId[result[i + k]]], n.x, n.y, n.z, d, length * 0.5);
+			planesAround[positionId[result[i + k]]].push_back((int)(i / 3));
+		}
+	}
+
+	double maxErrorSq = (double)maxError * maxError;
+	double worstDistance = 0.0;
+	std::vector<int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<int> triStart(vertexCount + 1);
+	std::vector<int> tris;
+	while (result.size() > targetIndexCount)
+	{
+		// Triangles around each vertex
+		size_t triCount = result.size() / 3;
+		std::fill(triStart.begin(), triStart.end(), 0);
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			triStart[result[i] + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			triStart[v + 1] += triStart[v];
+		}
+		tris.resize(result.size());
+		std::vector<int> fill(triStart.begin(), triStart.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			tris[fill[result[i]]++] = (int)(i / 3);
+		}
+
+		// Every edge in both directions, cheapest first
+		std::vector<Collapse> collapses;
+		collapses.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			int a = result[i];
+			int b = result[i - i % 3 + (i + 1) % 3];
+			for (int direction = 0; direction < 2; direction++, std::swap(a, b))
+			{
+				if (locked[positionId[a]] || positionId[a] == positionId[b])
+				{
+					continue;
+				}
+				Quadric merged = quadrics[positionId[a]];
+				AddQuadric(merged, quadrics[positionId[b]]);
+				Collapse c = { a, b, QuadricError(merged, verts[b].Position) };
+				collapses.push_back(c);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		// Apply as many as possible without two collapses touching the same triangles
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = (int)v;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+		size_t trisToRemove = triCount - targetIndexCount / 3;
+		size_t removed = 0;
+		size_t applied = 0;
+		for (size_t i = 0; i < collapses.size() && removed < trisToRemove; i++)
+		{
+			const Collapse& c = collapses[i];
+			if (c.error > maxErrorSq)
+			{
+				break; // The mean is over the bound, so the largest distance is too
+			}
+			if (touched[c.from] || touched[c.to])
+			{
+				continue;
+			}
+			const XMFLOAT3& target = verts[c.to].Position;
+			double distance = PlaneDistance(planes, planesAround[positionId[c.from]], target, PlaneDistance(planes, planesAround[positionId[c.to]], target, 0.0));
+			if (distance > maxError)
+			{
+				continue;
+			}
+
+			// Skip collapses that would fold a triangle over
+			bool flips = false;
+			for (int t = triStart[c.from]; t < triStart[c.from + 1] && !flips; t++)
+			{
+				const int* tri = &result[tris[t] * 3];
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+				{
+					continue; // This one disappears
+				}
+				XMFLOAT3 moved[3];
+				for (int k = 0; k < 3; k++)
+				{
+					moved[k] = verts[tri[k] == c.from ? c.to : tri[k]].Position;
+				}
+				XMVECTOR before = TriangleNormal(verts[tri[0]].Position, verts[tri[1]].Position, verts[tri[2]].Position);
+				XMVECTOR after = TriangleNormal(moved[0], moved[1], moved[2]);
+				float dot = XMVectorGetX(XMVector3Dot(before, after));
+				flips = dot <= 0.25f * XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+			}
+			if (flips)
+			{
+				continue;
+			}
+
+			remap[c.from] = c.to;
+			AddQuadric(quadrics[positionId[c.to]], quadrics[positionId[c.from]]);
+			std::vector<int>& merged = planesAround[positionId[c.to]];
+			merged.insert(merged.end(), planesAround[positionId[c.from]].begin(), planesAround[positionId[c.from]].end());
+			planesAround[positionId[c.from]].clear();
+			for (int t = triStart[c.from]; t < triStart[c.from + 1]; t++)
+			{
+				const int* tri = &result[tris[t] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+				{
+					removed++;
+				}
+			}
+			if (distance > worstDistance) worstDistance = distance;
+			applied++;
+		}
+		if (applied == 0)
+		{
+			break; // Everything left is locked, flips or is over the error bound
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (a != b && b != c && a != c)
+			{
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	if (resultError)
+	{
+		*resultError = (float)worstDistance;
+	}
+	return result;
+}
+
+std::vector<Meshlet> MeshOptimizer::BuildMeshlets(const std::vector<Vertex>& verts, std::vector<int>& indices, size_t maxVertices, size_t maxTriangles)
+{
+	std::vector<Meshlet> meshlets;
+	size_t triangleCount = indices.size() / 3;
+	size_t vertexCount = verts.size();
+	if (triangleCount == 0)
+	{
+		return meshlets;
+	}
+
+	// Vertex to triangle adjacency, same layout as OptimizeVertexCache
+	std::vector<int> adjacencyStart(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacencyStart[indices[i] + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	}
+	std::vector<int> adjacency(triangleCount * 3);
+	std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			adjacency[fill[indices[t * 3 + c]]++] = (int)t;
+		}
+	}
+
+	// Unit face normals, zero for degenerate triangles
+	std::vector<XMFLOAT3> normals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		XMVECTOR n = TriangleNormal(verts[indices[t * 3]].Position, verts[indices[t * 3 + 1]].Position, verts[indices[t * 3 + 2]].Position);
+		XMStoreFloat3(&normals[t], XMVector3Normalize(n));
+		if (!(XMVectorGetX(XMVector3LengthSq(n)) > 0.0f))
+		{
+			normals[t] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		}
+	}
+
+	std::vector<bool> used(triangleCount, false);
+	std::vector<int> vertexMeshlet(vertexCount, -1); // Which meshlet last took each vertex
+	std::vector<int> output;
+	output.reserve(triangleCount * 3);
+	size_t scanCursor = 0; // Next triangle to seed a meshlet from, the input order already has good locality
+
+	std::vector<int> meshletVerts;
+	std::vector<int> meshletTris;
+	std::vector<int> candidates; // Unused triangles touching the meshlet
+	while (output.size() < triangleCount * 3)
+	{
+		while (used[scanCursor]) scanCursor++;
+
+		int id = (int)meshlets.size();
+		meshletVerts.clear();
+		meshletTris.clear();
+		candidates.clear();
+		XMVECTOR normalSum = XMVectorZero();
+
+		// Greedily grow from the seed, taking whichever touching triangle adds the fewest
+		// new verts, and of those the one closest to the meshlet's average normal
+		int next = (int)scanCursor;
+		while (next >= 0)
+		{
+			used[next] = true;
+			meshletTris.push_back(next);
+			normalSum += XMLoadFloat3(&normals[next]);
+			for (int c = 0; c < 3; c++)
+			{
+				int v = indices[next * 3 + c];
+				output.push_back(v);
+				if (vertexMeshlet[v] != id)
+				{
+					vertexMeshlet[v] = id;
+					meshletVerts.push_back(v);
+					for (int a = adjacencyStart[v]; a < adjacencyStart[v + 1]; a++)
+					{
+						if (!used[adjacency[a]]) candidates.push_back(adjacency[a]);
+					}
+				}
+			}
+			if (meshletTris.size() >= maxTriangles)
+			{
+				break;
+			}
+
+			XMVECTOR axis = XMVector3Normalize(normalSum);
+			next = -1;
+			float bestScore = FLT_MAX;
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				int t = candidates[i];
+				if (used[t])
+				{
+					candidates[i--] = candidates.back(); // Swap remove, taken since it was added
+					candidates.pop_back();
+					continue;
+				}
+				int newVerts = (vertexMeshlet[indices[t * 3]] != id) + (vertexMeshlet[indices[t * 3 + 1]] != id) + (vertexMeshlet[indices[t * 3 + 2]] != id);
+				if (meshletVerts.size() + newVerts > maxVertices)
+				{
+					continue;
+				}
+				float score = newVerts + 0.5f * (1.0f - XMVectorGetX(XMVector3Dot(axis, XMLoadFloat3(&normals[t]))));
+				if (score < bestScore)
+				{
+					bestScore = score;
+					next = t;
+				}
+			}
+		}
+
+		// Bounding sphere around the box center, then the tightest cone around the average normal
+		Meshlet m;
+		m.indexCount = (int)meshletTris.size() * 3;
+		m.indexOffset = (int)output.size() - m.indexCount;
+		m.vertexCount = (int)meshletVerts.size();
+		XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+		XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+		for (size_t i = 0; i < meshletVerts.size(); i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&verts[meshletVerts[i]].Position);
+			boundsMin = XMVectorMin(boundsMin, p);
+			boundsMax = XMVectorMax(boundsMax, p);
+		}
+		XMVECTOR center = XMVectorScale(boundsMin + boundsMax, 0.5f);
+		float radiusSq = 0.0f;
+		for (size_t i = 0; i < meshletVerts.size(); i++)
+		{
+			radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&verts[meshletVerts[i]].Position) - center)));
+		}
+		XMStoreFloat3(&m.center, center);
+		m.radius = sqrtf(radiusSq);
+
+		XMVECTOR axis = XMVector3Normalize(normalSum);
+		float cutoff = XMVectorGetX(XMVector3LengthSq(normalSum)) > 0.0f ? 1.0f : 0.0f;
+		for (size_t i = 0; i < meshletTris.size(); i++)
+		{
+			XMVECTOR n = XMLoadFloat3(&normals[meshletTris[i]]);
+			if (XMVectorGetX(XMVector3LengthSq(n)) > 0.0f) // Degenerate triangles never rasterize, so they can't be seen either way
+			{
+				cutoff = std::min(cutoff, XMVectorGetX(XMVector3Dot(axis, n)));
+			}
+		}
+		XMStoreFloat3(&m.coneAxis, axis);
+		m.coneCutoff = cutoff;
+		meshlets.push_back(m);
+	}
+
+	indices.swap(output);
+	return meshlets;
+}
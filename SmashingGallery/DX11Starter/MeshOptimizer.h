@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+#include "Meshlet.h"
+
+// --------------------------------------------------------
+// Result of simulating a FIFO post-transform vertex cache
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	float acmr; // Average cache miss ratio, transformed verts per triangle (0.5 is ideal, 3 is worst)
+	float atvr; // Average transform to vertex ratio, transformed verts per unique vert (1 is ideal)
+};
+
+// --------------------------------------------------------
+// CPU-side clean up passes run on mesh data before it is
+// uploaded by Mesh::FillBuffers
+// --------------------------------------------------------
+class MeshOptimizer
+{
+public:
+	// Merges vertices with identical position, UV and normal and
+	// rewrites the indices to match. Returns the new vertex count.
+	static size_t WeldVertices(std::vector<Vertex>& verts, std::vector<int>& indices);
+
+	// Reorders triangles to maximize post-transform cache hits (Forsyth's algorithm)
+	static void OptimizeVertexCache(std::vector<int>& indices, size_t vertexCount);
+
+	// Reorders clusters of an already cache optimized triangle list so
+	// outward facing clusters draw first, cutting overdraw (Tipsify style)
+	static void OptimizeOverdraw(std::vector<int>& indices, const std::vector<Vertex>& verts);
+
+	// Reorders the vertices into first-use order so fetches walk memory linearly
+	static void OptimizeVertexFetch(std::vector<Vertex>& verts, std::vector<int>& indices);
+
+	// Quadric error edge collapse down to targetIndexCount, stopping early rather than
+	// move any vertex further than maxError from the original planes it was merged from.
+	// resultError is the largest such distance. Seam and border verts never move, so UV
+	// and normal seams are kept. The verts are shared with the input, only indices change.
+	static std::vector<int> Simplify(const std::vector<Vertex>& verts, const std::vector<int>& indices, size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+	// Splits the triangles into meshlets of at most maxVertices unique verts and maxTriangles
+	// triangles, growing each one across shared edges. Reorders the indices so every meshlet
+	// is a contiguous range; run it after the cache and overdraw passes since it sets the order.
+	static std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& verts, std::vector<int>& indices, size_t maxVertices = 64, size_t maxTriangles = 124);
+
+	// Simulates a FIFO cache of the given size, GPUs are typically 16-32 entries
+	static VertexCacheStats AnalyzeVertexCache(const std::vector<int>& indices, size_t vertexCount, unsigned int cacheSize = 16);
+};
+
@@ -0,0 +1,64 @@
+#include "Meshlet.h"
+#include <cmath>
+using namespace DirectX;
+
+int MeshletCuller::Cull(const Meshlet* meshlets, int count, const Frustum& frustum, XMFLOAT3 cameraPosition, std::vector<DrawRange>& ranges, MeshletCullStats* stats)
+{
+	int visible = 0;
+	int frustumCulled = 0;
+	int backfaceCulled = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const Meshlet& m = meshlets[i];
+		if (!frustum.IntersectsSphere(m.center, m.radius))
+		{
+			frustumCulled += m.indexCount / 3;
+			continue;
+		}
+		if (IsBackfacing(m, cameraPosition))
+		{
+			backfaceCulled += m.indexCount / 3;
+			continue;
+		}
+
+		// Meshlets are stored back to back, so runs of visible ones are one draw
+		if (!ranges.empty() && ranges.back().indexOffset + ranges.back().indexCount == m.indexOffset)
+		{
+			ranges.back().indexCount += m.indexCount;
+		}
+		else
+		{
+			DrawRange range = { m.indexOffset, m.indexCount };
+			ranges.push_back(range);
+		}
+		visible += m.indexCount / 3;
+	}
+
+	if (stats)
+	{
+		stats->frustumCulled = frustumCulled;
+		stats->backfaceCulled = backfaceCulled;
+		stats->visible = visible;
+	}
+	return visible;
+}
+
+bool MeshletCuller::IsBackfacing(const Meshlet& meshlet, XMFLOAT3 cameraPosition)
+{
+	if (meshlet.coneCutoff <= 0.0f)
+	{
+		return false;
+	}
+
+	// A triangle faces away when dot(normal, point - camera) >= 0. Over every point in
+	// the sphere and every normal in the cone, the smallest that dot can be is
+	// distance * cos(viewAngle + coneAngle) - radius, so cull when that's still positive.
+	float vx = meshlet.center.x - cameraPosition.x;
+	float vy = meshlet.center.y - cameraPosition.y;
+	float vz = meshlet.center.z - cameraPosition.z;
+	float along = vx * meshlet.coneAxis.x + vy * meshlet.coneAxis.y + vz * meshlet.coneAxis.z;
+	float acrossSq = vx * vx + vy * vy + vz * vz - along * along;
+	float across = acrossSq > 0.0f ? sqrtf(acrossSq) : 0.0f;
+	float coneSine = sqrtf(1.0f - meshlet.coneCutoff * meshlet.coneCutoff);
+	return along * meshlet.coneCutoff - across * coneSine >= meshlet.radius;
+}
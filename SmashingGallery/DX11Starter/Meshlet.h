@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+#include "Frustum.h"
+
+// --------------------------------------------------------
+// A small cluster of a mesh's LOD 0 triangles, a contiguous
+// range of its index buffer
+//
+// Built by MeshOptimizer::BuildMeshlets with at most 64 unique
+// vertices and 124 triangles each. Everything is object space.
+// --------------------------------------------------------
+struct Meshlet
+{
+	int indexOffset;
+	int indexCount;
+	int vertexCount; // Unique vertices the triangles use
+	DirectX::XMFLOAT3 center; // Bounding sphere of the triangles
+	float radius;
+	DirectX::XMFLOAT3 coneAxis; // Every triangle normal is within the cone around this axis
+	float coneCutoff; // Cosine of the cone's half angle, 0 or less when it's too wide to ever cull
+};
+
+// A run of indices to pass to DrawIndexed
+struct DrawRange
+{
+	int indexOffset;
+	int indexCount;
+};
+
+// What a cull threw away, in triangles
+struct MeshletCullStats
+{
+	int frustumCulled;
+	int backfaceCulled;
+	int visible;
+};
+
+// --------------------------------------------------------
+// CPU culling of meshlets before drawing
+// --------------------------------------------------------
+class MeshletCuller
+{
+public:
+	// Tests every meshlet against the frustum and the camera, and appends the visible
+	// ones to ranges, merging neighbours into a single draw. The frustum and camera
+	// must be in the mesh's object space, see Frustum. Returns the visible triangle count.
+	static int Cull(const Meshlet* meshlets, int count, const Frustum& frustum, DirectX::XMFLOAT3 cameraPosition, std::vector<DrawRange>& ranges, MeshletCullStats* stats = nullptr);
+
+	static bool IsBackfacing(const Meshlet& meshlet, DirectX::XMFLOAT3 cameraPosition); // Every triangle faces away from the camera
+};
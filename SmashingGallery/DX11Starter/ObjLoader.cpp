@@ -0,0 +1,511 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include <thread>
+#include <fstream>
+#include <climits>
+#include <cmath>
+using namespace DirectX;
+
+namespace
+{
+	const size_t MinChunkBytes = 1 << 20; // Smaller files aren't worth a thread
+	const int MissingIndex = INT_MAX; // Face corner had no index for this attribute
+	const int RelativeBias = 1 << 30; // Negative (relative) indices are stored as (chunk local index - bias)
+
+	const double PowersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 }; // Exactly representable as doubles
+
+	double GetSeconds()
+	{
+		LARGE_INTEGER now, frequency;
+		QueryPerformanceCounter(&now);
+		QueryPerformanceFrequency(&frequency);
+		return (double)now.QuadPart / (double)frequency.QuadPart;
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	// Reads a decimal float with optional sign, fraction and exponent
+	const char* ParseFloat(const char* p, const char* end, float* out)
+	{
+		p = SkipSpaces(p, end);
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		unsigned long long mantissa = 0;
+		int digits = 0; // Significant digits kept in the mantissa, 19 always fit in 64 bits
+		int exponent = 0;
+		while (p < end && IsDigit(*p))
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) digits++;
+			}
+			else
+			{
+				exponent++; // Dropped a digit from the integer part
+			}
+			p++;
+		}
+		if (p < end && *p == '.')
+		{
+			p++;
+			while (p < end && IsDigit(*p))
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0) digits++;
+					exponent--;
+				}
+				p++;
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+'))
+			{
+				negativeExponent = *p == '-';
+				p++;
+			}
+			int e = 0;
+			while (p < end && IsDigit(*p))
+			{
+				if (e < 10000) e = e * 10 + (*p - '0');
+				p++;
+			}
+			exponent += negativeExponent ? -e : e;
+		}
+
+		double value = (double)mantissa;
+		if (exponent < 0)
+		{
+			value = -exponent <= 22 ? value / PowersOfTen[-exponent] : value * pow(10.0, exponent);
+		}
+		else if (exponent > 0)
+		{
+			value = exponent <= 22 ? value * PowersOfTen[exponent] : value * pow(10.0, exponent);
+		}
+		*out = (float)(negative ? -value : value);
+		return p;
+	}
+
+	// Reads a signed decimal integer, returns p unchanged if there are no digits
+	const char* ParseInt(const char* p, const char* end, int* out, bool* found)
+	{
+		bool negative = false;
+		const char* start = p;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+		int value = 0;
+		const char* digitsStart = p;
+		while (p < end && IsDigit(*p))
+		{
+			value = value * 10 + (*p - '0');
+			p++;
+		}
+		*found = p != digitsStart;
+		if (!*found)
+		{
+			return start;
+		}
+		*out = negative ? -value : value;
+		return p;
+	}
+
+	// Converts a raw OBJ index (1-based, or negative for relative) into the chunk encoding
+	inline int EncodeIndex(int raw, size_t localCount)
+	{
+		if (raw > 0) return raw - 1; // Absolute, 0-based
+		if (raw < 0) return (int)localCount + raw - RelativeBias; // Relative to what this chunk has seen so far
+		return MissingIndex;
+	}
+
+	inline int DecodeIndex(int encoded, size_t chunkBase, size_t total)
+	{
+		if (encoded == MissingIndex) return -1;
+		long long index = encoded >= 0 ? encoded : (long long)chunkBase + encoded + RelativeBias;
+		return (index >= 0 && index < (long long)total) ? (int)index : -1;
+	}
+}
+
+bool ObjLoader::Load(const char* objFile, std::vector<Vertex>& verts, std::vector<int>& indices, ObjLoadStats* stats)
+{
+	double startTime = GetSeconds();
+
+	MappedFile file(objFile);
+	if (!file.IsOpen())
+	{
+		return false;
+	}
+	Parse(file.GetData(), file.GetSize(), verts, indices, stats);
+
+	if (stats)
+	{
+		stats->seconds = GetSeconds() - startTime; // Include the time spent mapping
+	}
+	return true;
+}
+
+void ObjLoader::Parse(const char* data, size_t size, std::vector<Vertex>& verts, std::vector<int>& indices, ObjLoadStats* stats)
+{
+	double startTime = GetSeconds();
+
+	// Split the file into line-aligned chunks, one per thread
+	size_t chunkCount = std::thread::hardware_concurrency();
+	if (chunkCount < 1) chunkCount = 1;
+	if (chunkCount > size / MinChunkBytes) chunkCount = size / MinChunkBytes;
+	if (chunkCount < 1) chunkCount = 1;
+
+	std::vector<Chunk> chunks(chunkCount);
+	const char* fileEnd = data + size;
+	const char* chunkStart = data;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = fileEnd;
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = data + size * (i + 1) / chunkCount;
+			if (chunkEnd < chunkStart) chunkEnd = chunkStart;
+			while (chunkEnd < fileEnd && *chunkEnd != '\n') chunkEnd++; // Move to the end of the line
+			if (chunkEnd < fileEnd) chunkEnd++;
+		}
+		chunks[i].begin = chunkStart;
+		chunks[i].end = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+
+	// Parse every chunk, the first one on this thread
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		workers.push_back(std::thread(ParseChunk, &chunks[i]));
+	}
+	ParseChunk(&chunks[0]);
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	// Merge the attribute streams in file order
+	size_t positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		chunks[i].positionBase = positionCount;
+		chunks[i].uvBase = uvCount;
+		chunks[i].normalBase = normalCount;
+		chunks[i].cornerBase = cornerCount;
+		positionCount += chunks[i].positions.size();
+		uvCount += chunks[i].uvs.size();
+		normalCount += chunks[i].normals.size();
+		cornerCount += chunks[i].corners.size();
+	}
+
+	std::vector<XMFLOAT3> positions(positionCount);
+	std::vector<XMFLOAT2> uvs(uvCount);
+	std::vector<XMFLOAT3> normals(normalCount);
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		if (!chunks[i].positions.empty()) memcpy(&positions[chunks[i].positionBase], &chunks[i].positions[0], chunks[i].positions.size() * sizeof(XMFLOAT3));
+		if (!chunks[i].uvs.empty()) memcpy(&uvs[chunks[i].uvBase], &chunks[i].uvs[0], chunks[i].uvs.size() * sizeof(XMFLOAT2));
+		if (!chunks[i].normals.empty()) memcpy(&normals[chunks[i].normalBase], &chunks[i].normals[0], chunks[i].normals.size() * sizeof(XMFLOAT3));
+	}
+
+	// Resolve the corners into vertices, each chunk writes its own slice
+	verts.resize(cornerCount);
+	if (cornerCount > 0)
+	{
+		workers.clear();
+		for (size_t i = 1; i < chunkCount; i++)
+		{
+			workers.push_back(std::thread(BuildVertices, &chunks[i], std::cref(positions), std::cref(uvs), std::cref(normals), &verts[chunks[i].cornerBase]));
+		}
+		BuildVertices(&chunks[0], positions, uvs, normals, &verts[0]);
+		for (size_t i = 0; i < workers.size(); i++)
+		{
+			workers[i].join();
+		}
+	}
+
+	// One index per corner
+	indices.resize(cornerCount);
+	for (size_t i = 0; i < cornerCount; i++)
+	{
+		indices[i] = (int)i;
+	}
+
+	if (stats)
+	{
+		stats->bytes = size;
+		stats->triangles = cornerCount / 3;
+		stats->seconds = GetSeconds() - startTime;
+	}
+}
+
+void ObjLoader::ParseChunk(Chunk* chunk)
+{
+	const char* p = chunk->begin;
+	const char* end = chunk->end;
+	std::vector<Corner> polygon; // Corners of the face on the current line
+
+	while (p < end)
+	{
+		const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+		if (lineEnd == nullptr) lineEnd = end;
+
+		p = SkipSpaces(p, lineEnd);
+		if (lineEnd - p >= 2 && p[0] == 'v' && p[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			p = ParseFloat(p + 2, lineEnd, &norm.x);
+			p = ParseFloat(p, lineEnd, &norm.y);
+			p = ParseFloat(p, lineEnd, &norm.z);
+			chunk->normals.push_back(norm);
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'v' && p[1] == 't')
+		{
+			XMFLOAT2 uv;
+			p = ParseFloat(p + 2, lineEnd, &uv.x);
+			p = ParseFloat(p, lineEnd, &uv.y);
+			chunk->uvs.push_back(uv);
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			XMFLOAT3 pos;
+			p = ParseFloat(p + 1, lineEnd, &pos.x);
+			p = ParseFloat(p, lineEnd, &pos.y);
+			p = ParseFloat(p, lineEnd, &pos.z);
+			chunk->positions.push_back(pos);
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			// Corners look like v, v/vt, v//vn or v/vt/vn
+			polygon.clear();
+			p++;
+			while (true)
+			{
+				p = SkipSpaces(p, lineEnd);
+				int raw = 0;
+				bool found = false;
+				p = ParseInt(p, lineEnd, &raw, &found);
+				if (!found) break;
+
+				Corner corner;
+				corner.position = EncodeIndex(raw, chunk->positions.size());
+				corner.uv = MissingIndex;
+				corner.normal = MissingIndex;
+				if (p < lineEnd && *p == '/')
+				{
+					p++;
+					p = ParseInt(p, lineEnd, &raw, &found);
+					if (found) corner.uv = EncodeIndex(raw, chunk->uvs.size());
+					if (p < lineEnd && *p == '/')
+					{
+						p++;
+						p = ParseInt(p, lineEnd, &raw, &found);
+						if (found) corner.normal = EncodeIndex(raw, chunk->normals.size());
+					}
+				}
+				polygon.push_back(corner);
+			}
+
+			// Fan triangulate, flipping the winding order for DirectX
+			for (size_t i = 1; i + 1 < polygon.size(); i++)
+			{
+				chunk->corners.push_back(polygon[0]);
+				chunk->corners.push_back(polygon[i + 1]);
+				chunk->corners.push_back(polygon[i]);
+			}
+		}
+
+		p = lineEnd + 1;
+	}
+}
+
+void ObjLoader::BuildVertices(const Chunk* chunk, const std::vector<XMFLOAT3>& positions, const std::vector<XMFLOAT2>& uvs, const std::vector<XMFLOAT3>& normals, Vertex* out)
+{
+	for (size_t i = 0; i < chunk->corners.size(); i++)
+	{
+		const Corner& c = chunk->corners[i];
+		int p = DecodeIndex(c.position, chunk->positionBase, positions.size());
+		int t = DecodeIndex(c.uv, chunk->uvBase, uvs.size());
+		int n = DecodeIndex(c.normal, chunk->normalBase, normals.size());
+
+		Vertex v;
+		v.Position = p >= 0 ? positions[p] : XMFLOAT3(0, 0, 0);
+		v.UV = t >= 0 ? uvs[t] : XMFLOAT2(0, 0);
+		v.Normal = n >= 0 ? normals[n] : XMFLOAT3(0, 0, 0);
+		v.Tangent = XMFLOAT3(0, 0, 0);
+
+		// Convert from the right-handed OBJ space to DirectX,
+		// and flip the UV since (0,0) is the top left for us
+		v.Position.z *= -1.0f;
+		v.Normal.z *= -1.0f;
+		v.UV.y = 1.0f - v.UV.y;
+
+		out[i] = v;
+	}
+}
+
+bool ObjLoader::LoadLegacy(const char* objFile, std::vector<Vertex>& verts, std::vector<int>& indices, ObjLoadStats* stats)
+{
+	double startTime = GetSeconds();
+
+	// File input object
+	std::ifstream obj(objFile);
+
+	// Check for successful open
+	if (!obj.is_open())
+	{
+		return false;
+	}
+
+	std::vector<XMFLOAT3> positions;     // Positions from the file
+	std::vector<XMFLOAT3> normals;       // Normals from the file
+	std::vector<XMFLOAT2> uvs;           // UVs from the file
+	unsigned int vertCounter = 0;        // Count of vertices/indices
+	char chars[100];                     // String for line reading
+	size_t bytes = 0;
+
+	// Still have data left?
+	while (obj.good())
+	{
+		// Get the line (100 characters should be more than enough)
+		obj.getline(chars, 100);
+		bytes += (size_t)obj.gcount();
+
+		// Check the type of line
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			sscanf_s(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+			normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			XMFLOAT2 uv;
+			sscanf_s(chars, "vt %f %f", &uv.x, &uv.y);
+			uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			XMFLOAT3 pos;
+			sscanf_s(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+			positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			// Read the face indices into an array
+			unsigned int i[12];
+			int facesRead = sscanf_s(
+				chars,
+				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2],
+				&i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8],
+				&i[9], &i[10], &i[11]);
+
+			Vertex v[4];
+			int cornerCount = facesRead == 12 ? 4 : 3;
+			for (int c = 0; c < cornerCount; c++)
+			{
+				// OBJ File indices are 1-based, so they need to be adusted
+				v[c].Position = positions[i[c * 3] - 1];
+				v[c].UV = uvs[i[c * 3 + 1] - 1];
+				v[c].Normal = normals[i[c * 3 + 2] - 1];
+				v[c].Tangent = XMFLOAT3(0, 0, 0);
+
+				// Flip the UV, Z pos and normal
+				v[c].UV.y = 1.0f - v[c].UV.y;
+				v[c].Position.z *= -1.0f;
+				v[c].Normal.z *= -1.0f;
+			}
+
+			// Add the verts to the vector (flipping the winding order)
+			verts.push_back(v[0]);
+			verts.push_back(v[2]);
+			verts.push_back(v[1]);
+			indices.push_back(vertCounter++);
+			indices.push_back(vertCounter++);
+			indices.push_back(vertCounter++);
+
+			// Was there a 4th face?
+			if (cornerCount == 4)
+			{
+				verts.push_back(v[0]);
+				verts.push_back(v[3]);
+				verts.push_back(v[2]);
+				indices.push_back(vertCounter++);
+				indices.push_back(vertCounter++);
+				indices.push_back(vertCounter++);
+			}
+		}
+	}
+
+	if (stats)
+	{
+		stats->bytes = bytes;
+		stats->triangles = vertCounter / 3;
+		stats->seconds = GetSeconds() - startTime;
+	}
+	return true;
+}
+
+bool ObjLoader::WriteSyntheticObj(const char* objFile, int rings, int segments)
+{
+	std::ofstream obj(objFile);
+	if (!obj.is_open())
+	{
+		return false;
+	}
+
+	char line[128];
+	for (int r = 0; r <= rings; r++) // One vertex per grid point, seam and poles duplicated like a DCC export
+	{
+		float phi = XM_PI * r / rings;
+		for (int s = 0; s <= segments; s++)
+		{
+			float theta = XM_2PI * s / segments;
+			float x = sinf(phi) * cosf(theta);
+			float y = cosf(phi);
+			float z = sinf(phi) * sinf(theta);
+			obj.write(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x, y, z));
+			obj.write(line, snprintf(line, sizeof(line), "vt %.6f %.6f\n", (float)s / segments, 1.0f - (float)r / rings));
+			obj.write(line, snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", x, y, z));
+		}
+	}
+
+	for (int r = 0; r < rings; r++)
+	{
+		for (int s = 0; s < segments; s++)
+		{
+			int a = r * (segments + 1) + s + 1;
+			int b = a + segments + 1;
+			obj.write(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, a + 1, a + 1, a + 1, b + 1, b + 1, b + 1, b, b, b));
+		}
+	}
+	return obj.good();
+}
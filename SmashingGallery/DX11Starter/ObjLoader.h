@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Size and timing info filled in by an OBJ import
+// --------------------------------------------------------
+struct ObjLoadStats
+{
+	size_t bytes; // Size of the source file
+	size_t triangles; // Triangles produced after triangulating the faces
+	double seconds; // Wall clock time for the whole import
+};
+
+// --------------------------------------------------------
+// OBJ importer for large meshes
+//
+// The file is memory mapped and split into line-aligned
+// chunks, each chunk is parsed on its own thread with a hand
+// written number scanner, and the chunks are merged back in
+// file order so the result matches a serial parse exactly.
+//
+// Output is in DirectX space: Z and normal Z are flipped,
+// UVs are flipped vertically and the winding is reversed.
+// --------------------------------------------------------
+class ObjLoader
+{
+public:
+	static bool Load(const char* objFile, std::vector<Vertex>& verts, std::vector<int>& indices, ObjLoadStats* stats = nullptr);
+	static void Parse(const char* data, size_t size, std::vector<Vertex>& verts, std::vector<int>& indices, ObjLoadStats* stats = nullptr); // Parses OBJ text that is already in memory
+	static bool LoadLegacy(const char* objFile, std::vector<Vertex>& verts, std::vector<int>& indices, ObjLoadStats* stats = nullptr); // Original getline/sscanf parser, kept as a benchmark baseline
+	static bool WriteSyntheticObj(const char* objFile, int rings, int segments); // Writes a UV sphere with quad faces for import benchmarks
+
+private:
+	struct Corner // One face corner, indices are encoded by ParseChunk
+	{
+		int position;
+		int uv;
+		int normal;
+	};
+
+	struct Chunk // Everything parsed out of one line-aligned slice of the file
+	{
+		const char* begin;
+		const char* end;
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<DirectX::XMFLOAT2> uvs;
+		std::vector<DirectX::XMFLOAT3> normals;
+		std::vector<Corner> corners; // Three per triangle, already in DirectX winding order
+		size_t positionBase; // Counts of data in all earlier chunks, filled in during the merge
+		size_t uvBase;
+		size_t normalBase;
+		size_t cornerBase;
+	};
+
+	static void ParseChunk(Chunk* chunk);
+	static void BuildVertices(const Chunk* chunk, const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<DirectX::XMFLOAT2>& uvs, const std::vector<DirectX::XMFLOAT3>& normals, Vertex* out);
+};
+
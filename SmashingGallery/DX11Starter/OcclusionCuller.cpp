@@ -0,0 +1,289 @@
+#include "OcclusionCuller.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include "SimdLanes.h"
+using namespace DirectX;
+using namespace SimdLanes;
+
+namespace
+{
+	// Offsets of each lane's pixel center from the start of its span
+	inline Lanes PixelCenters()
+	{
+		static const float centers[8] = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+		return Load(centers);
+	}
+
+	// A triangle edge as A * x + B * y + C, positive on the inside once Rasterize has evened out the winding
+	struct Edge
+	{
+		float a, b, c;
+	};
+
+	inline Edge MakeEdge(const XMFLOAT3& from, const XMFLOAT3& to)
+	{
+		Edge e;
+		e.a = from.y - to.y;
+		e.b = to.x - from.x;
+		e.c = -(e.a * from.x + e.b * from.y);
+		return e;
+	}
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+{
+	this->width = (width + TileSize - 1) / TileSize * TileSize;
+	this->height = (height + TileSize - 1) / TileSize * TileSize;
+	tilesWide = this->width / TileSize;
+	tilesHigh = this->height / TileSize;
+	depth.assign(this->width * this->height, 1.0f);
+	tileMaxDepth.assign(tilesWide * tilesHigh, 1.0f);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	triangleCount = 0;
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+void OcclusionCuller::Begin(const XMFLOAT4X4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.0f);
+	triangleCount = 0;
+}
+
+void OcclusionCuller::RenderOccluder(const XMFLOAT3* positions, int vertexCount, const int* indices, int indexCount, const XMFLOAT4X4& world)
+{
+	// Every vertex once, straight to clip space
+	XMMATRIX worldViewProjection = XMLoadFloat4x4(&world) * XMLoadFloat4x4(&viewProjection);
+	clipPositions.resize(vertexCount);
+	for (int i = 0; i < vertexCount; i++)
+	{
+		XMStoreFloat4(&clipPositions[i], XMVector4Transform(XMVectorSetW(XMLoadFloat3(&positions[i]), 1.0f), worldViewProjection));
+	}
+	for (int i = 0; i + 2 < indexCount; i += 3)
+	{
+		RasterizeClipped(clipPositions[indices[i]], clipPositions[indices[i + 1]], clipPositions[indices[i + 2]]);
+	}
+}
+
+void OcclusionCuller::Finish()
+{
+	for (int ty = 0; ty < tilesHigh; ty++)
+	{
+		for (int tx = 0; tx < tilesWide; tx++)
+		{
+			float farthest = 0.0f;
+			for (int y = ty * TileSize; y < (ty + 1) * TileSize; y++)
+			{
+				const float* row = &depth[y * width + tx * TileSize];
+				for (int x = 0; x < TileSize; x++)
+				{
+					farthest = row[x] > farthest ? row[x] : farthest;
+				}
+			}
+			tileMaxDepth[ty * tilesWide + tx] = farthest;
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax) const
+{
+	// Screen rectangle and nearest depth of all eight corners
+	XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+	float left = FLT_MAX, top = FLT_MAX, right = -FLT_MAX, bottom = -FLT_MAX;
+	float nearest = FLT_MAX;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		XMVECTOR point = XMVectorSet(corner & 1 ? boxMax.x : boxMin.x, corner & 2 ? boxMax.y : boxMin.y, corner & 4 ? boxMax.z : boxMin.z, 1.0f);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(point, matrix));
+		if (clip.z < 0.0f)
+		{
+			return true; // Reaches past the near plane, the camera could be inside it
+		}
+		XMFLOAT3 screen = ToScreen(clip);
+		left = screen.x < left ? screen.x : left;
+		right = screen.x > right ? screen.x : right;
+		top = screen.y < top ? screen.y : top;
+		bottom = screen.y > bottom ? screen.y : bottom;
+		nearest = screen.z < nearest ? screen.z : nearest;
+	}
+
+	// Every pixel the rectangle touches, not just the centers inside it
+	if (right < 0.0f || bottom < 0.0f || left >= (float)width || top >= (float)height)
+	{
+		return false; // Off screen
+	}
+	int firstX = left < 0.0f ? 0 : (int)left;
+	int firstY = top < 0.0f ? 0 : (int)top;
+	int lastX = right >= (float)width ? width - 1 : (int)right;
+	int lastY = bottom >= (float)height ? height - 1 : (int)bottom;
+	if (firstX > lastX || firstY > lastY)
+	{
+		return false;
+	}
+
+	for (int ty = firstY / TileSize; ty <= lastY / TileSize; ty++)
+	{
+		for (int tx = firstX / TileSize; tx <= lastX / TileSize; tx++)
+		{
+			if (nearest > tileMaxDepth[ty * tilesWide + tx])
+			{
+				continue; // Behind everything in this tile
+			}
+			int x0 = tx * TileSize > firstX ? tx * TileSize : firstX;
+			int x1 = (tx + 1) * TileSize - 1 < lastX ? (tx + 1) * TileSize - 1 : lastX;
+			int y0 = ty * TileSize > firstY ? ty * TileSize : firstY;
+			int y1 = (ty + 1) * TileSize - 1 < lastY ? (ty + 1) * TileSize - 1 : lastY;
+			for (int y = y0; y <= y1; y++)
+			{
+				const float* row = &depth[y * width];
+				for (int x = x0; x <= x1; x++)
+				{
+					if (nearest <= row[x])
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+int OcclusionCuller::CullSpheres(const SphereBatch& spheres, std::vector<int>& visible) const
+{
+	int kept = 0;
+	for (size_t i = 0; i < visible.size(); i++)
+	{
+		int index = visible[i];
+		float r = spheres.radius[index];
+		XMFLOAT3 boxMin(spheres.centerX[index] - r, spheres.centerY[index] - r, spheres.centerZ[index] - r);
+		XMFLOAT3 boxMax(spheres.centerX[index] + r, spheres.centerY[index] + r, spheres.centerZ[index] + r);
+		if (IsVisible(boxMin, boxMax))
+		{
+			visible[kept++] = index;
+		}
+	}
+	visible.resize(kept);
+	return kept;
+}
+
+int OcclusionCuller::GetWidth() const
+{
+	return width;
+}
+
+int OcclusionCuller::GetHeight() const
+{
+	return height;
+}
+
+const float* OcclusionCuller::GetDepth() const
+{
+	return &depth[0];
+}
+
+int OcclusionCuller::GetTriangleCount() const
+{
+	return triangleCount;
+}
+
+void OcclusionCuller::RasterizeClipped(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c)
+{
+	// Only the near plane needs real clipping, the rest is just scissoring to the screen
+	const XMFLOAT4* corners[3] = { &a, &b, &c };
+	XMFLOAT4 clipped[4];
+	int count = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		const XMFLOAT4& from = *corners[i];
+		const XMFLOAT4& to = *corners[(i + 1) % 3];
+		if (from.z >= 0.0f)
+		{
+			clipped[count++] = from;
+		}
+		if ((from.z >= 0.0f) != (to.z >= 0.0f))
+		{
+			float t = from.z / (from.z - to.z);
+			clipped[count++] = XMFLOAT4(from.x + (to.x - from.x) * t, from.y + (to.y - from.y) * t, 0.0f, from.w + (to.w - from.w) * t);
+		}
+	}
+	for (int i = 1; i + 1 < count; i++)
+	{
+		Rasterize(ToScreen(clipped[0]), ToScreen(clipped[i]), ToScreen(clipped[i + 1]));
+	}
+}
+
+void OcclusionCuller::Rasterize(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+{
+	float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+	if (!(area != 0.0f))
+	{
+		return; // Edge on, or NaN from a degenerate clip
+	}
+	const XMFLOAT3& p0 = a;
+	const XMFLOAT3& p1 = area > 0.0f ? b : c; // Drawn two sided, so flip the winding of back faces
+	const XMFLOAT3& p2 = area > 0.0f ? c : b;
+	area = area > 0.0f ? area : -area;
+
+	// Pixels whose centers fall in the bounding box, clamped to the screen
+	float minX = p0.x < p1.x ? (p0.x < p2.x ? p0.x : p2.x) : (p1.x < p2.x ? p1.x : p2.x);
+	float maxX = p0.x > p1.x ? (p0.x > p2.x ? p0.x : p2.x) : (p1.x > p2.x ? p1.x : p2.x);
+	float minY = p0.y < p1.y ? (p0.y < p2.y ? p0.y : p2.y) : (p1.y < p2.y ? p1.y : p2.y);
+	float maxY = p0.y > p1.y ? (p0.y > p2.y ? p0.y : p2.y) : (p1.y > p2.y ? p1.y : p2.y);
+	if (maxX < 0.5f || maxY < 0.5f || minX > width - 0.5f || minY > height - 0.5f)
+	{
+		return;
+	}
+	int firstX = minX < 0.5f ? 0 : (int)ceilf(minX - 0.5f);
+	int firstY = minY < 0.5f ? 0 : (int)ceilf(minY - 0.5f);
+	int lastX = maxX > width - 0.5f ? width - 1 : (int)floorf(maxX - 0.5f);
+	int lastY = maxY > height - 0.5f ? height - 1 : (int)floorf(maxY - 0.5f);
+	if (firstX > lastX || firstY > lastY)
+	{
+		return;
+	}
+	triangleCount++;
+
+	// Edge functions, and depth as a plane over the screen from the barycentric weights
+	Edge e0 = MakeEdge(p1, p2); // Zero along the edge opposite p0
+	Edge e1 = MakeEdge(p2, p0);
+	Edge e2 = MakeEdge(p0, p1);
+	float zA = (e0.a * p0.z + e1.a * p1.z + e2.a * p2.z) / area;
+	float zB = (e0.b * p0.z + e1.b * p1.z + e2.b * p2.z) / area;
+	float zC = p0.z - zA * p0.x - zB * p0.y;
+
+	Lanes e0a = Splat(e0.a), e1a = Splat(e1.a), e2a = Splat(e2.a), za = Splat(zA);
+	Lanes zero = Splat(0.0f);
+	int alignedX = firstX / LaneCount * LaneCount; // Rows are a whole number of lanes wide, so this never runs off the end
+	for (int y = firstY; y <= lastY; y++)
+	{
+		float centerY = y + 0.5f;
+		Lanes e0Row = Splat(e0.b * centerY + e0.c);
+		Lanes e1Row = Splat(e1.b * centerY + e1.c);
+		Lanes e2Row = Splat(e2.b * centerY + e2.c);
+		Lanes zRow = Splat(zB * centerY + zC);
+		float* row = &depth[y * width];
+		for (int x = alignedX; x <= lastX; x += LaneCount)
+		{
+			Lanes centerX = Add(Splat((float)x), PixelCenters());
+			Lanes inside = And(And(NotLess(Add(Mul(e0a, centerX), e0Row), zero),
+				NotLess(Add(Mul(e1a, centerX), e1Row), zero)),
+				NotLess(Add(Mul(e2a, centerX), e2Row), zero));
+			Lanes z = Add(Mul(za, centerX), zRow);
+			Lanes stored = Load(row + x);
+			Store(row + x, Select(inside, Min(stored, z), stored));
+		}
+	}
+}
+
+XMFLOAT3 OcclusionCuller::ToScreen(const XMFLOAT4& clip) const
+{
+	float inverseW = 1.0f / clip.w;
+	return XMFLOAT3((clip.x * inverseW * 0.5f + 0.5f) * width, (0.5f - clip.y * inverseW * 0.5f) * height, clip.z * inverseW);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Frustum.h"
+
+// --------------------------------------------------------
+// Software occlusion culling on the CPU
+//
+// Between Begin and Finish, big opaque meshes are rasterized
+// into a small depth buffer, several pixels at a time in SIMD.
+// Finish then keeps the farthest depth of every 8x8 tile, so
+// IsVisible can usually settle a box with a few tile reads,
+// and only looks at single pixels in tiles where it's close.
+//
+// A box is hidden only when its nearest point is behind the
+// occluders at every pixel its screen rectangle touches.
+// Occluders are sampled at pixel centers like the GPU does,
+// so the buffer should be a fair fraction of the real screen.
+// Depth runs 0 at the near plane to 1 at the far plane, and
+// occluders are drawn two sided.
+//
+// Nothing here touches Direct3D, so it runs anywhere, and the
+// depth buffer can be read back to check it against known
+// results.
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	OcclusionCuller(int width, int height); // Both rounded up to a multiple of the tile size
+	~OcclusionCuller();
+
+	void Begin(const DirectX::XMFLOAT4X4& viewProjection); // Clears to the far plane, the matrix is row vector, not the transposed shader copy
+	void RenderOccluder(const DirectX::XMFLOAT3* positions, int vertexCount, const int* indices, int indexCount, const DirectX::XMFLOAT4X4& world); // Triangle list, world is row vector too
+	void Finish(); // Builds the tile depths, call before testing
+
+	bool IsVisible(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax) const; // World space box, false only if it's entirely behind occluders or off screen
+	int CullSpheres(const SphereBatch& spheres, std::vector<int>& visible) const; // Drops the indices in visible whose spheres' boxes are hidden, keeps the order, returns how many are left
+
+	int GetWidth() const;
+	int GetHeight() const;
+	const float* GetDepth() const; // Row by row from the top left, width * height
+	int GetTriangleCount() const; // Rasterized since Begin, after near plane clipping
+
+	static const int TileSize = 8;
+
+private:
+	int width;
+	int height;
+	int tilesWide;
+	int tilesHigh;
+	DirectX::XMFLOAT4X4 viewProjection;
+	std::vector<float> depth;
+	std::vector<float> tileMaxDepth; // Farthest depth in each tile
+	std::vector<DirectX::XMFLOAT4> clipPositions; // Scratch for the occluder being drawn
+	int triangleCount;
+
+	void RasterizeClipped(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, const DirectX::XMFLOAT4& c); // Clips against the near plane first
+	void Rasterize(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, const DirectX::XMFLOAT3& c); // Screen x and y in pixels, z is depth
+	DirectX::XMFLOAT3 ToScreen(const DirectX::XMFLOAT4& clip) const;
+};
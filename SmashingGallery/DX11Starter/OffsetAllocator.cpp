@@ -0,0 +1,169 @@
+#include "OffsetAllocator.h"
+
+OffsetAllocator::OffsetAllocator(int capacity)
+{
+	this->capacity = 0;
+	used = 0;
+	Grow(capacity);
+}
+
+OffsetAllocator::~OffsetAllocator()
+{
+}
+
+int OffsetAllocator::Allocate(int size)
+{
+	if (size <= 0)
+	{
+		return -1;
+	}
+
+	// Smallest free range that fits, so big ranges stay whole for big meshes
+	std::multimap<int, int>::iterator fit = freeBySize.lower_bound(size);
+	if (fit == freeBySize.end())
+	{
+		return -1;
+	}
+	int offset = fit->second;
+	int rangeSize = fit->first;
+	RemoveFreeRange(freeByOffset.find(offset));
+	if (rangeSize > size)
+	{
+		AddFreeRange(offset + size, rangeSize - size); // Nothing free can touch it, so this never merges
+	}
+
+	int handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (int)blocks.size();
+		blocks.push_back(Block());
+	}
+	blocks[handle].offset = offset;
+	blocks[handle].size = size;
+	blocks[handle].live = true;
+	used += size;
+	return handle;
+}
+
+void OffsetAllocator::Free(int handle)
+{
+	if (handle < 0 || handle >= (int)blocks.size() || !blocks[handle].live)
+	{
+		return;
+	}
+	blocks[handle].live = false;
+	used -= blocks[handle].size;
+	AddFreeRange(blocks[handle].offset, blocks[handle].size);
+	freeHandles.push_back(handle);
+}
+
+int OffsetAllocator::GetOffset(int handle)
+{
+	return blocks[handle].offset;
+}
+
+int OffsetAllocator::GetSize(int handle)
+{
+	return blocks[handle].size;
+}
+
+int OffsetAllocator::GetCapacity()
+{
+	return capacity;
+}
+
+int OffsetAllocator::GetUsed()
+{
+	return used;
+}
+
+int OffsetAllocator::GetLargestFree()
+{
+	return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+}
+
+void OffsetAllocator::Grow(int newCapacity)
+{
+	if (newCapacity <= capacity)
+	{
+		return;
+	}
+	AddFreeRange(capacity, newCapacity - capacity);
+	capacity = newCapacity;
+}
+
+std::vector<OffsetMove> OffsetAllocator::Defragment()
+{
+	// Live blocks in offset order, each slid down to where the last one ended
+	std::map<int, int> live; // Offset to handle
+	for (int i = 0; i < (int)blocks.size(); i++)
+	{
+		if (blocks[i].live) live[blocks[i].offset] = i;
+	}
+
+	std::vector<OffsetMove> moves;
+	moves.reserve(live.size());
+	int end = 0;
+	for (std::map<int, int>::iterator it = live.begin(); it != live.end(); ++it)
+	{
+		Block& block = blocks[it->second];
+		OffsetMove move = { it->second, block.offset, end, block.size };
+		moves.push_back(move);
+		block.offset = end;
+		end += block.size;
+	}
+
+	freeByOffset.clear();
+	freeBySize.clear();
+	if (end < capacity)
+	{
+		AddFreeRange(end, capacity - end);
+	}
+	return moves;
+}
+
+void OffsetAllocator::AddFreeRange(int offset, int size)
+{
+	// Merge with the free range right after this one
+	std::map<int, int>::iterator next = freeByOffset.find(offset + size);
+	if (next != freeByOffset.end())
+	{
+		size += next->second;
+		RemoveFreeRange(next);
+	}
+
+	// And with the one right before
+	std::map<int, int>::iterator previous = freeByOffset.lower_bound(offset);
+	if (previous != freeByOffset.begin())
+	{
+		--previous;
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			RemoveFreeRange(previous);
+		}
+	}
+
+	freeByOffset[offset] = size;
+	freeBySize.insert(std::make_pair(size, offset));
+}
+
+void OffsetAllocator::RemoveFreeRange(std::map<int, int>::iterator range)
+{
+	std::pair<std::multimap<int, int>::iterator, std::multimap<int, int>::iterator> sameSize = freeBySize.equal_range(range->second);
+	for (std::multimap<int, int>::iterator it = sameSize.first; it != sameSize.second; ++it)
+	{
+		if (it->second == range->first)
+		{
+			freeBySize.erase(it);
+			break;
+		}
+	}
+	freeByOffset.erase(range);
+}
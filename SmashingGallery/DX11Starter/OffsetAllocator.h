@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <map>
+
+// A block that Defragment moved, so its owner can copy the data along
+struct OffsetMove
+{
+	int handle;
+	int from;
+	int to;
+	int size;
+};
+
+// --------------------------------------------------------
+// Hands out ranges of a linear space [0, capacity)
+//
+// Knows nothing about what the space holds, GeometryPool uses
+// one for vertices and one for indices. Allocations are best
+// fit and freed ranges merge with their neighbours. Callers
+// keep handles rather than offsets, since Defragment (and
+// only Defragment) moves blocks.
+// --------------------------------------------------------
+class OffsetAllocator
+{
+public:
+	OffsetAllocator(int capacity);
+	~OffsetAllocator();
+
+	int Allocate(int size); // Handle of the new block, or -1 when no free range is big enough
+	void Free(int handle);
+
+	int GetOffset(int handle);
+	int GetSize(int handle);
+	int GetCapacity();
+	int GetUsed(); // Total size of every live block
+	int GetLargestFree(); // The biggest Allocate that can succeed right now
+
+	void Grow(int newCapacity); // Adds free space at the end, nothing moves
+	std::vector<OffsetMove> Defragment(); // Packs every live block to the front in order, returns all of them
+
+private:
+	struct Block
+	{
+		int offset;
+		int size;
+		bool live;
+	};
+
+	std::vector<Block> blocks; // Indexed by handle
+	std::vector<int> freeHandles; // Handles of dead blocks, reused first
+	std::map<int, int> freeByOffset; // Free ranges, offset to size, never touching each other
+	std::multimap<int, int> freeBySize; // The same ranges, size to offset, for best fit
+	int capacity;
+	int used;
+
+	void AddFreeRange(int offset, int size); // Merges with neighbours
+	void RemoveFreeRange(std::map<int, int>::iterator range);
+};
@@ -0,0 +1,156 @@
+#include "PackedVertex.h"
+#include <d3dcompiler.h>
+#include <DirectXPackedVector.h>
+#include <cmath>
+#include <cfloat>
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+const float VertexPacker::MaxDirectionErrorDegrees = 1.0f;
+const float VertexPacker::MaxUVRelativeError = 1.0f / 2048.0f;
+
+namespace
+{
+	const D3D11_INPUT_ELEMENT_DESC PackedLayout[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // xy normal, zw tangent
+	};
+
+	inline float SignNotZero(float f)
+	{
+		return f >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	inline signed char ToSnorm8(float f)
+	{
+		if (f > 1.0f) f = 1.0f;
+		if (f < -1.0f) f = -1.0f;
+		return (signed char)(f * 127.0f + (f >= 0.0f ? 0.5f : -0.5f));
+	}
+
+	inline unsigned short ToUnorm16(float f)
+	{
+		if (!(f > 0.0f)) f = 0.0f; // Also catches NaN from a flat axis
+		if (f > 1.0f) f = 1.0f;
+		return (unsigned short)(f * 65535.0f + 0.5f);
+	}
+}
+
+void VertexPacker::Pack(const Vertex* verts, int count, std::vector<PackedVertex>& packed, XMFLOAT3& positionOffset, XMFLOAT3& positionScale)
+{
+	XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = 0; i < count; i++)
+	{
+		const XMFLOAT3& p = verts[i].Position;
+		boundsMin = XMFLOAT3(min(boundsMin.x, p.x), min(boundsMin.y, p.y), min(boundsMin.z, p.z));
+		boundsMax = XMFLOAT3(max(boundsMax.x, p.x), max(boundsMax.y, p.y), max(boundsMax.z, p.z));
+	}
+	if (count == 0)
+	{
+		boundsMin = boundsMax = XMFLOAT3(0, 0, 0);
+	}
+
+	// UNORM reads back as 0-1, so the scale is just the box size
+	positionOffset = boundsMin;
+	positionScale = XMFLOAT3(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z);
+
+	packed.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		const Vertex& v = verts[i];
+		PackedVertex& out = packed[i];
+		out.Position[0] = ToUnorm16((v.Position.x - boundsMin.x) / positionScale.x);
+		out.Position[1] = ToUnorm16((v.Position.y - boundsMin.y) / positionScale.y);
+		out.Position[2] = ToUnorm16((v.Position.z - boundsMin.z) / positionScale.z);
+		out.Position[3] = 0;
+		out.UV[0] = XMConvertFloatToHalf(v.UV.x);
+		out.UV[1] = XMConvertFloatToHalf(v.UV.y);
+		OctEncode(v.Normal, out.Normal);
+		OctEncode(v.Tangent, out.Tangent);
+	}
+}
+
+Vertex VertexPacker::Unpack(const PackedVertex& packed, const XMFLOAT3& positionOffset, const XMFLOAT3& positionScale)
+{
+	Vertex v;
+	v.Position.x = packed.Position[0] / 65535.0f * positionScale.x + positionOffset.x;
+	v.Position.y = packed.Position[1] / 65535.0f * positionScale.y + positionOffset.y;
+	v.Position.z = packed.Position[2] / 65535.0f * positionScale.z + positionOffset.z;
+	v.UV.x = XMConvertHalfToFloat(packed.UV[0]);
+	v.UV.y = XMConvertHalfToFloat(packed.UV[1]);
+	v.Normal = OctDecode(packed.Normal);
+	v.Tangent = OctDecode(packed.Tangent);
+	return v;
+}
+
+void VertexPacker::OctEncode(const XMFLOAT3& direction, signed char out[2])
+{
+	// Project onto the octahedron, then fold the lower half over the upper one
+	float length = fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z);
+	if (length == 0.0f)
+	{
+		out[0] = out[1] = 0;
+		return;
+	}
+	float x = direction.x / length;
+	float y = direction.y / length;
+	if (direction.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+		y = (1.0f - fabsf(x)) * SignNotZero(y);
+		x = foldedX;
+	}
+
+	// Try both roundings of each component and keep whichever decodes closest
+	XMVECTOR target = XMVector3Normalize(XMLoadFloat3(&direction));
+	float bestDot = -2.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		float cx = (i & 1 ? ceilf(x * 127.0f) : floorf(x * 127.0f)) / 127.0f;
+		float cy = (i & 2 ? ceilf(y * 127.0f) : floorf(y * 127.0f)) / 127.0f;
+		signed char candidate[2] = { ToSnorm8(cx), ToSnorm8(cy) };
+		XMFLOAT3 decoded = OctDecode(candidate);
+		float dot = XMVectorGetX(XMVector3Dot(target, XMLoadFloat3(&decoded)));
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			out[0] = candidate[0];
+			out[1] = candidate[1];
+		}
+	}
+}
+
+XMFLOAT3 VertexPacker::OctDecode(const signed char in[2])
+{
+	// SNORM maps -128 and -127 both to -1, same as the GPU does
+	float x = max(in[0] / 127.0f, -1.0f);
+	float y = max(in[1] / 127.0f, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f)
+	{
+		float unfoldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+		y = (1.0f - fabsf(x)) * SignNotZero(y);
+		x = unfoldedX;
+	}
+
+	XMFLOAT3 direction;
+	XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+	return direction;
+}
+
+ID3D11InputLayout* VertexPacker::CreateInputLayout(ID3D11Device* device, const wchar_t* shaderFile)
+{
+	ID3DBlob* shaderBlob = nullptr;
+	if (D3DReadFileToBlob(shaderFile, &shaderBlob) != S_OK)
+	{
+		return nullptr;
+	}
+
+	ID3D11InputLayout* inputLayout = nullptr;
+	device->CreateInputLayout(PackedLayout, sizeof(PackedLayout) / sizeof(PackedLayout[0]), shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), &inputLayout);
+	shaderBlob->Release();
+	return inputLayout;
+}
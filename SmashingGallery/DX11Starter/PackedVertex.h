@@ -0,0 +1,49 @@
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A 16 byte vertex for meshes loaded with MESH_PACK_VERTICES
+//
+// Position is 16 bit UNORM across the mesh's bounding box, so
+// the shader needs positionOffset and positionScale to undo it.
+// UVs are half floats. Normal and tangent are octahedral
+// encoded into 8 bits per component.
+//
+// Worst case round-trip error (checked by Benchmarks::VertexPacking):
+//  - position: half a step, box extent / 131070 per axis plus float rounding
+//  - UV: relative 2^-11 for |uv| in [2^-14, 2048), absolute 2^-25 below that
+//  - normal and tangent: 1 degree
+// --------------------------------------------------------
+struct PackedVertex
+{
+	unsigned short Position[4]; // R16G16B16A16_UNORM, w unused
+	unsigned short UV[2]; // R16G16_FLOAT
+	signed char Normal[2]; // R8G8B8A8_SNORM together with the tangent
+	signed char Tangent[2];
+};
+
+// --------------------------------------------------------
+// Converts between Vertex and PackedVertex
+// --------------------------------------------------------
+class VertexPacker
+{
+public:
+	// Packs every vertex, positions are quantized across the verts' own bounds.
+	// Outputs what the shader needs to get object space positions back:
+	// position = packed * positionScale + positionOffset
+	static void Pack(const Vertex* verts, int count, std::vector<PackedVertex>& packed, DirectX::XMFLOAT3& positionOffset, DirectX::XMFLOAT3& positionScale);
+	static Vertex Unpack(const PackedVertex& packed, const DirectX::XMFLOAT3& positionOffset, const DirectX::XMFLOAT3& positionScale);
+
+	static void OctEncode(const DirectX::XMFLOAT3& direction, signed char out[2]); // Picks the rounding with the smallest angular error
+	static DirectX::XMFLOAT3 OctDecode(const signed char in[2]);
+
+	// Input layout matching PackedVertex for the given compiled vertex shader, nullptr on failure
+	static ID3D11InputLayout* CreateInputLayout(ID3D11Device* device, const wchar_t* shaderFile);
+
+	static const float MaxDirectionErrorDegrees; // Documented bounds that the self check holds the packer to
+	static const float MaxUVRelativeError;
+};
@@ -0,0 +1,1013 @@
+#include "PhysicsWorld.h"
+#include <algorithm>
+#include <cmath>
+using namespace DirectX;
+
+namespace
+{
+	const float Friction = 0.5f;
+	const float Restitution = 0.2f;
+	const float RestitutionSpeed = 1.0f; // Slower impacts don't bounce, or resting contacts would never settle
+	const float PositionCorrection = 0.2f; // Fraction of an overlap pushed back out each step
+	const float AllowedOverlap = 0.005f; // Left alone, so resting contacts stay touching from one step to the next
+	const float ContactMargin = 0.02f; // Contacts start this far before bodies touch, on top of how far they could close in a step
+	const float MatchDistance = 0.05f; // A contact this close to one between the same bodies last step is taken to be the same one
+	const float LinearDamping = 0.05f; // Per second
+	const float AngularDamping = 0.2f;
+	const float SleepLinearSpeed = 0.05f; // Slower than both counts as still
+	const float SleepAngularSpeed = 0.1f;
+	const float TimeToSleep = 0.5f;
+	const int SolverIterations = 8;
+
+	XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z);
+	}
+
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Scale(const XMFLOAT3& a, float s)
+	{
+		return XMFLOAT3(a.x * s, a.y * s, a.z * s);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	float LengthSquared(const XMFLOAT3& a)
+	{
+		return Dot(a, a);
+	}
+
+	float Component(const XMFLOAT3& v, int axis)
+	{
+		return (&v.x)[axis];
+	}
+
+	float Sign(float x)
+	{
+		return x < 0.0f ? -1.0f : 1.0f;
+	}
+
+	XMFLOAT3 Rotate(const XMFLOAT4& q, const XMFLOAT3& v)
+	{
+		XMFLOAT3 axis(q.x, q.y, q.z);
+		XMFLOAT3 t = Scale(Cross(axis, v), 2.0f);
+		return Add(Add(v, Scale(t, q.w)), Cross(axis, t));
+	}
+
+	XMFLOAT3 InverseRotate(const XMFLOAT4& q, const XMFLOAT3& v)
+	{
+		return Rotate(XMFLOAT4(-q.x, -q.y, -q.z, q.w), v);
+	}
+
+	void GetAxes(const XMFLOAT4& q, XMFLOAT3* axes)
+	{
+		axes[0] = Rotate(q, XMFLOAT3(1.0f, 0.0f, 0.0f));
+		axes[1] = Rotate(q, XMFLOAT3(0.0f, 1.0f, 0.0f));
+		axes[2] = Rotate(q, XMFLOAT3(0.0f, 0.0f, 1.0f));
+	}
+
+	XMFLOAT3 Multiply(const XMFLOAT3* rows, const XMFLOAT3& v)
+	{
+		return XMFLOAT3(Dot(rows[0], v), Dot(rows[1], v), Dot(rows[2], v));
+	}
+
+	float Project(const XMFLOAT3* axes, const XMFLOAT3& extents, const XMFLOAT3& direction) // Half the box's length along direction
+	{
+		return extents.x * fabsf(Dot(axes[0], direction)) + extents.y * fabsf(Dot(axes[1], direction)) + extents.z * fabsf(Dot(axes[2], direction));
+	}
+
+	int ClipPolygon(const XMFLOAT3* points, int count, const XMFLOAT3& normal, float offset, XMFLOAT3* clipped) // Keeps the part where dot(normal, p) <= offset
+	{
+		int kept = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const XMFLOAT3& from = points[i];
+			const XMFLOAT3& to = points[(i + 1) % count];
+			float fromDistance = Dot(normal, from) - offset;
+			float toDistance = Dot(normal, to) - offset;
+			if (fromDistance <= 0.0f)
+			{
+				clipped[kept++] = from;
+			}
+			if ((fromDistance <= 0.0f) != (toDistance <= 0.0f))
+			{
+				clipped[kept++] = Add(from, Scale(Subtract(to, from), fromDistance / (fromDistance - toDistance)));
+			}
+		}
+		return kept;
+	}
+}
+
+PhysicsWorld::PhysicsWorld(XMFLOAT3 gravity)
+{
+	this->gravity = gravity;
+	bodyCount = 0;
+	islandCount = 0;
+}
+
+PhysicsWorld::~PhysicsWorld()
+{
+}
+
+int PhysicsWorld::AddSphere(const XMFLOAT3& position, float radius, float mass, int userData)
+{
+	return AddBody(position, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT3(radius, radius, radius), mass, SHAPE_SPHERE, userData);
+}
+
+int PhysicsWorld::AddBox(const XMFLOAT3& position, const XMFLOAT4& rotation, const XMFLOAT3& halfExtents, float mass, int userData)
+{
+	return AddBody(position, rotation, halfExtents, mass, SHAPE_BOX, userData);
+}
+
+int PhysicsWorld::AddPlane(const XMFLOAT3& normal, float offset)
+{
+	Plane plane;
+	plane.normal = normal;
+	plane.offset = offset;
+	plane.body = AddBody(Scale(normal, offset), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f, SHAPE_PLANE, -1);
+	planes.push_back(plane);
+	return plane.body;
+}
+
+int PhysicsWorld::AddBody(const XMFLOAT3& position, const XMFLOAT4& rotation, const XMFLOAT3& halfExtents, float mass, int shape, int userData)
+{
+	int id;
+	if (freeBodies.empty())
+	{
+		id = (int)bodies.size();
+		bodies.push_back(Body());
+	}
+	else
+	{
+		id = freeBodies.back();
+		freeBodies.pop_back();
+	}
+	Body& body = bodies[id];
+	body.position = position;
+	body.rotation = rotation;
+	body.linearVelocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	body.angularVelocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	body.halfExtents = halfExtents;
+	body.inverseMass = mass > 0.0f ? 1.0f / mass : 0.0f;
+	body.inverseInertia = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	if (mass > 0.0f && shape == SHAPE_SPHERE)
+	{
+		float inverse = 1.0f / (0.4f * mass * halfExtents.x * halfExtents.x);
+		body.inverseInertia = XMFLOAT3(inverse, inverse, inverse);
+	}
+	else if (mass > 0.0f && shape == SHAPE_BOX)
+	{
+		float x = halfExtents.x * halfExtents.x, y = halfExtents.y * halfExtents.y, z = halfExtents.z * halfExtents.z;
+		body.inverseInertia = XMFLOAT3(3.0f / (mass * (y + z)), 3.0f / (mass * (x + z)), 3.0f / (mass * (x + y)));
+	}
+	UpdateInertia(body);
+	body.sleepTime = 0.0f;
+	body.shape = shape;
+	body.userData = userData;
+	body.proxy = shape != SHAPE_PLANE ? tree.CreateProxy(GetBox(body), id) : -1;
+	body.awakeIndex = -1;
+	body.islandNext = id;
+	bodyCount++;
+
+	if (mass > 0.0f)
+	{
+		body.awakeIndex = (int)awake.size();
+		awake.push_back(id);
+	}
+	else
+	{
+		WakeTouching(id); // Static bodies never look for contacts themselves, so whatever sleeps where it lands has to
+	}
+	return id;
+}
+
+void PhysicsWorld::Remove(int body)
+{
+	// Its island and anything resting on it have to find out it's gone
+	Wake(body);
+	WakeTouching(body);
+	Body& removed = bodies[body];
+	if (removed.proxy != -1)
+	{
+		tree.DestroyProxy(removed.proxy);
+	}
+	if (removed.awakeIndex != -1)
+	{
+		int last = awake.back();
+		awake[removed.awakeIndex] = last;
+		bodies[last].awakeIndex = removed.awakeIndex;
+		awake.pop_back();
+	}
+	removed.shape = -1;
+	removed.awakeIndex = -1;
+	freeBodies.push_back(body);
+	bodyCount--;
+
+	for (size_t i = 0; i < planes.size(); i++)
+	{
+		if (planes[i].body == body)
+		{
+			planes.erase(planes.begin() + i);
+			break;
+		}
+	}
+	auto touches = [body](const Contact& contact) { return contact.bodyA == body || contact.bodyB == body; };
+	contacts.erase(std::remove_if(contacts.begin(), contacts.end(), touches), contacts.end());
+	previousContacts.erase(std::remove_if(previousContacts.begin(), previousContacts.end(), touches), previousContacts.end());
+	moved.erase(std::remove(moved.begin(), moved.end(), body), moved.end());
+}
+
+void PhysicsWorld::SetTransform(int body, const XMFLOAT3& position, const XMFLOAT4& rotation)
+{
+	WakeTouching(body); // Where it was
+	Body& moving = bodies[body];
+	moving.position = position;
+	moving.rotation = rotation;
+	UpdateInertia(moving);
+	if (moving.proxy != -1)
+	{
+		tree.MoveProxy(moving.proxy, GetBox(moving), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	}
+	WakeTouching(body); // And where it is now, which wakes it too
+	moving.sleepTime = 0.0f;
+}
+
+void PhysicsWorld::SetVelocity(int body, const XMFLOAT3& linear, const XMFLOAT3& angular)
+{
+	Body& moving = bodies[body];
+	if (moving.inverseMass == 0.0f)
+	{
+		return;
+	}
+	Wake(body);
+	moving.linearVelocity = linear;
+	moving.angularVelocity = angular;
+	moving.sleepTime = 0.0f;
+}
+
+void PhysicsWorld::ApplyImpulse(int body, const XMFLOAT3& impulse, const XMFLOAT3& point)
+{
+	Body& moving = bodies[body];
+	if (moving.inverseMass == 0.0f)
+	{
+		return;
+	}
+	Wake(body);
+	UpdateInertia(moving);
+	moving.linearVelocity = Add(moving.linearVelocity, Scale(impulse, moving.inverseMass));
+	moving.angularVelocity = Add(moving.angularVelocity, Multiply(moving.inverseInertiaWorld, Cross(Subtract(point, moving.position), impulse)));
+	moving.sleepTime = 0.0f;
+}
+
+void PhysicsWorld::Step(float deltaTime)
+{
+	if (deltaTime <= 0.0f)
+	{
+		return;
+	}
+
+	// Gravity and damping, then each awake body's box stretched along where it's heading
+	for (size_t i = 0; i < awake.size(); i++)
+	{
+		Body& body = bodies[awake[i]];
+		body.linearVelocity = Scale(Add(body.linearVelocity, Scale(gravity, deltaTime)), 1.0f / (1.0f + deltaTime * LinearDamping));
+		body.angularVelocity = Scale(body.angularVelocity, 1.0f / (1.0f + deltaTime * AngularDamping));
+		tree.MoveProxy(body.proxy, GetBox(body), Scale(body.linearVelocity, deltaTime));
+	}
+
+	// How far a body's surface could move this step, so contacts start before anything gets there
+	auto reach = [deltaTime](const Body& body)
+	{
+		float radius = body.shape == SHAPE_SPHERE ? body.halfExtents.x : sqrtf(LengthSquared(body.halfExtents));
+		return (sqrtf(LengthSquared(body.linearVelocity)) + sqrtf(LengthSquared(body.angularVelocity)) * radius) * deltaTime;
+	};
+
+	// Every pair is found once, by whichever of two awake bodies comes first, or by the awake one.
+	// A sleeping body that turns out to be touched wakes onto the end of the list, so its own contacts get found too.
+	previousContacts.swap(contacts);
+	contacts.clear();
+	for (size_t i = 0; i < awake.size(); i++)
+	{
+		int a = awake[i];
+		float reachA = reach(bodies[a]);
+		tree.QueryBox(tree.GetFatBox(bodies[a].proxy), [&](int proxy)
+		{
+			int b = tree.GetUserData(proxy);
+			const Body& other = bodies[b];
+			if (b == a || (other.awakeIndex != -1 && other.awakeIndex < (int)i))
+			{
+				return true;
+			}
+			size_t before = contacts.size();
+			Collide(a, b, ContactMargin + reachA + reach(other));
+			if (contacts.size() != before)
+			{
+				Wake(b);
+			}
+			return true;
+		});
+		for (size_t p = 0; p < planes.size(); p++)
+		{
+			CollidePlane(a, planes[p], ContactMargin + reachA);
+		}
+	}
+
+	// Sorted, so the same pairs solve in the same order every run, and so last step's contacts can be found by pair
+	std::stable_sort(contacts.begin(), contacts.end(), [](const Contact& x, const Contact& y) { return x.key < y.key; });
+	size_t previous = 0;
+	for (size_t c = 0; c < contacts.size(); c++)
+	{
+		Contact& contact = contacts[c];
+		while (previous < previousContacts.size() && previousContacts[previous].key < contact.key)
+		{
+			previous++;
+		}
+		float nearest = MatchDistance * MatchDistance;
+		for (size_t p = previous; p < previousContacts.size() && previousContacts[p].key == contact.key; p++)
+		{
+			float distanceSquared = LengthSquared(Subtract(previousContacts[p].point, contact.point));
+			if (distanceSquared < nearest)
+			{
+				nearest = distanceSquared;
+				contact.normalImpulse = previousContacts[p].normalImpulse;
+				contact.tangentImpulse1 = previousContacts[p].tangentImpulse1;
+				contact.tangentImpulse2 = previousContacts[p].tangentImpulse2;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < awake.size(); i++)
+	{
+		UpdateInertia(bodies[awake[i]]);
+	}
+	PrepareContacts(deltaTime);
+	for (int iteration = 0; iteration < SolverIterations; iteration++)
+	{
+		SolveContacts();
+	}
+
+	for (size_t i = 0; i < awake.size(); i++)
+	{
+		Body& body = bodies[awake[i]];
+		body.position = Add(body.position, Scale(body.linearVelocity, deltaTime));
+
+		// dq/dt = w q / 2, with w as a quaternion with no real part
+		XMFLOAT4& q = body.rotation;
+		XMFLOAT3 w = body.angularVelocity;
+		XMFLOAT3 imaginary(q.x, q.y, q.z);
+		XMFLOAT3 change = Add(Scale(w, q.w), Cross(w, imaginary));
+		float half = 0.5f * deltaTime;
+		q = XMFLOAT4(q.x + change.x * half, q.y + change.y * half, q.z + change.z * half, q.w - Dot(w, imaginary) * half);
+		float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		q = XMFLOAT4(q.x / length, q.y / length, q.z / length, q.w / length);
+	}
+
+	UpdateIslands(deltaTime);
+}
+
+XMFLOAT3 PhysicsWorld::GetPosition(int body) const
+{
+	return bodies[body].position;
+}
+
+XMFLOAT4 PhysicsWorld::GetRotation(int body) const
+{
+	return bodies[body].rotation;
+}
+
+XMFLOAT3 PhysicsWorld::GetLinearVelocity(int body) const
+{
+	return bodies[body].linearVelocity;
+}
+
+XMFLOAT3 PhysicsWorld::GetAngularVelocity(int body) const
+{
+	return bodies[body].angularVelocity;
+}
+
+int PhysicsWorld::GetUserData(int body) const
+{
+	return bodies[body].userData;
+}
+
+bool PhysicsWorld::IsAwake(int body) const
+{
+	return bodies[body].awakeIndex != -1;
+}
+
+const std::vector<int>& PhysicsWorld::GetMovedBodies() const
+{
+	return moved;
+}
+
+int PhysicsWorld::GetBodyCount() const
+{
+	return bodyCount;
+}
+
+int PhysicsWorld::GetAwakeCount() const
+{
+	return (int)awake.size();
+}
+
+int PhysicsWorld::GetContactCount() const
+{
+	return (int)contacts.size();
+}
+
+int PhysicsWorld::GetIslandCount() const
+{
+	return islandCount;
+}
+
+Aabb PhysicsWorld::GetBox(const Body& body) const
+{
+	if (body.shape == SHAPE_SPHERE)
+	{
+		return Aabb::FromSphere(body.position, body.halfExtents.x);
+	}
+	XMFLOAT3 axes[3];
+	GetAxes(body.rotation, axes);
+	XMFLOAT3 extents(
+		fabsf(axes[0].x) * body.halfExtents.x + fabsf(axes[1].x) * body.halfExtents.y + fabsf(axes[2].x) * body.halfExtents.z,
+		fabsf(axes[0].y) * body.halfExtents.x + fabsf(axes[1].y) * body.halfExtents.y + fabsf(axes[2].y) * body.halfExtents.z,
+		fabsf(axes[0].z) * body.halfExtents.x + fabsf(axes[1].z) * body.halfExtents.y + fabsf(axes[2].z) * body.halfExtents.z);
+	Aabb box;
+	box.min = Subtract(body.position, extents);
+	box.max = Add(body.position, extents);
+	return box;
+}
+
+void PhysicsWorld::UpdateInertia(Body& body)
+{
+	// R I^-1 R^T, with the rotation's columns being the body's axes
+	XMFLOAT3 axes[3];
+	GetAxes(body.rotation, axes);
+	for (int row = 0; row < 3; row++)
+	{
+		body.inverseInertiaWorld[row] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		for (int k = 0; k < 3; k++)
+		{
+			body.inverseInertiaWorld[row] = Add(body.inverseInertiaWorld[row], Scale(axes[k], Component(axes[k], row) * Component(body.inverseInertia, k)));
+		}
+	}
+}
+
+void PhysicsWorld::Wake(int body)
+{
+	if (bodies[body].inverseMass == 0.0f || bodies[body].awakeIndex != -1)
+	{
+		return;
+	}
+	int member = body;
+	do
+	{
+		Body& waking = bodies[member];
+		int next = waking.islandNext;
+		waking.islandNext = member;
+		waking.awakeIndex = (int)awake.size();
+		waking.sleepTime = 0.0f;
+		awake.push_back(member);
+		member = next;
+	} while (member != body);
+}
+
+void PhysicsWorld::WakeTouching(int body)
+{
+	Wake(body);
+	if (bodies[body].proxy == -1)
+	{
+		// Planes aren't in the tree and reach everywhere, so everything has to check again
+		for (size_t i = 0; i < bodies.size(); i++)
+		{
+			if (bodies[i].shape != -1)
+			{
+				Wake((int)i);
+			}
+		}
+		return;
+	}
+	tree.QueryBox(tree.GetFatBox(bodies[body].proxy), [&](int proxy)
+	{
+		Wake(tree.GetUserData(proxy));
+		return true;
+	});
+}
+
+void PhysicsWorld::UpdateIslands(float deltaTime)
+{
+	// Awake bodies touching through contacts are one island, static bodies and planes don't join them up
+	int count = (int)awake.size();
+	moved = awake;
+	islandParents.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		islandParents[i] = i;
+	}
+	for (size_t c = 0; c < contacts.size(); c++)
+	{
+		const Body& a = bodies[contacts[c].bodyA];
+		const Body& b = bodies[contacts[c].bodyB];
+		if (a.inverseMass > 0.0f && b.inverseMass > 0.0f)
+		{
+			int rootA = FindRoot(islandParents, a.awakeIndex);
+			int rootB = FindRoot(islandParents, b.awakeIndex);
+			islandParents[std::max(rootA, rootB)] = std::min(rootA, rootB);
+		}
+	}
+
+	// An island sleeps once its least still body has been still long enough
+	islandSleepTimes.assign(count, TimeToSleep);
+	islandCount = 0;
+	for (int i = 0; i < count; i++)
+	{
+		Body& body = bodies[awake[i]];
+		bool still = LengthSquared(body.linearVelocity) < SleepLinearSpeed * SleepLinearSpeed && LengthSquared(body.angularVelocity) < SleepAngularSpeed * SleepAngularSpeed;
+		body.sleepTime = still ? body.sleepTime + deltaTime : 0.0f;
+		int root = FindRoot(islandParents, i);
+		islandSleepTimes[root] = std::min(islandSleepTimes[root], body.sleepTime);
+		islandCount += root == i ? 1 : 0;
+	}
+
+	// Sleeping islands go into a loop through their bodies, for waking them all together.
+	// The rest stay awake, packed down in the order they were.
+	islandHeads.assign(count, -1);
+	islandTails.assign(count, -1);
+	int kept = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int id = awake[i];
+		Body& body = bodies[id];
+		int root = FindRoot(islandParents, i);
+		if (islandSleepTimes[root] < TimeToSleep)
+		{
+			body.awakeIndex = kept;
+			awake[kept++] = id;
+			continue;
+		}
+		body.linearVelocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		body.angularVelocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		body.awakeIndex = -1;
+		body.islandNext = islandHeads[root] != -1 ? islandHeads[root] : id;
+		islandTails[root] = islandTails[root] != -1 ? islandTails[root] : id;
+		islandHeads[root] = id;
+		tree.MoveProxy(body.proxy, GetBox(body), XMFLOAT3(0.0f, 0.0f, 0.0f)); // Where it came to rest, it won't be moved again until it wakes
+	}
+	awake.resize(kept);
+	for (int root = 0; root < count; root++)
+	{
+		if (islandTails[root] != -1)
+		{
+			bodies[islandTails[root]].islandNext = islandHeads[root];
+		}
+	}
+}
+
+int PhysicsWorld::FindRoot(std::vector<int>& parents, int i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]]; // Halve the path on the way up
+		i = parents[i];
+	}
+	return i;
+}
+
+void PhysicsWorld::Collide(int a, int b, float margin)
+{
+	const Body& bodyA = bodies[a];
+	const Body& bodyB = bodies[b];
+	if (bodyA.shape == SHAPE_SPHERE && bodyB.shape == SHAPE_SPHERE)
+	{
+		XMFLOAT3 offset = Subtract(bodyB.position, bodyA.position);
+		float radii = bodyA.halfExtents.x + bodyB.halfExtents.x;
+		float distanceSquared = LengthSquared(offset);
+		if (distanceSquared > (radii + margin) * (radii + margin))
+		{
+			return;
+		}
+		float distance = sqrtf(distanceSquared);
+		XMFLOAT3 normal = distance > 1e-6f ? Scale(offset, 1.0f / distance) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+		float separation = distance - radii;
+		AddContact(a, b, Add(bodyA.position, Scale(normal, bodyA.halfExtents.x + separation * 0.5f)), normal, separation);
+	}
+	else if (bodyA.shape == SHAPE_SPHERE)
+	{
+		CollideSphereBox(a, b, margin);
+	}
+	else if (bodyB.shape == SHAPE_SPHERE)
+	{
+		CollideSphereBox(b, a, margin);
+	}
+	else
+	{
+		CollideBoxes(a, b, margin);
+	}
+}
+
+void PhysicsWorld::CollidePlane(int body, const Plane& plane, float margin)
+{
+	const Body& colliding = bodies[body];
+	if (colliding.shape == SHAPE_SPHERE)
+	{
+		float separation = Dot(plane.normal, colliding.position) - plane.offset - colliding.halfExtents.x;
+		if (separation <= margin)
+		{
+			AddContact(plane.body, body, Subtract(colliding.position, Scale(plane.normal, colliding.halfExtents.x + separation * 0.5f)), plane.normal, separation);
+		}
+		return;
+	}
+
+	// Every corner close enough, which is the four of a face lying flat
+	XMFLOAT3 axes[3];
+	GetAxes(colliding.rotation, axes);
+	for (int corner = 0; corner < 8; corner++)
+	{
+		XMFLOAT3 point = colliding.position;
+		for (int k = 0; k < 3; k++)
+		{
+			point = Add(point, Scale(axes[k], ((corner >> k) & 1 ? 1.0f : -1.0f) * Component(colliding.halfExtents, k)));
+		}
+		float separation = Dot(plane.normal, point) - plane.offset;
+		if (separation <= margin)
+		{
+			AddContact(plane.body, body, Subtract(point, Scale(plane.normal, separation * 0.5f)), plane.normal, separation);
+		}
+	}
+}
+
+void PhysicsWorld::CollideSphereBox(int sphere, int box, float margin)
+{
+	// In the box's space the closest point is the center clamped to the box
+	const Body& ball = bodies[sphere];
+	const Body& block = bodies[box];
+	float radius = ball.halfExtents.x;
+	XMFLOAT3 local = InverseRotate(block.rotation, Subtract(ball.position, block.position));
+	XMFLOAT3 closest(
+		std::max(-block.halfExtents.x, std::min(local.x, block.halfExtents.x)),
+		std::max(-block.halfExtents.y, std::min(local.y, block.halfExtents.y)),
+		std::max(-block.halfExtents.z, std::min(local.z, block.halfExtents.z)));
+	XMFLOAT3 outside = Subtract(local, closest);
+	float distanceSquared = LengthSquared(outside);
+	XMFLOAT3 normal;
+	float separation;
+	if (distanceSquared > 0.0f)
+	{
+		if (distanceSquared > (radius + margin) * (radius + margin))
+		{
+			return;
+		}
+		float distance = sqrtf(distanceSquared);
+		normal = Scale(outside, 1.0f / distance);
+		separation = distance - radius;
+	}
+	else
+	{
+		// The center is inside, so out through the nearest face
+		int axis = 0;
+		float depth = block.halfExtents.x - fabsf(local.x);
+		for (int k = 1; k < 3; k++)
+		{
+			float faceDepth = Component(block.halfExtents, k) - fabsf(Component(local, k));
+			if (faceDepth < depth)
+			{
+				axis = k;
+				depth = faceDepth;
+			}
+		}
+		normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		(&normal.x)[axis] = Sign(Component(local, axis));
+		(&closest.x)[axis] = Sign(Component(local, axis)) * Component(block.halfExtents, axis);
+		separation = -depth - radius;
+	}
+	normal = Rotate(block.rotation, normal);
+	XMFLOAT3 surface = Add(block.position, Rotate(block.rotation, closest));
+	AddContact(box, sphere, Add(surface, Scale(normal, separation * 0.5f)), normal, separation);
+}
+
+void PhysicsWorld::CollideBoxes(int a, int b, float margin)
+{
+	const Body& bodyA = bodies[a];
+	const Body& bodyB = bodies[b];
+	XMFLOAT3 axes[2][3];
+	GetAxes(bodyA.rotation, axes[0]);
+	GetAxes(bodyB.rotation, axes[1]);
+	const XMFLOAT3* extents[2] = { &bodyA.halfExtents, &bodyB.halfExtents };
+	XMFLOAT3 offset = Subtract(bodyB.position, bodyA.position);
+
+	// Separating axes: each box's face normals and the nine pairs of edges. Any gap wider than the margin
+	// means no contact, otherwise the least separated face of each box and pair of edges are kept.
+	float faceSeparation[2] = { -1e30f, -1e30f };
+	int faceAxis[2] = { 0, 0 };
+	XMFLOAT3 faceNormal[2]; // From A to B
+	for (int box = 0; box < 2; box++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			const XMFLOAT3& axis = axes[box][i];
+			float distance = Dot(offset, axis);
+			float separation = fabsf(distance) - Project(axes[0], *extents[0], axis) - Project(axes[1], *extents[1], axis);
+			if (separation > margin)
+			{
+				return;
+			}
+			if (separation > faceSeparation[box])
+			{
+				faceSeparation[box] = separation;
+				faceAxis[box] = i;
+				faceNormal[box] = distance < 0.0f ? Scale(axis, -1.0f) : axis;
+			}
+		}
+	}
+	float edgeSeparation = -1e30f;
+	int edgeA = -1, edgeB = -1;
+	XMFLOAT3 edgeNormal;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			XMFLOAT3 axis = Cross(axes[0][i], axes[1][j]);
+			float lengthSquared = LengthSquared(axis);
+			if (lengthSquared < 1e-6f)
+			{
+				continue; // Parallel edges, which the faces already cover
+			}
+			axis = Scale(axis, 1.0f / sqrtf(lengthSquared));
+			float distance = Dot(offset, axis);
+			float separation = fabsf(distance) - Project(axes[0], *extents[0], axis) - Project(axes[1], *extents[1], axis);
+			if (separation > margin)
+			{
+				return;
+			}
+			if (separation > edgeSeparation)
+			{
+				edgeSeparation = separation;
+				edgeA = i;
+				edgeB = j;
+				edgeNormal = distance < 0.0f ? Scale(axis, -1.0f) : axis;
+			}
+		}
+	}
+
+	// Faces give steadier contacts, so B's face or an edge pair only wins by a clear margin
+	int reference = faceSeparation[1] > 0.98f * faceSeparation[0] + 0.001f ? 1 : 0;
+	if (edgeA != -1 && edgeSeparation > 0.98f * faceSeparation[reference] + 0.01f)
+	{
+		// The two edges nearest each other along the normal, touching where their lines come closest
+		XMFLOAT3 pointA = bodyA.position;
+		XMFLOAT3 pointB = bodyB.position;
+		for (int k = 0; k < 3; k++)
+		{
+			if (k != edgeA)
+			{
+				pointA = Add(pointA, Scale(axes[0][k], Component(bodyA.halfExtents, k) * Sign(Dot(axes[0][k], edgeNormal))));
+			}
+			if (k != edgeB)
+			{
+				pointB = Subtract(pointB, Scale(axes[1][k], Component(bodyB.halfExtents, k) * Sign(Dot(axes[1][k], edgeNormal))));
+			}
+		}
+		const XMFLOAT3& u = axes[0][edgeA];
+		const XMFLOAT3& v = axes[1][edgeB];
+		XMFLOAT3 between = Subtract(pointA, pointB);
+		float uv = Dot(u, v), ur = Dot(u, between), vr = Dot(v, between);
+		float s = (uv * vr - ur) / (1.0f - uv * uv);
+		s = std::max(-Component(bodyA.halfExtents, edgeA), std::min(s, Component(bodyA.halfExtents, edgeA)));
+		float t = uv * s + vr;
+		t = std::max(-Component(bodyB.halfExtents, edgeB), std::min(t, Component(bodyB.halfExtents, edgeB)));
+		XMFLOAT3 closestA = Add(pointA, Scale(u, s));
+		XMFLOAT3 closestB = Add(pointB, Scale(v, t));
+		AddContact(a, b, Scale(Add(closestA, closestB), 0.5f), edgeNormal, edgeSeparation);
+		return;
+	}
+
+	// The reference face, and the incident box's face turned most against it, clipped to the reference face's sides
+	int incident = 1 - reference;
+	const Body& referenceBody = reference == 0 ? bodyA : bodyB;
+	const Body& incidentBody = reference == 0 ? bodyB : bodyA;
+	const XMFLOAT3* referenceAxes = axes[reference];
+	const XMFLOAT3* incidentAxes = axes[incident];
+	XMFLOAT3 normal = reference == 0 ? faceNormal[0] : Scale(faceNormal[1], -1.0f); // From the reference box toward the other
+	int axis = faceAxis[reference];
+	XMFLOAT3 faceCenter = Add(referenceBody.position, Scale(normal, Component(referenceBody.halfExtents, axis)));
+
+	int incidentAxis = 0;
+	for (int k = 1; k < 3; k++)
+	{
+		if (fabsf(Dot(incidentAxes[k], normal)) > fabsf(Dot(incidentAxes[incidentAxis], normal)))
+		{
+			incidentAxis = k;
+		}
+	}
+	XMFLOAT3 incidentNormal = Dot(incidentAxes[incidentAxis], normal) > 0.0f ? Scale(incidentAxes[incidentAxis], -1.0f) : incidentAxes[incidentAxis];
+	XMFLOAT3 incidentCenter = Add(incidentBody.position, Scale(incidentNormal, Component(incidentBody.halfExtents, incidentAxis)));
+	int sideU = (incidentAxis + 1) % 3, sideV = (incidentAxis + 2) % 3;
+	XMFLOAT3 u = Scale(incidentAxes[sideU], Component(incidentBody.halfExtents, sideU));
+	XMFLOAT3 v = Scale(incidentAxes[sideV], Component(incidentBody.halfExtents, sideV));
+	XMFLOAT3 polygon[2][8] = {};
+	polygon[0][0] = Add(Add(incidentCenter, u), v);
+	polygon[0][1] = Add(Subtract(incidentCenter, u), v);
+	polygon[0][2] = Subtract(Subtract(incidentCenter, u), v);
+	polygon[0][3] = Subtract(Add(incidentCenter, u), v);
+	int count = 4;
+	int current = 0;
+	for (int k = 0; k < 3 && count > 0; k++)
+	{
+		if (k == axis)
+		{
+			continue;
+		}
+		float center = Dot(referenceAxes[k], referenceBody.position);
+		float extent = Component(referenceBody.halfExtents, k);
+		count = ClipPolygon(polygon[current], count, referenceAxes[k], center + extent, polygon[1 - current]);
+		current = 1 - current;
+		count = ClipPolygon(polygon[current], count, Scale(referenceAxes[k], -1.0f), extent - center, polygon[1 - current]);
+		current = 1 - current;
+	}
+
+	// Points below the reference face, or nearly, cut down to the four that best cover the area
+	XMFLOAT3 points[8];
+	float separations[8];
+	int found = 0;
+	for (int i = 0; i < count; i++)
+	{
+		float separation = Dot(normal, Subtract(polygon[current][i], faceCenter));
+		if (separation <= margin)
+		{
+			points[found] = polygon[current][i];
+			separations[found++] = separation;
+		}
+	}
+	int keep[4] = { -1, -1, -1, -1 };
+	if (found <= 4)
+	{
+		for (int i = 0; i < found; i++)
+		{
+			keep[i] = i;
+		}
+	}
+	else
+	{
+		keep[0] = 0; // Deepest
+		for (int i = 1; i < found; i++)
+		{
+			keep[0] = separations[i] < separations[keep[0]] ? i : keep[0];
+		}
+		float farthest = -1.0f; // From it
+		for (int i = 0; i < found; i++)
+		{
+			float distanceSquared = LengthSquared(Subtract(points[i], points[keep[0]]));
+			if (distanceSquared > farthest)
+			{
+				farthest = distanceSquared;
+				keep[1] = i;
+			}
+		}
+		float mostLeft = 0.0f, mostRight = 0.0f; // Biggest triangles either side of the line through both
+		XMFLOAT3 line = Subtract(points[keep[1]], points[keep[0]]);
+		for (int i = 0; i < found; i++)
+		{
+			float area = Dot(Cross(line, Subtract(points[i], points[keep[0]])), normal);
+			if (area > mostLeft)
+			{
+				mostLeft = area;
+				keep[2] = i;
+			}
+			if (area < mostRight)
+			{
+				mostRight = area;
+				keep[3] = i;
+			}
+		}
+	}
+	int referenceId = reference == 0 ? a : b;
+	int incidentId = reference == 0 ? b : a;
+	for (int k = 0; k < 4; k++)
+	{
+		if (keep[k] != -1)
+		{
+			AddContact(referenceId, incidentId, Subtract(points[keep[k]], Scale(normal, separations[keep[k]] * 0.5f)), normal, separations[keep[k]]);
+		}
+	}
+}
+
+void PhysicsWorld::AddContact(int a, int b, const XMFLOAT3& point, const XMFLOAT3& normal, float separation)
+{
+	Contact contact;
+	contact.bodyA = a < b ? a : b;
+	contact.bodyB = a < b ? b : a;
+	contact.key = (unsigned long long)contact.bodyA << 32 | (unsigned int)contact.bodyB;
+	contact.point = point;
+	contact.normal = a < b ? normal : Scale(normal, -1.0f);
+	contact.separation = separation;
+	contact.normalImpulse = 0.0f;
+	contact.tangentImpulse1 = 0.0f;
+	contact.tangentImpulse2 = 0.0f;
+	contacts.push_back(contact);
+}
+
+void PhysicsWorld::PrepareContacts(float deltaTime)
+{
+	for (size_t c = 0; c < contacts.size(); c++)
+	{
+		Contact& contact = contacts[c];
+		const Body& a = bodies[contact.bodyA];
+		const Body& b = bodies[contact.bodyB];
+		contact.armA = Subtract(contact.point, a.position);
+		contact.armB = Subtract(contact.point, b.position);
+
+		// Any two directions across the normal, picked the same way every step so warm started friction lines up
+		const XMFLOAT3& n = contact.normal;
+		contact.tangent1 = fabsf(n.x) >= 0.57735f ? XMFLOAT3(n.y, -n.x, 0.0f) : XMFLOAT3(0.0f, n.z, -n.y);
+		contact.tangent1 = Scale(contact.tangent1, 1.0f / sqrtf(LengthSquared(contact.tangent1)));
+		contact.tangent2 = Cross(n, contact.tangent1);
+
+		// 1 / (how fast an impulse of one along a direction parts them)
+		auto mass = [&](const XMFLOAT3& direction)
+		{
+			XMFLOAT3 turnA = Cross(contact.armA, direction);
+			XMFLOAT3 turnB = Cross(contact.armB, direction);
+			float k = a.inverseMass + b.inverseMass + Dot(turnA, Multiply(a.inverseInertiaWorld, turnA)) + Dot(turnB, Multiply(b.inverseInertiaWorld, turnB));
+			return k > 0.0f ? 1.0f / k : 0.0f;
+		};
+		contact.normalMass = mass(contact.normal);
+		contact.tangentMass1 = mass(contact.tangent1);
+		contact.tangentMass2 = mass(contact.tangent2);
+
+		// Apart, they may close the gap but no more. Overlapping, they're pushed out a bit at a time.
+		// Only a contact that wasn't already pushing last step bounces, a resting one rocking can't set off another.
+		XMFLOAT3 relative = Subtract(Add(b.linearVelocity, Cross(b.angularVelocity, contact.armB)), Add(a.linearVelocity, Cross(a.angularVelocity, contact.armA)));
+		float approach = Dot(relative, contact.normal);
+		if (contact.separation > 0.0f)
+		{
+			contact.targetSpeed = -contact.separation / deltaTime;
+		}
+		else
+		{
+			contact.targetSpeed = PositionCorrection * std::max(0.0f, -contact.separation - AllowedOverlap) / deltaTime;
+			if (approach < -RestitutionSpeed && contact.normalImpulse == 0.0f)
+			{
+				contact.targetSpeed = std::max(contact.targetSpeed, -Restitution * approach);
+			}
+		}
+
+		ApplyContactImpulse(contact, Add(Scale(contact.normal, contact.normalImpulse), Add(Scale(contact.tangent1, contact.tangentImpulse1), Scale(contact.tangent2, contact.tangentImpulse2))));
+	}
+}
+
+void PhysicsWorld::SolveContacts()
+{
+	for (size_t c = 0; c < contacts.size(); c++)
+	{
+		Contact& contact = contacts[c];
+		const Body& a = bodies[contact.bodyA];
+		const Body& b = bodies[contact.bodyB];
+		auto relativeVelocity = [&]()
+		{
+			return Subtract(Add(b.linearVelocity, Cross(b.angularVelocity, contact.armB)), Add(a.linearVelocity, Cross(a.angularVelocity, contact.armA)));
+		};
+
+		// Friction first, each direction held to what the push between them allows
+		float limit = Friction * contact.normalImpulse;
+		float* tangentImpulses[2] = { &contact.tangentImpulse1, &contact.tangentImpulse2 };
+		const XMFLOAT3* tangents[2] = { &contact.tangent1, &contact.tangent2 };
+		float tangentMasses[2] = { contact.tangentMass1, contact.tangentMass2 };
+		for (int t = 0; t < 2; t++)
+		{
+			float impulse = -Dot(relativeVelocity(), *tangents[t]) * tangentMasses[t];
+			float total = std::max(-limit, std::min(*tangentImpulses[t] + impulse, limit));
+			impulse = total - *tangentImpulses[t];
+			*tangentImpulses[t] = total;
+			ApplyContactImpulse(contact, Scale(*tangents[t], impulse));
+		}
+
+		// Then the push, which can only ever add up to pushing them apart
+		float impulse = (contact.targetSpeed - Dot(relativeVelocity(), contact.normal)) * contact.normalMass;
+		float total = std::max(contact.normalImpulse + impulse, 0.0f);
+		impulse = total - contact.normalImpulse;
+		contact.normalImpulse = total;
+		ApplyContactImpulse(contact, Scale(contact.normal, impulse));
+	}
+}
+
+void PhysicsWorld::ApplyContactImpulse(const Contact& contact, const XMFLOAT3& impulse)
+{
+	Body& a = bodies[contact.bodyA];
+	Body& b = bodies[contact.bodyB];
+	a.linearVelocity = Subtract(a.linearVelocity, Scale(impulse, a.inverseMass));
+	a.angularVelocity = Subtract(a.angularVelocity, Multiply(a.inverseInertiaWorld, Cross(contact.armA, impulse)));
+	b.linearVelocity = Add(b.linearVelocity, Scale(impulse, b.inverseMass));
+	b.angularVelocity = Add(b.angularVelocity, Multiply(b.inverseInertiaWorld, Cross(contact.armB, impulse)));
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "DynamicBVH.h"
+
+// Shapes a rigid body can have
+enum RigidBodyShape
+{
+	SHAPE_SPHERE,
+	SHAPE_BOX,
+	SHAPE_PLANE // Only made by AddPlane, never moves
+};
+
+// --------------------------------------------------------
+// Rigid bodies knocked around by gravity and each other
+//
+// Spheres and boxes, moving and rotating, plus static planes
+// for the floor and walls. Every step finds what touches,
+// makes contact points for it, and solves them with
+// sequential impulses: a few passes over the contacts, each
+// pushing the bodies apart just enough and clamping friction
+// to what the push allows. Impulses are carried over to the
+// same contacts next step, so stacks settle in a few steps
+// instead of jittering.
+//
+// Contacts start a little before bodies touch, by as much as
+// they could close in one step, so fast debris stops at the
+// floor instead of sinking in and being pushed back out.
+//
+// Bodies touching each other form islands. When everything
+// on an island has been nearly still for half a second, the
+// whole island falls asleep. Sleeping bodies aren't moved,
+// queried or solved, so a floor covered in settled debris
+// costs nothing per step, only what's awake does. Anything
+// awake that touches a sleeping body wakes its island, and
+// so does an impulse or a teleport.
+//
+// Body ids stay put until removed. Positions and rotations
+// are world space, rotations quaternions. A mass of 0 makes a
+// static body that never moves.
+// --------------------------------------------------------
+class PhysicsWorld
+{
+public:
+	PhysicsWorld(DirectX::XMFLOAT3 gravity = DirectX::XMFLOAT3(0.0f, -9.8f, 0.0f));
+	~PhysicsWorld();
+
+	int AddSphere(const DirectX::XMFLOAT3& position, float radius, float mass, int userData);
+	int AddBox(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT4& rotation, const DirectX::XMFLOAT3& halfExtents, float mass, int userData);
+	int AddPlane(const DirectX::XMFLOAT3& normal, float offset); // Everything stays on the side the normal faces, where dot(normal, p) >= offset
+	void Remove(int body); // Wakes whatever it was touching
+
+	void SetTransform(int body, const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT4& rotation); // Teleports and wakes it
+	void SetVelocity(int body, const DirectX::XMFLOAT3& linear, const DirectX::XMFLOAT3& angular); // Wakes it
+	void ApplyImpulse(int body, const DirectX::XMFLOAT3& impulse, const DirectX::XMFLOAT3& point); // At a world space point, wakes it
+
+	void Step(float deltaTime);
+
+	DirectX::XMFLOAT3 GetPosition(int body) const;
+	DirectX::XMFLOAT4 GetRotation(int body) const;
+	DirectX::XMFLOAT3 GetLinearVelocity(int body) const;
+	DirectX::XMFLOAT3 GetAngularVelocity(int body) const;
+	int GetUserData(int body) const;
+	bool IsAwake(int body) const; // Static bodies never are
+
+	const std::vector<int>& GetMovedBodies() const; // Every body awake during the last step, the only ones whose transforms changed
+	int GetBodyCount() const;
+	int GetAwakeCount() const;
+	int GetContactCount() const; // From the last step
+	int GetIslandCount() const; // Awake islands in the last step
+
+private:
+	struct Body
+	{
+		DirectX::XMFLOAT3 position;
+		DirectX::XMFLOAT4 rotation;
+		DirectX::XMFLOAT3 linearVelocity;
+		DirectX::XMFLOAT3 angularVelocity;
+		DirectX::XMFLOAT3 halfExtents; // The radius in every component for spheres
+		DirectX::XMFLOAT3 inverseInertia; // About the body's own axes
+		DirectX::XMFLOAT3 inverseInertiaWorld[3]; // Rows, refreshed every step it's awake
+		float inverseMass; // 0 for static bodies
+		float sleepTime; // How long it's been nearly still
+		int shape; // RigidBodyShape, -1 once removed
+		int userData;
+		int proxy; // In the tree, -1 for planes
+		int awakeIndex; // In awake, -1 while asleep and for static bodies
+		int islandNext; // Next body of the island it fell asleep with, round in a loop back to itself
+	};
+
+	struct Plane
+	{
+		DirectX::XMFLOAT3 normal;
+		float offset;
+		int body;
+	};
+
+	struct Contact
+	{
+		unsigned long long key; // Both bodies, for finding the same contact last step
+		int bodyA; // Always the lower id
+		int bodyB;
+		DirectX::XMFLOAT3 point; // Halfway between the two surfaces
+		DirectX::XMFLOAT3 normal; // From A to B
+		float separation; // Negative while they overlap
+		DirectX::XMFLOAT3 tangent1, tangent2;
+		DirectX::XMFLOAT3 armA, armB; // From each body's center to the point
+		float normalMass, tangentMass1, tangentMass2;
+		float targetSpeed; // How fast the solver wants them parting, negative lets them close the gap
+		float normalImpulse, tangentImpulse1, tangentImpulse2; // Totals so far, warm started from last step
+	};
+
+	DirectX::XMFLOAT3 gravity;
+	std::vector<Body> bodies; // Indexed by body id
+	std::vector<int> freeBodies; // Reused first
+	std::vector<Plane> planes;
+	std::vector<int> awake;
+	std::vector<int> moved;
+	std::vector<Contact> contacts;
+	std::vector<Contact> previousContacts;
+	std::vector<int> islandParents; // By awake index, scratch for grouping islands
+	std::vector<int> islandHeads, islandTails;
+	std::vector<float> islandSleepTimes;
+	DynamicBVH tree;
+	int bodyCount;
+	int islandCount;
+
+	int AddBody(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT4& rotation, const DirectX::XMFLOAT3& halfExtents, float mass, int shape, int userData);
+	Aabb GetBox(const Body& body) const;
+	void UpdateInertia(Body& body); // Its inverse inertia turned to the way it's facing now
+	void Wake(int body); // And the island it fell asleep with
+	void WakeTouching(int body); // It and everything near enough to be resting on it
+	void UpdateIslands(float deltaTime); // Groups awake bodies by contact and puts still islands to sleep
+
+	void Collide(int a, int b, float margin); // Contacts between two bodies closer than margin
+	void CollidePlane(int body, const Plane& plane, float margin);
+	void CollideSphereBox(int sphere, int box, float margin);
+	void CollideBoxes(int a, int b, float margin);
+	void AddContact(int a, int b, const DirectX::XMFLOAT3& point, const DirectX::XMFLOAT3& normal, float separation); // Normal from a to b
+
+	void PrepareContacts(float deltaTime); // Arms, masses and target speeds, then last step's impulses applied again
+	void SolveContacts();
+	void ApplyContactImpulse(const Contact& contact, const DirectX::XMFLOAT3& impulse); // Onto B, and the opposite onto A
+	static int FindRoot(std::vector<int>& parents, int i);
+};
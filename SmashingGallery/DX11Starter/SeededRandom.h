@@ -0,0 +1,25 @@
+#pragma once
+
+// --------------------------------------------------------
+// The one small generator everything that needs repeatable
+// randomness steps
+//
+// A 32-bit linear congruential generator with the Numerical
+// Recipes constants. The caller owns the seed, so the same
+// seed always gives the same sequence, on any thread and
+// with any compiler. Fine for scattering points and jitter,
+// not for anything that has to look statistically clean.
+// --------------------------------------------------------
+namespace SeededRandom
+{
+	inline unsigned int NextSeed(unsigned int& seed) // Steps the seed and returns it
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return seed;
+	}
+
+	inline float NextRandom(unsigned int& seed) // 0 to 1, from the top 24 bits of the next seed
+	{
+		return (NextSeed(seed) >> 8) / 16777216.0f;
+	}
+}
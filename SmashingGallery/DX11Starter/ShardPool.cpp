@@ -0,0 +1,211 @@
+#include "ShardPool.h"
+#include "SeededRandom.h"
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const float Gravity = -9.8f;
+	const float BurstSpeed = 1.5f; // How fast shards fly apart, on top of being knocked along by the hit
+	const float HitCarry = 0.1f; // Of the bullet's velocity, for the shards right at the hit
+	const float SpinSpeed = 8.0f; // Most radians per second about each axis
+	const float Bounce = 0.3f; // Of the speed into the floor that comes back out
+	const float FloorFriction = 0.6f; // Of the sliding speed and spin kept each bounce
+	const float ShrinkTime = 0.5f; // Shards shrink away over their last this many seconds
+}
+
+ShardPool::ShardPool(int maxShards, float lifetime, float floorHeight)
+{
+	this->maxShards = maxShards;
+	this->lifetime = lifetime;
+	this->floorHeight = floorHeight;
+
+	shards = new Shard[maxShards];
+	firstAliveIndex = 0;
+	firstDeadIndex = 0;
+	livingCount = 0;
+	recycledCount = 0;
+	random = 1;
+}
+
+ShardPool::~ShardPool()
+{
+	delete[] shards;
+}
+
+int ShardPool::AddPattern(const FracturePattern* pattern)
+{
+	int groupCount = (int)groupCursors.size();
+	patterns.push_back(pattern);
+	patternGroups.push_back(groupCount);
+	groupCursors.resize(groupCount + pattern->GetShardCount());
+	return (int)patterns.size() - 1;
+}
+
+int ShardPool::GetPatternCount() const
+{
+	return (int)patterns.size();
+}
+
+const FracturePattern* ShardPool::GetPattern(int pattern) const
+{
+	return patterns[pattern];
+}
+
+void ShardPool::Shatter(int pattern, const XMFLOAT4X4& worldMatrix, const XMFLOAT3& velocity, const XMFLOAT3& hitPoint, const XMFLOAT3& hitVelocity)
+{
+	// Every piece keeps the object's scale and rotation and starts where it sat in it
+	XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&worldMatrix));
+	XMVECTOR scale, rotation, translation;
+	if (!XMMatrixDecompose(&scale, &rotation, &translation, world))
+	{
+		scale = XMVectorSplatOne(); // Sheared, pieces keep their shape instead
+		rotation = XMQuaternionIdentity();
+	}
+	XMFLOAT3 scale3;
+	XMFLOAT4 rotation4;
+	XMStoreFloat3(&scale3, scale);
+	XMStoreFloat4(&rotation4, rotation);
+	float largestScale = fmaxf(fabsf(scale3.x), fmaxf(fabsf(scale3.y), fabsf(scale3.z)));
+	XMVECTOR hit = XMLoadFloat3(&hitPoint);
+
+	const FracturePattern* fracture = patterns[pattern];
+	for (int k = 0; k < fracture->GetShardCount(); k++)
+	{
+		if (livingCount == maxShards)
+		{
+			// Full, so the oldest shard goes early
+			firstAliveIndex = (firstAliveIndex + 1) % maxShards;
+			livingCount--;
+			recycledCount++;
+		}
+		Shard& shard = shards[firstDeadIndex];
+		const FractureShard& piece = fracture->GetShard(k);
+		XMVECTOR position = XMVector3TransformCoord(XMLoadFloat3(&piece.center), world);
+
+		// Away from the hit, faster the closer it was, plus some of the bullet's push
+		XMVECTOR away = XMVectorSubtract(position, hit);
+		float distance = XMVectorGetX(XMVector3Length(away));
+		float nearness = 1.0f / (1.0f + distance * 4.0f);
+		XMVECTOR push = XMVectorAdd(
+			XMVectorScale(XMVector3Normalize(away), BurstSpeed * (0.5f + SeededRandom::NextRandom(random)) * (0.5f + nearness)),
+			XMVectorScale(XMLoadFloat3(&hitVelocity), HitCarry * nearness));
+		XMStoreFloat3(&shard.position, position);
+		XMStoreFloat3(&shard.velocity, XMVectorAdd(XMLoadFloat3(&velocity), push));
+		shard.rotation = rotation4;
+		shard.previousPosition = shard.position;
+		shard.previousRotation = rotation4;
+		shard.angularVelocity = XMFLOAT3((SeededRandom::NextRandom(random) * 2.0f - 1.0f) * SpinSpeed, (SeededRandom::NextRandom(random) * 2.0f - 1.0f) * SpinSpeed, (SeededRandom::NextRandom(random) * 2.0f - 1.0f) * SpinSpeed);
+		shard.scale = scale3;
+		shard.reach = piece.radius * largestScale;
+		shard.age = 0.0f;
+		shard.group = patternGroups[pattern] + k;
+
+		firstDeadIndex = (firstDeadIndex + 1) % maxShards;
+		livingCount++;
+	}
+}
+
+void ShardPool::Update(float dt, JobSystem* jobs)
+{
+	// Jobs get slices of the living run, which may wrap past the end of the array
+	auto updateRange = [this, dt](int first, int last)
+	{
+		for (int k = first; k < last; k++)
+			UpdateSingleShard(dt, (firstAliveIndex + k) % maxShards);
+	};
+	if (jobs != nullptr)
+		jobs->ParallelFor(livingCount, 1024, updateRange);
+	else
+		updateRange(0, livingCount);
+
+	// Shards age in the order they were placed, so any whose time is up sit at the
+	// oldest end of the run, including ones that only reached it this step
+	while (livingCount > 0 && shards[firstAliveIndex].age >= lifetime)
+	{
+		firstAliveIndex = (firstAliveIndex + 1) % maxShards;
+		livingCount--;
+	}
+}
+
+void ShardPool::UpdateSingleShard(float dt, int index)
+{
+	Shard& shard = shards[index];
+	shard.age += dt;
+	if (shard.age >= lifetime)
+		return; // Update retires it
+
+	shard.previousPosition = shard.position;
+	shard.previousRotation = shard.rotation;
+
+	shard.velocity.y += Gravity * dt;
+	shard.position.x += shard.velocity.x * dt;
+	shard.position.y += shard.velocity.y * dt;
+	shard.position.z += shard.velocity.z * dt;
+
+	// Spin applied as a quaternion derivative, renormalized so it never drifts
+	XMVECTOR spin = XMVectorSet(shard.angularVelocity.x, shard.angularVelocity.y, shard.angularVelocity.z, 0.0f);
+	XMVECTOR rotation = XMLoadFloat4(&shard.rotation);
+	rotation = XMVectorAdd(rotation, XMVectorScale(XMQuaternionMultiply(rotation, spin), 0.5f * dt));
+	XMStoreFloat4(&shard.rotation, XMQuaternionNormalize(rotation));
+
+	// The floor is the only thing shards hit, and reach keeps every corner above it
+	float lowest = shard.position.y - shard.reach;
+	if (lowest < floorHeight)
+	{
+		shard.position.y += floorHeight - lowest;
+		if (shard.velocity.y < 0.0f)
+		{
+			shard.velocity.y *= -Bounce;
+			shard.velocity.x *= FloorFriction;
+			shard.velocity.z *= FloorFriction;
+			shard.angularVelocity.x *= FloorFriction;
+			shard.angularVelocity.y *= FloorFriction;
+			shard.angularVelocity.z *= FloorFriction;
+		}
+	}
+}
+
+void ShardPool::CopyToSnapshot(ShardSnapshot& snapshot)
+{
+	// A counting sort by group, into vectors that keep their size from frame to frame
+	int groupCount = (int)groupCursors.size();
+	snapshot.groupStarts.assign(groupCount + 1, 0);
+	for (int k = 0; k < livingCount; k++)
+		snapshot.groupStarts[shards[(firstAliveIndex + k) % maxShards].group + 1]++;
+	for (int g = 0; g < groupCount; g++)
+	{
+		snapshot.groupStarts[g + 1] += snapshot.groupStarts[g];
+		groupCursors[g] = snapshot.groupStarts[g];
+	}
+
+	snapshot.instances.resize(livingCount);
+	for (int k = 0; k < livingCount; k++)
+	{
+		const Shard& shard = shards[(firstAliveIndex + k) % maxShards];
+		ShardInstance& instance = snapshot.instances[groupCursors[shard.group]++];
+		float shrink = fminf(1.0f, (lifetime - shard.age) / ShrinkTime);
+		instance.previousRotation = shard.previousRotation;
+		instance.rotation = shard.rotation;
+		instance.previousPosition = shard.previousPosition;
+		instance.position = shard.position;
+		instance.scale = XMFLOAT3(shard.scale.x * shrink, shard.scale.y * shrink, shard.scale.z * shrink);
+	}
+	snapshot.patternGroups.assign(patternGroups.begin(), patternGroups.end());
+}
+
+int ShardPool::GetLivingCount() const
+{
+	return livingCount;
+}
+
+int ShardPool::GetMaxShards() const
+{
+	return maxShards;
+}
+
+int ShardPool::GetRecycledCount() const
+{
+	return recycledCount;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "FracturePattern.h"
+#include "JobSystem.h"
+
+// One shard to draw, laid out for ShardVShader's per instance inputs
+struct ShardInstance
+{
+	DirectX::XMFLOAT4 previousRotation; // End of the step before, the shader blends the two
+	DirectX::XMFLOAT4 rotation;
+	DirectX::XMFLOAT3 previousPosition; // World space, where the shard's center goes
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 scale; // The broken object's, shrinking away as the shard's time runs out
+};
+
+// The living shards as of the last step, copied out for ShardRenderer so the render thread never reads the pool
+struct ShardSnapshot
+{
+	std::vector<ShardInstance> instances; // Grouped by pattern, then by shard within the pattern
+	std::vector<int> groupStarts; // Where each group's instances start in instances, then one past the last
+	std::vector<int> patternGroups; // Each pattern's first group, its shards follow in order
+};
+
+// --------------------------------------------------------
+// Every flying shard of broken glass, in one array made up
+// front
+//
+// A hit only places one shard per piece of the object's
+// FracturePattern, all worked out ahead of time, so breaking
+// something costs a handful of writes and no allocations.
+// Every shard lives as long, so like the particle Emitter the
+// pool is a ring: new ones go at the back and the oldest die
+// off the front. When it's full, the oldest are recycled
+// early to make room.
+//
+// Shards fly off the hit and spin, fall, and skid to a stop
+// on the floor, never touching each other. Each step's
+// snapshot groups them by piece, so every kind of piece is
+// one instanced draw however many objects have broken.
+// --------------------------------------------------------
+class ShardPool
+{
+public:
+	ShardPool(int maxShards, float lifetime, float floorHeight);
+	~ShardPool();
+
+	int AddPattern(const FracturePattern* pattern); // Before the first Shatter, the pattern has to outlive the pool
+	int GetPatternCount() const;
+	const FracturePattern* GetPattern(int pattern) const;
+
+	void Shatter(int pattern, const DirectX::XMFLOAT4X4& worldMatrix, const DirectX::XMFLOAT3& velocity, const DirectX::XMFLOAT3& hitPoint, const DirectX::XMFLOAT3& hitVelocity); // worldMatrix is transposed like the store's, velocity the object's own
+
+	void Update(float dt, JobSystem* jobs = nullptr); // Shards are split across the jobs if there are any
+	void UpdateSingleShard(float dt, int index); // Only touches that shard, so it can run on any thread
+
+	void CopyToSnapshot(ShardSnapshot& snapshot); // On the thread that calls Update
+
+	int GetLivingCount() const;
+	int GetMaxShards() const;
+	int GetRecycledCount() const; // Shards that died early to make room
+
+private:
+	struct Shard
+	{
+		DirectX::XMFLOAT3 position;
+		DirectX::XMFLOAT4 rotation;
+		DirectX::XMFLOAT3 previousPosition;
+		DirectX::XMFLOAT4 previousRotation;
+		DirectX::XMFLOAT3 velocity;
+		DirectX::XMFLOAT3 angularVelocity; // Radians per second about each world axis
+		DirectX::XMFLOAT3 scale;
+		float reach; // Farthest any vertex gets from the center
+		float age;
+		int group; // Pattern's first group plus which piece it is
+	};
+
+	Shard* shards;
+	int maxShards;
+	int firstAliveIndex;
+	int firstDeadIndex;
+	int livingCount;
+	int recycledCount;
+	float lifetime;
+	float floorHeight;
+	unsigned int random; // Its own generator, so the same hits break the same way
+
+	std::vector<const FracturePattern*> patterns;
+	std::vector<int> patternGroups;
+	std::vector<int> groupCursors; // Scratch for grouping the snapshot, one per group
+};
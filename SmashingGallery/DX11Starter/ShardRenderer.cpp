@@ -0,0 +1,124 @@
+#include "ShardRenderer.h"
+#include "GeometryPool.h"
+
+using namespace DirectX;
+
+ShardRenderer::ShardRenderer(ID3D11Device* device, int maxInstances, SimpleVertexShader* vs, SimplePixelShader* ps)
+{
+	this->vs = vs;
+	this->ps = ps;
+	this->maxInstances = maxInstances;
+	refractionScale = .03f;
+	padding = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	D3D11_BUFFER_DESC instanceDesc = {};
+	instanceDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	instanceDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	instanceDesc.Usage = D3D11_USAGE_DYNAMIC;
+	instanceDesc.ByteWidth = sizeof(ShardInstance) * maxInstances;
+	device->CreateBuffer(&instanceDesc, 0, &instanceBuffer);
+}
+
+ShardRenderer::~ShardRenderer()
+{
+	for (size_t i = 0; i < patterns.size(); i++)
+	{
+		if (patterns[i].vertexBuffer) patterns[i].vertexBuffer->Release();
+		if (patterns[i].indexBuffer) patterns[i].indexBuffer->Release();
+	}
+	instanceBuffer->Release();
+}
+
+void ShardRenderer::SetPattern(int pattern, const FracturePattern* fracture, GlassMat* material, ID3D11Device* device)
+{
+	if ((int)patterns.size() <= pattern)
+	{
+		Pattern empty = { nullptr, nullptr, nullptr, nullptr };
+		patterns.resize(pattern + 1, empty);
+	}
+	Pattern& entry = patterns[pattern];
+	if (entry.vertexBuffer) entry.vertexBuffer->Release();
+	if (entry.indexBuffer) entry.indexBuffer->Release();
+	entry.fracture = fracture;
+	entry.material = material;
+	entry.vertexBuffer = nullptr;
+	entry.indexBuffer = nullptr;
+	if (fracture->GetVertexCount() == 0)
+	{
+		return;
+	}
+
+	D3D11_BUFFER_DESC vbd = {};
+	vbd.Usage = D3D11_USAGE_IMMUTABLE;
+	vbd.ByteWidth = sizeof(Vertex) * fracture->GetVertexCount();
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	D3D11_SUBRESOURCE_DATA vertexData = {};
+	vertexData.pSysMem = fracture->GetVertices();
+	device->CreateBuffer(&vbd, &vertexData, &entry.vertexBuffer);
+
+	D3D11_BUFFER_DESC ibd = {};
+	ibd.Usage = D3D11_USAGE_IMMUTABLE;
+	ibd.ByteWidth = sizeof(int) * fracture->GetIndexCount();
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	D3D11_SUBRESOURCE_DATA indexData = {};
+	indexData.pSysMem = fracture->GetIndices();
+	device->CreateBuffer(&ibd, &indexData, &entry.indexBuffer);
+}
+
+void ShardRenderer::Draw(ID3D11DeviceContext* context, Camera* camera, const ShardSnapshot& snapshot, float blend)
+{
+	int instanceCount = (int)snapshot.instances.size();
+	if (instanceCount == 0)
+		return;
+	instanceCount = instanceCount < maxInstances ? instanceCount : maxInstances;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	context->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	memcpy(mapped.pData, &snapshot.instances[0], sizeof(ShardInstance) * instanceCount);
+	context->Unmap(instanceBuffer, 0);
+
+	vs->SetMatrix4x4("view", camera->GetViewMatrix());
+	vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+	vs->SetFloat("blend", blend);
+	vs->SetShader();
+	vs->CopyAllBufferData();
+	ps->SetShader();
+
+	for (size_t p = 0; p < patterns.size() && p < snapshot.patternGroups.size(); p++)
+	{
+		const Pattern& pattern = patterns[p];
+		if (pattern.vertexBuffer == nullptr)
+			continue;
+		int firstGroup = snapshot.patternGroups[p];
+		int shardCount = pattern.fracture->GetShardCount();
+		if (snapshot.groupStarts[firstGroup] == snapshot.groupStarts[firstGroup + shardCount])
+			continue; // Nothing of this one is flying
+
+		ps->SetSamplerState("basicSampler", pattern.material->GetSamplerState());
+		ps->SetShaderResourceView("diffuseTexture", pattern.material->GetShaderResourceView());
+		ps->SetShaderResourceView("normalTexture", pattern.material->GetNormalShaderResourceView());
+		ps->SetShaderResourceView("refractionTexture", pattern.material->GetRefractionShaderResourceView());
+		ps->SetData("refractionScale", &refractionScale, 4);
+		ps->SetData("padding", &padding, 12);
+		ps->CopyBufferData("glassBuffer");
+
+		ID3D11Buffer* buffers[2] = { pattern.vertexBuffer, instanceBuffer };
+		UINT strides[2] = { sizeof(Vertex), sizeof(ShardInstance) };
+		UINT offsets[2] = { 0, 0 };
+		context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+		context->IASetIndexBuffer(pattern.indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+
+		for (int s = 0; s < shardCount; s++)
+		{
+			int first = snapshot.groupStarts[firstGroup + s];
+			int last = snapshot.groupStarts[firstGroup + s + 1];
+			last = last < instanceCount ? last : instanceCount;
+			if (last > first)
+			{
+				const FractureShard& shard = pattern.fracture->GetShard(s);
+				context->DrawIndexedInstanced(shard.indexCount, last - first, shard.firstIndex, 0, first);
+			}
+		}
+	}
+	GeometryPool::InvalidateBinding(); // The next mesh draw has to bind the pool again
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+#include "Camera.h"
+#include "SimpleShader.h"
+#include "GlassMat.h"
+#include "FracturePattern.h"
+#include "ShardPool.h"
+
+// --------------------------------------------------------
+// Draws a ShardPool's snapshot, one instanced draw for each
+// kind of piece
+//
+// Each pattern's pieces sit in one vertex and index buffer
+// made when it's added, and each step's instances go up in
+// one dynamic buffer, so drawing thousands of shards is a
+// copy and a few dozen draw calls. ShardVShader places every
+// instance by its own rotation and position, blended between
+// the last two steps, and the glass pixel shader does the
+// rest, so shards look like the glass they broke from.
+// --------------------------------------------------------
+class ShardRenderer
+{
+public:
+	ShardRenderer(ID3D11Device* device, int maxInstances, SimpleVertexShader* vs, SimplePixelShader* ps);
+	~ShardRenderer();
+
+	void SetPattern(int pattern, const FracturePattern* fracture, GlassMat* material, ID3D11Device* device); // The id ShardPool::AddPattern gave it
+
+	void Draw(ID3D11DeviceContext* context, Camera* camera, const ShardSnapshot& snapshot, float blend); // Only reads the snapshot, blend is how far past its step to draw
+
+private:
+	struct Pattern
+	{
+		const FracturePattern* fracture;
+		GlassMat* material;
+		ID3D11Buffer* vertexBuffer;
+		ID3D11Buffer* indexBuffer;
+	};
+
+	std::vector<Pattern> patterns; // By the pool's pattern id
+	ID3D11Buffer* instanceBuffer;
+	int maxInstances;
+	float refractionScale; // As Glass uses
+	DirectX::XMFLOAT3 padding;
+
+	SimpleVertexShader* vs;
+	SimplePixelShader* ps;
+};
@@ -0,0 +1,66 @@
+// Same as GlassVShader.hlsl, but for shards of broken glass drawn
+// instanced, each placed by its own rotation and position (see
+// ShardInstance in ShardPool.h) instead of a world matrix
+
+cbuffer cameraData : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+cbuffer shardData : register(b1)
+{
+	float blend; // How far from each instance's previous step to this one
+};
+
+// The _PER_INSTANCE inputs come from the second vertex buffer, one per shard
+struct VertexShaderInput
+{
+	float3 position           : POSITION;     // Relative to the shard's center
+	float2 uv		          : TEXCOORD;
+	float3 normal		      : NORMAL;
+	float3 tangent		      : TANGENT;
+	float4 previousRotation   : PREVIOUS_ROTATION_PER_INSTANCE;
+	float4 rotation           : ROTATION_PER_INSTANCE;
+	float3 previousPosition   : PREVIOUS_POSITION_PER_INSTANCE;
+	float3 shardPosition      : SHARD_POSITION_PER_INSTANCE;
+	float3 scale              : SCALE_PER_INSTANCE;
+};
+
+// Matches GlassPShader's input
+struct VertexToPixel
+{
+	float4 position		      : SV_POSITION;
+	float4 refractionPosition : TEXCOORD;
+	float2 uv                 : TEXCOORD1;
+	float3 normal		      : NORMAL;
+	float3 tangent		      : TANGENT;
+};
+
+// Rotates v by the unit quaternion q
+float3 Rotate(float4 q, float3 v)
+{
+	float3 t = 2.0f * cross(q.xyz, v);
+	return v + q.w * t + cross(q.xyz, t);
+}
+
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+
+	// Blended between the two steps, the rotations are never far enough apart to need a slerp
+	float4 rotation = normalize(lerp(input.previousRotation, input.rotation, blend));
+	float3 center = lerp(input.previousPosition, input.shardPosition, blend);
+	float3 worldPosition = Rotate(rotation, input.position * input.scale) + center;
+
+	matrix viewProjection = mul(view, projection);
+	output.position = mul(float4(worldPosition, 1.0f), viewProjection);
+	output.refractionPosition = output.position;
+
+	// Dividing by the scale keeps normals at right angles to a stretched surface
+	output.normal = normalize(Rotate(rotation, input.normal / input.scale));
+	output.tangent = normalize(Rotate(rotation, input.tangent * input.scale));
+
+	output.uv = input.uv;
+	return output;
+}
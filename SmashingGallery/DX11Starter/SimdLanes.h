@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// --------------------------------------------------------
+// Lane-wise float math, as wide as the build allows
+//
+// Lanes is eight floats with AVX, four with SSE and a plain
+// float otherwise, and LaneCount says which. Loops written
+// against these run unchanged at every width. Comparisons
+// give all ones in the lanes where they hold, so they can be
+// combined with And and Or or turned into bits with Mask.
+// Only plain IEEE operations are used, so every width gives
+// the same bits for the same inputs.
+// --------------------------------------------------------
+namespace SimdLanes
+{
+#if defined(__AVX__)
+	typedef __m256 Lanes;
+	const int LaneCount = 8;
+	inline Lanes Load(const float* p) { return _mm256_loadu_ps(p); }
+	inline void Store(float* p, Lanes a) { _mm256_storeu_ps(p, a); }
+	inline Lanes Splat(float f) { return _mm256_set1_ps(f); }
+	inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+	inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+	inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+	inline Lanes Div(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+	inline Lanes Sqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+	inline Lanes NotEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); } // True if either is NaN, like !=
+	inline Lanes And(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+	inline Lanes Or(Lanes a, Lanes b) { return _mm256_or_ps(a, b); }
+	inline Lanes Negate(Lanes a) { return _mm256_sub_ps(_mm256_setzero_ps(), a); }
+	inline Lanes NotLess(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_NLT_UQ); } // True if either is NaN, like !(a < b)
+	inline int Mask(Lanes a) { return _mm256_movemask_ps(a); } // Lane i's sign in bit i
+	inline Lanes Min(Lanes a, Lanes b) { return _mm256_min_ps(a, b); } // b if either is NaN, like a < b ? a : b
+	inline Lanes Max(Lanes a, Lanes b) { return _mm256_max_ps(a, b); } // b if either is NaN, like a > b ? a : b
+	inline Lanes LessEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); } // False if either is NaN, like <=
+	inline Lanes Select(Lanes mask, Lanes a, Lanes b) { return _mm256_blendv_ps(b, a, mask); } // a where mask is set, b elsewhere
+	inline Lanes NotGreater(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_NGT_UQ); } // True if either is NaN, like !(a > b)
+	inline Lanes GreaterEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	inline Lanes Less(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+	typedef __m128 Lanes;
+	const int LaneCount = 4;
+	inline Lanes Load(const float* p) { return _mm_loadu_ps(p); }
+	inline void Store(float* p, Lanes a) { _mm_storeu_ps(p, a); }
+	inline Lanes Splat(float f) { return _mm_set1_ps(f); }
+	inline Lanes Add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+	inline Lanes Sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+	inline Lanes Mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+	inline Lanes Div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+	inline Lanes Sqrt(Lanes a) { return _mm_sqrt_ps(a); }
+	inline Lanes NotEqual(Lanes a, Lanes b) { return _mm_cmpneq_ps(a, b); }
+	inline Lanes And(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+	inline Lanes Or(Lanes a, Lanes b) { return _mm_or_ps(a, b); }
+	inline Lanes Negate(Lanes a) { return _mm_sub_ps(_mm_setzero_ps(), a); }
+	inline Lanes NotLess(Lanes a, Lanes b) { return _mm_cmpnlt_ps(a, b); }
+	inline int Mask(Lanes a) { return _mm_movemask_ps(a); }
+	inline Lanes Min(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+	inline Lanes Max(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+	inline Lanes LessEqual(Lanes a, Lanes b) { return _mm_cmple_ps(a, b); }
+	inline Lanes Select(Lanes mask, Lanes a, Lanes b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	inline Lanes NotGreater(Lanes a, Lanes b) { return _mm_cmpngt_ps(a, b); }
+	inline Lanes GreaterEqual(Lanes a, Lanes b) { return _mm_cmpge_ps(a, b); }
+	inline Lanes Less(Lanes a, Lanes b) { return _mm_cmplt_ps(a, b); }
+#else
+	typedef float Lanes;
+	const int LaneCount = 1;
+	inline Lanes Load(const float* p) { return *p; }
+	inline void Store(float* p, Lanes a) { *p = a; }
+	inline Lanes Splat(float f) { return f; }
+	inline Lanes Add(Lanes a, Lanes b) { return a + b; }
+	inline Lanes Sub(Lanes a, Lanes b) { return a - b; }
+	inline Lanes Mul(Lanes a, Lanes b) { return a * b; }
+	inline Lanes Div(Lanes a, Lanes b) { return a / b; }
+	inline Lanes Sqrt(Lanes a) { return sqrtf(a); }
+	inline Lanes FromBits(unsigned int bits) { Lanes a; memcpy(&a, &bits, sizeof(a)); return a; }
+	inline unsigned int ToBits(Lanes a) { unsigned int bits; memcpy(&bits, &a, sizeof(bits)); return bits; }
+	inline Lanes NotEqual(Lanes a, Lanes b) { return FromBits(a != b ? 0xffffffff : 0); }
+	inline Lanes And(Lanes a, Lanes b) { return FromBits(ToBits(a) & ToBits(b)); }
+	inline Lanes Or(Lanes a, Lanes b) { return FromBits(ToBits(a) | ToBits(b)); }
+	inline Lanes Negate(Lanes a) { return -a; }
+	inline Lanes NotLess(Lanes a, Lanes b) { return FromBits(!(a < b) ? 0xffffffff : 0); }
+	inline int Mask(Lanes a) { return (int)(ToBits(a) >> 31); }
+	inline Lanes Min(Lanes a, Lanes b) { return a < b ? a : b; }
+	inline Lanes Max(Lanes a, Lanes b) { return a > b ? a : b; }
+	inline Lanes LessEqual(Lanes a, Lanes b) { return FromBits(a <= b ? 0xffffffff : 0); }
+	inline Lanes Select(Lanes mask, Lanes a, Lanes b) { return ToBits(mask) != 0 ? a : b; }
+	inline Lanes NotGreater(Lanes a, Lanes b) { return FromBits(!(a > b) ? 0xffffffff : 0); }
+	inline Lanes GreaterEqual(Lanes a, Lanes b) { return FromBits(a >= b ? 0xffffffff : 0); }
+	inline Lanes Less(Lanes a, Lanes b) { return FromBits(a < b ? 0xffffffff : 0); }
+#endif
+}
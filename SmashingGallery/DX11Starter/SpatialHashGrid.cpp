@@ -0,0 +1,218 @@
+#include "SpatialHashGrid.h"
+#include <algorithm>
+#include <cmath>
+using namespace DirectX;
+
+SpatialHashGrid::SpatialHashGrid(float cellSize)
+{
+	inverseCellSize = 1.0f / cellSize;
+	proxyCount = 0;
+}
+
+SpatialHashGrid::~SpatialHashGrid()
+{
+}
+
+int SpatialHashGrid::Add(const Aabb& box, int userData, unsigned int layers, unsigned int mask)
+{
+	int proxy;
+	if (freeProxies.empty())
+	{
+		proxy = (int)proxies.size();
+		proxies.push_back(Proxy());
+	}
+	else
+	{
+		proxy = freeProxies.back();
+		freeProxies.pop_back();
+	}
+	Proxy& p = proxies[proxy];
+	p.box = box;
+	p.userData = userData;
+	p.layers = layers;
+	p.mask = mask;
+	GetCellRange(box, p.cellMin, p.cellMax);
+	Insert(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void SpatialHashGrid::Remove(int proxy)
+{
+	Erase(proxy);
+	freeProxies.push_back(proxy);
+	proxyCount--;
+}
+
+void SpatialHashGrid::Move(int proxy, const Aabb& box)
+{
+	Proxy& p = proxies[proxy];
+	p.box = box;
+	int cellMin[3], cellMax[3];
+	GetCellRange(box, cellMin, cellMax);
+	if (cellMin[0] == p.cellMin[0] && cellMin[1] == p.cellMin[1] && cellMin[2] == p.cellMin[2] &&
+		cellMax[0] == p.cellMax[0] && cellMax[1] == p.cellMax[1] && cellMax[2] == p.cellMax[2])
+	{
+		return; // Same cells, only the box changed
+	}
+	Erase(proxy);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		p.cellMin[axis] = cellMin[axis];
+		p.cellMax[axis] = cellMax[axis];
+	}
+	Insert(proxy);
+}
+
+int SpatialHashGrid::GetUserData(int proxy) const
+{
+	return proxies[proxy].userData;
+}
+
+unsigned int SpatialHashGrid::GetLayers(int proxy) const
+{
+	return proxies[proxy].layers;
+}
+
+const Aabb& SpatialHashGrid::GetBox(int proxy) const
+{
+	return proxies[proxy].box;
+}
+
+int SpatialHashGrid::GetProxyCount() const
+{
+	return proxyCount;
+}
+
+int SpatialHashGrid::GetCellCount() const
+{
+	return (int)cells.size();
+}
+
+const std::vector<BroadphasePair>& SpatialHashGrid::FindPairs()
+{
+	pairs.clear();
+	for (size_t c = 0; c < cells.size(); c++)
+	{
+		const Cell& cell = cells[c];
+		int count = (int)cell.proxies.size();
+		for (int i = 0; i < count; i++)
+		{
+			const Proxy& a = proxies[cell.proxies[i]];
+			for (int j = i + 1; j < count; j++)
+			{
+				const Proxy& b = proxies[cell.proxies[j]];
+				if ((a.layers & b.mask) == 0 || (b.layers & a.mask) == 0 || !a.box.Overlaps(b.box))
+				{
+					continue;
+				}
+
+				// The overlap's low corner is in both ranges, so exactly one shared cell holds it.
+				// Compared by key, since cells whose keys wrap to the same value share one Cell
+				// that only remembers the first one's coordinates.
+				float corner[3] = { std::max(a.box.min.x, b.box.min.x), std::max(a.box.min.y, b.box.min.y), std::max(a.box.min.z, b.box.min.z) };
+				if (Key(GetCell(corner, 0), GetCell(corner, 1), GetCell(corner, 2)) != Key(cell.coordinates[0], cell.coordinates[1], cell.coordinates[2]))
+				{
+					continue;
+				}
+				BroadphasePair pair;
+				pair.proxyA = std::min(cell.proxies[i], cell.proxies[j]);
+				pair.proxyB = std::max(cell.proxies[i], cell.proxies[j]);
+				pairs.push_back(pair);
+			}
+		}
+	}
+
+	std::sort(pairs.begin(), pairs.end(), [](const BroadphasePair& a, const BroadphasePair& b)
+	{
+		return a.proxyA != b.proxyA ? a.proxyA < b.proxyA : a.proxyB < b.proxyB;
+	});
+	return pairs;
+}
+
+void SpatialHashGrid::Insert(int proxy)
+{
+	const Proxy& p = proxies[proxy];
+	for (int x = p.cellMin[0]; x <= p.cellMax[0]; x++)
+	{
+		for (int y = p.cellMin[1]; y <= p.cellMax[1]; y++)
+		{
+			for (int z = p.cellMin[2]; z <= p.cellMax[2]; z++)
+			{
+				unsigned long long key = Key(x, y, z);
+				std::unordered_map<unsigned long long, int>::iterator found = cellOfKey.find(key);
+				int index;
+				if (found == cellOfKey.end())
+				{
+					index = (int)cells.size();
+					cells.push_back(Cell());
+					cells[index].coordinates[0] = x;
+					cells[index].coordinates[1] = y;
+					cells[index].coordinates[2] = z;
+					cellOfKey[key] = index;
+				}
+				else
+				{
+					index = found->second;
+				}
+				cells[index].proxies.push_back(proxy);
+			}
+		}
+	}
+}
+
+void SpatialHashGrid::Erase(int proxy)
+{
+	const Proxy& p = proxies[proxy];
+	for (int x = p.cellMin[0]; x <= p.cellMax[0]; x++)
+	{
+		for (int y = p.cellMin[1]; y <= p.cellMax[1]; y++)
+		{
+			for (int z = p.cellMin[2]; z <= p.cellMax[2]; z++)
+			{
+				std::unordered_map<unsigned long long, int>::iterator found = cellOfKey.find(Key(x, y, z));
+				int index = found->second;
+				std::vector<int>& members = cells[index].proxies;
+				*std::find(members.begin(), members.end(), proxy) = members.back();
+				members.pop_back();
+				if (!members.empty())
+				{
+					continue;
+				}
+
+				// Empty, so the last cell fills its slot
+				cellOfKey.erase(found);
+				int last = (int)cells.size() - 1;
+				if (index != last)
+				{
+					std::swap(cells[index], cells[last]);
+					const int* moved = cells[index].coordinates;
+					cellOfKey[Key(moved[0], moved[1], moved[2])] = index;
+				}
+				cells.pop_back();
+			}
+		}
+	}
+}
+
+void SpatialHashGrid::GetCellRange(const Aabb& box, int* cellMin, int* cellMax) const
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		cellMin[axis] = GetCell(&box.min.x, axis);
+		cellMax[axis] = GetCell(&box.max.x, axis);
+	}
+}
+
+int SpatialHashGrid::GetCell(const float* point, int axis) const
+{
+	return (int)floorf(point[axis] * inverseCellSize);
+}
+
+unsigned long long SpatialHashGrid::Key(int x, int y, int z)
+{
+	// 21 bits an axis, wrapping around a million cells out. Cells that wrap onto the same key
+	// share a Cell, which costs extra overlap tests but never a pair, see FindPairs
+	const unsigned long long bits = 0x1fffff;
+	return ((unsigned long long)x & bits) << 42 | ((unsigned long long)y & bits) << 21 | ((unsigned long long)z & bits);
+}
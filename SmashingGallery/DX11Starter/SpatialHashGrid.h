@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "DynamicBVH.h"
+
+// Two proxies whose boxes overlap and whose layers collide
+struct BroadphasePair
+{
+	int proxyA; // Always the lower id
+	int proxyB;
+};
+
+// --------------------------------------------------------
+// Broadphase that buckets boxes into a uniform 3D grid
+//
+// Only occupied cells exist, found through a hash of their
+// coordinates, so the world has no bounds. Every proxy sits
+// in each cell its box touches. Move only touches the cells
+// when the box crosses into a different range of them, which
+// for small fast objects like bullets is most of the time,
+// and for slow ones hardly ever.
+//
+// Each proxy has layer bits saying what it is and mask bits
+// saying what it collides with. A pair is only reported when
+// each one's layers are in the other's mask, so bullets never
+// get tested against bullets.
+//
+// FindPairs reports every pair once, from the cell holding
+// the low corner of where the two boxes overlap, and sorts
+// them, so the list comes out the same every time for the
+// same boxes however the proxies were added and moved.
+//
+// Cells work best at about the size of the common object;
+// a box many cells across is in every one of them.
+// --------------------------------------------------------
+class SpatialHashGrid
+{
+public:
+	SpatialHashGrid(float cellSize);
+	~SpatialHashGrid();
+
+	int Add(const Aabb& box, int userData, unsigned int layers, unsigned int mask);
+	void Remove(int proxy);
+	void Move(int proxy, const Aabb& box);
+
+	int GetUserData(int proxy) const;
+	unsigned int GetLayers(int proxy) const;
+	const Aabb& GetBox(int proxy) const;
+	int GetProxyCount() const;
+	int GetCellCount() const; // Occupied cells
+
+	const std::vector<BroadphasePair>& FindPairs(); // Sorted by proxyA then proxyB, valid until the next call
+
+private:
+	struct Proxy
+	{
+		Aabb box;
+		int cellMin[3]; // Inclusive range of cells it's in
+		int cellMax[3];
+		int userData;
+		unsigned int layers;
+		unsigned int mask;
+	};
+
+	struct Cell
+	{
+		int coordinates[3];
+		std::vector<int> proxies;
+	};
+
+	float inverseCellSize; // Cells per world unit
+	std::vector<Proxy> proxies; // Indexed by proxy id
+	std::vector<int> freeProxies; // Reused first
+	std::vector<Cell> cells; // Only occupied ones, in no particular order
+	std::unordered_map<unsigned long long, int> cellOfKey;
+	std::vector<BroadphasePair> pairs;
+	int proxyCount;
+
+	void Insert(int proxy); // Into every cell of its range
+	void Erase(int proxy); // Out of every cell of its range, freeing cells that empty
+	void GetCellRange(const Aabb& box, int* cellMin, int* cellMax) const;
+	int GetCell(const float* point, int axis) const;
+	static unsigned long long Key(int x, int y, int z);
+};
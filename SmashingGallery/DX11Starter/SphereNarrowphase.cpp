@@ -0,0 +1,361 @@
+#include "SphereNarrowphase.h"
+#include <cmath>
+#include <algorithm>
+#include "SimdLanes.h"
+using namespace DirectX;
+using namespace SimdLanes;
+
+namespace
+{
+	// Overlap bits for one sphere against the lane's worth of others starting at index i
+	inline int TestLanes(Lanes cx, Lanes cy, Lanes cz, Lanes r, const SphereBatch& others, int i)
+	{
+		Lanes dx = Sub(cx, Load(&others.centerX[i]));
+		Lanes dy = Sub(cy, Load(&others.centerY[i]));
+		Lanes dz = Sub(cz, Load(&others.centerZ[i]));
+		Lanes radii = Add(r, Load(&others.radius[i]));
+		Lanes distanceSq = Add(Add(Mul(dx, dx), Mul(dy, dy)), Mul(dz, dz));
+		return Mask(NotGreater(distanceSq, Mul(radii, radii)));
+	}
+
+	// Box corner with max on the axes whose bit is set, x 1, y 2, z 4
+	inline XMFLOAT3 Corner(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, int bits)
+	{
+		return XMFLOAT3((bits & 1) ? boxMax.x : boxMin.x, (bits & 2) ? boxMax.y : boxMin.y, (bits & 4) ? boxMax.z : boxMin.z);
+	}
+
+	// Earliest of two times, where -1 is never
+	inline float Earliest(float a, float b)
+	{
+		if (a < 0.0f)
+		{
+			return b;
+		}
+		return b < 0.0f || a < b ? a : b;
+	}
+}
+
+void SweptSphereBatch::Clear()
+{
+	start.Clear();
+	moveX.clear();
+	moveY.clear();
+	moveZ.clear();
+}
+
+void SweptSphereBatch::Add(const XMFLOAT3& center, float sphereRadius, const XMFLOAT3& displacement)
+{
+	start.Add(center, sphereRadius);
+	moveX.push_back(displacement.x);
+	moveY.push_back(displacement.y);
+	moveZ.push_back(displacement.z);
+}
+
+int SweptSphereBatch::GetCount() const
+{
+	return start.GetCount();
+}
+
+bool SphereNarrowphase::Overlaps(const XMFLOAT3& centerA, float radiusA, const XMFLOAT3& centerB, float radiusB)
+{
+	float dx = centerA.x - centerB.x;
+	float dy = centerA.y - centerB.y;
+	float dz = centerA.z - centerB.z;
+	float radii = radiusA + radiusB;
+	return !(dx * dx + dy * dy + dz * dz > radii * radii);
+}
+
+int SphereNarrowphase::TestOne(const XMFLOAT3& center, float radius, const SphereBatch& others, std::vector<int>& hits)
+{
+	int count = others.GetCount();
+	hits.resize(count); // Room for all of them, trimmed at the end
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	Lanes cx = Splat(center.x), cy = Splat(center.y), cz = Splat(center.z), r = Splat(radius);
+	int* out = &hits[0];
+	int found = 0;
+	int i = 0;
+	for (; i + LaneCount <= count; i += LaneCount)
+	{
+		// Write every lane's index but only move past the hits
+		int mask = TestLanes(cx, cy, cz, r, others, i);
+		for (int lane = 0; lane < LaneCount; lane++)
+		{
+			out[found] = i + lane;
+			found += (mask >> lane) & 1;
+		}
+	}
+	for (; i < count; i++)
+	{
+		if (Overlaps(center, radius, XMFLOAT3(others.centerX[i], others.centerY[i], others.centerZ[i]), others.radius[i]))
+		{
+			out[found++] = i;
+		}
+	}
+
+	hits.resize(found);
+	return found;
+}
+
+int SphereNarrowphase::TestAll(const SphereBatch& a, const SphereBatch& b, std::vector<SphereHit>& hits)
+{
+	hits.clear();
+	int countB = b.GetCount();
+	SphereHit hit;
+	for (int i = 0; i < a.GetCount(); i++)
+	{
+		XMFLOAT3 center(a.centerX[i], a.centerY[i], a.centerZ[i]);
+		Lanes cx = Splat(center.x), cy = Splat(center.y), cz = Splat(center.z), r = Splat(a.radius[i]);
+		hit.a = i;
+		int j = 0;
+		for (; j + LaneCount <= countB; j += LaneCount)
+		{
+			// Hits are rare, so most blocks are one test and no writes
+			int mask = TestLanes(cx, cy, cz, r, b, j);
+			while (mask != 0)
+			{
+				int lane = 0;
+				while (((mask >> lane) & 1) == 0)
+				{
+					lane++;
+				}
+				hit.b = j + lane;
+				hits.push_back(hit);
+				mask &= mask - 1; // Clear the lowest bit
+			}
+		}
+		for (; j < countB; j++)
+		{
+			if (Overlaps(center, a.radius[i], XMFLOAT3(b.centerX[j], b.centerY[j], b.centerZ[j]), b.radius[j]))
+			{
+				hit.b = j;
+				hits.push_back(hit);
+			}
+		}
+	}
+	return (int)hits.size();
+}
+
+int SphereNarrowphase::TestPairs(const SphereBatch& a, const SphereBatch& b, std::vector<int>& hits)
+{
+	int count = a.GetCount();
+	hits.resize(count);
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	int* out = &hits[0];
+	int found = 0;
+	int i = 0;
+	for (; i + LaneCount <= count; i += LaneCount)
+	{
+		int mask = TestLanes(Load(&a.centerX[i]), Load(&a.centerY[i]), Load(&a.centerZ[i]), Load(&a.radius[i]), b, i);
+		for (int lane = 0; lane < LaneCount; lane++)
+		{
+			out[found] = i + lane;
+			found += (mask >> lane) & 1;
+		}
+	}
+	for (; i < count; i++)
+	{
+		if (Overlaps(XMFLOAT3(a.centerX[i], a.centerY[i], a.centerZ[i]), a.radius[i], XMFLOAT3(b.centerX[i], b.centerY[i], b.centerZ[i]), b.radius[i]))
+		{
+			out[found++] = i;
+		}
+	}
+
+	hits.resize(found);
+	return found;
+}
+
+float SphereNarrowphase::SweepSphere(const XMFLOAT3& start, const XMFLOAT3& displacement, float radius, const XMFLOAT3& center, float otherRadius)
+{
+	// Where |m + d t| reaches the sum of the radii, the smaller root of a t^2 + 2 b t + c
+	float mx = start.x - center.x;
+	float my = start.y - center.y;
+	float mz = start.z - center.z;
+	float radii = radius + otherRadius;
+	float a = displacement.x * displacement.x + displacement.y * displacement.y + displacement.z * displacement.z;
+	float b = mx * displacement.x + my * displacement.y + mz * displacement.z;
+	float c = (mx * mx + my * my + mz * mz) - radii * radii;
+	if (!(c > 0.0f))
+	{
+		return 0.0f; // Already touching, by the same test as Overlaps
+	}
+	if (b > 0.0f)
+	{
+		return -1.0f; // Moving apart
+	}
+	float t = (-b - sqrtf(b * b - a * c)) / a; // NaN if it misses or doesn't move
+	return t <= 1.0f ? t : -1.0f;
+}
+
+float SphereNarrowphase::SweepBox(const XMFLOAT3& start, const XMFLOAT3& displacement, float radius, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	const float* s = &start.x;
+	const float* d = &displacement.x;
+	const float* low = &boxMin.x;
+	const float* high = &boxMax.x;
+
+	// Already touching if the closest point of the box is within the radius
+	float distanceSq = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float outside = s[axis] < low[axis] ? low[axis] - s[axis] : (s[axis] > high[axis] ? s[axis] - high[axis] : 0.0f);
+		distanceSq += outside * outside;
+	}
+	if (distanceSq <= radius * radius)
+	{
+		return 0.0f;
+	}
+
+	// Ericson's moving sphere against a box: first where the center's path enters the box grown by the radius
+	float enter = 0.0f;
+	float exit = 1.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float slabLow = low[axis] - radius;
+		float slabHigh = high[axis] + radius;
+		if (d[axis] == 0.0f)
+		{
+			if (s[axis] < slabLow || s[axis] > slabHigh)
+			{
+				return -1.0f;
+			}
+			continue;
+		}
+		float t0 = (slabLow - s[axis]) / d[axis];
+		float t1 = (slabHigh - s[axis]) / d[axis];
+		if (t0 > t1)
+		{
+			std::swap(t0, t1);
+		}
+		enter = t0 > enter ? t0 : enter;
+		exit = t1 < exit ? t1 : exit;
+		if (enter > exit)
+		{
+			return -1.0f;
+		}
+	}
+
+	// Past the box on one axis is a face, and that's the answer. Past it on two or three
+	// the grown box's square edge or corner is really rounded, so test the edges there.
+	int below = 0;
+	int above = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float p = s[axis] + d[axis] * enter;
+		below |= p < low[axis] ? 1 << axis : 0;
+		above |= p > high[axis] ? 1 << axis : 0;
+	}
+	int outside = below | above;
+	if ((outside & (outside - 1)) == 0)
+	{
+		return enter;
+	}
+	XMFLOAT3 corner = Corner(boxMin, boxMax, above);
+	if (outside == 7)
+	{
+		float t = SweepCapsule(start, displacement, radius, corner, Corner(boxMin, boxMax, above ^ 1));
+		t = Earliest(t, SweepCapsule(start, displacement, radius, corner, Corner(boxMin, boxMax, above ^ 2)));
+		return Earliest(t, SweepCapsule(start, displacement, radius, corner, Corner(boxMin, boxMax, above ^ 4)));
+	}
+	return SweepCapsule(start, displacement, radius, corner, Corner(boxMin, boxMax, above | (7 & ~outside))); // The edge runs along the one axis it's inside on
+}
+
+float SphereNarrowphase::SweepCapsule(const XMFLOAT3& start, const XMFLOAT3& displacement, float radius, const XMFLOAT3& end0, const XMFLOAT3& end1)
+{
+	// The round ends are spheres. Anything that reaches the flat ends of the
+	// cylinder between them goes through those spheres first.
+	float t = Earliest(SweepSphere(start, displacement, radius, end0, 0.0f), SweepSphere(start, displacement, radius, end1, 0.0f));
+
+	// The side, with everything along the axis taken out
+	XMVECTOR axis = XMVectorSubtract(XMLoadFloat3(&end1), XMLoadFloat3(&end0));
+	XMVECTOR m = XMVectorSubtract(XMLoadFloat3(&start), XMLoadFloat3(&end0));
+	XMVECTOR d = XMLoadFloat3(&displacement);
+	float axisSq = XMVectorGetX(XMVector3Dot(axis, axis));
+	float mAlong = XMVectorGetX(XMVector3Dot(m, axis));
+	float dAlong = XMVectorGetX(XMVector3Dot(d, axis));
+	XMVECTOR mAcross = XMVectorSubtract(m, XMVectorScale(axis, mAlong / axisSq));
+	XMVECTOR dAcross = XMVectorSubtract(d, XMVectorScale(axis, dAlong / axisSq));
+	float a = XMVectorGetX(XMVector3Dot(dAcross, dAcross));
+	float b = XMVectorGetX(XMVector3Dot(mAcross, dAcross));
+	float c = XMVectorGetX(XMVector3Dot(mAcross, mAcross)) - radius * radius;
+	if (c <= 0.0f || b > 0.0f || a == 0.0f)
+	{
+		return t; // Starts inside the infinite cylinder or never gets closer to it, so only the ends count
+	}
+	float discriminant = b * b - a * c;
+	if (discriminant < 0.0f)
+	{
+		return t;
+	}
+	float side = (-b - sqrtf(discriminant)) / a;
+	float along = (mAlong + dAlong * side) / axisSq;
+	if (side > 1.0f || along < 0.0f || along > 1.0f)
+	{
+		return t;
+	}
+	return Earliest(t, side);
+}
+
+int SphereNarrowphase::SweepPairs(const SweptSphereBatch& a, const SphereBatch& b, std::vector<int>& hits, std::vector<float>& times)
+{
+	int count = a.GetCount();
+	hits.resize(count);
+	times.resize(count);
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	int* out = &hits[0];
+	float* outTimes = &times[0];
+	int found = 0;
+	int i = 0;
+	for (; i + LaneCount <= count; i += LaneCount)
+	{
+		// SweepSphere a lane's worth at a time, in the same order
+		Lanes dx = Load(&a.moveX[i]), dy = Load(&a.moveY[i]), dz = Load(&a.moveZ[i]);
+		Lanes mx = Sub(Load(&a.start.centerX[i]), Load(&b.centerX[i]));
+		Lanes my = Sub(Load(&a.start.centerY[i]), Load(&b.centerY[i]));
+		Lanes mz = Sub(Load(&a.start.centerZ[i]), Load(&b.centerZ[i]));
+		Lanes radii = Add(Load(&a.start.radius[i]), Load(&b.radius[i]));
+		Lanes qa = Add(Add(Mul(dx, dx), Mul(dy, dy)), Mul(dz, dz));
+		Lanes qb = Add(Add(Mul(mx, dx), Mul(my, dy)), Mul(mz, dz));
+		Lanes qc = Sub(Add(Add(Mul(mx, mx), Mul(my, my)), Mul(mz, mz)), Mul(radii, radii));
+		Lanes zero = Splat(0.0f);
+		Lanes touching = NotGreater(qc, zero);
+		Lanes t = Div(Sub(Negate(qb), Sqrt(Sub(Mul(qb, qb), Mul(qa, qc)))), qa);
+		Lanes hit = Or(touching, And(NotGreater(qb, zero), LessEqual(t, Splat(1.0f))));
+
+		float laneTimes[LaneCount];
+		Store(laneTimes, Select(touching, zero, t));
+		int mask = Mask(hit);
+		for (int lane = 0; lane < LaneCount; lane++)
+		{
+			out[found] = i + lane;
+			outTimes[found] = laneTimes[lane];
+			found += (mask >> lane) & 1;
+		}
+	}
+	for (; i < count; i++)
+	{
+		XMFLOAT3 start(a.start.centerX[i], a.start.centerY[i], a.start.centerZ[i]);
+		XMFLOAT3 displacement(a.moveX[i], a.moveY[i], a.moveZ[i]);
+		float t = SweepSphere(start, displacement, a.start.radius[i], XMFLOAT3(b.centerX[i], b.centerY[i], b.centerZ[i]), b.radius[i]);
+		if (t >= 0.0f)
+		{
+			out[found] = i;
+			outTimes[found++] = t;
+		}
+	}
+
+	hits.resize(found);
+	times.resize(found);
+	return found;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Frustum.h"
+
+// One overlap from SphereNarrowphase::TestAll
+struct SphereHit
+{
+	int a; // Index into the first batch
+	int b; // Index into the second
+};
+
+// Spheres moving in straight lines over a step, for the swept tests
+struct SweptSphereBatch
+{
+	SphereBatch start; // Where each one is at the start of the step
+	std::vector<float> moveX, moveY, moveZ; // How far each one goes by the end of it
+
+	void Clear();
+	void Add(const DirectX::XMFLOAT3& center, float sphereRadius, const DirectX::XMFLOAT3& displacement);
+	int GetCount() const;
+};
+
+// --------------------------------------------------------
+// Sphere against sphere overlap tests, several at a time
+//
+// Spheres come in SphereBatch arrays, so one sphere is tested
+// against a lane's worth of others per instruction: 8 with
+// AVX, 4 with SSE. Hits come back as a compact list of
+// indices in the order they were tested, written without a
+// branch per sphere.
+//
+// Spheres touching exactly count as a hit, like the Collider.
+// Every path does the math in the same order as Overlaps, so
+// they all give the same answer on the same spheres.
+//
+// The swept tests find when a sphere moving over a step first
+// touches something standing still, as a fraction of the step,
+// so fast bullets can't pass through a target between two
+// steps. Against a box that's the box grown by the radius,
+// with rounded edges and corners. Something already touching
+// at the start is hit at 0.
+// --------------------------------------------------------
+class SphereNarrowphase
+{
+public:
+	static bool Overlaps(const DirectX::XMFLOAT3& centerA, float radiusA, const DirectX::XMFLOAT3& centerB, float radiusB);
+
+	static int TestOne(const DirectX::XMFLOAT3& center, float radius, const SphereBatch& others, std::vector<int>& hits); // hits gets the indices into others that overlap, returns how many
+	static int TestAll(const SphereBatch& a, const SphereBatch& b, std::vector<SphereHit>& hits); // Every sphere in a against every one in b, hits ordered by a then b
+	static int TestPairs(const SphereBatch& a, const SphereBatch& b, std::vector<int>& hits); // Only a[i] against b[i], for a broadphase's candidates, hits gets each i that overlaps
+
+	static float SweepSphere(const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& displacement, float radius, const DirectX::XMFLOAT3& center, float otherRadius); // Fraction of the step at first touch, or -1 if it never does
+	static float SweepBox(const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& displacement, float radius, const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax); // The same against an axis aligned box
+	static int SweepPairs(const SweptSphereBatch& a, const SphereBatch& b, std::vector<int>& hits, std::vector<float>& times); // SweepSphere on a[i] against b[i], hits gets each i that touches and times when
+
+private:
+	static float SweepCapsule(const DirectX::XMFLOAT3& start, const DirectX::XMFLOAT3& displacement, float radius, const DirectX::XMFLOAT3& end0, const DirectX::XMFLOAT3& end1); // Against a box edge grown by the radius
+};
@@ -0,0 +1,316 @@
+#include "TangentGenerator.h"
+#include <thread>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include "SimdLanes.h"
+using namespace DirectX;
+using namespace SimdLanes;
+
+namespace
+{
+	const int MinTrisPerThread = 1 << 15; // Smaller meshes aren't worth a thread
+
+#if defined(__AVX__) || defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+	// Loads Position.xyz + UV.x and UV.y of four verts and transposes them into lanes
+	inline void GatherQuarter(const Vertex* const* v, __m128& x, __m128& y, __m128& z, __m128& u, __m128& w)
+	{
+		__m128 a = _mm_loadu_ps(&v[0]->Position.x);
+		__m128 b = _mm_loadu_ps(&v[1]->Position.x);
+		__m128 c = _mm_loadu_ps(&v[2]->Position.x);
+		__m128 d = _mm_loadu_ps(&v[3]->Position.x);
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		x = a; y = b; z = c; u = d;
+		w = _mm_setr_ps(v[0]->UV.y, v[1]->UV.y, v[2]->UV.y, v[3]->UV.y);
+	}
+#endif
+
+#if defined(__AVX__)
+	inline void Gather(const Vertex* const* v, Lanes& x, Lanes& y, Lanes& z, Lanes& u, Lanes& w)
+	{
+		__m128 x0, y0, z0, u0, w0, x1, y1, z1, u1, w1;
+		GatherQuarter(v, x0, y0, z0, u0, w0);
+		GatherQuarter(v + 4, x1, y1, z1, u1, w1);
+		x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+		y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+		z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+		u = _mm256_insertf128_ps(_mm256_castps128_ps256(u0), u1, 1);
+		w = _mm256_insertf128_ps(_mm256_castps128_ps256(w0), w1, 1);
+	}
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+	inline void Gather(const Vertex* const* v, Lanes& x, Lanes& y, Lanes& z, Lanes& u, Lanes& w) { GatherQuarter(v, x, y, z, u, w); }
+#else
+	inline void Gather(const Vertex* const* v, Lanes& x, Lanes& y, Lanes& z, Lanes& u, Lanes& w)
+	{
+		x = v[0]->Position.x; y = v[0]->Position.y; z = v[0]->Position.z; u = v[0]->UV.x; w = v[0]->UV.y;
+	}
+#endif
+
+	int ThreadCount(int count, int minPerThread)
+	{
+		int threadCount = (int)std::thread::hardware_concurrency();
+		if (threadCount > count / minPerThread) threadCount = count / minPerThread;
+		return threadCount < 1 ? 1 : threadCount;
+	}
+
+	// Runs work(first, last) over [0, count) split into contiguous ranges, one per thread
+	template<typename Work>
+	void RunRanges(int count, int minPerThread, Work work)
+	{
+		int threadCount = ThreadCount(count, minPerThread);
+
+		std::vector<std::thread> workers;
+		for (int i = 1; i < threadCount; i++)
+		{
+			workers.push_back(std::thread(work, (int)((long long)count * i / threadCount), (int)((long long)count * (i + 1) / threadCount)));
+		}
+		work(0, count / threadCount);
+		for (size_t i = 0; i < workers.size(); i++)
+		{
+			workers[i].join();
+		}
+	}
+}
+
+void TangentGenerator::Generate(Vertex* verts, int numVerts, const int* indices, int numIndices, TangentMode mode)
+{
+	int numTris = numIndices / 3;
+
+	Job job;
+	job.verts = verts;
+	job.indices = indices;
+	job.numTris = numTris;
+	job.mode = mode;
+	job.scatter = mode == TANGENTS_ACCUMULATE && ThreadCount(numTris, MinTrisPerThread) == 1;
+
+	// Single threaded, each batch of faces is added in as soon as it's
+	// done instead of being stored and making a second trip through memory
+	std::vector<float> faceX(job.scatter ? 0 : numTris), faceY(faceX.size()), faceZ(faceX.size());
+	job.faceX = faceX.empty() ? nullptr : &faceX[0];
+	job.faceY = faceY.empty() ? nullptr : &faceY[0];
+	job.faceZ = faceZ.empty() ? nullptr : &faceZ[0];
+	for (int v = 0; v < numVerts && job.scatter; v++)
+	{
+		verts[v].Tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	// Faces are split by triangle. Vertices are split by vertex, every
+	// thread walks all the faces and only adds into the vertices it owns,
+	// so there are no races and each vertex sums its faces in order.
+	const Job* shared = &job;
+	RunRanges(numTris, MinTrisPerThread, [shared](int first, int last) { FaceTangents(shared, first, last); });
+	RunRanges(numVerts, MinTrisPerThread, [shared](int first, int last) { VertexTangents(shared, first, last); });
+}
+
+void TangentGenerator::FaceTangents(const Job* job, int firstTri, int lastTri)
+{
+	Vertex* verts = job->verts;
+	const int* indices = job->indices;
+
+	for (int base = firstTri; base < lastTri; base += LaneCount)
+	{
+		// Gather one batch of triangles into SoA, padding the tail with copies of the last one
+		Vertex* corners[3][LaneCount];
+		int batchSize = lastTri - base < LaneCount ? lastTri - base : LaneCount;
+		for (int lane = 0; lane < LaneCount; lane++)
+		{
+			int tri = base + (lane < batchSize ? lane : batchSize - 1);
+			corners[0][lane] = &verts[indices[tri * 3]];
+			corners[1][lane] = &verts[indices[tri * 3 + 1]];
+			corners[2][lane] = &verts[indices[tri * 3 + 2]];
+		}
+		Lanes px[3], py[3], pz[3], u[3], v[3];
+		for (int c = 0; c < 3; c++)
+		{
+			Gather(corners[c], px[c], py[c], pz[c], u[c], v[c]);
+		}
+
+		Lanes x1 = Sub(px[1], px[0]); // Edges relative to the first corner
+		Lanes y1 = Sub(py[1], py[0]);
+		Lanes z1 = Sub(pz[1], pz[0]);
+		Lanes x2 = Sub(px[2], px[0]);
+		Lanes y2 = Sub(py[2], py[0]);
+		Lanes z2 = Sub(pz[2], pz[0]);
+
+		Lanes s1 = Sub(u[1], u[0]); // Same edges in UV space
+		Lanes t1 = Sub(v[1], v[0]);
+		Lanes s2 = Sub(u[2], u[0]);
+		Lanes t2 = Sub(v[2], v[0]);
+
+		Lanes det = Sub(Mul(s1, t2), Mul(s2, t1));
+		Lanes tx = Sub(Mul(t2, x1), Mul(t1, x2));
+		Lanes ty = Sub(Mul(t2, y1), Mul(t1, y2));
+		Lanes tz = Sub(Mul(t2, z1), Mul(t1, z2));
+
+		if (job->mode == TANGENTS_ACCUMULATE)
+		{
+			Lanes r = Div(Splat(1.0f), det); // Same operation order as the legacy loop
+			tx = Mul(tx, r);
+			ty = Mul(ty, r);
+			tz = Mul(tz, r);
+		}
+		else
+		{
+			// Unit length with the UV winding's sign, zero for degenerate faces
+			Lanes length = Sqrt(Add(Add(Mul(tx, tx), Mul(ty, ty)), Mul(tz, tz)));
+			Lanes sign = Or(And(det, Splat(-0.0f)), Splat(1.0f));
+			Lanes zero = Splat(0.0f);
+			Lanes valid = And(NotEqual(length, zero), NotEqual(det, zero));
+			Lanes scale = And(valid, Div(sign, length));
+			tx = Mul(tx, scale);
+			ty = Mul(ty, scale);
+			tz = Mul(tz, scale);
+		}
+
+		float outX[LaneCount], outY[LaneCount], outZ[LaneCount];
+		Store(outX, tx);
+		Store(outY, ty);
+		Store(outZ, tz);
+		if (!job->scatter)
+		{
+			memcpy(job->faceX + base, outX, batchSize * sizeof(float));
+			memcpy(job->faceY + base, outY, batchSize * sizeof(float));
+			memcpy(job->faceZ + base, outZ, batchSize * sizeof(float));
+		}
+		else
+		{
+			for (int lane = 0; lane < batchSize; lane++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					XMFLOAT3& tangent = corners[c][lane]->Tangent;
+					tangent.x += outX[lane];
+					tangent.y += outY[lane];
+					tangent.z += outZ[lane];
+				}
+			}
+		}
+	}
+}
+
+void TangentGenerator::VertexTangents(const Job* job, int firstVert, int lastVert)
+{
+	Vertex* verts = job->verts;
+	const int* indices = job->indices;
+	unsigned int rangeSize = (unsigned int)(lastVert - firstVert);
+
+	for (int v = firstVert; v < lastVert && !job->scatter; v++) // Scattered sums are already in place
+	{
+		verts[v].Tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	if (job->mode == TANGENTS_ACCUMULATE && !job->scatter)
+	{
+		for (int i = 0; i < job->numTris * 3; i++)
+		{
+			int v = indices[i];
+			if ((unsigned int)(v - firstVert) < rangeSize) // Skip other threads' vertices
+			{
+				int tri = i / 3;
+				verts[v].Tangent.x += job->faceX[tri];
+				verts[v].Tangent.y += job->faceY[tri];
+				verts[v].Tangent.z += job->faceZ[tri];
+			}
+		}
+	}
+	else if (job->mode == TANGENTS_MIKKTSPACE)
+	{
+		for (int i = 0; i < job->numTris * 3; i++)
+		{
+			int v = indices[i];
+			if ((unsigned int)(v - firstVert) >= rangeSize)
+			{
+				continue;
+			}
+
+			// MikkTSpace: project the face tangent into this vertex's tangent plane
+			// and weight it by the corner angle, measured in that plane too
+			int tri = i / 3;
+			int corner = i - tri * 3;
+			XMVECTOR normal = XMLoadFloat3(&verts[v].Normal);
+			XMVECTOR face = XMVectorSet(job->faceX[tri], job->faceY[tri], job->faceZ[tri], 0);
+			face = XMVector3Normalize(face - normal * XMVector3Dot(normal, face));
+
+			XMVECTOR position = XMLoadFloat3(&verts[v].Position);
+			XMVECTOR edge1 = XMLoadFloat3(&verts[indices[tri * 3 + (corner + 1) % 3]].Position) - position;
+			XMVECTOR edge2 = XMLoadFloat3(&verts[indices[tri * 3 + (corner + 2) % 3]].Position) - position;
+			edge1 = XMVector3Normalize(edge1 - normal * XMVector3Dot(normal, edge1));
+			edge2 = XMVector3Normalize(edge2 - normal * XMVector3Dot(normal, edge2));
+			float cosine = XMVectorGetX(XMVector3Dot(edge1, edge2));
+			if (cosine > 1.0f) cosine = 1.0f;
+			if (cosine < -1.0f) cosine = -1.0f;
+
+			XMVECTOR tangent = XMLoadFloat3(&verts[v].Tangent) + face * acosf(cosine);
+			XMStoreFloat3(&verts[v].Tangent, tangent);
+		}
+	}
+
+	for (int v = firstVert; v < lastVert; v++) // Ortho check
+	{
+		XMVECTOR normal = XMLoadFloat3(&verts[v].Normal);
+		XMVECTOR tangent = XMLoadFloat3(&verts[v].Tangent);
+		tangent = XMVector3Normalize(tangent - normal * XMVector3Dot(normal, tangent)); // Gram-Schmidt
+		XMStoreFloat3(&verts[v].Tangent, tangent);
+	}
+}
+
+void TangentGenerator::GenerateLegacy(Vertex* verts, int numVerts, const int* indices, int numIndices)
+{
+	for (int i = 0; i < numVerts; i++) // I fthey've changed we don't want residual
+	{
+		verts[i].Tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	for (int i = 0; i < numIndices;) // Take it one tri at a time
+	{
+		unsigned int i1 = indices[i++];
+		unsigned int i2 = indices[i++];
+		unsigned int i3 = indices[i++];
+		Vertex* v1 = &verts[i1];
+		Vertex* v2 = &verts[i2];
+		Vertex* v3 = &verts[i3];
+
+		float x1 = v2->Position.x - v1->Position.x; // Vectors relative to tri position (basically edges)
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+
+		float s1 = v2->UV.x - v1->UV.x; // Vectors relative to uv
+		float t1 = v2->UV.y - v1->UV.y;
+
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		float r = 1.0f / (s1 * t2 - s2 * t1); // Vectors for tangent calcs
+
+		float tx = (t2 * x1 - t1 * x2) * r;
+		float ty = (t2 * y1 - t1 * y2) * r;
+		float tz = (t2 * z1 - t1 * z2) * r;
+
+		v1->Tangent.x += tx; // Adjest each vert's tangents
+		v1->Tangent.y += ty;
+		v1->Tangent.z += tz;
+
+		v2->Tangent.x += tx;
+		v2->Tangent.y += ty;
+		v2->Tangent.z += tz;
+
+		v3->Tangent.x += tx;
+		v3->Tangent.y += ty;
+		v3->Tangent.z += tz;
+	}
+
+	for (int i = 0; i < numVerts; i++) // Ortho check
+	{
+		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+
+
+		tangent = XMVector3Normalize(tangent - normal * XMVector3Dot(normal, tangent)); // Gram-Schmidt
+
+		XMStoreFloat3(&verts[i].Tangent, tangent);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Vertex.h"
+
+// How per-vertex tangents are built from the triangles around them
+enum TangentMode
+{
+	TANGENTS_ACCUMULATE = 0, // Sum of unnormalized face tangents, the engine's original behavior
+	TANGENTS_MIKKTSPACE = 1 // Angle weighted, normal projected face tangents, matches MikkTSpace bakers
+};
+
+// --------------------------------------------------------
+// Tangent frame generation for indexed triangle lists
+//
+// Face tangents are computed in SIMD batches of triangles
+// (AVX, SSE or scalar depending on the build), then each
+// thread adds the faces into its own range of vertices.
+// Every vertex adds its faces in triangle order no matter how
+// the work is split, so results are bitwise identical on any
+// thread count, and ACCUMULATE matches GenerateLegacy exactly.
+//
+// Vertex has no handedness component, so MIKKTSPACE output
+// matches external bakers except across mirrored UV seams.
+// --------------------------------------------------------
+class TangentGenerator
+{
+public:
+	static void Generate(Vertex* verts, int numVerts, const int* indices, int numIndices, TangentMode mode = TANGENTS_ACCUMULATE);
+	static void GenerateLegacy(Vertex* verts, int numVerts, const int* indices, int numIndices); // Original one triangle at a time version, kept as a benchmark baseline
+
+private:
+	struct Job // Shared state for both passes
+	{
+		Vertex* verts;
+		const int* indices;
+		int numTris;
+		TangentMode mode;
+		float* faceX; // Face tangents, SoA so the batches store straight into them
+		float* faceY;
+		float* faceZ;
+		bool scatter; // Face pass adds straight into the vertices, only when it runs on one thread
+	};
+
+	static void FaceTangents(const Job* job, int firstTri, int lastTri);
+	static void VertexTangents(const Job* job, int firstVert, int lastVert);
+};
@@ -0,0 +1,622 @@
+#include "TransformStore.h"
+#include <cstring>
+#include "SimdLanes.h"
+using namespace DirectX;
+using namespace SimdLanes;
+
+namespace
+{
+	const int MinWordsPerJob = 16; // 1024 transforms, fewer aren't worth handing to another thread
+
+	// Stores a lane's worth of built matrices, at whatever width SimdLanes picked
+#if defined(__AVX__) || defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+	// Transposes the rows of four objects out of twelve lanes of columns, r[0..11] is
+	// m00 m10 m20 px m01 m11 m21 py m02 m12 m22 pz as stored (already transposed)
+	inline void StoreQuarter(XMFLOAT4X4* out, __m128* r)
+	{
+		__m128 lastRow = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+		_MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+		_MM_TRANSPOSE4_PS(r[4], r[5], r[6], r[7]);
+		_MM_TRANSPOSE4_PS(r[8], r[9], r[10], r[11]);
+		for (int i = 0; i < 4; i++)
+		{
+			float* m = &out[i].m[0][0];
+			_mm_storeu_ps(m, r[i]);
+			_mm_storeu_ps(m + 4, r[4 + i]);
+			_mm_storeu_ps(m + 8, r[8 + i]);
+			_mm_storeu_ps(m + 12, lastRow);
+		}
+	}
+#endif
+
+#if defined(__AVX__)
+	inline void StoreMatrices(XMFLOAT4X4* out, const Lanes* r)
+	{
+		__m128 low[12], high[12];
+		for (int i = 0; i < 12; i++)
+		{
+			low[i] = _mm256_castps256_ps128(r[i]);
+			high[i] = _mm256_extractf128_ps(r[i], 1);
+		}
+		StoreQuarter(out, low);
+		StoreQuarter(out + 4, high);
+	}
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+	inline void StoreMatrices(XMFLOAT4X4* out, const Lanes* r)
+	{
+		__m128 copy[12];
+		for (int i = 0; i < 12; i++)
+		{
+			copy[i] = r[i];
+		}
+		StoreQuarter(out, copy);
+	}
+#else
+	inline void StoreMatrices(XMFLOAT4X4* out, const Lanes* r)
+	{
+		*out = XMFLOAT4X4(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], r[8], r[9], r[10], r[11], 0.0f, 0.0f, 0.0f, 1.0f);
+	}
+#endif
+
+	// Scale * Rotation(quaternion) * Translation, written out as the transposed rows.
+	// Templated so the scalar leftovers share the exact same operations as the lanes.
+	template<typename T, typename Ops>
+	inline void BuildRows(T x, T y, T z, T w, T sx, T sy, T sz, T px, T py, T pz, T* r, Ops ops)
+	{
+		T one = ops.Splat(1.0f);
+		T two = ops.Splat(2.0f);
+		T xx = ops.Mul(x, x), yy = ops.Mul(y, y), zz = ops.Mul(z, z);
+		T xy = ops.Mul(x, y), xz = ops.Mul(x, z), yz = ops.Mul(y, z);
+		T wx = ops.Mul(w, x), wy = ops.Mul(w, y), wz = ops.Mul(w, z);
+
+		// Row i of the rotation scaled by scale i becomes column i of the stored matrix
+		r[0] = ops.Mul(ops.Sub(one, ops.Mul(two, ops.Add(yy, zz))), sx);
+		r[4] = ops.Mul(ops.Mul(two, ops.Add(xy, wz)), sx);
+		r[8] = ops.Mul(ops.Mul(two, ops.Sub(xz, wy)), sx);
+		r[1] = ops.Mul(ops.Mul(two, ops.Sub(xy, wz)), sy);
+		r[5] = ops.Mul(ops.Sub(one, ops.Mul(two, ops.Add(xx, zz))), sy);
+		r[9] = ops.Mul(ops.Mul(two, ops.Add(yz, wx)), sy);
+		r[2] = ops.Mul(ops.Mul(two, ops.Add(xz, wy)), sz);
+		r[6] = ops.Mul(ops.Mul(two, ops.Sub(yz, wx)), sz);
+		r[10] = ops.Mul(ops.Sub(one, ops.Mul(two, ops.Add(xx, yy))), sz);
+		r[3] = px;
+		r[7] = py;
+		r[11] = pz;
+	}
+
+	struct LaneOps
+	{
+		Lanes Splat(float f) { return SimdLanes::Splat(f); }
+		Lanes Add(Lanes a, Lanes b) { return SimdLanes::Add(a, b); }
+		Lanes Sub(Lanes a, Lanes b) { return SimdLanes::Sub(a, b); }
+		Lanes Mul(Lanes a, Lanes b) { return SimdLanes::Mul(a, b); }
+	};
+
+	struct ScalarOps
+	{
+		float Splat(float f) { return f; }
+		float Add(float a, float b) { return a + b; }
+		float Sub(float a, float b) { return a - b; }
+		float Mul(float a, float b) { return a * b; }
+	};
+
+	// Moves every element to its new slot
+	template<typename T>
+	void Permute(std::vector<T>& values, const std::vector<int>& newSlots)
+	{
+		std::vector<T> moved(values.size());
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			moved[newSlots[i]] = values[i];
+		}
+		values.swap(moved);
+	}
+}
+
+TransformStore::TransformStore()
+{
+	count = 0;
+	orderChanged = false;
+	parentedCount = 0;
+}
+
+TransformStore::~TransformStore()
+{
+}
+
+int TransformStore::Add()
+{
+	int handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (int)slotOfHandle.size();
+		slotOfHandle.push_back(-1);
+	}
+
+	int slot = count++;
+	slotOfHandle[handle] = slot;
+	handleOfSlot.push_back(handle);
+	positionX.push_back(0.0f); positionY.push_back(0.0f); positionZ.push_back(0.0f);
+	rotationX.push_back(0.0f); rotationY.push_back(0.0f); rotationZ.push_back(0.0f); rotationW.push_back(1.0f);
+	scaleX.push_back(1.0f); scaleY.push_back(1.0f); scaleZ.push_back(1.0f);
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	worldMatrices.push_back(identity);
+	previousWorldMatrices.push_back(identity);
+	parentHandles.push_back(-1);
+	childCounts.push_back(0);
+	if ((int)dirty.size() * 64 < count)
+	{
+		// Atomics can't be moved, so grow by copying the bits over
+		std::vector<std::atomic<unsigned long long>> grown(dirty.size() * 2 + 1);
+		for (size_t word = 0; word < dirty.size(); word++)
+		{
+			grown[word] = dirty[word].load();
+		}
+		for (size_t word = dirty.size(); word < grown.size(); word++)
+		{
+			grown[word] = 0;
+		}
+		dirty.swap(grown);
+	}
+	MarkDirty(slot);
+	orderChanged = true; // A root appended after the children
+	return handle;
+}
+
+void TransformStore::Remove(int handle)
+{
+	int slot = slotOfHandle[handle];
+	if (childCounts[slot] > 0)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (parentHandles[i] == handle)
+			{
+				parentHandles[i] = -1;
+				parentedCount--;
+				MarkDirty(i);
+			}
+		}
+	}
+	if (parentHandles[slot] >= 0)
+	{
+		childCounts[slotOfHandle[parentHandles[slot]]]--;
+		parentedCount--;
+	}
+
+	// Fill the hole with the last slot so the arrays stay packed
+	int last = count - 1;
+	if (slot != last)
+	{
+		positionX[slot] = positionX[last]; positionY[slot] = positionY[last]; positionZ[slot] = positionZ[last];
+		rotationX[slot] = rotationX[last]; rotationY[slot] = rotationY[last]; rotationZ[slot] = rotationZ[last]; rotationW[slot] = rotationW[last];
+		scaleX[slot] = scaleX[last]; scaleY[slot] = scaleY[last]; scaleZ[slot] = scaleZ[last];
+		worldMatrices[slot] = worldMatrices[last];
+		previousWorldMatrices[slot] = previousWorldMatrices[last];
+		parentHandles[slot] = parentHandles[last];
+		childCounts[slot] = childCounts[last];
+		if (GetDirty(last)) MarkDirty(slot); else ClearDirty(slot);
+		handleOfSlot[slot] = handleOfSlot[last];
+		slotOfHandle[handleOfSlot[slot]] = slot;
+	}
+	ClearDirty(last);
+
+	positionX.pop_back(); positionY.pop_back(); positionZ.pop_back();
+	rotationX.pop_back(); rotationY.pop_back(); rotationZ.pop_back(); rotationW.pop_back();
+	scaleX.pop_back(); scaleY.pop_back(); scaleZ.pop_back();
+	worldMatrices.pop_back();
+	previousWorldMatrices.pop_back();
+	parentHandles.pop_back();
+	childCounts.pop_back();
+	handleOfSlot.pop_back();
+	slotOfHandle[handle] = -1;
+	freeHandles.push_back(handle);
+	count--;
+	orderChanged = true;
+}
+
+int TransformStore::GetCount()
+{
+	return count;
+}
+
+bool TransformStore::SetParent(int handle, int parentHandle)
+{
+	for (int ancestor = parentHandle; ancestor >= 0; ancestor = parentHandles[slotOfHandle[ancestor]])
+	{
+		if (ancestor == handle)
+		{
+			return false;
+		}
+	}
+
+	int slot = slotOfHandle[handle];
+	if (parentHandles[slot] >= 0)
+	{
+		childCounts[slotOfHandle[parentHandles[slot]]]--;
+		parentedCount--;
+	}
+	if (parentHandle >= 0)
+	{
+		childCounts[slotOfHandle[parentHandle]]++;
+		parentedCount++;
+	}
+	parentHandles[slot] = parentHandle;
+	MarkDirty(slot);
+	orderChanged = true;
+	return true;
+}
+
+int TransformStore::GetParent(int handle)
+{
+	return parentHandles[slotOfHandle[handle]];
+}
+
+XMFLOAT3 TransformStore::GetPosition(int handle)
+{
+	int slot = slotOfHandle[handle];
+	return XMFLOAT3(positionX[slot], positionY[slot], positionZ[slot]);
+}
+
+XMFLOAT4 TransformStore::GetRotation(int handle)
+{
+	int slot = slotOfHandle[handle];
+	return XMFLOAT4(rotationX[slot], rotationY[slot], rotationZ[slot], rotationW[slot]);
+}
+
+XMFLOAT3 TransformStore::GetScale(int handle)
+{
+	int slot = slotOfHandle[handle];
+	return XMFLOAT3(scaleX[slot], scaleY[slot], scaleZ[slot]);
+}
+
+const XMFLOAT4X4& TransformStore::GetWorldMatrix(int handle)
+{
+	return worldMatrices[slotOfHandle[handle]];
+}
+
+const XMFLOAT4X4& TransformStore::GetPreviousWorldMatrix(int handle)
+{
+	return previousWorldMatrices[slotOfHandle[handle]];
+}
+
+XMFLOAT3 TransformStore::GetWorldVelocity(int handle, float deltaTime)
+{
+	const XMFLOAT4X4& now = worldMatrices[slotOfHandle[handle]];
+	const XMFLOAT4X4& before = previousWorldMatrices[slotOfHandle[handle]];
+	return XMFLOAT3((now._14 - before._14) / deltaTime, (now._24 - before._24) / deltaTime, (now._34 - before._34) / deltaTime); // Translation of the transposed matrices
+}
+
+bool TransformStore::IsDirty(int handle)
+{
+	return GetDirty(slotOfHandle[handle]);
+}
+
+void TransformStore::SetPosition(int handle, const XMFLOAT3& position)
+{
+	int slot = slotOfHandle[handle];
+	positionX[slot] = position.x;
+	positionY[slot] = position.y;
+	positionZ[slot] = position.z;
+	MarkDirty(slot);
+}
+
+void TransformStore::SetRotation(int handle, const XMFLOAT4& rotation)
+{
+	int slot = slotOfHandle[handle];
+	rotationX[slot] = rotation.x;
+	rotationY[slot] = rotation.y;
+	rotationZ[slot] = rotation.z;
+	rotationW[slot] = rotation.w;
+	MarkDirty(slot);
+}
+
+void TransformStore::SetScale(int handle, const XMFLOAT3& scale)
+{
+	int slot = slotOfHandle[handle];
+	scaleX[slot] = scale.x;
+	scaleY[slot] = scale.y;
+	scaleZ[slot] = scale.z;
+	MarkDirty(slot);
+}
+
+void TransformStore::UpdateWorldMatrix(int handle)
+{
+	// Straight from the local transforms, since the parents' stored matrices may be out of date.
+	// Their dirty bits stay set so the next batched pass still reaches their other children,
+	// and so does this one's if it has children, since they only get rebuilt through it.
+	int slot = slotOfHandle[handle];
+	XMMATRIX world = GetLocalMatrix(slot);
+	for (int ancestor = parentHandles[slot]; ancestor >= 0; ancestor = parentHandles[slotOfHandle[ancestor]])
+	{
+		world = world * GetLocalMatrix(slotOfHandle[ancestor]);
+	}
+	XMStoreFloat4x4(&worldMatrices[slot], XMMatrixTranspose(world));
+	if (childCounts[slot] == 0)
+	{
+		ClearDirty(slot);
+	}
+}
+
+int TransformStore::UpdateWorldMatrices(JobSystem* jobs)
+{
+	if (parentedCount == 0)
+	{
+		levelStarts.assign(1, 0); // Everything is a root, any order will do
+		levelStarts.push_back(count);
+		orderChanged = false;
+	}
+	else if (orderChanged)
+	{
+		SortByDepth();
+	}
+
+	int rebuilt = 0;
+	int rebuiltAbove = 0;
+	for (size_t level = 0; level + 1 < levelStarts.size(); level++)
+	{
+		int first = levelStarts[level];
+		int end = levelStarts[level + 1];
+		bool parented = level > 0;
+		bool propagate = parented && rebuiltAbove > 0;
+		int firstWord = first >> 6;
+		int wordCount = end > first ? ((end - 1) >> 6) - firstWord + 1 : 0;
+		if (jobs == nullptr || wordCount < MinWordsPerJob * 2)
+		{
+			rebuiltAbove = UpdateLevel(first, end, parented, propagate);
+		}
+		else
+		{
+			// Split on whole words, so jobs only share a dirty word at the ends of the depth
+			std::atomic<int> levelRebuilt(0);
+			jobs->ParallelFor(wordCount, MinWordsPerJob, [&](int fromWord, int toWord)
+			{
+				int from = (firstWord + fromWord) << 6;
+				int to = (firstWord + toWord) << 6;
+				levelRebuilt += UpdateLevel(from > first ? from : first, to < end ? to : end, parented, propagate);
+			});
+			rebuiltAbove = levelRebuilt;
+		}
+		rebuilt += rebuiltAbove;
+	}
+
+	for (size_t word = 0; word < dirty.size(); word++)
+	{
+		dirty[word] = 0;
+	}
+	for (size_t i = 0; i < skippedHandles.size(); i++)
+	{
+		int slot = slotOfHandle[skippedHandles[i]];
+		if (slot >= 0)
+		{
+			previousWorldMatrices[slot] = worldMatrices[slot];
+		}
+	}
+	skippedHandles.clear();
+	return rebuilt;
+}
+
+void TransformStore::SavePreviousWorldMatrices()
+{
+	previousWorldMatrices = worldMatrices;
+}
+
+void TransformStore::SkipInterpolation(int handle)
+{
+	skippedHandles.push_back(handle);
+}
+
+XMFLOAT4X4 TransformStore::Interpolate(const XMFLOAT4X4& previous, const XMFLOAT4X4& current, float t)
+{
+	if (memcmp(&previous, &current, sizeof(XMFLOAT4X4)) == 0)
+	{
+		return current; // Didn't move, the usual case
+	}
+
+	// Lerping the matrices themselves would shrink anything turning, so split them up first
+	XMVECTOR scaleA, rotationA, translationA;
+	XMVECTOR scaleB, rotationB, translationB;
+	XMFLOAT4X4 result;
+	if (!XMMatrixDecompose(&scaleA, &rotationA, &translationA, XMMatrixTranspose(XMLoadFloat4x4(&previous))) ||
+		!XMMatrixDecompose(&scaleB, &rotationB, &translationB, XMMatrixTranspose(XMLoadFloat4x4(&current))))
+	{
+		return current; // Sheared by a non-uniformly scaled parent, draw it where it is
+	}
+	XMMATRIX world = XMMatrixScalingFromVector(XMVectorLerp(scaleA, scaleB, t)) *
+		XMMatrixRotationQuaternion(XMQuaternionSlerp(rotationA, rotationB, t)) *
+		XMMatrixTranslationFromVector(XMVectorLerp(translationA, translationB, t));
+	XMStoreFloat4x4(&result, XMMatrixTranspose(world));
+	return result;
+}
+
+void TransformStore::MarkDirty(int slot)
+{
+	dirty[slot >> 6].fetch_or(1ull << (slot & 63), std::memory_order_relaxed);
+}
+
+void TransformStore::ClearDirty(int slot)
+{
+	dirty[slot >> 6].fetch_and(~(1ull << (slot & 63)), std::memory_order_relaxed);
+}
+
+bool TransformStore::GetDirty(int slot)
+{
+	return (dirty[slot >> 6].load(std::memory_order_relaxed) >> (slot & 63)) & 1;
+}
+
+void TransformStore::SortByDepth()
+{
+	// Depth of every slot, walking up only until a parent that already has one
+	std::vector<int> depths(count, -1);
+	std::vector<int> chain;
+	int deepest = 0;
+	for (int slot = 0; slot < count; slot++)
+	{
+		int current = slot;
+		while (depths[current] < 0 && parentHandles[current] >= 0)
+		{
+			chain.push_back(current);
+			current = slotOfHandle[parentHandles[current]];
+		}
+		int depth = depths[current] < 0 ? 0 : depths[current];
+		depths[current] = depth;
+		while (!chain.empty())
+		{
+			depths[chain.back()] = ++depth;
+			chain.pop_back();
+		}
+		deepest = depths[slot] > deepest ? depths[slot] : deepest;
+	}
+
+	// Counting sort, stable so the slots within a depth keep their order
+	levelStarts.assign(deepest + 2, 0);
+	for (int slot = 0; slot < count; slot++)
+	{
+		levelStarts[depths[slot] + 1]++;
+	}
+	for (int level = 0; level <= deepest; level++)
+	{
+		levelStarts[level + 1] += levelStarts[level];
+	}
+	std::vector<int> next(levelStarts.begin(), levelStarts.end() - 1);
+	std::vector<int> newSlots(count);
+	for (int slot = 0; slot < count; slot++)
+	{
+		newSlots[slot] = next[depths[slot]]++;
+	}
+
+	std::vector<char> dirtySlots(count);
+	for (int slot = 0; slot < count; slot++)
+	{
+		dirtySlots[slot] = GetDirty(slot);
+	}
+	Permute(positionX, newSlots); Permute(positionY, newSlots); Permute(positionZ, newSlots);
+	Permute(rotationX, newSlots); Permute(rotationY, newSlots); Permute(rotationZ, newSlots); Permute(rotationW, newSlots);
+	Permute(scaleX, newSlots); Permute(scaleY, newSlots); Permute(scaleZ, newSlots);
+	Permute(worldMatrices, newSlots);
+	Permute(previousWorldMatrices, newSlots);
+	Permute(parentHandles, newSlots);
+	Permute(childCounts, newSlots);
+	Permute(handleOfSlot, newSlots);
+	Permute(dirtySlots, newSlots);
+
+	parentSlots.resize(count);
+	for (int slot = 0; slot < count; slot++)
+	{
+		slotOfHandle[handleOfSlot[slot]] = slot;
+		if (dirtySlots[slot]) MarkDirty(slot); else ClearDirty(slot);
+	}
+	for (int slot = 0; slot < count; slot++)
+	{
+		parentSlots[slot] = parentHandles[slot] < 0 ? -1 : slotOfHandle[parentHandles[slot]];
+	}
+	orderChanged = false;
+}
+
+int TransformStore::UpdateLevel(int first, int end, bool parented, bool propagate)
+{
+	if (propagate)
+	{
+		// Parents are all one level up and already done, so their dirty bits are final
+		for (int slot = first; slot < end; slot++)
+		{
+			if (GetDirty(parentSlots[slot]))
+			{
+				MarkDirty(slot);
+			}
+		}
+	}
+	return UpdateRange(first, end, parented);
+}
+
+int TransformStore::UpdateRange(int first, int end, bool parented)
+{
+	const unsigned long long groupMask = (1ull << LaneCount) - 1; // LaneCount divides 64, so a group never straddles two words
+	XMFLOAT4X4 locals[LaneCount];
+	int rebuilt = 0;
+	for (int group = first - first % LaneCount; group < end; group += LaneCount)
+	{
+		unsigned long long word = dirty[group >> 6].load(std::memory_order_relaxed);
+		if (word == 0)
+		{
+			group = (group | 63) + 1 - LaneCount; // 64 clean transforms skipped at once
+			continue;
+		}
+		unsigned long long bits = (word >> (group & 63)) & groupMask;
+		if (bits == 0)
+		{
+			continue;
+		}
+
+		if (group < first || group + LaneCount > end)
+		{
+			// Shared with another depth, so only the lanes in this one
+			int from = group > first ? group : first;
+			int to = group + LaneCount < end ? group + LaneCount : end;
+			for (int slot = from; slot < to; slot++)
+			{
+				if (GetDirty(slot))
+				{
+					XMFLOAT4X4& local = parented ? locals[0] : worldMatrices[slot];
+					CalculateSlot(slot, local);
+					if (parented)
+					{
+						ApplyParent(slot, local);
+					}
+					rebuilt++;
+				}
+			}
+			continue;
+		}
+
+		// Clean lanes in a dirty group get rebuilt too, which is cheaper than masking them.
+		// Children are built to the side though, a clean child's local matrix isn't its world one.
+		Lanes r[12];
+		BuildRows(Load(&rotationX[group]), Load(&rotationY[group]), Load(&rotationZ[group]), Load(&rotationW[group]),
+			Load(&scaleX[group]), Load(&scaleY[group]), Load(&scaleZ[group]),
+			Load(&positionX[group]), Load(&positionY[group]), Load(&positionZ[group]), r, LaneOps());
+		StoreMatrices(parented ? locals : &worldMatrices[group], r);
+		for (int lane = 0; lane < LaneCount; lane++)
+		{
+			if ((bits >> lane) & 1)
+			{
+				if (parented)
+				{
+					ApplyParent(group + lane, locals[lane]);
+				}
+				rebuilt++;
+			}
+		}
+	}
+	return rebuilt;
+}
+
+void TransformStore::CalculateSlot(int slot, XMFLOAT4X4& local)
+{
+	float r[12];
+	BuildRows(rotationX[slot], rotationY[slot], rotationZ[slot], rotationW[slot],
+		scaleX[slot], scaleY[slot], scaleZ[slot],
+		positionX[slot], positionY[slot], positionZ[slot], r, ScalarOps());
+	local = XMFLOAT4X4(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], r[8], r[9], r[10], r[11], 0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void TransformStore::ApplyParent(int slot, const XMFLOAT4X4& local)
+{
+	// Both transposed, so parent * local here is local * parent in row vector terms
+	XMFLOAT4X4 parentWorld = worldMatrices[parentSlots[slot]];
+	XMStoreFloat4x4(&worldMatrices[slot], XMMatrixMultiply(XMLoadFloat4x4(&parentWorld), XMLoadFloat4x4(&local)));
+}
+
+XMMATRIX TransformStore::GetLocalMatrix(int slot)
+{
+	XMFLOAT4 rotation(rotationX[slot], rotationY[slot], rotationZ[slot], rotationW[slot]);
+	return XMMatrixScaling(scaleX[slot], scaleY[slot], scaleZ[slot]) *
+		XMMatrixRotationQuaternion(XMLoadFloat4(&rotation)) *
+		XMMatrixTranslation(positionX[slot], positionY[slot], positionZ[slot]);
+}
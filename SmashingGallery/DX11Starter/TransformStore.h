@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <DirectXMath.h>
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Position, rotation and scale of many objects, kept as
+// structure-of-arrays so one pass can rebuild every dirty
+// world matrix several objects at a time
+//
+// Setters only mark the transform dirty. UpdateWorldMatrices
+// rebuilds all of them at once, UpdateWorldMatrix just one.
+// World matrices are stored transposed, ready for the shader,
+// same as GameObject always has.
+//
+// A transform with a parent is relative to it. Slots are kept
+// sorted breadth first by depth, so parents always come before
+// their children and each depth is one contiguous range. An
+// update walks the depths in order, marks children of dirty
+// parents dirty by index, and so only touches changed subtrees.
+//
+// Callers keep handles rather than indices, since Remove and
+// the depth sort both move transforms around to stay packed.
+//
+// For drawing between fixed simulation steps, the store can
+// keep a copy of every world matrix from the step before.
+// SavePreviousWorldMatrices copies them all, so it's meant for
+// stores the size of a scene, not the benchmarks' millions.
+//
+// The setters are safe to call from several jobs at once as
+// long as each handle belongs to one job. Everything else,
+// Add, Remove, SetParent and the updates included, isn't.
+// --------------------------------------------------------
+class TransformStore
+{
+public:
+	TransformStore();
+	~TransformStore();
+
+	int Add(); // Handle of a new identity transform
+	void Remove(int handle); // Its children become roots
+	int GetCount();
+
+	bool SetParent(int handle, int parentHandle); // -1 makes it a root, false (and nothing changes) if it would make a loop
+	int GetParent(int handle);
+
+	DirectX::XMFLOAT3 GetPosition(int handle);
+	DirectX::XMFLOAT4 GetRotation(int handle); // Quaternion
+	DirectX::XMFLOAT3 GetScale(int handle);
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(int handle); // As of the last update, transposed
+	const DirectX::XMFLOAT4X4& GetPreviousWorldMatrix(int handle); // As of the last SavePreviousWorldMatrices, transposed
+	DirectX::XMFLOAT3 GetWorldVelocity(int handle, float deltaTime); // Between the previous and current world matrices, so zero until this step's update
+	bool IsDirty(int handle); // Only this transform, a moved parent doesn't show up until the next update
+
+	void SetPosition(int handle, const DirectX::XMFLOAT3& position);
+	void SetRotation(int handle, const DirectX::XMFLOAT4& rotation);
+	void SetScale(int handle, const DirectX::XMFLOAT3& scale);
+
+	void UpdateWorldMatrix(int handle); // The per-object path, one XMMATRIX at a time up the parent chain
+	int UpdateWorldMatrices(JobSystem* jobs = nullptr); // Batched SIMD pass over every dirty transform and their descendants, returns how many it rebuilt
+
+	void SavePreviousWorldMatrices(); // Once per simulation step, before anything moves
+	void SkipInterpolation(int handle); // For teleports, the previous matrix catches up at the next UpdateWorldMatrices
+	static DirectX::XMFLOAT4X4 Interpolate(const DirectX::XMFLOAT4X4& previous, const DirectX::XMFLOAT4X4& current, float t); // Transposed world matrices, rotation slerped
+
+private:
+	// One entry per live transform, indexed by slot
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> previousWorldMatrices;
+	std::vector<std::atomic<unsigned long long>> dirty; // One bit per slot, atomic so jobs can mark neighbours at once
+	std::vector<int> parentHandles; // -1 for roots
+	std::vector<int> childCounts;
+
+	std::vector<int> slotOfHandle; // -1 for removed handles
+	std::vector<int> handleOfSlot;
+	std::vector<int> freeHandles; // Reused first
+	std::vector<int> skippedHandles; // Waiting for SkipInterpolation to take effect
+	int count;
+
+	// Only valid after SortByDepth
+	std::vector<int> parentSlots; // -1 for roots
+	std::vector<int> levelStarts; // First slot of each depth, then count
+	bool orderChanged; // The hierarchy or the slots changed since the last sort
+	int parentedCount; // Transforms with a parent, none means the whole store is one depth
+
+	void MarkDirty(int slot);
+	void ClearDirty(int slot);
+	bool GetDirty(int slot);
+	void SortByDepth();
+	int UpdateLevel(int first, int end, bool parented, bool propagate); // Part of one depth, returns how many it rebuilt
+	int UpdateRange(int first, int end, bool parented); // Dirty slots of one depth, returns how many it rebuilt
+	void CalculateSlot(int slot, DirectX::XMFLOAT4X4& local); // Scalar version of one batch lane, also does the leftovers
+	void ApplyParent(int slot, const DirectX::XMFLOAT4X4& local);
+	DirectX::XMMATRIX GetLocalMatrix(int slot);
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+
+// --------------------------------------------------------
+// Lock-free handoff of whole values from one thread to another
+//
+// Three slots: the writer fills its own, the reader draws from
+// its own, and the third sits between them. Publish swaps the
+// writer's slot into the middle and Acquire swaps the middle
+// out to the reader, each with a single atomic exchange, so
+// neither side ever waits on the other. If the writer is
+// faster, frames the reader never picked up are overwritten,
+// and the reader always gets the newest finished one.
+//
+// Only one thread may write and only one may read.
+// --------------------------------------------------------
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer();
+
+	T& GetWriteSlot(); // Writer only, stays the same until the next Publish
+	void Publish(); // Writer only, hands the write slot over and starts a new one
+
+	bool Acquire(); // Reader only, true if a newer slot was published since the last call
+	T& GetReadSlot(); // Reader only, the last acquired slot
+
+private:
+	static const int IndexMask = 3;
+	static const int FreshBit = 4; // Set on the middle slot until the reader takes it
+
+	T slots[3];
+	int writing; // Only touched by the writer
+	std::atomic<int> middle; // Index plus FreshBit
+	int reading; // Only touched by the reader
+};
+
+template<typename T>
+TripleBuffer<T>::TripleBuffer()
+{
+	writing = 0;
+	middle = 1;
+	reading = 2;
+}
+
+template<typename T>
+T& TripleBuffer<T>::GetWriteSlot()
+{
+	return slots[writing];
+}
+
+template<typename T>
+void TripleBuffer<T>::Publish()
+{
+	// Release makes the slot's contents visible with it, acquire is for the slot the reader gave back
+	writing = middle.exchange(writing | FreshBit, std::memory_order_acq_rel) & IndexMask;
+}
+
+template<typename T>
+bool TripleBuffer<T>::Acquire()
+{
+	if ((middle.load(std::memory_order_relaxed) & FreshBit) == 0)
+	{
+		return false;
+	}
+	reading = middle.exchange(reading, std::memory_order_acq_rel) & IndexMask; // Only the writer sets the bit, so it's still fresh
+	return true;
+}
+
+template<typename T>
+T& TripleBuffer<T>::GetReadSlot()
+{
+	return slots[reading];
+}
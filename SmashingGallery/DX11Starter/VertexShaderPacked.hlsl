@@ -0,0 +1,67 @@
+// Same as VertexShader.hlsl, but reads PackedVertex data
+// (see PackedVertex.h) and unpacks it before doing the usual work
+
+cbuffer cameraData : register(b0)
+{
+	matrix view;
+	matrix projection;
+	matrix shadowView;
+	matrix shadowProj;
+};
+
+cbuffer perObjectData : register(b1)
+{
+	matrix world;
+	float3 positionOffset; // Undoes the position quantization, set from the Mesh
+	float3 positionScale;
+};
+
+// Layout comes from VertexPacker::CreateInputLayout, not reflection
+struct VertexShaderInput
+{
+	float4 position           : POSITION;     // R16G16B16A16_UNORM, 0-1 across the mesh bounds
+	float2 uv		          : TEXCOORD;     // R16G16_FLOAT
+	float4 normalTangent      : NORMAL;       // R8G8B8A8_SNORM, octahedral normal in xy and tangent in zw
+};
+
+struct VertexToPixel
+{
+	float4 position		      : SV_POSITION;
+	float2 uv                 : TEXCOORD;
+	float3 normal		      : NORMAL;
+	float3 tangent		      : TANGENT;
+	float4 shadowMapPosition  : POSITION1;
+};
+
+// Inverse of VertexPacker::OctEncode
+float3 OctDecode(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+	{
+		n.xy = (1.0f - abs(n.yx)) * (n.xy >= 0.0f ? 1.0f : -1.0f);
+	}
+	return normalize(n);
+}
+
+VertexToPixel main( VertexShaderInput input )
+{
+	VertexToPixel output;
+
+	float3 position = input.position.xyz * positionScale + positionOffset;
+	float3 normal = OctDecode(input.normalTangent.xy);
+	float3 tangent = OctDecode(input.normalTangent.zw);
+
+	matrix worldViewProj = mul(mul(world, view), projection);
+
+	// Shadows: Calculate where this vertex ended up in the SHADOW MAP itself
+	matrix shadowWVP = mul(mul(world, shadowView), shadowProj);
+	output.shadowMapPosition = mul(float4(position, 1.0f), shadowWVP);
+
+	output.position = mul(float4(position, 1.0f), worldViewProj);
+	output.normal = normalize(mul(normal, (float3x3)world));
+	output.tangent = normalize(mul(tangent, (float3x3)world));
+	output.uv = input.uv;
+
+	return output;
+}
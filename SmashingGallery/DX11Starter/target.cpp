@@ -1,10 +1,10 @@
 #include "target.h"
+#include "GameObject.h"
 
 
 
 target::target()
 {
-	isActive = true;
 }
 
 
@@ -15,6 +15,20 @@ target::~target()
 void target::Start(GameObject* parent)
 {
 	gameObject = parent;
+	TargetComponent component = { 0.0f, -1 };
+	GameObject::GetEntityWorld().Add(parent->GetEntity(), component);
+	ColliderComponent collider = { -1, LAYER_TARGET, LAYER_BULLET };
+	GameObject::GetEntityWorld().Add(parent->GetEntity(), collider);
+}
+
+bool target::IsActive()
+{
+	return gameObject->IsActive();
+}
+
+void target::SetActive(bool active)
+{
+	gameObject->SetActive(active);
 }
 
 void target::Update()